@@ -79,6 +79,24 @@ TEST(CuesheetTests, test_ImageAndCue_Adds2TracksWithCorrectTitles) {
     plt_free (plt);
 }
 
+TEST(CuesheetTests, test_ImageAndCueLoadedTwice_CachedCueGivesSameTracks) {
+    char path[PATH_MAX];
+    snprintf (path, sizeof (path), "%s/TestData/image+cue", dbplugindir);
+
+    for (int i = 0; i < 2; i++) {
+        playlist_t *plt = plt_alloc("test");
+
+        plt_insert_dir2(0, plt, NULL, path, NULL, NULL, NULL);
+
+        EXPECT_EQ(plt_get_item_count(plt, PL_MAIN), 2);
+        EXPECT_EQ(strcmp (pl_find_meta (plt->head[PL_MAIN], "title"), "Test Track 01"), 0);
+        EXPECT_EQ(strcmp (pl_find_meta (plt->head[PL_MAIN], "album"), "Test Album"), 0);
+        EXPECT_EQ(strcmp (pl_find_meta (plt->head[PL_MAIN]->next[PL_MAIN], "title"), "Test Track 02"), 0);
+
+        plt_free (plt);
+    }
+}
+
 TEST(CuesheetTests, test_CueWithTrackComposer_SetsCueComposerForOneTrack) {
     const char cue[] =
     "FILE \"file.wav\" WAVE\n"
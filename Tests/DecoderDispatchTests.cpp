@@ -0,0 +1,249 @@
+/*
+    DeaDBeeF -- the music player
+    Copyright (C) 2009-2023 Oleksiy Yakovenko and other contributors
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <deadbeef/deadbeef.h>
+#include "decoderdispatch.h"
+#include "plugins.h"
+#include "conf.h"
+#include <gtest/gtest.h>
+
+static DB_playItem_t *
+_dummy_insert (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) {
+    return NULL;
+}
+
+static const char *_exts_a[] = { "aaa", "bbb", NULL };
+static const char *_exts_b[] = { "BBB", NULL };
+static const char *_exts_wildcard[] = { "*", NULL };
+static const char *_prefixes_c[] = { "ccc", NULL };
+static const char *_exts_flac[] = { "flac", NULL };
+
+class DecoderDispatchTests: public ::testing::Test {
+protected:
+    void SetUp() override {
+        _init_decoder (&_dec_a, "test_a", _exts_a, NULL);
+        _init_decoder (&_dec_b, "test_b", _exts_b, NULL);
+        _init_decoder (&_dec_wildcard, "test_wildcard", _exts_wildcard, NULL);
+        _init_decoder (&_dec_c, "test_c", NULL, _prefixes_c);
+        _init_decoder (&_dec_flac, "stdflac", _exts_flac, NULL);
+
+        plug_register_in (&_dec_a.plugin);
+        plug_register_in (&_dec_b.plugin);
+        plug_register_in (&_dec_wildcard.plugin);
+        plug_register_in (&_dec_c.plugin);
+        plug_register_in (&_dec_flac.plugin);
+    }
+
+    void TearDown() override {
+        plug_remove_plugin (&_dec_a);
+        plug_remove_plugin (&_dec_b);
+        plug_remove_plugin (&_dec_wildcard);
+        plug_remove_plugin (&_dec_c);
+        plug_remove_plugin (&_dec_flac);
+        conf_remove_items ("add_files_sniff_content");
+        decoder_dispatch_configchanged ();
+    }
+
+    // Results filtered down to the decoders registered by the fixture, sniffed the same way as in plt_insert_file
+    int find (const char *fname, const char *fn, const char *ext) {
+        DB_decoder_t *all[DECODER_DISPATCH_MAX];
+        int n = decoder_dispatch_find (fn, ext, all, &_ambiguous);
+        if (n > 0 && _ambiguous) {
+            n = decoder_dispatch_sniff (fname, all, n, 0);
+        }
+        int count = 0;
+        for (int i = 0; i < n; i++) {
+            if (all[i] == &_dec_a || all[i] == &_dec_b || all[i] == &_dec_wildcard || all[i] == &_dec_c || all[i] == &_dec_flac) {
+                _found[count++] = all[i];
+            }
+        }
+        return count;
+    }
+
+    DB_decoder_t _dec_a;
+    DB_decoder_t _dec_b;
+    DB_decoder_t _dec_wildcard;
+    DB_decoder_t _dec_c;
+    DB_decoder_t _dec_flac;
+    DB_decoder_t *_found[DECODER_DISPATCH_MAX];
+    int _ambiguous;
+
+private:
+    static void _init_decoder (DB_decoder_t *dec, const char *id, const char **exts, const char **prefixes) {
+        memset (dec, 0, sizeof (DB_decoder_t));
+        dec->plugin.type = DB_PLUGIN_DECODER;
+        dec->plugin.id = id;
+        dec->exts = exts;
+        dec->prefixes = prefixes;
+        dec->insert = _dummy_insert;
+    }
+};
+
+TEST_F(DecoderDispatchTests, test_ExtensionMatch_IsCaseInsensitiveAndInListOrder) {
+    int n = find ("/music/file.Bbb", "file.Bbb", "Bbb");
+    EXPECT_EQ(n, 3);
+    EXPECT_EQ(_found[0], &_dec_a);
+    EXPECT_EQ(_found[1], &_dec_b);
+    EXPECT_EQ(_found[2], &_dec_wildcard);
+}
+
+TEST_F(DecoderDispatchTests, test_UnknownExtension_OnlyWildcard) {
+    int n = find ("/music/file.xyz", "file.xyz", "xyz");
+    EXPECT_EQ(n, 1);
+    EXPECT_EQ(_found[0], &_dec_wildcard);
+}
+
+TEST_F(DecoderDispatchTests, test_PrefixMatch_Found) {
+    int n = find ("/music/ccc.song", "ccc.song", "song");
+    EXPECT_EQ(n, 2);
+    EXPECT_EQ(_found[0], &_dec_wildcard);
+    EXPECT_EQ(_found[1], &_dec_c);
+}
+
+TEST_F(DecoderDispatchTests, test_DecoderRemoved_TableRebuilt) {
+    plug_remove_plugin (&_dec_a);
+    int n = find ("/music/file.aaa", "file.aaa", "aaa");
+    EXPECT_EQ(n, 1);
+    EXPECT_EQ(_found[0], &_dec_wildcard);
+}
+
+// writes a file with FLAC content and the given extension, which is 3 characters long
+static void
+_write_flac_file (char *path) {
+    int fd = mkstemps (path, 4);
+    ASSERT_GE(fd, 0);
+    static const char data[] = "fLaC\0\0\0\x22";
+    ASSERT_EQ(write (fd, data, sizeof (data)), (ssize_t)sizeof (data));
+    close (fd);
+}
+
+TEST_F(DecoderDispatchTests, test_FlacContentWithAmbiguousExtension_FlacDecoderFirst) {
+    char path[] = "/tmp/ddb_dispatch_XXXXXX.bbb";
+    _write_flac_file (path);
+
+    int n = find (path, strrchr (path, '/') + 1, "bbb");
+    unlink (path);
+
+    EXPECT_TRUE(_ambiguous);
+    EXPECT_EQ(n, 4);
+    EXPECT_EQ(_found[0], &_dec_flac);
+    EXPECT_EQ(_found[1], &_dec_a);
+    EXPECT_EQ(_found[2], &_dec_b);
+    EXPECT_EQ(_found[3], &_dec_wildcard);
+}
+
+TEST_F(DecoderDispatchTests, test_FlacContentWithOnlyWildcardMatch_FlacDecoderFirst) {
+    char path[] = "/tmp/ddb_dispatch_XXXXXX.xyz";
+    _write_flac_file (path);
+
+    int n = find (path, strrchr (path, '/') + 1, "xyz");
+    unlink (path);
+
+    EXPECT_TRUE(_ambiguous);
+    EXPECT_EQ(n, 2);
+    EXPECT_EQ(_found[0], &_dec_flac);
+    EXPECT_EQ(_found[1], &_dec_wildcard);
+}
+
+TEST_F(DecoderDispatchTests, test_FlacContentWithSingleDecoderExtension_NotSniffed) {
+    char path[] = "/tmp/ddb_dispatch_XXXXXX.aaa";
+    _write_flac_file (path);
+
+    int n = find (path, strrchr (path, '/') + 1, "aaa");
+    unlink (path);
+
+    EXPECT_FALSE(_ambiguous);
+    EXPECT_EQ(n, 2);
+    EXPECT_EQ(_found[0], &_dec_a);
+    EXPECT_EQ(_found[1], &_dec_wildcard);
+}
+
+TEST_F(DecoderDispatchTests, test_SniffingDisabled_ExtensionOrderOnly) {
+    conf_set_int ("add_files_sniff_content", 0);
+    decoder_dispatch_configchanged ();
+
+    char path[] = "/tmp/ddb_dispatch_XXXXXX.bbb";
+    _write_flac_file (path);
+
+    int n = find (path, strrchr (path, '/') + 1, "bbb");
+    unlink (path);
+
+    EXPECT_EQ(n, 3);
+    EXPECT_EQ(_found[0], &_dec_a);
+    EXPECT_EQ(_found[1], &_dec_b);
+    EXPECT_EQ(_found[2], &_dec_wildcard);
+}
+
+TEST_F(DecoderDispatchTests, test_FlacContentWithSingleDecoderExtension_FirstDecoderFailed_FlacDecoderNext) {
+    char path[] = "/tmp/ddb_dispatch_XXXXXX.aaa";
+    _write_flac_file (path);
+
+    DB_decoder_t *all[DECODER_DISPATCH_MAX];
+    int n = decoder_dispatch_find (strrchr (path, '/') + 1, "aaa", all, &_ambiguous);
+    ASSERT_GT(n, 0);
+    EXPECT_EQ(all[0], &_dec_a);
+
+    // as in plt_insert_file, after the decoder matching the extension has failed
+    n = decoder_dispatch_sniff (path, all, n, 1);
+    unlink (path);
+
+    EXPECT_EQ(all[0], &_dec_a);
+    EXPECT_EQ(all[1], &_dec_flac);
+    int wildcard_pos = -1;
+    for (int i = 0; i < n; i++) {
+        if (all[i] == &_dec_wildcard) {
+            wildcard_pos = i;
+        }
+    }
+    EXPECT_GT(wildcard_pos, 1);
+}
+
+TEST_F(DecoderDispatchTests, test_FlacContent_FlacDecoderAlreadyFailed_OrderUnchanged) {
+    char path[] = "/tmp/ddb_dispatch_XXXXXX.flac";
+    int fd = mkstemps (path, 5);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(write (fd, "fLaC", 4), 4);
+    close (fd);
+
+    DB_decoder_t *all[DECODER_DISPATCH_MAX];
+    int n = decoder_dispatch_find (strrchr (path, '/') + 1, "flac", all, &_ambiguous);
+    int flac_pos = -1;
+    for (int i = 0; i < n; i++) {
+        if (all[i] == &_dec_flac) {
+            flac_pos = i;
+        }
+    }
+    ASSERT_GE(flac_pos, 0);
+
+    int n2 = decoder_dispatch_sniff (path, all, n, flac_pos + 1);
+    unlink (path);
+
+    EXPECT_EQ(n2, n);
+    EXPECT_EQ(all[flac_pos], &_dec_flac);
+    for (int i = flac_pos + 1; i < n; i++) {
+        EXPECT_NE(all[i], &_dec_flac);
+    }
+}
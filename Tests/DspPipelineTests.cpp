@@ -0,0 +1,139 @@
+/*
+    DeaDBeeF -- the music player
+    Copyright (C) 2009-2023 Oleksiy Yakovenko and other contributors
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "dsppipeline.h"
+#include <gtest/gtest.h>
+
+typedef struct {
+    ddb_dsp_context_t ctx;
+    float state[2];
+} lowpass_ctx_t;
+
+// one-pole lowpass, which carries its state from one call to the next
+static int
+_lowpass_process (ddb_dsp_context_t *ctx, float *samples, int frames, int maxframes, ddb_waveformat_t *fmt, float *ratio) {
+    lowpass_ctx_t *lp = (lowpass_ctx_t *)ctx;
+    for (int i = 0; i < frames; i++) {
+        for (int c = 0; c < fmt->channels; c++) {
+            float *s = &samples[i * fmt->channels + c];
+            lp->state[c] += (*s - lp->state[c]) * 0.1f;
+            *s = lp->state[c];
+        }
+    }
+    return frames;
+}
+
+// doubles the samplerate by repeating each frame
+static int
+_upsample_process (ddb_dsp_context_t *ctx, float *samples, int frames, int maxframes, ddb_waveformat_t *fmt, float *ratio) {
+    if (frames * 2 > maxframes) {
+        return frames;
+    }
+    for (int i = frames - 1; i >= 0; i--) {
+        for (int c = 0; c < fmt->channels; c++) {
+            samples[(i * 2 + 1) * fmt->channels + c] = samples[i * fmt->channels + c];
+            samples[i * 2 * fmt->channels + c] = samples[i * fmt->channels + c];
+        }
+    }
+    fmt->samplerate *= 2;
+    *ratio = 0.5f;
+    return frames * 2;
+}
+
+class DspPipelineTests: public ::testing::Test {
+protected:
+    void SetUp() override {
+        dsp_pipeline_init ();
+
+        _lowpass_plugin.plugin.id = "lowpass";
+        _lowpass_plugin.process = _lowpass_process;
+        _upsample_plugin.plugin.id = "upsample";
+        _upsample_plugin.process = _upsample_process;
+
+        _lowpass1.ctx.plugin = &_lowpass_plugin;
+        _lowpass1.ctx.enabled = 1;
+        _lowpass1.ctx.next = &_upsample;
+        _upsample.plugin = &_upsample_plugin;
+        _upsample.enabled = 1;
+        _upsample.next = &_lowpass2.ctx;
+        _lowpass2.ctx.plugin = &_lowpass_plugin;
+        _lowpass2.ctx.enabled = 1;
+    }
+
+    void TearDown() override {
+        dsp_pipeline_free ();
+    }
+
+    void resetState() {
+        memset (_lowpass1.state, 0, sizeof (_lowpass1.state));
+        memset (_lowpass2.state, 0, sizeof (_lowpass2.state));
+    }
+
+    // processes several consecutive blocks of a sawtooth, and returns the concatenated output
+    std::vector<float> processBlocks(int threaded, int nframes, int maxframes, ddb_waveformat_t *out_fmt) {
+        dsp_pipeline_set_threaded (threaded);
+        resetState ();
+        std::vector<float> output;
+        std::vector<float> buffer (maxframes * 2);
+        for (int block = 0; block < 3; block++) {
+            for (int i = 0; i < nframes * 2; i++) {
+                buffer[i] = (float)((block * nframes * 2 + i) % 101) / 100;
+            }
+            ddb_waveformat_t fmt = { .bps = 32, .channels = 2, .samplerate = 44100, .channelmask = 3, .is_float = 1 };
+            float ratio = 1;
+            int res = dsp_pipeline_process (&_lowpass1.ctx, buffer.data (), nframes, maxframes, &fmt, &ratio);
+            EXPECT_EQ(res, nframes * 2);
+            EXPECT_EQ(ratio, 0.5f);
+            *out_fmt = fmt;
+            output.insert (output.end (), buffer.begin (), buffer.begin () + res * 2);
+        }
+        return output;
+    }
+
+    DB_dsp_t _lowpass_plugin = {};
+    DB_dsp_t _upsample_plugin = {};
+    lowpass_ctx_t _lowpass1 = {};
+    ddb_dsp_context_t _upsample = {};
+    lowpass_ctx_t _lowpass2 = {};
+};
+
+TEST_F(DspPipelineTests, test_Process_Threaded_SameOutputAsSequential) {
+    ddb_waveformat_t fmt_sequential, fmt_threaded;
+    std::vector<float> sequential = processBlocks (0, 4000, 8000, &fmt_sequential);
+    std::vector<float> threaded = processBlocks (1, 4000, 8000, &fmt_threaded);
+
+    EXPECT_EQ(fmt_sequential.samplerate, 88200);
+    EXPECT_EQ(fmt_threaded.samplerate, 88200);
+    ASSERT_EQ(sequential.size (), threaded.size ());
+    EXPECT_EQ(0, memcmp (sequential.data (), threaded.data (), sequential.size () * sizeof (float)));
+}
+
+TEST_F(DspPipelineTests, test_Process_ThreadedUnevenChunks_SameOutputAsSequential) {
+    // the last chunk is shorter than the others, and the chunks only have exactly enough room to grow
+    ddb_waveformat_t fmt_sequential, fmt_threaded;
+    std::vector<float> sequential = processBlocks (0, 2053, 4106, &fmt_sequential);
+    std::vector<float> threaded = processBlocks (1, 2053, 4106, &fmt_threaded);
+
+    ASSERT_EQ(sequential.size (), threaded.size ());
+    EXPECT_EQ(0, memcmp (sequential.data (), threaded.data (), sequential.size () * sizeof (float)));
+}
@@ -24,6 +24,8 @@
 #include <deadbeef/deadbeef.h>
 #include "premix.h"
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <math.h>
 
 TEST(FormatConversionTests, testConvertFromStereoToBackLeftBackRight_AllSamplesDiscarded) {
     int16_t samples[4] = { 0x1000, 0x2000, 0x3000, 0x4000 };
@@ -76,3 +78,194 @@ TEST(FormatConversionTests, testConvertFromStereoToBackLeftFrontRight_LeftChanne
     EXPECT_TRUE(outsamples[2] == 0);
     EXPECT_TRUE(outsamples[3] == 0x4000);
 }
+
+// Scalar reference for pcm_convert_with_gain: every sample goes through float, scaled by the gain,
+// and is rounded to nearest and clipped when stored as an integer.
+static float
+_reference_load (const ddb_waveformat_t *fmt, const char *p) {
+    if (fmt->is_float) {
+        return *(const float *)p;
+    }
+    switch (fmt->bps) {
+    case 8:
+        return *(const int8_t *)p / (float)0x80;
+    case 16:
+        return *(const int16_t *)p / (float)0x8000;
+    case 24: {
+        const uint8_t *b = (const uint8_t *)p;
+        return (int32_t)(b[0] | (b[1]<<8) | ((int8_t)b[2]<<16)) / (float)0x800000;
+    }
+    default:
+        return *(const int32_t *)p / (float)0x80000000;
+    }
+}
+
+static void
+_reference_store (const ddb_waveformat_t *fmt, float sample, float gain, char *p) {
+    if (fmt->is_float) {
+        *(float *)p = sample * gain;
+        return;
+    }
+    switch (fmt->bps) {
+    case 8:
+        *(int8_t *)p = (int8_t)std::min (0x7fL, std::max (-0x80L, lrintf (sample * gain * 0x80)));
+        break;
+    case 16:
+        *(int16_t *)p = (int16_t)std::min (0x7fffL, std::max (-0x8000L, lrintf (sample * gain * 0x8000)));
+        break;
+    case 24: {
+        int32_t s = (int32_t)std::min (0x7fffffL, std::max (-0x800000L, lrintf (sample * gain * 0x800000)));
+        uint8_t *b = (uint8_t *)p;
+        b[0] = s & 0xff;
+        b[1] = (s >> 8) & 0xff;
+        b[2] = (s >> 16) & 0xff;
+        break;
+    }
+    default: {
+        float s = sample * gain;
+        *(int32_t *)p = s >= 1.f ? INT32_MAX : (s <= -1.f ? INT32_MIN : (int32_t)lrintf (s * (float)0x80000000));
+        break;
+    }
+    }
+}
+
+// Odd length, spanning several internal chunks, so that the vectorized loops and their tails are both covered
+#define REFERENCE_NUM_SAMPLES 5003
+
+static void
+_fill_reference_input (const ddb_waveformat_t *fmt, char *buffer) {
+    ddb_waveformat_t float_fmt = *fmt;
+    float_fmt.bps = 32;
+    float_fmt.is_float = 1;
+    float samples[REFERENCE_NUM_SAMPLES];
+    uint32_t seed = 12345;
+    for (int i = 0; i < REFERENCE_NUM_SAMPLES; i++) {
+        seed = seed * 1664525 + 1013904223;
+        // up to 1.5 in float, to check the clipping, and the full range otherwise
+        samples[i] = ((int32_t)seed / (float)0x80000000) * (fmt->is_float ? 1.5f : 1.f);
+    }
+    samples[0] = fmt->is_float ? 1.f : 0.999f;
+    samples[1] = -1.f;
+    samples[2] = 0.5f / 0x8000; // rounding boundaries
+    samples[3] = -0.5f / 0x8000;
+    if (fmt->is_float) {
+        memcpy (buffer, samples, sizeof (samples));
+    }
+    else {
+        pcm_convert (&float_fmt, (const char *)samples, fmt, buffer, sizeof (samples));
+    }
+}
+
+static void
+_expect_matches_reference (int in_bps, int in_float, int out_bps, int out_float, float gain) {
+    ddb_waveformat_t inputfmt = {
+        .bps = in_bps,
+        .channels = 1,
+        .samplerate = 44100,
+        .channelmask = DDB_SPEAKER_FRONT_LEFT,
+        .is_float = in_float,
+    };
+    ddb_waveformat_t outputfmt = inputfmt;
+    outputfmt.bps = out_bps;
+    outputfmt.is_float = out_float;
+
+    int in_ss = in_bps / 8;
+    int out_ss = out_bps / 8;
+    char *input = (char *)malloc (REFERENCE_NUM_SAMPLES * in_ss);
+    char *output = (char *)malloc (REFERENCE_NUM_SAMPLES * out_ss);
+    char *expected = (char *)malloc (REFERENCE_NUM_SAMPLES * out_ss);
+    _fill_reference_input (&inputfmt, input);
+
+    for (int i = 0; i < REFERENCE_NUM_SAMPLES; i++) {
+        _reference_store (&outputfmt, _reference_load (&inputfmt, input + i * in_ss), gain, expected + i * out_ss);
+    }
+
+    int res = pcm_convert_with_gain (&inputfmt, input, &outputfmt, output, REFERENCE_NUM_SAMPLES * in_ss, gain);
+    EXPECT_EQ(res, REFERENCE_NUM_SAMPLES * out_ss);
+    int mismatch = -1;
+    for (int i = 0; i < REFERENCE_NUM_SAMPLES; i++) {
+        if (memcmp (output + i * out_ss, expected + i * out_ss, out_ss)) {
+            mismatch = i;
+            break;
+        }
+    }
+    EXPECT_EQ(mismatch, -1) << in_bps << (in_float ? "f" : "") << " -> " << out_bps << (out_float ? "f" : "") << ", gain " << gain;
+
+    free (input);
+    free (output);
+    free (expected);
+}
+
+static const struct {
+    int bps;
+    int is_float;
+} reference_formats[] = {
+    { 8, 0 },
+    { 16, 0 },
+    { 24, 0 },
+    { 32, 0 },
+    { 32, 1 },
+};
+
+static void
+_expect_all_formats_match_reference (float gain) {
+    for (auto &in : reference_formats) {
+        for (auto &out : reference_formats) {
+            if (in.bps == 32 && !in.is_float && out.bps == 32 && !out.is_float) {
+                continue; // scaled in fixed point, see testConvertWithGain_Int32ToInt32
+            }
+            _expect_matches_reference (in.bps, in.is_float, out.bps, out.is_float, gain);
+        }
+    }
+}
+
+TEST(FormatConversionTests, testConvertWithGain_UnityGain_MatchesReference) {
+    _expect_all_formats_match_reference (1.f);
+}
+
+TEST(FormatConversionTests, testConvertWithGain_Attenuation_MatchesReference) {
+    _expect_all_formats_match_reference (0.37f);
+}
+
+TEST(FormatConversionTests, testConvertWithGain_Amplification_MatchesReferenceAndClips) {
+    _expect_all_formats_match_reference (1.9f);
+}
+
+TEST(FormatConversionTests, testConvertWithGain_FloatOutput_NotClipped) {
+    float samples[2] = { 0.8f, -0.9f };
+    float outsamples[2] = { 0, 0 };
+
+    ddb_waveformat_t fmt = {
+        .bps = 32,
+        .channels = 2,
+        .samplerate = 44100,
+        .channelmask = DDB_SPEAKER_FRONT_LEFT|DDB_SPEAKER_FRONT_RIGHT,
+        .is_float = 1,
+    };
+
+    pcm_convert_with_gain (&fmt, (const char *)samples, &fmt, (char *)outsamples, sizeof (samples), 2.f);
+    EXPECT_EQ(outsamples[0], 1.6f);
+    EXPECT_EQ(outsamples[1], -1.8f);
+}
+
+TEST(FormatConversionTests, testConvertWithGain_Int32ToInt32) {
+    int32_t samples[4] = { 0x40000000, -0x40000000, INT32_MAX, INT32_MIN };
+    int32_t outsamples[4] = { 0, 0, 0, 0 };
+
+    ddb_waveformat_t fmt = {
+        .bps = 32,
+        .channels = 2,
+        .samplerate = 44100,
+        .channelmask = DDB_SPEAKER_FRONT_LEFT|DDB_SPEAKER_FRONT_RIGHT,
+    };
+
+    pcm_convert_with_gain (&fmt, (const char *)samples, &fmt, (char *)outsamples, sizeof (samples), 0.5f);
+    EXPECT_EQ(outsamples[0], 0x20000000);
+    EXPECT_EQ(outsamples[1], -0x20000000);
+
+    pcm_convert_with_gain (&fmt, (const char *)samples, &fmt, (char *)outsamples, sizeof (samples), 4.f);
+    EXPECT_EQ(outsamples[0], INT32_MAX);
+    EXPECT_EQ(outsamples[1], INT32_MIN);
+    EXPECT_EQ(outsamples[2], INT32_MAX);
+    EXPECT_EQ(outsamples[3], INT32_MIN);
+}
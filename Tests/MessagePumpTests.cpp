@@ -0,0 +1,164 @@
+/*
+    DeaDBeeF -- the music player
+    Copyright (C) 2009-2023 Oleksiy Yakovenko and other contributors
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "messagepump.h"
+#include "playlist.h"
+#include <gtest/gtest.h>
+
+class MessagePumpTests: public ::testing::Test {
+protected:
+    void SetUp() override {
+        messagepump_init ();
+        for (int i = 0; i < 3; i++) {
+            _tracks[i] = pl_item_alloc ();
+        }
+    }
+
+    void TearDown() override {
+        uint32_t id;
+        uintptr_t ctx;
+        uint32_t p1;
+        uint32_t p2;
+        while (messagepump_pop (&id, &ctx, &p1, &p2) != -1) {
+            if (id >= DB_EV_FIRST && ctx) {
+                messagepump_event_free ((ddb_event_t *)ctx);
+            }
+        }
+        messagepump_free ();
+        for (int i = 0; i < 3; i++) {
+            pl_item_unref (_tracks[i]);
+        }
+    }
+
+    void sendTrackInfoChanged (playItem_t *track, uint32_t p1) {
+        ddb_event_track_t *ev = (ddb_event_track_t *)messagepump_event_alloc (DB_EV_TRACKINFOCHANGED);
+        ev->track = DB_PLAYITEM (track);
+        pl_item_ref (track);
+        messagepump_push_event ((ddb_event_t *)ev, p1, 0);
+    }
+
+    playItem_t *_tracks[3];
+};
+
+TEST_F(MessagePumpTests, test_TrackInfoChangedSingleTrack_DeliveredAsTrackInfoChanged) {
+    sendTrackInfoChanged (_tracks[0], 0);
+
+    uint32_t id;
+    uintptr_t ctx;
+    uint32_t p1;
+    uint32_t p2;
+    EXPECT_EQ (messagepump_pop (&id, &ctx, &p1, &p2), 0);
+    EXPECT_EQ (id, DB_EV_TRACKINFOCHANGED);
+    EXPECT_EQ (((ddb_event_track_t *)ctx)->track, DB_PLAYITEM (_tracks[0]));
+    messagepump_event_free ((ddb_event_t *)ctx);
+    EXPECT_EQ (messagepump_pop (&id, &ctx, &p1, &p2), -1);
+}
+
+TEST_F(MessagePumpTests, test_TrackInfoChangedMultipleTracks_CoalescedIntoOneEvent) {
+    sendTrackInfoChanged (_tracks[0], 0);
+    sendTrackInfoChanged (_tracks[1], 0);
+    sendTrackInfoChanged (_tracks[0], 0);
+    sendTrackInfoChanged (_tracks[2], 0);
+
+    uint32_t id;
+    uintptr_t ctx;
+    uint32_t p1;
+    uint32_t p2;
+    EXPECT_EQ (messagepump_pop (&id, &ctx, &p1, &p2), 0);
+    EXPECT_EQ (id, DB_EV_TRACKSINFOCHANGED);
+    ddb_event_tracks_t *ev = (ddb_event_tracks_t *)ctx;
+    EXPECT_EQ (ev->count, 3);
+    EXPECT_EQ (ev->tracks[0], DB_PLAYITEM (_tracks[0]));
+    EXPECT_EQ (ev->tracks[1], DB_PLAYITEM (_tracks[1]));
+    EXPECT_EQ (ev->tracks[2], DB_PLAYITEM (_tracks[2]));
+    messagepump_event_free ((ddb_event_t *)ctx);
+    EXPECT_EQ (messagepump_pop (&id, &ctx, &p1, &p2), -1);
+}
+
+TEST_F(MessagePumpTests, test_TrackInfoChangedAroundOtherMessage_OrderPreserved) {
+    sendTrackInfoChanged (_tracks[0], 0);
+    sendTrackInfoChanged (_tracks[1], 0);
+    messagepump_push (DB_EV_PLAYLISTSWITCHED, 0, 0, 0);
+    sendTrackInfoChanged (_tracks[0], 0);
+    sendTrackInfoChanged (_tracks[2], 0);
+
+    uint32_t id;
+    uintptr_t ctx;
+    uint32_t p1;
+    uint32_t p2;
+    EXPECT_EQ (messagepump_pop (&id, &ctx, &p1, &p2), 0);
+    EXPECT_EQ (id, DB_EV_TRACKSINFOCHANGED);
+    ddb_event_tracks_t *ev = (ddb_event_tracks_t *)ctx;
+    EXPECT_EQ (ev->count, 2);
+    EXPECT_EQ (ev->tracks[0], DB_PLAYITEM (_tracks[0]));
+    EXPECT_EQ (ev->tracks[1], DB_PLAYITEM (_tracks[1]));
+    messagepump_event_free ((ddb_event_t *)ctx);
+
+    // the changes made after the message are not moved ahead of it
+    EXPECT_EQ (messagepump_pop (&id, &ctx, &p1, &p2), 0);
+    EXPECT_EQ (id, DB_EV_PLAYLISTSWITCHED);
+
+    EXPECT_EQ (messagepump_pop (&id, &ctx, &p1, &p2), 0);
+    EXPECT_EQ (id, DB_EV_TRACKSINFOCHANGED);
+    ev = (ddb_event_tracks_t *)ctx;
+    EXPECT_EQ (ev->count, 2);
+    EXPECT_EQ (ev->tracks[0], DB_PLAYITEM (_tracks[0]));
+    EXPECT_EQ (ev->tracks[1], DB_PLAYITEM (_tracks[2]));
+    messagepump_event_free ((ddb_event_t *)ctx);
+
+    EXPECT_EQ (messagepump_pop (&id, &ctx, &p1, &p2), -1);
+}
+
+TEST_F(MessagePumpTests, test_TrackInfoChangedWithPlayqueueChange_NotCoalesced) {
+    sendTrackInfoChanged (_tracks[0], DDB_PLAYLIST_CHANGE_PLAYQUEUE);
+    sendTrackInfoChanged (_tracks[1], DDB_PLAYLIST_CHANGE_PLAYQUEUE);
+
+    uint32_t id;
+    uintptr_t ctx;
+    uint32_t p1;
+    uint32_t p2;
+    for (int i = 0; i < 2; i++) {
+        EXPECT_EQ (messagepump_pop (&id, &ctx, &p1, &p2), 0);
+        EXPECT_EQ (id, DB_EV_TRACKINFOCHANGED);
+        EXPECT_EQ (p1, DDB_PLAYLIST_CHANGE_PLAYQUEUE);
+        EXPECT_EQ (((ddb_event_track_t *)ctx)->track, DB_PLAYITEM (_tracks[i]));
+        messagepump_event_free ((ddb_event_t *)ctx);
+    }
+}
+
+TEST_F(MessagePumpTests, test_TrackInfoChangedAfterPop_StartsNewBatch) {
+    sendTrackInfoChanged (_tracks[0], 0);
+
+    uint32_t id;
+    uintptr_t ctx;
+    uint32_t p1;
+    uint32_t p2;
+    EXPECT_EQ (messagepump_pop (&id, &ctx, &p1, &p2), 0);
+    messagepump_event_free ((ddb_event_t *)ctx);
+
+    sendTrackInfoChanged (_tracks[0], 0);
+    EXPECT_EQ (messagepump_pop (&id, &ctx, &p1, &p2), 0);
+    EXPECT_EQ (id, DB_EV_TRACKINFOCHANGED);
+    EXPECT_EQ (((ddb_event_track_t *)ctx)->track, DB_PLAYITEM (_tracks[0]));
+    messagepump_event_free ((ddb_event_t *)ctx);
+}
@@ -0,0 +1,185 @@
+/*
+    DeaDBeeF -- the music player
+    Copyright (C) 2009-2023 Oleksiy Yakovenko and other contributors
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "pcmpack.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <stdlib.h>
+
+// The throughput tests are disabled, so that they don't slow down the normal test run.
+// Run them with --gtest_also_run_disabled_tests --gtest_filter='PcmPackBenchmarks.*'
+
+#define NUM_FRAMES 4096
+#define MAX_CHANNELS 8
+#define NUM_ITERATIONS 20000
+
+class PcmPackBenchmarks: public ::testing::Test {
+protected:
+    void SetUp() override {
+        for (int c = 0; c < MAX_CHANNELS; c++) {
+            planes[c] = (int32_t *)malloc (NUM_FRAMES * sizeof (int32_t));
+            for (int i = 0; i < NUM_FRAMES; i++) {
+                planes[c][i] = (int32_t)((rand () & 0xffffff) - 0x800000);
+            }
+        }
+        output = (char *)malloc (NUM_FRAMES * MAX_CHANNELS * 4);
+        expected = (char *)malloc (NUM_FRAMES * MAX_CHANNELS * 4);
+    }
+
+    void TearDown() override {
+        for (int c = 0; c < MAX_CHANNELS; c++) {
+            free (planes[c]);
+        }
+        free (output);
+        free (expected);
+    }
+
+    // Limits the samples to the range of the bit depth, as decoders would output
+    void clampPlanes (int bps) {
+        for (int c = 0; c < MAX_CHANNELS; c++) {
+            for (int i = 0; i < NUM_FRAMES; i++) {
+                planes[c][i] = (int32_t)((uint32_t)planes[c][i] << (32 - bps)) >> (32 - bps);
+            }
+        }
+    }
+
+    // Per-sample reference implementation, like the decoders had before
+    void packReference (char *out, int channels, int nframes, int bps, int shift) {
+        for (int i = 0; i < nframes; i++) {
+            for (int c = 0; c < channels; c++) {
+                int32_t sample = (int32_t)((uint32_t)planes[c][i] << shift);
+                for (int b = 0; b < bps / 8; b++) {
+                    *out++ = (char)(sample >> (b * 8));
+                }
+            }
+        }
+    }
+
+    void verifyPlanarPack (int channels, int nframes, int bps, int shift) {
+        ddb_pcm_pack_planar_int32 (output, planes, channels, nframes, bps, shift);
+        packReference (expected, channels, nframes, bps, shift);
+        EXPECT_TRUE(!memcmp (expected, output, nframes * channels * bps / 8));
+    }
+
+    // Returns the throughput in MB/s of output data
+    double measurePlanarPack (int channels, int bps, int reference) {
+        int64_t total = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < NUM_ITERATIONS; i++) {
+            if (reference) {
+                packReference (output, channels, NUM_FRAMES, bps, 0);
+            }
+            else {
+                ddb_pcm_pack_planar_int32 (output, planes, channels, NUM_FRAMES, bps, 0);
+            }
+            total += NUM_FRAMES * channels * bps / 8;
+        }
+        auto end = std::chrono::steady_clock::now();
+        double sec = std::chrono::duration<double>(end - start).count();
+        return total / sec / (1024 * 1024);
+    }
+
+    int32_t *planes[MAX_CHANNELS];
+    char *output;
+    char *expected;
+};
+
+TEST_F(PcmPackBenchmarks, test_PackPlanarStereo16_MatchesReference) {
+    clampPlanes (16);
+    verifyPlanarPack (2, NUM_FRAMES, 16, 0);
+    verifyPlanarPack (2, 13, 16, 0);
+}
+
+TEST_F(PcmPackBenchmarks, test_PackPlanarStereo16Shifted_MatchesReference) {
+    clampPlanes (12);
+    verifyPlanarPack (2, NUM_FRAMES - 3, 16, 4);
+}
+
+TEST_F(PcmPackBenchmarks, test_PackPlanar24_MatchesReference) {
+    for (int channels = 1; channels <= MAX_CHANNELS; channels++) {
+        verifyPlanarPack (channels, NUM_FRAMES, 24, 0);
+        verifyPlanarPack (channels, 1, 24, 0);
+    }
+}
+
+TEST_F(PcmPackBenchmarks, test_PackPlanar32_MatchesReference) {
+    for (int channels = 1; channels <= MAX_CHANNELS; channels++) {
+        verifyPlanarPack (channels, NUM_FRAMES - 1, 32, 0);
+    }
+    clampPlanes (20);
+    verifyPlanarPack (2, NUM_FRAMES, 32, 4);
+}
+
+TEST_F(PcmPackBenchmarks, test_PackPlanar8_MatchesReference) {
+    clampPlanes (8);
+    verifyPlanarPack (3, NUM_FRAMES, 8, 0);
+}
+
+TEST_F(PcmPackBenchmarks, test_PackInterleaved16_MatchesReference) {
+    clampPlanes (16);
+    ddb_pcm_pack_int32 (output, planes[0], NUM_FRAMES - 5, 16);
+    for (int i = 0; i < NUM_FRAMES - 5; i++) {
+        EXPECT_EQ(((int16_t *)output)[i], planes[0][i]);
+    }
+}
+
+TEST_F(PcmPackBenchmarks, test_InterleaveFloatStereo_MatchesReference) {
+    const void *float_planes[2] = { planes[0], planes[1] };
+    ddb_pcm_interleave (output, float_planes, 2, NUM_FRAMES - 7, 4);
+    for (int i = 0; i < NUM_FRAMES - 7; i++) {
+        EXPECT_EQ(((int32_t *)output)[i*2], planes[0][i]);
+        EXPECT_EQ(((int32_t *)output)[i*2+1], planes[1][i]);
+    }
+}
+
+TEST_F(PcmPackBenchmarks, test_Interleave16Stereo_MatchesReference) {
+    const void *planes16[2] = { planes[0], planes[1] };
+    ddb_pcm_interleave (output, planes16, 2, NUM_FRAMES - 3, 2);
+    for (int i = 0; i < NUM_FRAMES - 3; i++) {
+        EXPECT_EQ(((int16_t *)output)[i*2], ((int16_t *)planes[0])[i]);
+        EXPECT_EQ(((int16_t *)output)[i*2+1], ((int16_t *)planes[1])[i]);
+    }
+}
+
+TEST_F(PcmPackBenchmarks, test_RemapChannels_ReordersChannels) {
+    const uint8_t map[3] = { 2, 0, 1 };
+    ddb_pcm_remap_channels (output, (const char *)planes[0], 3, 100, 4, map);
+    for (int i = 0; i < 100; i++) {
+        EXPECT_EQ(((int32_t *)output)[i*3], planes[0][i*3+2]);
+        EXPECT_EQ(((int32_t *)output)[i*3+1], planes[0][i*3]);
+        EXPECT_EQ(((int32_t *)output)[i*3+2], planes[0][i*3+1]);
+    }
+}
+
+TEST_F(PcmPackBenchmarks, DISABLED_test_PackPlanarStereo16_Throughput) {
+    clampPlanes (16);
+    printf ("pack: s32p -> s16, 2ch: %.1f MB/s (reference: %.1f MB/s)\n", measurePlanarPack (2, 16, 0), measurePlanarPack (2, 16, 1));
+}
+
+TEST_F(PcmPackBenchmarks, DISABLED_test_PackPlanarStereo32_Throughput) {
+    printf ("pack: s32p -> s32, 2ch: %.1f MB/s (reference: %.1f MB/s)\n", measurePlanarPack (2, 32, 0), measurePlanarPack (2, 32, 1));
+}
+
+TEST_F(PcmPackBenchmarks, DISABLED_test_PackPlanar24_6ch_Throughput) {
+    printf ("pack: s32p -> s24, 6ch: %.1f MB/s (reference: %.1f MB/s)\n", measurePlanarPack (6, 24, 0), measurePlanarPack (6, 24, 1));
+}
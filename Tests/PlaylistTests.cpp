@@ -10,6 +10,7 @@
 #include <deadbeef/common.h>
 #include "plmeta.h"
 #include "plugins.h"
+#include "threading.h"
 #include <gtest/gtest.h>
 
 TEST(PlaylistTests, test_SearchForValueInSingleValueItems_FindsTheItem) {
@@ -139,3 +140,151 @@ TEST(PlaylistTests, test_IsRelativePathWin32_WeirdPath_True) {
     int res = is_relative_path_win32 ("something:something");
     EXPECT_TRUE(res);
 }
+
+#pragma mark - Metadata index
+
+TEST(PlaylistTests, test_FindMeta_ManyFields_FindsAllFieldsCaseInsensitive) {
+    playItem_t *it = pl_item_alloc();
+
+    char key[20];
+    char value[20];
+    for (int i = 0; i < 50; i++) {
+        snprintf (key, sizeof (key), "key%d", i);
+        snprintf (value, sizeof (value), "value%d", i);
+        pl_add_meta (it, key, value);
+    }
+
+    for (int i = 0; i < 50; i++) {
+        snprintf (key, sizeof (key), "KEY%d", i);
+        snprintf (value, sizeof (value), "value%d", i);
+        EXPECT_STREQ(pl_find_meta (it, key), value);
+    }
+
+    pl_item_unref (it);
+}
+
+TEST(PlaylistTests, test_FindMeta_ManyFieldsDeleted_DoesNotFindDeletedFields) {
+    playItem_t *it = pl_item_alloc();
+
+    char key[20];
+    for (int i = 0; i < 50; i++) {
+        snprintf (key, sizeof (key), "key%d", i);
+        pl_add_meta (it, key, "value");
+    }
+
+    for (int i = 0; i < 50; i += 2) {
+        snprintf (key, sizeof (key), "key%d", i);
+        pl_delete_meta (it, key);
+    }
+
+    for (int i = 0; i < 50; i++) {
+        snprintf (key, sizeof (key), "key%d", i);
+        if (i % 2) {
+            EXPECT_STREQ(pl_find_meta (it, key), "value");
+        }
+        else {
+            EXPECT_TRUE(pl_find_meta (it, key) == NULL);
+        }
+    }
+
+    pl_item_unref (it);
+}
+
+TEST(PlaylistTests, test_FindMeta_ManyFieldsWithOverride_FindsOverride) {
+    playItem_t *it = pl_item_alloc();
+
+    char key[20];
+    for (int i = 0; i < 50; i++) {
+        snprintf (key, sizeof (key), "key%d", i);
+        pl_add_meta (it, key, "value");
+    }
+    pl_add_meta (it, ":FILETYPE", "MP3");
+    pl_add_meta (it, "!FILETYPE", "FLAC");
+
+    EXPECT_STREQ(pl_find_meta (it, ":FILETYPE"), "FLAC");
+    EXPECT_STREQ(pl_find_meta_raw (it, ":FILETYPE"), "MP3");
+
+    pl_item_unref (it);
+}
+
+TEST(PlaylistTests, test_AddMeta_ManyFieldsMixedWithProperties_KeepsFieldsBeforeProperties) {
+    playItem_t *it = pl_item_alloc();
+
+    char key[20];
+    for (int i = 0; i < 20; i++) {
+        snprintf (key, sizeof (key), "key%d", i);
+        pl_add_meta (it, key, "value");
+        snprintf (key, sizeof (key), ":PROP%d", i);
+        pl_add_meta (it, key, "value");
+    }
+    pl_delete_meta (it, ":PROP0");
+    pl_delete_meta (it, "key19");
+    pl_add_meta (it, "key20", "value");
+    pl_add_meta (it, ":PROP20", "value");
+
+    int count = 0;
+    int prop_seen = 0;
+    for (DB_metaInfo_t *m = it->meta; m; m = m->next) {
+        if (m->key[0] == ':') {
+            prop_seen = 1;
+        }
+        else {
+            EXPECT_FALSE(prop_seen);
+        }
+        count++;
+    }
+    EXPECT_EQ(count, 40);
+    EXPECT_STREQ(pl_find_meta (it, "KEY20"), "value");
+    EXPECT_TRUE(pl_find_meta (it, "key19") == NULL);
+    EXPECT_TRUE(pl_find_meta (it, ":prop0") == NULL);
+
+    pl_item_unref (it);
+}
+
+#pragma mark - Read lock
+
+static void
+_read_lock_thread (void *ctx) {
+    pl_read_lock ();
+    *(int *)ctx = 1;
+    pl_read_unlock ();
+}
+
+static void
+_write_lock_thread (void *ctx) {
+    pl_lock ();
+    *(int *)ctx = 1;
+    pl_unlock ();
+}
+
+TEST(PlaylistTests, test_ReadLock_TakenByAnotherThread_IsShared) {
+    int done = 0;
+    pl_read_lock ();
+    intptr_t tid = thread_start (_read_lock_thread, &done);
+    thread_join (tid);
+    pl_read_unlock ();
+
+    EXPECT_EQ(done, 1);
+}
+
+TEST(PlaylistTests, test_ReadLockNestedInWriteLock_ReleasedWithWriteLock) {
+    playItem_t *it = pl_item_alloc();
+    pl_add_meta(it, "title", "value");
+
+    pl_lock ();
+    pl_read_lock ();
+    pl_read_lock ();
+    const char *value = pl_find_meta (it, "title");
+    pl_read_unlock ();
+    pl_read_unlock ();
+    pl_unlock ();
+
+    int done = 0;
+    intptr_t tid = thread_start (_write_lock_thread, &done);
+    thread_join (tid);
+
+    EXPECT_STREQ(value, "value");
+    EXPECT_EQ(done, 1);
+
+    pl_item_unref (it);
+}
@@ -22,6 +22,7 @@
 */
 
 #include <gtest/gtest.h>
+#include <thread>
 #include "ringbuf.h"
 
 TEST(RingBufTests, read_nowrap_success) {
@@ -115,3 +116,224 @@ TEST(RingBufTests, readKeep_twice_success) {
     EXPECT_TRUE(!memcmp(buf, "hello", 5));
     EXPECT_TRUE(!memcmp(buf2, "hello", 5));
 }
+
+TEST(RingBufTests, writeAcquire_empty_returnsWholeBuffer) {
+    char buffer[10];
+    ringbuf_t ringbuf;
+    ringbuf_init(&ringbuf, buffer, sizeof (buffer));
+
+    size_t avail;
+    char *ptr = ringbuf_write_acquire(&ringbuf, &avail);
+
+    EXPECT_EQ(ptr, buffer);
+    EXPECT_EQ(avail, 10);
+}
+
+TEST(RingBufTests, writeAcquire_wrap_returnsContiguousTail) {
+    char buffer[10];
+    ringbuf_t ringbuf;
+    ringbuf_init(&ringbuf, buffer, sizeof (buffer));
+
+    char buf[10];
+    ringbuf_write(&ringbuf, (char *)"-------", 7);
+    ringbuf_read(&ringbuf, buf, 5);
+
+    size_t avail;
+    char *ptr = ringbuf_write_acquire(&ringbuf, &avail);
+
+    EXPECT_EQ(ptr, buffer + 7);
+    EXPECT_EQ(avail, 3);
+}
+
+TEST(RingBufTests, writeCommit_inPlace_readBack) {
+    char buffer[10];
+    ringbuf_t ringbuf;
+    ringbuf_init(&ringbuf, buffer, sizeof (buffer));
+
+    size_t avail;
+    char *ptr = ringbuf_write_acquire(&ringbuf, &avail);
+    memcpy (ptr, "hello", 5);
+    ringbuf_write_commit(&ringbuf, 5);
+
+    char buf[5];
+    size_t sz = ringbuf_read(&ringbuf, buf, 5);
+    EXPECT_EQ(sz, 5);
+    EXPECT_TRUE(!memcmp(buf, "hello", 5));
+}
+
+TEST(RingBufTests, readAcquire_wrap_returnsUpToEndOfBuffer) {
+    char buffer[10];
+    ringbuf_t ringbuf;
+    ringbuf_init(&ringbuf, buffer, sizeof (buffer));
+
+    char buf[10];
+    ringbuf_write(&ringbuf, (char *)"-------", 7);
+    ringbuf_read(&ringbuf, buf, 7);
+    ringbuf_write(&ringbuf, (char *)"helloworld", 10);
+
+    size_t avail;
+    char *ptr = ringbuf_read_acquire(&ringbuf, &avail);
+    EXPECT_EQ(avail, 3);
+    EXPECT_TRUE(!memcmp(ptr, "hel", 3));
+    ringbuf_read_commit(&ringbuf, avail);
+
+    ptr = ringbuf_read_acquire(&ringbuf, &avail);
+    EXPECT_EQ(avail, 7);
+    EXPECT_TRUE(!memcmp(ptr, "loworld", 7));
+    ringbuf_read_commit(&ringbuf, avail);
+
+    EXPECT_EQ(ringbuf_get_remaining(&ringbuf), 0);
+}
+
+TEST(RingBufTests, read_positionsPast32Bit_dataIsIntact) {
+    char buffer[10];
+    ringbuf_t ringbuf;
+    ringbuf_init(&ringbuf, buffer, sizeof (buffer));
+
+    // the size is not a power of two, so the cursor would jump if the positions wrapped at 2^32
+    ringbuf.read_pos = ringbuf.write_pos = 0xfffffffc;
+
+    char buf[10];
+    for (int i = 0; i < 4; i++) {
+        ringbuf_write(&ringbuf, (char *)"hello", 5);
+        ringbuf_write(&ringbuf, (char *)"world", 5);
+        size_t sz = ringbuf_read(&ringbuf, buf, 10);
+        EXPECT_EQ(sz, 10);
+        EXPECT_TRUE(!memcmp(buf, "helloworld", 10));
+    }
+    EXPECT_EQ(ringbuf_get_read_pos(&ringbuf), 0xfffffffcull + 40);
+    EXPECT_EQ(ringbuf_get_remaining(&ringbuf), 0);
+}
+
+TEST(RingBufTests, mirrored_readAcrossWrap_isContiguous) {
+    ringbuf_t ringbuf;
+    if (ringbuf_init_mirrored(&ringbuf, 10) != 0) {
+        GTEST_SKIP();
+    }
+
+    size_t size = ringbuf.size;
+    char *filler = (char *)calloc(1, size);
+    ringbuf_write(&ringbuf, filler, size - 5);
+    ringbuf_read(&ringbuf, filler, size - 5);
+    free (filler);
+
+    ringbuf_write(&ringbuf, (char *)"helloworld", 10);
+
+    size_t avail;
+    char *ptr = ringbuf_read_acquire(&ringbuf, &avail);
+    EXPECT_EQ(avail, 10);
+    EXPECT_TRUE(!memcmp(ptr, "helloworld", 10));
+
+    ringbuf_deinit(&ringbuf);
+}
+
+static const size_t stress_total = 4 * 1024 * 1024;
+
+static void
+_stress_produce (ringbuf_t *ringbuf, int in_place) {
+    char chunk[997];
+    size_t pos = 0;
+    size_t chunk_size = 1;
+    while (pos < stress_total) {
+        size_t n = std::min (chunk_size, stress_total - pos);
+        if (in_place) {
+            size_t avail;
+            char *ptr = ringbuf_write_acquire(ringbuf, &avail);
+            n = std::min (n, avail);
+            if (n == 0) {
+                std::this_thread::yield();
+                continue;
+            }
+            for (size_t i = 0; i < n; i++) {
+                ptr[i] = (char)((pos + i) % 251);
+            }
+            ringbuf_write_commit(ringbuf, n);
+        }
+        else {
+            for (size_t i = 0; i < n; i++) {
+                chunk[i] = (char)((pos + i) % 251);
+            }
+            if (ringbuf_write(ringbuf, chunk, n) != 0) {
+                std::this_thread::yield();
+                continue;
+            }
+        }
+        pos += n;
+        chunk_size = chunk_size % (sizeof (chunk) - 7) + 7;
+    }
+}
+
+static size_t
+_stress_consume (ringbuf_t *ringbuf, int in_place) {
+    char chunk[1009];
+    size_t pos = 0;
+    size_t errors = 0;
+    size_t chunk_size = 3;
+    while (pos < stress_total) {
+        const char *data = chunk;
+        size_t n;
+        if (in_place) {
+            data = ringbuf_read_acquire(ringbuf, &n);
+            n = std::min (n, chunk_size);
+        }
+        else {
+            n = ringbuf_read(ringbuf, chunk, chunk_size);
+        }
+        if (n == 0) {
+            std::this_thread::yield();
+            continue;
+        }
+        for (size_t i = 0; i < n; i++) {
+            if (data[i] != (char)((pos + i) % 251)) {
+                errors++;
+            }
+        }
+        if (in_place) {
+            ringbuf_read_commit(ringbuf, n);
+        }
+        pos += n;
+        chunk_size = chunk_size % (sizeof (chunk) - 11) + 11;
+    }
+    return errors;
+}
+
+static void
+_stress_run (ringbuf_t *ringbuf, int in_place) {
+    size_t errors = 0;
+    std::thread consumer([&] {
+        errors = _stress_consume (ringbuf, in_place);
+    });
+    _stress_produce (ringbuf, in_place);
+    consumer.join();
+
+    EXPECT_EQ(errors, 0);
+    EXPECT_EQ(ringbuf_get_remaining(ringbuf), 0);
+}
+
+TEST(RingBufTests, concurrentWriteRead_stress_dataIsIntact) {
+    char buffer[4093];
+    ringbuf_t ringbuf;
+    ringbuf_init(&ringbuf, buffer, sizeof (buffer));
+
+    _stress_run (&ringbuf, 0);
+}
+
+TEST(RingBufTests, concurrentAcquireCommit_stress_dataIsIntact) {
+    char buffer[4093];
+    ringbuf_t ringbuf;
+    ringbuf_init(&ringbuf, buffer, sizeof (buffer));
+
+    _stress_run (&ringbuf, 1);
+}
+
+TEST(RingBufTests, concurrentMirrored_stress_dataIsIntact) {
+    ringbuf_t ringbuf;
+    if (ringbuf_init_mirrored(&ringbuf, 4096) != 0) {
+        GTEST_SKIP();
+    }
+
+    _stress_run (&ringbuf, 0);
+    _stress_run (&ringbuf, 1);
+
+    ringbuf_deinit(&ringbuf);
+}
@@ -0,0 +1,67 @@
+/*
+    DeaDBeeF -- the music player
+    Copyright (C) 2009-2023 Oleksiy Yakovenko and other contributors
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "slaballoc.h"
+#include <gtest/gtest.h>
+
+TEST(SlabAllocatorTests, test_Alloc_ManyObjects_AllocatesNewSlabs) {
+    slab_allocator_t *allocator = slab_allocator_create (24, 4);
+    void *ptrs[10];
+    for (int i = 0; i < 10; i++) {
+        ptrs[i] = slab_alloc (allocator);
+        memset (ptrs[i], 0xff, 24);
+    }
+    slab_allocator_stats_t stats;
+    slab_allocator_get_stats (allocator, &stats);
+    EXPECT_EQ(stats.objects_used, 10);
+    EXPECT_EQ(stats.objects_free, 0);
+    EXPECT_EQ(stats.slab_count, 3);
+    slab_allocator_free (allocator);
+}
+
+TEST(SlabAllocatorTests, test_Alloc_AfterFree_ReusesZeroedObject) {
+    slab_allocator_t *allocator = slab_allocator_create (24, 4);
+    char *ptr = (char *)slab_alloc (allocator);
+    memset (ptr, 0xff, 24);
+    slab_free (allocator, ptr);
+
+    char *ptr2 = (char *)slab_alloc (allocator);
+    EXPECT_EQ(ptr, ptr2);
+    for (int i = 0; i < 24; i++) {
+        EXPECT_EQ(ptr2[i], 0);
+    }
+
+    slab_allocator_stats_t stats;
+    slab_allocator_get_stats (allocator, &stats);
+    EXPECT_EQ(stats.objects_used, 1);
+    EXPECT_EQ(stats.slab_count, 1);
+    slab_allocator_free (allocator);
+}
+
+TEST(SlabAllocatorTests, test_Alloc_SmallObjectSize_IsPointerAligned) {
+    slab_allocator_t *allocator = slab_allocator_create (3, 16);
+    char *ptr1 = (char *)slab_alloc (allocator);
+    char *ptr2 = (char *)slab_alloc (allocator);
+    EXPECT_EQ((ptr2 - ptr1) % sizeof (void *), 0);
+    slab_allocator_free (allocator);
+}
@@ -0,0 +1,137 @@
+/*
+    DeaDBeeF -- the music player
+    Copyright (C) 2009-2023 Oleksiy Yakovenko and other contributors
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "premix.h"
+#include "streamer.h"
+#include "streamreader.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <math.h>
+
+// The throughput tests are disabled, so that they don't slow down the normal test run.
+// Run them with --gtest_also_run_disabled_tests --gtest_filter='StreamerPipelineBenchmarks.*'
+
+#define BLOCK_SIZE 16384
+#define NUM_ITERATIONS 20000
+
+class StreamerPipelineBenchmarks: public ::testing::Test {
+protected:
+    void SetUp() override {
+        memset (&block, 0, sizeof (block));
+        block.buf = (char *)malloc (BLOCK_SIZE);
+        output = (char *)malloc (BLOCK_SIZE * 4);
+    }
+
+    void TearDown() override {
+        free (block.buf);
+        free (output);
+    }
+
+    // Fills the block with a sine wave in the specified format
+    void fillBlock (int bps, int is_float) {
+        ddb_waveformat_t float_fmt = {
+            .bps = 32,
+            .channels = 2,
+            .samplerate = 44100,
+            .channelmask = 3,
+            .is_float = 1,
+        };
+        float samples[BLOCK_SIZE / 4];
+        int nsamples = BLOCK_SIZE / 4;
+        for (int i = 0; i < nsamples; i++) {
+            samples[i] = 0.8f * sinf (i * 0.05f);
+        }
+        memcpy (&block.fmt, &float_fmt, sizeof (ddb_waveformat_t));
+        block.fmt.bps = bps;
+        block.fmt.is_float = is_float;
+        int framesize = block.fmt.channels * bps / 8;
+        int nframes = BLOCK_SIZE / 2 / framesize;
+        block.size = pcm_convert (&float_fmt, (char *)samples, &block.fmt, block.buf, nframes * float_fmt.channels * 4);
+    }
+
+    // Runs the block through the output processing repeatedly, returns the throughput in MB/s of input data
+    double measure (int out_bps, int out_is_float, float replaygain_amp) {
+        ddb_waveformat_t out_fmt;
+        memcpy (&out_fmt, &block.fmt, sizeof (ddb_waveformat_t));
+        out_fmt.bps = out_bps;
+        out_fmt.is_float = out_is_float;
+        block.replaygain_amp = replaygain_amp;
+
+        int64_t total = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < NUM_ITERATIONS; i++) {
+            block.pos = 0;
+            float ratio;
+            int res = streamer_process_block_data (&block, &out_fmt, output, BLOCK_SIZE * 4, &ratio);
+            EXPECT_GT(res, 0);
+            total += block.size;
+        }
+        auto end = std::chrono::steady_clock::now();
+        double sec = std::chrono::duration<double>(end - start).count();
+        return total / sec / (1024 * 1024);
+    }
+
+    streamblock_t block;
+    char *output;
+};
+
+TEST_F(StreamerPipelineBenchmarks, DISABLED_test_Int16ToInt16_NoGain) {
+    fillBlock (16, 0);
+    printf ("pipeline: s16 -> s16, no gain: %.1f MB/s\n", measure (16, 0, 1.f));
+}
+
+TEST_F(StreamerPipelineBenchmarks, DISABLED_test_Int16ToInt16_ReplayGain) {
+    fillBlock (16, 0);
+    printf ("pipeline: s16 -> s16, replaygain: %.1f MB/s\n", measure (16, 0, 0.7f));
+}
+
+TEST_F(StreamerPipelineBenchmarks, DISABLED_test_Int16ToFloat_ReplayGain) {
+    fillBlock (16, 0);
+    printf ("pipeline: s16 -> f32, replaygain: %.1f MB/s\n", measure (32, 1, 0.7f));
+}
+
+TEST_F(StreamerPipelineBenchmarks, DISABLED_test_Int24ToInt32_ReplayGain) {
+    fillBlock (24, 0);
+    printf ("pipeline: s24 -> s32, replaygain: %.1f MB/s\n", measure (32, 0, 0.7f));
+}
+
+TEST_F(StreamerPipelineBenchmarks, DISABLED_test_FloatToInt16_ReplayGain) {
+    fillBlock (32, 1);
+    printf ("pipeline: f32 -> s16, replaygain: %.1f MB/s\n", measure (16, 0, 0.7f));
+}
+
+TEST_F(StreamerPipelineBenchmarks, test_ReplayGainMatchesSeparatePasses) {
+    fillBlock (16, 0);
+    ddb_waveformat_t out_fmt;
+    memcpy (&out_fmt, &block.fmt, sizeof (ddb_waveformat_t));
+    block.replaygain_amp = 0.5f;
+    float ratio;
+    int res = streamer_process_block_data (&block, &out_fmt, output, BLOCK_SIZE * 4, &ratio);
+    EXPECT_EQ(res, block.size);
+
+    char *expected = (char *)malloc (block.size);
+    memcpy (expected, block.buf, block.size);
+    pcm_apply_gain (&block.fmt, expected, block.size, 0.5f);
+    EXPECT_TRUE(!memcmp (expected, output, block.size));
+    free (expected);
+}
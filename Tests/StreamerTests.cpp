@@ -170,6 +170,16 @@ protected:
                             _trackinfochanged_handler ((ddb_event_track_t *)ctx, this);
                         }
                         break;
+                    case DB_EV_TRACKSINFOCHANGED:
+                        if (_trackinfochanged_handler) {
+                            ddb_event_tracks_t *ev = (ddb_event_tracks_t *)ctx;
+                            for (int i = 0; i < ev->count; i++) {
+                                ddb_event_track_t track_ev = {};
+                                track_ev.track = ev->tracks[i];
+                                _trackinfochanged_handler (&track_ev, this);
+                            }
+                        }
+                        break;
                     }
                 }
                 if (msg >= DB_EV_FIRST && ctx) {
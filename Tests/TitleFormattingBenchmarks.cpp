@@ -0,0 +1,157 @@
+/*
+    DeaDBeeF -- the music player
+    Copyright (C) 2009-2023 Oleksiy Yakovenko and other contributors
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "messagepump.h"
+#include "playlist.h"
+#include "plmeta.h"
+#include "plugins.h"
+#include "streamer.h"
+#include "tf.h"
+#include <gtest/gtest.h>
+#include <chrono>
+
+static DB_output_t fake_out = {
+    .plugin.id = "fake_out",
+    .plugin.name = "fake_out",
+};
+
+// The benchmarks are disabled, so that they don't slow down the normal test run.
+// Run them with --gtest_also_run_disabled_tests --gtest_filter='TitleFormattingBenchmarks.*'
+
+#define NUM_TRACKS 2000
+#define NUM_ITERATIONS 20
+
+// typical playlist column scripts
+static const char *column_scripts[] = {
+    "%artist% - %title%",
+    "$if(%album artist%,%album artist%,%artist%) - ['['%year%']' ]%album%",
+    "[%tracknumber%. ]%title%[ // %track artist%]",
+    "%length%",
+    "$pad_right($upper(%codec%),10) %bitrate%kbps $repeat(=,20)",
+    NULL
+};
+
+class TitleFormattingBenchmarks: public ::testing::Test {
+protected:
+    void SetUp() override {
+        messagepump_init();
+        plug_set_output (&fake_out);
+        streamer_init();
+
+        for (int i = 0; i < NUM_TRACKS; i++) {
+            char title[100];
+            snprintf (title, sizeof (title), "Title %d", i);
+            tracks[i] = pl_item_alloc_init ("testfile.flac", "stdflac");
+            pl_add_meta (tracks[i], "artist", "Artist Name");
+            pl_add_meta (tracks[i], "album", "Album Name");
+            pl_add_meta (tracks[i], "year", "2001");
+            pl_add_meta (tracks[i], "title", title);
+            pl_add_meta (tracks[i], "tracknumber", "5");
+            pl_replace_meta (tracks[i], ":FILETYPE", "FLAC");
+            pl_replace_meta (tracks[i], ":BITRATE", "900");
+        }
+    }
+
+    void TearDown() override {
+        for (int i = 0; i < NUM_TRACKS; i++) {
+            pl_item_unref (tracks[i]);
+        }
+        streamer_free();
+
+        // flush any remaining events
+        uint32_t _id;
+        uintptr_t ctx;
+        uint32_t p1;
+        uint32_t p2;
+        while (messagepump_pop(&_id, &ctx, &p1, &p2) != -1) {
+            if (_id >= DB_EV_FIRST && ctx) {
+                messagepump_event_free ((ddb_event_t *)ctx);
+            }
+        }
+
+        messagepump_free();
+    }
+
+    // Evaluates all column scripts for all tracks, the way playlist redraw does, returns the elapsed time in ms
+    double evalColumns (int modify) {
+        char *bc[10];
+        int count = 0;
+        for (count = 0; column_scripts[count]; count++) {
+            bc[count] = tf_compile (column_scripts[count]);
+        }
+
+        ddb_tf_context_t ctx = {
+            ._size = sizeof (ddb_tf_context_t),
+            .flags = DDB_TF_CONTEXT_NO_DYNAMIC,
+        };
+
+        char buffer[1024];
+        auto start = std::chrono::steady_clock::now();
+        for (int iter = 0; iter < NUM_ITERATIONS; iter++) {
+            for (int i = 0; i < NUM_TRACKS; i++) {
+                if (modify) {
+                    pl_replace_meta (tracks[i], "year", iter & 1 ? "2001" : "2002");
+                }
+                ctx.it = (DB_playItem_t *)tracks[i];
+                for (int s = 0; s < count; s++) {
+                    tf_eval (&ctx, bc[s], buffer, sizeof (buffer));
+                }
+            }
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        for (int s = 0; s < count; s++) {
+            tf_free (bc[s]);
+        }
+
+        return std::chrono::duration<double, std::milli>(end - start).count();
+    }
+
+    playItem_t *tracks[NUM_TRACKS];
+};
+
+TEST_F(TitleFormattingBenchmarks, DISABLED_test_EvalColumns_UnmodifiedTracks) {
+    double ms = evalColumns (0);
+    printf ("tf: %d evaluations of unmodified tracks: %.2f ms\n", NUM_TRACKS * NUM_ITERATIONS * 5, ms);
+    EXPECT_GT(ms, 0);
+}
+
+TEST_F(TitleFormattingBenchmarks, DISABLED_test_EvalColumns_ModifiedTracks) {
+    double ms = evalColumns (1);
+    printf ("tf: %d evaluations of modified tracks: %.2f ms\n", NUM_TRACKS * NUM_ITERATIONS * 5, ms);
+    EXPECT_GT(ms, 0);
+}
+
+TEST_F(TitleFormattingBenchmarks, DISABLED_test_CompileScripts) {
+    auto start = std::chrono::steady_clock::now();
+    for (int iter = 0; iter < NUM_TRACKS; iter++) {
+        for (int s = 0; column_scripts[s]; s++) {
+            char *bc = tf_compile (column_scripts[s]);
+            tf_free (bc);
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    double ms = std::chrono::duration<double, std::milli>(end - start).count();
+    printf ("tf: %d compilations: %.2f ms\n", NUM_TRACKS * 5, ms);
+    EXPECT_GT(ms, 0);
+}
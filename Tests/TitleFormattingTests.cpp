@@ -2741,3 +2741,42 @@ TEST_F(TitleFormattingTests, test_meta_bufferTooShortWithMultibyteCharsInput_ret
     tf_free (bc);
     EXPECT_STREQ(buffer, "ΘΘΘ");
 }
+
+TEST_F(TitleFormattingTests, test_CachedResult_MetadataChanged_returnsNewValue) {
+    char *bc = tf_compile("%title%");
+    pl_add_meta (it, "title", "Title1");
+    tf_eval (&ctx, bc, buffer, sizeof (buffer));
+    EXPECT_STREQ(buffer, "Title1");
+    pl_replace_meta (it, "title", "Title2");
+    tf_eval (&ctx, bc, buffer, sizeof (buffer));
+    EXPECT_STREQ(buffer, "Title2");
+    pl_delete_meta (it, "title");
+    tf_eval (&ctx, bc, buffer, sizeof (buffer));
+    tf_free (bc);
+    EXPECT_STREQ(buffer, "");
+}
+
+TEST_F(TitleFormattingTests, test_CachedResult_SmallerBuffer_returnsTruncated) {
+    char *bc = tf_compile("%title%");
+    pl_add_meta (it, "title", "Title1");
+    tf_eval (&ctx, bc, buffer, sizeof (buffer));
+    EXPECT_STREQ(buffer, "Title1");
+    tf_eval (&ctx, bc, buffer, 4);
+    tf_free (bc);
+    EXPECT_STREQ(buffer, "Tit");
+}
+
+TEST_F(TitleFormattingTests, test_FoldedConstantFunction_InCondition_returnsTrue) {
+    char *bc = tf_compile("$if($upper(abc),%title%,no)");
+    pl_add_meta (it, "title", "Title1");
+    tf_eval (&ctx, bc, buffer, sizeof (buffer));
+    tf_free (bc);
+    EXPECT_STREQ(buffer, "Title1");
+}
+
+TEST_F(TitleFormattingTests, test_FoldedConstantFunction_BufferTooShort_returnsTruncated) {
+    char *bc = tf_compile("$upper(abcdef)");
+    tf_eval (&ctx, bc, buffer, 4);
+    tf_free (bc);
+    EXPECT_STREQ(buffer, "ABC");
+}
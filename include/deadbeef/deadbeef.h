@@ -71,6 +71,7 @@ extern "C" {
 // that there's a better replacement in the newer deadbeef versions.
 
 // API version history:
+// 1.17 -- deadbeef-1.9.6
 // 1.16 -- deadbeef-1.9.4
 // 1.15 -- deadbeef-1.9.0
 // 1.14 -- deadbeef-1.8.8
@@ -100,7 +101,7 @@ extern "C" {
 // 0.1 -- deadbeef-0.2.0
 
 #define DB_API_VERSION_MAJOR 1
-#define DB_API_VERSION_MINOR 16
+#define DB_API_VERSION_MINOR 17
 
 #if defined(__clang__)
 
@@ -137,6 +138,12 @@ extern "C" {
 #define DDB_API_LEVEL DB_API_VERSION_MINOR
 #endif
 
+#if (DDB_WARN_DEPRECATED && DDB_API_LEVEL >= 17)
+#define DEPRECATED_117 DDB_DEPRECATED("since deadbeef API 1.17")
+#else
+#define DEPRECATED_117
+#endif
+
 #if (DDB_WARN_DEPRECATED && DDB_API_LEVEL >= 16)
 #define DEPRECATED_116 DDB_DEPRECATED("since deadbeef API 1.16")
 #else
@@ -443,6 +450,16 @@ typedef struct {
     time_t started_timestamp; // time when "track" started playing
 } ddb_event_track_t;
 
+#if (DDB_API_LEVEL >= 17)
+typedef struct {
+    ddb_event_t ev;
+    DB_playItem_t **tracks; // each changed track appears once
+    int count;
+} ddb_event_tracks_t;
+// When sending this event, tracks must be allocated with malloc, and hold a reference to each track;
+// both are released by event_free.
+#endif
+
 typedef struct {
     ddb_event_t ev;
     DB_playItem_t *from;
@@ -539,6 +556,14 @@ enum {
     DB_EV_CURSOR_MOVED = 1007, // used for syncing cursor position between playlist views, p1 = PL_MAIN or PL_SEARCH, ctx is a ddb_event_track_t, containing the new track under cursor
 #endif
 
+#if (DDB_API_LEVEL >= 17)
+    // trackinfo of several tracks was changed, ctx=ddb_event_tracks_t
+    // DB_EV_TRACKSINFOCHANGED NOTE: the DB_EV_TRACKINFOCHANGED events with p1=0 are coalesced until the message loop gets to them,
+    // a single track is still delivered as DB_EV_TRACKINFOCHANGED, while multiple tracks are delivered in this event.
+    // Plugins built against older API levels receive one DB_EV_TRACKINFOCHANGED per track instead.
+    DB_EV_TRACKSINFOCHANGED = 1008,
+#endif
+
     DB_EV_MAX
 };
 
@@ -1680,6 +1705,30 @@ typedef struct {
     /// since this function internally uses streamer_lock, which may cause a deadlock against pl_lock.
     ddb_playItem_t * (*streamer_get_playing_track_safe) (void);
 #endif
+
+#if (DDB_API_LEVEL >= 17)
+    /// Zero-copy alternative to @c streamer_read.
+    /// Sets @c *data to a pointer into the streamer's output buffer, which holds
+    /// up to @c size bytes of audio in the output format, ready to be consumed in place.
+    /// The returned size may be less than requested, e.g. when the buffer wraps around,
+    /// in which case the output plugin may call this again after committing.
+    /// Every successful call must be followed by @c streamer_read_commit,
+    /// before any other @c streamer_read or @c streamer_read_acquire call.
+    /// @return Number of bytes available at @c *data, or 0 if no data is available.
+    int (*streamer_read_acquire) (const char **data, int size);
+
+    /// Releases the data obtained from @c streamer_read_acquire.
+    /// The bytes which were not consumed are returned again by the next @c streamer_read_acquire,
+    /// and the volume is not applied to them twice.
+    /// @param size Number of bytes which were consumed, at most the value returned from @c streamer_read_acquire.
+    void (*streamer_read_commit) (int size);
+
+    /// Should be called by output plugins at the start of the thread which calls @c streamer_read.
+    /// If the user enabled the real-time mode (streamer.realtime), the thread is switched to real-time scheduling,
+    /// and with streamer.realtime_check, allocations and lock waits on it are reported.
+    /// @return 0 if the thread is running with real-time priority
+    int (*thread_promote_realtime) (void);
+#endif
 } DB_functions_t;
 
 // NOTE: an item placement must be selected like this
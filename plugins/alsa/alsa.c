@@ -60,7 +60,7 @@ static int conf_alsa_resample = 1;
 static char conf_alsa_soundcard[100] = "default";
 
 static int
-palsa_callback (char *stream, int len);
+palsa_write (int len);
 
 static void
 palsa_thread (void *context);
@@ -656,6 +656,7 @@ alsa_recover (int err) {
 static void
 palsa_thread (void *context) {
     prctl (PR_SET_NAME, "deadbeef-alsa", 0, 0, 0, 0);
+    deadbeef->thread_promote_realtime ();
     int err = 0;
     int avail;
     for (;;) {
@@ -699,14 +700,8 @@ palsa_thread (void *context) {
         int maxwait = period_size * 1000 / plugin.fmt.samplerate;
         if (avail >= period_size) {
             int sz = avail * (plugin.fmt.bps>>3) * plugin.fmt.channels;
-            char buf[sz];
 
-            int br = palsa_callback (buf, sz);
-
-            int err = 0;
-            int frames = snd_pcm_bytes_to_frames(audio, br);
-
-            err = snd_pcm_writei (audio, buf, frames);
+            int err = palsa_write (sz);
 
             if (err < 0) {
                 err = alsa_recover (err);
@@ -744,22 +739,51 @@ palsa_thread (void *context) {
     UNLOCK;
 }
 
+// Write len bytes to the device, directly from the streamer output buffer.
+// Only the frames accepted by the device are committed, the rest stays in the streamer buffer.
+// Missing data is padded with silence.
+// @return the result of the last snd_pcm_writei call
 static int
-palsa_callback (char *stream, int len) {
-    if (state != DDB_PLAYBACK_STATE_PLAYING || !deadbeef->streamer_ok_to_read (-1)) {
-        memset (stream, 0, len);
-        return len;
+palsa_write (int len) {
+    int err = 0;
+    int written = 0;
+    if (state == DDB_PLAYBACK_STATE_PLAYING && deadbeef->streamer_ok_to_read (-1)) {
+        while (written < len) {
+            const char *data;
+            int br = deadbeef->streamer_read_acquire (&data, len - written);
+            if (br <= 0) {
+                break;
+            }
+            err = snd_pcm_writei (audio, data, snd_pcm_bytes_to_frames (audio, br));
+            if (err < 0) {
+                deadbeef->streamer_read_commit (0);
+                return err;
+            }
+            int bw = (int)snd_pcm_frames_to_bytes (audio, err);
+            deadbeef->streamer_read_commit (bw);
+            written += bw;
+            if (bw < br) {
+                // the device didn't take everything, don't pad the gap with silence
+                return err;
+            }
+        }
     }
-    int bytesread = deadbeef->streamer_read (stream, len);
 
-    if (bytesread < len) {
-        if (bytesread < 0) {
-            bytesread = 0;
+    // pad the rest of the period with silence
+    static const char silence[8192];
+    while (written < len) {
+        int sz = len - written < (int)sizeof (silence) ? len - written : (int)sizeof (silence);
+        snd_pcm_sframes_t frames = snd_pcm_bytes_to_frames (audio, sz);
+        if (frames <= 0) {
+            break;
         }
-        memset (stream + bytesread, 0, len-bytesread);
-        bytesread = len;
+        err = snd_pcm_writei (audio, silence, frames);
+        if (err < 0 || err < frames) {
+            break;
+        }
+        written += (int)snd_pcm_frames_to_bytes (audio, err);
     }
-    return bytesread;
+    return err;
 }
 
 static int
@@ -58,6 +58,7 @@
 #include "artwork_internal.h"
 #include "cache.h"
 #include "coverinfo.h"
+#include "dirlisting.h"
 #include "lastfm.h"
 #include "musicbrainz.h"
 #include "mp4tagutil.h"
@@ -85,6 +86,9 @@ static void *listeners_userdata[MAX_LISTENERS];
 
 dispatch_queue_t sync_queue; // used in artwork_internal, therefore not static
 static dispatch_queue_t process_queue;
+static dispatch_queue_t local_queue;
+static dispatch_semaphore_t local_semaphore;
+static dispatch_queue_t web_queue;
 static dispatch_queue_t fetch_queue;
 static dispatch_semaphore_t fetch_semaphore;
 
@@ -266,13 +270,13 @@ strings_equal (const char *s1, const char *s2) {
 #endif
 
 static int
-vfs_scan_results (struct dirent *entry, const char *container_uri, ddb_cover_info_t *cover, const char *mask) {
+vfs_scan_results (const char *name, const char *container_uri, ddb_cover_info_t *cover, const char *mask) {
     /* VFS container, double check the match in case scandir didn't implement filtering */
-    if (!fnmatch (mask, entry->d_name, FNM_CASEFOLD)) {
-        trace ("found cover %s in %s\n", entry->d_name, container_uri);
-        size_t len = strlen (container_uri) + strlen(entry->d_name) + 2;
+    if (!fnmatch (mask, name, FNM_CASEFOLD)) {
+        trace ("found cover %s in %s\n", name, container_uri);
+        size_t len = strlen (container_uri) + strlen(name) + 2;
         cover->image_filename = malloc (len);
-        snprintf (cover->image_filename, len, "%s:%s", container_uri, entry->d_name);
+        snprintf (cover->image_filename, len, "%s:%s", container_uri, name);
         return 0;
     }
 
@@ -280,12 +284,12 @@ vfs_scan_results (struct dirent *entry, const char *container_uri, ddb_cover_inf
 }
 
 static int
-dir_scan_results (struct dirent *entry, const char *container, ddb_cover_info_t *cover) {
+dir_scan_results (const char *name, const char *container, ddb_cover_info_t *cover) {
     /* Local file in a directory */
-    trace ("found cover %s in local folder\n", entry->d_name);
-    size_t len = strlen (container) + strlen(entry->d_name) + 2;
+    trace ("found cover %s in local folder\n", name);
+    size_t len = strlen (container) + strlen(name) + 2;
     cover->image_filename = malloc (len);
-    snprintf (cover->image_filename, len, "%s/%s", container, entry->d_name);
+    snprintf (cover->image_filename, len, "%s/%s", container, name);
     struct stat stat_struct;
     if (!stat (cover->image_filename, &stat_struct) && S_ISREG (stat_struct.st_mode) && stat_struct.st_size > 0) {
         return 0;
@@ -300,10 +304,7 @@ dir_scan_results (struct dirent *entry, const char *container, ddb_cover_info_t
 
 static int
 scan_local_path (const char *local_path, const char *uri, DB_vfs_t *vfsplug, ddb_cover_info_t *cover) {
-    struct dirent **files = NULL;
-    int (* custom_scandir)(const char *, struct dirent ***, int (*)(const struct dirent *), int (*)(const struct dirent **, const struct dirent **));
-    custom_scandir = vfsplug ? vfsplug->scandir : scandir;
-    int files_count = custom_scandir (local_path, &files, NULL, NULL);
+    dir_listing_t *listing = dir_listing_get (local_path, vfsplug);
 
     __block char *filemask = NULL;
 
@@ -313,7 +314,7 @@ scan_local_path (const char *local_path, const char *uri, DB_vfs_t *vfsplug, ddb
 
     int err = -1;
 
-    if (files != NULL) {
+    if (listing != NULL) {
         const char *filemask_end = filemask + strlen (filemask);
         char *p;
         while ((p = strrchr (filemask, ';'))) {
@@ -321,13 +322,13 @@ scan_local_path (const char *local_path, const char *uri, DB_vfs_t *vfsplug, ddb
         }
 
         for (char *mask = filemask; mask < filemask_end; mask += strlen (mask)+1) {
-            for (int i = 0; i < files_count; i++) {
-                if (!fnmatch (mask, files[i]->d_name, FNM_CASEFOLD)) {
+            for (int i = 0; i < listing->count; i++) {
+                if (!fnmatch (mask, listing->names[i], FNM_CASEFOLD)) {
                     if (uri) {
-                        err = vfs_scan_results (files[i], uri, cover, mask);
+                        err = vfs_scan_results (listing->names[i], uri, cover, mask);
                     }
                     else {
-                        err = dir_scan_results (files[i], local_path, cover);
+                        err = dir_scan_results (listing->names[i], local_path, cover);
                     }
                 }
                 if (!err) {
@@ -338,10 +339,7 @@ scan_local_path (const char *local_path, const char *uri, DB_vfs_t *vfsplug, ddb
                 break;
             }
         }
-        for (size_t i = 0; i < files_count; i++) {
-            free (files[i]);
-        }
-        free (files);
+        dir_listing_release (listing);
     }
 
     free (filemask);
@@ -351,24 +349,18 @@ scan_local_path (const char *local_path, const char *uri, DB_vfs_t *vfsplug, ddb
 // FIXME: this returns only one path that matches subfolder. Usually that's enough, but can be improved.
 static char *
 get_case_insensitive_path (const char *local_path, const char *subfolder, DB_vfs_t *vfsplug) {
-    struct dirent **files = NULL;
-    int (* custom_scandir)(const char *, struct dirent ***, int (*)(const struct dirent *), int (*)(const struct dirent **, const struct dirent **));
-    custom_scandir = vfsplug ? vfsplug->scandir : scandir;
-    int files_count = custom_scandir (local_path, &files, NULL, NULL);
+    dir_listing_t *listing = dir_listing_get (local_path, vfsplug);
     char *ret = NULL;
-    if (files != NULL) {
-        for (int i = 0; i < files_count; i++) {
-            if (!strcasecmp (subfolder, files[i]->d_name)) {
-                size_t l = strlen (local_path) + strlen (files[i]->d_name) + 2;
+    if (listing != NULL) {
+        for (int i = 0; i < listing->count; i++) {
+            if (!strcasecmp (subfolder, listing->names[i])) {
+                size_t l = strlen (local_path) + strlen (listing->names[i]) + 2;
                 ret = malloc (l);
-                snprintf (ret, l, "%s/%s", local_path, files[i]->d_name);
+                snprintf (ret, l, "%s/%s", local_path, listing->names[i]);
                 break;
             }
         }
-        for (size_t i = 0; i < files_count; i++) {
-            free (files[i]);
-        }
-        free (files);
+        dir_listing_release (listing);
     }
     return ret;
 }
@@ -809,8 +801,11 @@ _consume_blob (ddb_cover_info_t *cover, const char *cache_path) {
 // Local cover: save to cache & return path
 // Embedded cover: save to cache & return blob
 // Web cover: save_to_local ? save_to_local&return_path : save_to_cache&return_path
-static void
-process_query (ddb_cover_info_t *cover) {
+//
+// The local part returns 1 when the query is resolved by the disk cache, local files or embedded tags,
+// or 0 when the web lookups need to run.
+static int
+process_query_local (ddb_cover_info_t *cover) {
     int islocal = deadbeef->is_local_file (cover->priv->filepath);
 
     struct stat cache_stat;
@@ -821,7 +816,7 @@ process_query (ddb_cover_info_t *cover) {
         if (!res && cache_stat.st_size != 0) {
             cover->image_filename = strdup(cover->priv->track_cache_path);
             cover->cover_found = 1;
-            return;
+            return 1;
         }
     }
 
@@ -830,19 +825,19 @@ process_query (ddb_cover_info_t *cover) {
         if (!res && cache_stat.st_size != 0) {
             cover->image_filename = strdup(cover->priv->album_cache_path);
             cover->cover_found = 1;
-            return;
+            return 1;
         }
     }
     else {
         trace ("artwork: undefined album cache path\n");
-        return;
+        return 1;
     }
 
     // Flood control, don't retry missing artwork for an hour unless something changes
     if (!res && cache_stat.st_mtime + 60*60 > time (NULL)) {
         int recheck = cache_stat.st_size == 0 || recheck_missing_artwork (cover->priv->filepath, cache_stat.st_mtime);
         if (!recheck) {
-            return;
+            return 1;
         }
     }
 
@@ -857,7 +852,7 @@ process_query (ddb_cover_info_t *cover) {
                     free (fname_copy);
                     copy_file(cover->image_filename, cover->priv->album_cache_path);
                     cover->cover_found = 1;
-                    return;
+                    return 1;
                 }
             }
 
@@ -866,7 +861,7 @@ process_query (ddb_cover_info_t *cover) {
                 free (fname_copy);
                 copy_file(cover->image_filename, cover->priv->album_cache_path);
                 cover->cover_found = 1;
-                return;
+                return 1;
             }
 
             free (fname_copy);
@@ -880,7 +875,7 @@ process_query (ddb_cover_info_t *cover) {
         if (!flac_extract_art (cover)) {
             _consume_blob (cover, simplified_cache ? cover->priv->album_cache_path : cover->priv->track_cache_path);
             cover->cover_found = 1;
-            return;
+            return 1;
         }
 #endif
 
@@ -889,7 +884,7 @@ process_query (ddb_cover_info_t *cover) {
         if (!id3_extract_art (cover)) {
             _consume_blob (cover, simplified_cache ? cover->priv->album_cache_path : cover->priv->track_cache_path);
             cover->cover_found = 1;
-            return;
+            return 1;
         }
 
         // try to load embedded from apev2
@@ -897,7 +892,7 @@ process_query (ddb_cover_info_t *cover) {
         if (!apev2_extract_art (cover)) {
             _consume_blob (cover, simplified_cache ? cover->priv->album_cache_path : cover->priv->track_cache_path);
             cover->cover_found = 1;
-            return;
+            return 1;
         }
 
         // try to load embedded from mp4
@@ -905,7 +900,7 @@ process_query (ddb_cover_info_t *cover) {
         if (!mp4_extract_art (cover)) {
             _consume_blob (cover, simplified_cache ? cover->priv->album_cache_path : cover->priv->track_cache_path);
             cover->cover_found = 1;
-            return;
+            return 1;
         }
 
 #ifdef USE_OGG
@@ -913,7 +908,7 @@ process_query (ddb_cover_info_t *cover) {
         if (!ogg_extract_art (cover)) {
             _consume_blob (cover, simplified_cache ? cover->priv->album_cache_path : cover->priv->track_cache_path);
             cover->cover_found = 1;
-            return;
+            return 1;
         }
 #endif
     }
@@ -930,11 +925,19 @@ process_query (ddb_cover_info_t *cover) {
 #endif
         ) {
         _touch(cover->priv->album_cache_path);
-        return;
+        return 1;
     }
+    return 0;
+#else
+    return 1;
+#endif
+}
 
+static void
+process_query_web (ddb_cover_info_t *cover) {
+#ifdef USE_VFS_CURL
     /* Web lookups */
-    res = -1;
+    int res = -1;
 
     // don't attempt to load AY covers from regular music services
     if (artwork_enable_wos && strlen (cover->priv->filepath) > 3 && !strcasecmp (cover->priv->filepath + strlen (cover->priv->filepath) - 3, ".ay")) {
@@ -1384,6 +1387,9 @@ _init_cover_metadata(ddb_cover_info_t *cover, ddb_playItem_t *track) {
 
     deadbeef->pl_lock ();
     strncat (cover->priv->filepath, deadbeef->pl_find_meta (track, ":URI"), sizeof(cover->priv->filepath) - strlen(cover->priv->filepath) - 1);
+    // recorded by the flac decoder on insert, lets flac_extract_art read the picture without walking the file
+    cover->priv->flac_picture_offset = deadbeef->pl_find_meta_int (track, ":FLAC_PICTURE_OFFSET", 0);
+    cover->priv->flac_picture_size = deadbeef->pl_find_meta_int (track, ":FLAC_PICTURE_SIZE", 0);
     deadbeef->pl_unlock ();
 
     ddb_tf_context_t ctx = {0};
@@ -1425,6 +1431,34 @@ _init_cover_metadata(ddb_cover_info_t *cover, ddb_playItem_t *track) {
     }
 }
 
+// The web_queue admits the lookups into the concurrent fetch queue one by one, as fetch slots become free
+static void
+_fetch_query_web (ddb_cover_info_t *cover, ddb_cover_query_t *query, int64_t job_idx) {
+    dispatch_async (web_queue, ^{
+        dispatch_semaphore_wait(fetch_semaphore, DISPATCH_TIME_FOREVER);
+        __block int cancel_job = 0;
+        dispatch_sync(sync_queue, ^{
+            if (job_idx < cancellation_idx) {
+                cancel_job = 1;
+            }
+        });
+
+        if (cancel_job) {
+            callback_and_free_squashed (cover, query);
+            dispatch_semaphore_signal (fetch_semaphore);
+            return;
+        }
+
+        dispatch_async (fetch_queue, ^{
+            process_query_web (cover);
+
+            // update queue, and notity the caller
+            callback_and_free_squashed (cover, query);
+            dispatch_semaphore_signal (fetch_semaphore);
+        });
+    });
+}
+
 #pragma mark - API entry points
 
 static void
@@ -1489,8 +1523,8 @@ cover_get (ddb_cover_query_t *query, ddb_cover_callback_t callback) {
                 return;
             }
 
-            // fetch on concurrent fetch queue
-            dispatch_semaphore_wait(fetch_semaphore, DISPATCH_TIME_FOREVER);
+            // local lookups run on their own pool, so that they don't wait behind slow web fetches
+            dispatch_semaphore_wait(local_semaphore, DISPATCH_TIME_FOREVER);
             __block int cancel_job = 0;
             dispatch_sync(sync_queue, ^{
                 if (job_idx < cancellation_idx) {
@@ -1500,24 +1534,27 @@ cover_get (ddb_cover_query_t *query, ddb_cover_callback_t callback) {
 
             if (cancel_job) {
                 callback_and_free_squashed (cover, query);
-                dispatch_semaphore_signal (fetch_semaphore);
+                dispatch_semaphore_signal (local_semaphore);
                 return;
             }
 
-            dispatch_async (fetch_queue, ^{
-                process_query (cover);
-
+            dispatch_async (local_queue, ^{
+                if (process_query_local (cover)) {
 #if MEASURE_COVER_GET
-                struct timeval tm2;
-                gettimeofday (&tm2, NULL);
-                long ms = (tm2.tv_sec*1000+tm2.tv_usec/1000) - (tm1.tv_sec*1000+tm1.tv_usec/1000);
-                const char *uri = deadbeef->pl_find_meta(query->track, ":URI");
-                printf ("cover_get %s took %d ms\n", uri, (int)ms);
+                    struct timeval tm2;
+                    gettimeofday (&tm2, NULL);
+                    long ms = (tm2.tv_sec*1000+tm2.tv_usec/1000) - (tm1.tv_sec*1000+tm1.tv_usec/1000);
+                    const char *uri = deadbeef->pl_find_meta(query->track, ":URI");
+                    printf ("cover_get %s took %d ms\n", uri, (int)ms);
 #endif
 
-                // update queue, and notity the caller
-                callback_and_free_squashed (cover, query);
-                dispatch_semaphore_signal (fetch_semaphore);
+                    // update queue, and notity the caller
+                    callback_and_free_squashed (cover, query);
+                }
+                else {
+                    _fetch_query_web (cover, query, job_idx);
+                }
+                dispatch_semaphore_signal (local_semaphore);
             });
         }
     });
@@ -1768,6 +1805,9 @@ invalidate_playitem_cache (DB_plugin_action_t *action, ddb_action_context_t ctx)
         return -1;
 
     dispatch_async(process_queue, ^{
+        // forget the directory listings as well, in case a filesystem did not update the mtime
+        dir_listing_cache_clear ();
+
         DB_playItem_t *it = deadbeef->plt_get_first (plt, PL_MAIN);
         while (it) {
             if (deadbeef->pl_is_selected (it)) {
@@ -1822,17 +1862,30 @@ artwork_plugin_stop (void (^completion_block)(void)) {
     queue_clear ();
     stop_cache_cleaner ();
 
-    // lock semaphore
+    // lock semaphores, the local lookups first, since they pass the queries on to the web queue
+    for (int i = 0; i < LOCAL_CONCURRENT_LIMIT; i++) {
+        dispatch_semaphore_wait(local_semaphore, DISPATCH_TIME_FOREVER);
+    }
+    dispatch_sync(web_queue, ^{});
     for (int i = 0; i < FETCH_CONCURRENT_LIMIT; i++) {
         dispatch_semaphore_wait(fetch_semaphore, DISPATCH_TIME_FOREVER);
     }
     dispatch_async (process_queue, ^{
+        dispatch_release(local_queue);
+        local_queue = NULL;
+        dispatch_release(web_queue);
+        web_queue = NULL;
         dispatch_release(fetch_queue);
         fetch_queue = NULL;
         dispatch_release(process_queue);
         process_queue = NULL;
 
-        // unlock semaphore
+        // unlock semaphores
+        for (int i = 0; i < LOCAL_CONCURRENT_LIMIT; i++) {
+            dispatch_semaphore_signal (local_semaphore);
+        }
+        dispatch_release(local_semaphore);
+        local_semaphore = NULL;
         for (int i = 0; i < FETCH_CONCURRENT_LIMIT; i++) {
             dispatch_semaphore_signal (fetch_semaphore);
         }
@@ -1840,6 +1893,7 @@ artwork_plugin_stop (void (^completion_block)(void)) {
         fetch_semaphore = NULL;
 
         cover_cache_free ();
+        dir_listing_cache_clear ();
 
         cover_info_cleanup();
 
@@ -1920,6 +1974,9 @@ artwork_plugin_start (void) {
 
     sync_queue = dispatch_queue_create("ArtworkSyncQueue", NULL);
     process_queue = dispatch_queue_create("ArtworkProcessQueue", NULL);
+    local_queue = dispatch_queue_create("ArtworkLocalQueue", DISPATCH_QUEUE_CONCURRENT);
+    local_semaphore = dispatch_semaphore_create(LOCAL_CONCURRENT_LIMIT);
+    web_queue = dispatch_queue_create("ArtworkWebQueue", NULL);
     fetch_queue = dispatch_queue_create("ArtworkFetchQueue", DISPATCH_QUEUE_CONCURRENT);
     fetch_semaphore = dispatch_semaphore_create(FETCH_CONCURRENT_LIMIT);
 
@@ -2007,6 +2064,7 @@ ddb_artwork_plugin_t plugin = {
     .default_image_path = artwork_default_image_path,
     .allocate_source_id = artwork_allocate_source_id,
     .cancel_queries_with_source_id = artwork_cancel_queries_with_source_id,
+    .thumbnail_path = make_thumbnail_path,
 };
 
 DB_plugin_t *
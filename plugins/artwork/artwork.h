@@ -28,7 +28,7 @@
 #include <time.h>
 
 #define DDB_ARTWORK_MAJOR_VERSION 2
-#define DDB_ARTWORK_MINOR_VERSION 0
+#define DDB_ARTWORK_MINOR_VERSION 1
 
 /// The flags below can be used in the `flags` member of the `ddb_cover_query_t` structure,
 /// and can be OR'ed together.
@@ -136,6 +136,19 @@ typedef struct {
     /// Cancel all queries with the specified source_id
     void
     (*cancel_queries_with_source_id) (int64_t source_id);
+
+    /// Get the path of the on-disk thumbnail for the image file @c image_filename,
+    /// e.g. @c ddb_cover_info_t.image_filename, to be displayed at up to @c width x @c height pixels.
+    ///
+    /// Thumbnails are kept at a few fixed square sizes, the one to scale the image into is returned in @c thumbnail_size.
+    /// The caller decides the image format, and should write the thumbnail to a temporary file, then rename it to @c path.
+    /// Thumbnails are removed together with the cached cover, and expire with the rest of the cache.
+    ///
+    /// Returns 1 if the thumbnail exists and is up to date, 0 if it needs to be created at @c path,
+    /// or -1 if the size is too large for a thumbnail, or on error.
+    /// Available since version 2.1
+    int
+    (*thumbnail_path) (const char *image_filename, int width, int height, char *path, size_t size, int *thumbnail_size);
 } ddb_artwork_plugin_t;
 
 #endif /*__ARTWORK_H*/
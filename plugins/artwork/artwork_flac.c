@@ -21,6 +21,7 @@
     3. This notice may not be removed or altered from any source distribution.
 */
 
+#include <stdlib.h>
 #include <string.h>
 #include <limits.h>
 #include <deadbeef/deadbeef.h>
@@ -61,11 +62,84 @@ static FLAC__IOCallbacks flac_iocb = {
     .close = NULL
 };
 
+static uint32_t
+_read_be32 (const uint8_t *p) {
+    return ((uint32_t)p[0]<<24) | ((uint32_t)p[1]<<16) | ((uint32_t)p[2]<<8) | (uint32_t)p[3];
+}
+
+// Load the PICTURE block recorded by the flac decoder at insert time.
+// The offset may be stale if the file was retagged since, so the block header
+// is verified first, and any mismatch falls back to the full chain read.
+static int
+flac_extract_art_at_offset (ddb_cover_info_t *cover) {
+    int64_t offset = cover->priv->flac_picture_offset;
+    int64_t size = cover->priv->flac_picture_size;
+    if (offset < 8 || size < 32 || size >= (1<<24)) {
+        return -1;
+    }
+
+    DB_FILE *file = deadbeef->fopen (cover->priv->filepath);
+    if (!file) {
+        return -1;
+    }
+
+    uint8_t *block = NULL;
+    uint8_t hdr[4];
+    if (deadbeef->fseek (file, offset - 4, SEEK_SET)
+        || deadbeef->fread (hdr, 1, 4, file) != 4
+        || (hdr[0] & 0x7f) != FLAC__METADATA_TYPE_PICTURE
+        || (((int64_t)hdr[1]<<16) | (hdr[2]<<8) | hdr[3]) != size) {
+        goto error;
+    }
+
+    block = malloc (size);
+    if (!block || deadbeef->fread (block, 1, size, file) != size) {
+        goto error;
+    }
+    deadbeef->fclose (file);
+    file = NULL;
+
+    // type, mime, description, width, height, depth, colors, data length
+    uint64_t pos = 4;
+    uint32_t mime_len = _read_be32 (block + pos);
+    pos += 4 + (uint64_t)mime_len;
+    if (pos + 4 > size) {
+        goto error;
+    }
+    uint32_t descr_len = _read_be32 (block + pos);
+    pos += 4 + (uint64_t)descr_len + 16;
+    if (pos + 4 > size) {
+        goto error;
+    }
+    uint32_t data_len = _read_be32 (block + pos);
+    pos += 4;
+    if (data_len == 0 || pos + data_len > size) {
+        goto error;
+    }
+
+    trace ("found flac cover art of %d bytes at offset %lld\n", data_len, (long long)offset);
+    cover->priv->blob = (char *)block;
+    cover->priv->blob_size = size;
+    cover->priv->blob_image_offset = pos;
+    cover->priv->blob_image_size = data_len;
+    return 0;
+
+error:
+    if (file) {
+        deadbeef->fclose (file);
+    }
+    free (block);
+    return -1;
+}
+
 int
 flac_extract_art (ddb_cover_info_t *cover) {
     if (!strcasestr (cover->priv->filepath, ".flac") && !strcasestr (cover->priv->filepath, ".oga")) {
         return -1;
     }
+    if (!flac_extract_art_at_offset (cover)) {
+        return 0;
+    }
     int err = -1;
     DB_FILE *file = NULL;
     FLAC__Metadata_Iterator *iterator = NULL;
@@ -31,6 +31,7 @@
 #define max(x,y) ((x)>(y)?(x):(y))
 
 #define FETCH_CONCURRENT_LIMIT 5
+#define LOCAL_CONCURRENT_LIMIT 4
 
 struct ddb_cover_info_priv_s {
     // query info
@@ -40,6 +41,8 @@ struct ddb_cover_info_priv_s {
     char artist[1000];
     char title[1000];
     int is_compilation;
+    int64_t flac_picture_offset; // file offset of the first FLAC PICTURE block body, or 0 if unknown
+    int64_t flac_picture_size; // size of that block body
 
     char track_cache_path[PATH_MAX];
     char album_cache_path[PATH_MAX];
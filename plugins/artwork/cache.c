@@ -23,13 +23,19 @@
 
 #include <dirent.h>
 #include <dispatch/dispatch.h>
+#include <inttypes.h>
 #include <libgen.h>
 #include <limits.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <time.h>
 #include <unistd.h>
+#ifdef _WIN32
+#include <sys/utime.h>
+#endif
 #ifdef HAVE_CONFIG_H
 #include "../../config.h"
 #endif
@@ -62,22 +68,139 @@ make_cache_root_path (char *path, const size_t size) {
     return 0;
 }
 
+static int
+path_ok (const char *entry) {
+    return strcmp (entry, ".") && strcmp (entry, "..");
+}
+
+// Square sizes the thumbnails are stored at; a request is served from the smallest one which covers it
+static const int thumbnail_sizes[] = { 64, 128, 256, 512 };
+
+// Seconds since the last use, until a thumbnail expires; independent of the cover expiration, which is off by default
+#define THUMBNAIL_EXPIRATION_TIME (30 * 24 * 60 * 60)
+
+static int
+make_thumbnail_root_path (char *path, const size_t size) {
+    const char *cache_root_path = deadbeef->get_system_dir(DDB_SYS_DIR_CACHE);
+    size_t res;
+    res = snprintf(path, size, "%s/covers2-thumbs", cache_root_path);
+    if (res >= size) {
+        trace ("artwork: thumbnail root path truncated at %d bytes\n", (int)size);
+        return -1;
+    }
+    return 0;
+}
+
+// All thumbnails of one image live in a directory named after the hash of the image path
+static int
+make_thumbnail_dir_path (const char *image_path, char *path, const size_t size) {
+    char root_path[PATH_MAX];
+    if (make_thumbnail_root_path (root_path, sizeof (root_path))) {
+        return -1;
+    }
+
+    uint64_t hash = 0xcbf29ce484222325ULL; // FNV-1a
+    for (const unsigned char *p = (const unsigned char *)image_path; *p; p++) {
+        hash = (hash ^ *p) * 0x100000001b3ULL;
+    }
+
+    size_t res = snprintf (path, size, "%s/%016" PRIx64, root_path, hash);
+    if (res >= size) {
+        return -1;
+    }
+    return 0;
+}
+
+// Unlinks the thumbnails not newer than `expiry`, or all of them, and the directory once it's empty
+static void
+remove_thumbnail_dir (const char *dir_path, const int remove_all, const time_t expiry) {
+    DIR *dir = opendir (dir_path);
+    if (dir == NULL) {
+        return;
+    }
+    struct dirent *entry;
+    char entry_path[PATH_MAX];
+    while ((entry = readdir (dir))) {
+        if (!path_ok (entry->d_name)) {
+            continue;
+        }
+        if (sizeof (entry_path) <= snprintf (entry_path, sizeof (entry_path), "%s/%s", dir_path, entry->d_name)) {
+            continue;
+        }
+        struct stat stat_buf;
+        if (remove_all || (!stat (entry_path, &stat_buf) && stat_buf.st_mtime <= expiry)) {
+            (void)unlink (entry_path);
+        }
+    }
+    closedir (dir);
+    (void)rmdir (dir_path);
+}
+
+void
+remove_thumbnails (const char *image_path) {
+    char dir_path[PATH_MAX];
+    if (!make_thumbnail_dir_path (image_path, dir_path, sizeof (dir_path))) {
+        remove_thumbnail_dir (dir_path, 1, 0);
+    }
+}
+
+int
+make_thumbnail_path (const char *image_path, int width, int height, char *path, size_t size, int *thumbnail_size) {
+    int needed = max (width, height);
+    int box = 0;
+    for (int i = 0; i < sizeof (thumbnail_sizes) / sizeof (thumbnail_sizes[0]); i++) {
+        if (thumbnail_sizes[i] >= needed) {
+            box = thumbnail_sizes[i];
+            break;
+        }
+    }
+    if (needed <= 0 || box == 0) {
+        return -1;
+    }
+
+    char dir_path[PATH_MAX];
+    if (make_thumbnail_dir_path (image_path, dir_path, sizeof (dir_path))) {
+        return -1;
+    }
+    if (size <= snprintf (path, size, "%s/%d.thumb", dir_path, box)) {
+        return -1;
+    }
+    *thumbnail_size = box;
+
+    struct stat image_stat;
+    if (stat (image_path, &image_stat)) {
+        return -1;
+    }
+
+    // A thumbnail written in the same second as the image may predate it, so it needs to be strictly newer
+    struct stat thumbnail_stat;
+    if (!stat (path, &thumbnail_stat) && thumbnail_stat.st_size > 0 && thumbnail_stat.st_mtime > image_stat.st_mtime) {
+        // Mark the thumbnail as used, at most once a day, so that the cleaner only prunes the unused ones
+        if (thumbnail_stat.st_mtime < time (NULL) - 24 * 60 * 60) {
+#ifdef _WIN32
+            (void)_utime (path, NULL);
+#else
+            (void)utimes (path, NULL);
+#endif
+        }
+        return 1;
+    }
+
+    return ensure_dir (path) ? 0 : -1;
+}
+
 void
 remove_cache_item (const char *cache_path) {
     // Unlink the expired file, and the artist directory if it is empty
     (void)unlink (cache_path);
+    remove_thumbnails (cache_path);
 }
 
 static int
-path_ok (const char *entry) {
-    return strcmp (entry, ".") && strcmp (entry, "..");
-}
-
-static int
-should_terminate(void) {
+should_terminate(int covers) {
     __block int terminate = 0;
     dispatch_sync(sync_queue, ^{
-        terminate = (_terminate || _file_expiration_time == 0);
+        terminate = (_terminate || (covers && _file_expiration_time == 0));
     });
     return terminate;
 }
@@ -89,17 +212,17 @@ cache_cleaner_worker (void) {
         return;
     }
 
-    const int32_t cache_secs = _file_expiration_time;
+    __block int32_t cache_secs = 0;
+    dispatch_sync(sync_queue, ^{
+        cache_secs = _file_expiration_time;
+    });
     const time_t cache_expiry = time (NULL) - cache_secs;
 
-    DIR *covers_dir = opendir (covers_path);
-    if (covers_dir == NULL) {
-        return;
-    }
     struct dirent *entry;
     char entry_path[PATH_MAX];
 
-    while (!should_terminate() && (entry = readdir (covers_dir))) {
+    DIR *covers_dir = cache_secs != 0 ? opendir (covers_path) : NULL;
+    while (covers_dir != NULL && !should_terminate(1) && (entry = readdir (covers_dir))) {
         if (path_ok (entry->d_name)) {
             if (sizeof (entry_path) < snprintf (entry_path, sizeof(entry_path), "%s/%s", covers_path, entry->d_name)) {
                 trace("artwork: cache cleaner entry_path buffer too small for path:\n%s/%s\n", covers_path, entry->d_name);
@@ -120,14 +243,36 @@ cache_cleaner_worker (void) {
         closedir (covers_dir);
         covers_dir = NULL;
     }
+
+    // Thumbnails are pruned even when the covers never expire, since they are also made for the images outside of the cache;
+    // they expire when unused for a while, and together with their cover
+    const time_t thumbnail_expiry = time (NULL) - THUMBNAIL_EXPIRATION_TIME;
+    char thumbnails_path[PATH_MAX];
+    if (make_thumbnail_root_path (thumbnails_path, sizeof (thumbnails_path))) {
+        return;
+    }
+    DIR *thumbnails_dir = opendir (thumbnails_path);
+    if (thumbnails_dir == NULL) {
+        return;
+    }
+    while (!should_terminate(0) && (entry = readdir (thumbnails_dir))) {
+        if (path_ok (entry->d_name)) {
+            if (sizeof (entry_path) < snprintf (entry_path, sizeof(entry_path), "%s/%s", thumbnails_path, entry->d_name)) {
+                continue;
+            }
+            remove_thumbnail_dir (entry_path, 0, thumbnail_expiry);
+        }
+    }
+    closedir (thumbnails_dir);
 }
 
-void
-cache_configchanged (void) {
+static void
+_update_expiration_time (int start) {
     dispatch_sync(sync_queue, ^{
         int32_t old_expiration_time = _file_expiration_time;
         _file_expiration_time = deadbeef->conf_get_int ("artwork.cache.expiration_time", 0) * 60 * 60;
-        if (old_expiration_time == 0 && _file_expiration_time != 0) {
+        // The first pass always runs, to prune the thumbnails
+        if (start || (old_expiration_time == 0 && _file_expiration_time != 0)) {
             dispatch_async(worker_queue, ^{
                 cache_cleaner_worker();
             });
@@ -136,6 +281,11 @@ cache_configchanged (void) {
     });
 }
 
+void
+cache_configchanged (void) {
+    _update_expiration_time (0);
+}
+
 int
 start_cache_cleaner (void) {
     _terminate = 0;
@@ -143,7 +293,7 @@ start_cache_cleaner (void) {
     sync_queue = dispatch_queue_create("ArtworkCacheSyncQueue", NULL);
     worker_queue = dispatch_queue_create("ArtworkCacheCleanerQueue", NULL);
 
-    cache_configchanged();
+    _update_expiration_time (1);
 
     return 0;
 }
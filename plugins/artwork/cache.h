@@ -26,6 +26,8 @@
 
 int make_cache_root_path(char *path, const size_t size);
 void remove_cache_item(const char *entry_path);
+int make_thumbnail_path(const char *image_path, int width, int height, char *path, size_t size, int *thumbnail_size);
+void remove_thumbnails(const char *image_path);
 void cache_configchanged(void);
 void start_cache_cleaner(void);
 void stop_cache_cleaner(void);
@@ -0,0 +1,135 @@
+/*
+    DeaDBeeF -- the music player
+    Copyright (C) 2009-2023 Oleksiy Yakovenko and other contributors
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <dirent.h>
+#include <dispatch/dispatch.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "dirlisting.h"
+
+#define DIR_LISTING_CACHE_SIZE 1024
+
+extern dispatch_queue_t sync_queue;
+
+// Direct-mapped by path hash: lookups for one album come in bursts, so only the recent directories need to stay
+static dir_listing_t *dir_listing_cache[DIR_LISTING_CACHE_SIZE];
+
+static uint32_t
+_path_hash (const char *path) {
+    uint32_t hash = 2166136261u; // FNV-1a
+    for (const unsigned char *p = (const unsigned char *)path; *p; p++) {
+        hash = (hash ^ *p) * 16777619u;
+    }
+    return hash;
+}
+
+// called on sync_queue
+static void
+_dir_listing_release (dir_listing_t *listing) {
+    listing->refc -= 1;
+    if (listing->refc != 0) {
+        return;
+    }
+    for (int i = 0; i < listing->count; i++) {
+        free (listing->names[i]);
+    }
+    free (listing->names);
+    free (listing->path);
+    free (listing);
+}
+
+dir_listing_t *
+dir_listing_get (const char *path, DB_vfs_t *vfsplug) {
+    // A change within the same second as the listing wouldn't update the mtime,
+    // so such directories are listed again until their mtime is in the past
+    struct stat stat_buf;
+    int cacheable = !stat (path, &stat_buf) && stat_buf.st_mtime < time (NULL);
+    const uint32_t slot = _path_hash (path) % DIR_LISTING_CACHE_SIZE;
+
+    __block dir_listing_t *listing = NULL;
+    if (cacheable) {
+        dispatch_sync(sync_queue, ^{
+            dir_listing_t *cached = dir_listing_cache[slot];
+            if (cached != NULL && cached->mtime == stat_buf.st_mtime && !strcmp (cached->path, path)) {
+                cached->refc += 1;
+                listing = cached;
+            }
+        });
+        if (listing != NULL) {
+            return listing;
+        }
+    }
+
+    struct dirent **files = NULL;
+    int (* custom_scandir)(const char *, struct dirent ***, int (*)(const struct dirent *), int (*)(const struct dirent **, const struct dirent **));
+    custom_scandir = vfsplug ? vfsplug->scandir : scandir;
+    int files_count = custom_scandir (path, &files, NULL, NULL);
+    if (files == NULL) {
+        return NULL;
+    }
+
+    listing = calloc (1, sizeof (dir_listing_t));
+    listing->path = strdup (path);
+    listing->mtime = cacheable ? stat_buf.st_mtime : 0;
+    listing->refc = 1;
+    listing->names = calloc (files_count > 0 ? files_count : 1, sizeof (char *));
+    for (int i = 0; i < files_count; i++) {
+        listing->names[listing->count++] = strdup (files[i]->d_name);
+        free (files[i]);
+    }
+    free (files);
+
+    if (cacheable) {
+        dispatch_sync(sync_queue, ^{
+            dir_listing_t *old = dir_listing_cache[slot];
+            listing->refc += 1;
+            dir_listing_cache[slot] = listing;
+            if (old != NULL) {
+                _dir_listing_release (old);
+            }
+        });
+    }
+
+    return listing;
+}
+
+void
+dir_listing_release (dir_listing_t *listing) {
+    dispatch_sync(sync_queue, ^{
+        _dir_listing_release (listing);
+    });
+}
+
+void
+dir_listing_cache_clear (void) {
+    dispatch_sync(sync_queue, ^{
+        for (int i = 0; i < DIR_LISTING_CACHE_SIZE; i++) {
+            if (dir_listing_cache[i] != NULL) {
+                _dir_listing_release (dir_listing_cache[i]);
+                dir_listing_cache[i] = NULL;
+            }
+        }
+    });
+}
@@ -0,0 +1,50 @@
+/*
+    DeaDBeeF -- the music player
+    Copyright (C) 2009-2023 Oleksiy Yakovenko and other contributors
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef __ARTWORK_DIRLISTING_H
+#define __ARTWORK_DIRLISTING_H
+
+#include <time.h>
+#include <deadbeef/deadbeef.h>
+
+typedef struct dir_listing_s {
+    char *path;
+    time_t mtime; // mtime of the directory when it was listed
+    int refc;
+    int count;
+    char **names;
+} dir_listing_t;
+
+/// Returns the entry names of the directory, or of the VFS container if @c vfsplug is not NULL.
+/// The listing is shared with other lookups until the directory mtime changes.
+/// Returns NULL if the directory can't be read, otherwise release the result with @c dir_listing_release.
+dir_listing_t *
+dir_listing_get (const char *path, DB_vfs_t *vfsplug);
+
+void
+dir_listing_release (dir_listing_t *listing);
+
+void
+dir_listing_cache_clear (void);
+
+#endif /*__ARTWORK_DIRLISTING_H*/
@@ -699,7 +699,7 @@ main_cleanup_and_quit (void);
     else if (_id == DB_EV_SONGFINISHED) {
         [g_appDelegate performSelectorOnMainThread:@selector(clearDockNowPlaying) withObject:nil waitUntilDone:NO];
     }
-    else if (_id == DB_EV_SONGCHANGED || _id == DB_EV_TRACKINFOCHANGED || (_id == DB_EV_PLAYLISTCHANGED && p1 == DDB_PLAYLIST_CHANGE_CONTENT)) {
+    else if (_id == DB_EV_SONGCHANGED || _id == DB_EV_TRACKINFOCHANGED || _id == DB_EV_TRACKSINFOCHANGED || (_id == DB_EV_PLAYLISTCHANGED && p1 == DDB_PLAYLIST_CHANGE_CONTENT)) {
         [g_appDelegate performSelectorOnMainThread:@selector(updateTitleBar) withObject:nil waitUntilDone:NO];
     }
     else if (_id == DB_EV_VOLUMECHANGED) {
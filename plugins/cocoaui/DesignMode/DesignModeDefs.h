@@ -38,6 +38,7 @@ NS_ASSUME_NONNULL_BEGIN
 - (nullable NSDictionary *)serializedRootDictionary;
 - (void)deserializeFromRootDictionary:(nullable NSDictionary *)dictionary;
 @property (nullable,nonatomic,readonly) NSString *displayName;
+@property (nonatomic,readonly) BOOL handlesTracksBatch; // Return YES to get DB_EV_TRACKSINFOCHANGED, instead of one DB_EV_TRACKINFOCHANGED per track
 
 @end
 
@@ -6,6 +6,7 @@
 //  Copyright © 2021 Oleksiy Yakovenko. All rights reserved.
 //
 
+#include <deadbeef/deadbeef.h>
 #import "DesignModeState.h"
 #import "WidgetBase.h"
 #import "WidgetTopLevelView.h"
@@ -48,6 +49,18 @@
 
 - (void)message:(uint32_t)_id ctx:(uintptr_t)ctx p1:(uint32_t)p1 p2:(uint32_t)p2 {
     for (id<WidgetProtocol> widget in self.childWidgets) {
+        if (_id == DB_EV_TRACKSINFOCHANGED && !([widget respondsToSelector:@selector(handlesTracksBatch)] && widget.handlesTracksBatch)) {
+            ddb_event_tracks_t *ev = (ddb_event_tracks_t *)ctx;
+            for (int i = 0; i < ev->count; i++) {
+                ddb_event_track_t track_ev = {
+                    .ev.event = DB_EV_TRACKINFOCHANGED,
+                    .ev.size = sizeof (ddb_event_track_t),
+                    .track = ev->tracks[i],
+                };
+                [widget message:DB_EV_TRACKINFOCHANGED ctx:(uintptr_t)&track_ev p1:0 p2:0];
+            }
+            continue;
+        }
         [widget message:_id ctx:ctx p1:p1 p2:p2];
     }
 }
@@ -21,6 +21,11 @@
     return @"Holder";
 }
 
+// The children get the batch or the expanded tracks from WidgetBase
+- (BOOL)handlesTracksBatch {
+    return YES;
+}
+
 - (instancetype)initWithDeps:(id<DesignModeDepsProtocol>)deps originalTypeName:(NSString *)originalTypeName {
     self = [super initWithDeps:deps];
     if (self == nil) {
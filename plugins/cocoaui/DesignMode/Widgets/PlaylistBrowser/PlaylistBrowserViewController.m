@@ -128,6 +128,7 @@ extern DB_functions_t *deadbeef;
     case DB_EV_PAUSED:
     case DB_EV_STOP:
     case DB_EV_TRACKINFOCHANGED:
+    case DB_EV_TRACKSINFOCHANGED:
         {
             dispatch_async(dispatch_get_main_queue(), ^{
                 [self reloadData];
@@ -45,4 +45,8 @@
     [self.viewController widgetMessage:_id ctx:ctx p1:p1 p2:p2];
 }
 
+- (BOOL)handlesTracksBatch {
+    return YES;
+}
+
 @end
@@ -61,6 +61,10 @@
     [self.viewController sendMessage:_id ctx:ctx p1:p1 p2:p2];
 }
 
+- (BOOL)handlesTracksBatch {
+    return YES;
+}
+
 - (BOOL)makeFirstResponder {
     PlaylistView *playlistView = (PlaylistView *)self.viewController.view;
     [playlistView.window makeFirstResponder:playlistView.contentView];
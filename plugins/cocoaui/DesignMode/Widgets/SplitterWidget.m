@@ -47,6 +47,11 @@ typedef NS_ENUM(NSInteger,HoldingMode) {
     return NO;
 }
 
+// The children get the batch or the expanded tracks from WidgetBase
+- (BOOL)handlesTracksBatch {
+    return YES;
+}
+
 - (instancetype)initWithDeps:(id<DesignModeDepsProtocol>)deps {
     self = [super initWithDeps:deps];
     if (self == nil) {
@@ -29,6 +29,11 @@
     return @"Tabs";
 }
 
+// The children get the batch or the expanded tracks from WidgetBase
+- (BOOL)handlesTracksBatch {
+    return YES;
+}
+
 - (instancetype)initWithDeps:(id<DesignModeDepsProtocol>)deps {
     self = [super initWithDeps:deps];
     if (self == nil) {
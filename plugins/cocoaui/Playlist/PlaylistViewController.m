@@ -1192,6 +1192,28 @@ artwork_listener (ddb_artwork_listener_event_t event, void *user_data, int64_t p
             }
         }
             break;
+        case DB_EV_TRACKSINFOCHANGED: {
+            ddb_event_tracks_t *ev = (ddb_event_tracks_t *)ctx;
+            int count = ev->count;
+            DB_playItem_t **tracks = malloc (count * sizeof (DB_playItem_t *));
+            for (int i = 0; i < count; i++) {
+                tracks[i] = ev->tracks[i];
+                deadbeef->pl_item_ref (tracks[i]);
+            }
+            // all rows are invalidated in one go, and get redrawn in a single pass
+            dispatch_async(dispatch_get_main_queue(), ^{
+                PlaylistView *listview = (PlaylistView *)self.view;
+                for (int i = 0; i < count; i++) {
+                    int idx = deadbeef->pl_get_idx_of (tracks[i]);
+                    if (idx != -1) {
+                        [listview.contentView drawRow:idx];
+                    }
+                    deadbeef->pl_item_unref (tracks[i]);
+                }
+                free (tracks);
+            });
+        }
+            break;
         case DB_EV_PAUSED: {
             dispatch_async(dispatch_get_main_queue(), ^{
                 PlaylistView *listview = (PlaylistView *)self.view;
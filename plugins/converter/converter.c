@@ -40,6 +40,11 @@
 #include <unistd.h>
 #include <inttypes.h>
 #include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#if HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>
+#endif
 #include <deadbeef/deadbeef.h>
 #include "converter.h"
 #include <deadbeef/strdupa.h>
@@ -855,8 +860,13 @@ static const unsigned char format_id_pcm[] = {
     0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71
 };
 
+// When stream_size is not negative, the wave header announces exactly that many bytes of data.
+// The audio is never altered to match it: the writing stops as soon as the decoder produces more,
+// and nothing is padded when it produces less, so the caller can tell from the returned size
+// that the data didn't match, and convert again without announcing the size.
+// The returned size is the amount of data produced by the decoder.
 static int64_t
-_write_wav (DB_playItem_t *it, DB_decoder_t *dec, DB_fileinfo_t *fileinfo, ddb_dsp_preset_t *dsp_preset, ddb_encoder_preset_t *encoder_preset, int *abort, int fd, int output_bps, int output_is_float) {
+_write_wav (DB_playItem_t *it, DB_decoder_t *dec, DB_fileinfo_t *fileinfo, ddb_dsp_preset_t *dsp_preset, ddb_encoder_preset_t *encoder_preset, int *abort, int fd, int output_bps, int output_is_float, int64_t stream_size) {
     int64_t res = -1;
     char *buffer = NULL;
     char *dspbuffer = NULL;
@@ -951,7 +961,10 @@ _write_wav (DB_playItem_t *it, DB_decoder_t *dec, DB_fileinfo_t *fileinfo, ddb_d
 
             }
 
-            if (outsr != fileinfo->fmt.samplerate) {
+            if (stream_size >= 0) {
+                size = stream_size;
+            }
+            else if (outsr != fileinfo->fmt.samplerate) {
                 uint64_t temp = size;
                 temp *= outsr;
                 temp /= fileinfo->fmt.samplerate;
@@ -1029,7 +1042,11 @@ _write_wav (DB_playItem_t *it, DB_decoder_t *dec, DB_fileinfo_t *fileinfo, ddb_d
             }
         }
 
-        int64_t res = write (fd, buffer, sz);
+        if (stream_size >= 0 && outsize > stream_size) {
+            break;
+        }
+
+        int64_t res = sz > 0 ? write (fd, buffer, sz) : 0;
         if (sz != res) {
             trace ("Write error (%"PRId64" bytes written out of %d)\n", res, sz);
             goto error;
@@ -1039,7 +1056,7 @@ _write_wav (DB_playItem_t *it, DB_decoder_t *dec, DB_fileinfo_t *fileinfo, ddb_d
     res = outsize;
 
     // rewrite wave data size
-    if (encoder_preset->method == DDB_ENCODER_METHOD_FILE) {
+    if (encoder_preset->method == DDB_ENCODER_METHOD_FILE && stream_size < 0) {
         uint32_t writesize;
 
         // RIFF chunk size
@@ -1124,6 +1141,74 @@ _get_encoder_cmdline (ddb_encoder_preset_t *encoder_preset, char *enc, int len,
     return 0;
 }
 
+#if defined(__linux__) && HAVE_SYS_SENDFILE_H
+// Copies a local file inside the kernel, without passing the data through userspace buffers.
+// Returns 0 on success, -1 on error, or 1 if the copy needs to be done by reading and writing.
+static int
+_copy_file_in_kernel (const char *in, const char *out) {
+    int fin = open (in, O_RDONLY | O_LARGEFILE);
+    if (fin == -1) {
+        return 1;
+    }
+    struct stat st;
+    if (fstat (fin, &st) || !S_ISREG (st.st_mode)) {
+        close (fin);
+        return 1;
+    }
+    int fout = open (out, O_WRONLY | O_CREAT | O_TRUNC | O_LARGEFILE, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
+    if (fout == -1) {
+        trace ("Failed to open file %s for writing\n", out);
+        close (fin);
+        return -1;
+    }
+
+    int res = 0;
+    int64_t total = 0;
+#if HAVE_COPY_FILE_RANGE && !PORTABLE
+    int use_copy_file_range = 1;
+#else
+    int use_copy_file_range = 0;
+#endif
+    while (total < st.st_size) {
+        size_t len = (size_t)min (st.st_size - total, 0x40000000);
+        ssize_t n;
+#if HAVE_COPY_FILE_RANGE && !PORTABLE
+        if (use_copy_file_range) {
+            n = copy_file_range (fin, NULL, fout, NULL, len, 0);
+            if (n < 0 && total == 0 && (errno == ENOSYS || errno == EXDEV || errno == EINVAL || errno == EOPNOTSUPP)) {
+                use_copy_file_range = 0;
+                continue;
+            }
+        }
+        else
+#endif
+        {
+            n = sendfile (fout, fin, NULL, len);
+            if (n < 0 && total == 0 && (errno == ENOSYS || errno == EINVAL)) {
+                res = 1;
+                break;
+            }
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            trace ("Failed to write file %s: %s\n", out, n < 0 ? strerror (errno) : "unexpected end of file");
+            res = -1;
+            break;
+        }
+        total += n;
+    }
+
+    close (fin);
+    if (close (fout) && !res) {
+        trace ("Failed to write file %s: %s\n", out, strerror (errno));
+        res = -1;
+    }
+    return res;
+}
+#endif
+
 #define BUFFER_SIZE 4096
 static int
 _copy_file (const char *in, const char *out) {
@@ -1137,14 +1222,31 @@ _copy_file (const char *in, const char *out) {
         }
     }
 
+    char tmp_out[PATH_MAX];
+    snprintf (tmp_out, PATH_MAX, "%s.part", out);
+
+#if defined(__linux__) && HAVE_SYS_SENDFILE_H
+    if (deadbeef->is_local_file (in)) {
+        int res = _copy_file_in_kernel (in, tmp_out);
+        if (res <= 0) {
+            if (!res) {
+                res = rename (tmp_out, out);
+                if (res) {
+                    trace ("Failed to move %s to %s: %s\n", tmp_out, out, strerror (errno));
+                }
+            }
+            unlink (tmp_out);
+            return res;
+        }
+    }
+#endif
+
     DB_FILE *infile = deadbeef->fopen (in);
     if (!infile) {
         trace ("Failed to open file %s for reading\n", in);
         return -1;
     }
 
-    char tmp_out[PATH_MAX];
-    snprintf (tmp_out, PATH_MAX, "%s.part", out);
     FILE *fout = fopen (tmp_out, "w+b");
     if (!fout) {
         trace ("Failed to open file %s for writing\n", tmp_out);
@@ -1342,6 +1444,140 @@ ddb_mktemp(char *template, size_t template_size, char *suffix) {
 #endif
 }
 
+#ifndef _WIN32
+#define FIFO_OPEN_TIMEOUT_MS 10000
+
+// File based encoders can be fed through a named pipe, when the exact size of the wave data is known in advance.
+static int
+_can_stream_to_encoder (DB_playItem_t *it, ddb_dsp_preset_t *dsp_preset) {
+    if (!deadbeef->conf_get_int ("converter.stream_file_encoders", 1)) {
+        return 0;
+    }
+    if (dsp_preset && dsp_preset->chain) {
+        return 0;
+    }
+    return deadbeef->pl_item_get_endsample (it) > deadbeef->pl_item_get_startsample (it);
+}
+
+// Sends the wave data to a file based encoder through a named pipe, instead of a temp file.
+// Returns 0 on success, -1 on error, or 1 if the encoder couldn't be fed this way,
+// i.e. it didn't open the pipe, or the decoded size didn't match the announced one,
+// and the conversion needs to be retried using a temp file.
+// The encoder failures are returned as errors, since the retry would run the same encoder again.
+static int
+_encode_via_fifo (DB_playItem_t *it, DB_decoder_t *dec, DB_fileinfo_t *fileinfo, ddb_encoder_preset_t *encoder_preset, const char *escaped_out, int output_bps, int output_is_float, int *pabort) {
+    int64_t startsample = deadbeef->pl_item_get_startsample (it);
+    int64_t endsample = deadbeef->pl_item_get_endsample (it);
+    int samplesize = fileinfo->fmt.channels * output_bps / 8;
+    int64_t stream_size = (endsample - startsample + 1) * samplesize;
+
+    const char *tmp = getenv ("TMPDIR");
+    if (!tmp) {
+        tmp = "/tmp";
+    }
+    char fifo_dir[PATH_MAX];
+    snprintf (fifo_dir, sizeof (fifo_dir), "%s/ddbconvXXXXXX", tmp);
+    if (!mkdtemp (fifo_dir)) {
+        return 1;
+    }
+    char fifo_name[PATH_MAX];
+    snprintf (fifo_name, sizeof (fifo_name), "%s/input.wav", fifo_dir);
+
+    int res = 1;
+    int fd = -1;
+    FILE *enc_pipe = NULL;
+    char enc[2000];
+
+    if (mkfifo (fifo_name, S_IRUSR | S_IWUSR)) {
+        trace ("Failed to create fifo %s\n", fifo_name);
+        goto done;
+    }
+
+    if (_get_encoder_cmdline (encoder_preset, enc, sizeof (enc), escaped_out, fifo_name) < 0) {
+        res = -1;
+        goto done;
+    }
+
+    enc_pipe = popen (enc, "w");
+    if (!enc_pipe) {
+        trace ("Failed to execute the encoder, command used:\n%s\n", enc);
+        res = -1;
+        goto done;
+    }
+
+    // wait for the encoder to open its input
+    for (int elapsed = 0; ; elapsed += 10) {
+        fd = open (fifo_name, O_WRONLY | O_NONBLOCK | _O_BINARY);
+        if (fd != -1 || errno != ENXIO || elapsed >= FIFO_OPEN_TIMEOUT_MS || (pabort && *pabort)) {
+            break;
+        }
+        usleep (10000);
+    }
+    if (fd == -1) {
+        trace ("The encoder didn't open %s, falling back to a temp file\n", fifo_name);
+        goto done;
+    }
+    fcntl (fd, F_SETFL, fcntl (fd, F_GETFL) & ~O_NONBLOCK);
+#ifdef F_SETPIPE_SZ
+    // the pipe is the only buffer between the decoder and the encoder
+    fcntl (fd, F_SETPIPE_SZ, 1024 * 1024);
+#endif
+
+    // if the encoder quits early, the write should fail instead of killing the player
+    sigset_t sigpipe_mask, old_mask;
+    sigemptyset (&sigpipe_mask);
+    sigaddset (&sigpipe_mask, SIGPIPE);
+    pthread_sigmask (SIG_BLOCK, &sigpipe_mask, &old_mask);
+
+    int64_t outsize = _write_wav (it, dec, fileinfo, NULL, encoder_preset, pabort, fd, output_bps, output_is_float, stream_size);
+    close (fd);
+    fd = -1;
+
+    sigset_t pending;
+    sigpending (&pending);
+    if (sigismember (&pending, SIGPIPE)) {
+        int sig;
+        sigwait (&sigpipe_mask, &sig);
+    }
+    pthread_sigmask (SIG_SETMASK, &old_mask, NULL);
+
+    int status = pclose (enc_pipe);
+    enc_pipe = NULL;
+
+    if (pabort && *pabort) {
+        res = -1;
+        goto done;
+    }
+    if (outsize >= 0 && outsize != stream_size) {
+        // the encoder got a cut off stream, its exit status doesn't matter
+        trace ("Decoded %"PRId64" bytes, while %"PRId64" were expected, retrying with a temp file\n", outsize, stream_size);
+        goto done;
+    }
+    if (outsize < 0 || status == -1 || WEXITSTATUS (status)) {
+        trace ("The encoder failed reading from a fifo, command used:\n%s\n", enc);
+        res = -1;
+        goto done;
+    }
+    res = 0;
+
+done:
+    if (fd != -1) {
+        close (fd);
+    }
+    if (enc_pipe) {
+        // wake up the encoder, if it's still waiting for a writer
+        int unblock = open (fifo_name, O_RDWR | O_NONBLOCK);
+        if (unblock != -1) {
+            close (unblock);
+        }
+        pclose (enc_pipe);
+    }
+    unlink (fifo_name);
+    rmdir (fifo_dir);
+    return res;
+}
+#endif
+
 static int
 convert2 (ddb_converter_settings_t *settings, DB_playItem_t *it, const char *out, int *pabort) {
     int output_bps = settings->output_bps;
@@ -1423,6 +1659,24 @@ convert2 (ddb_converter_settings_t *settings, DB_playItem_t *it, const char *out
                 switch (encoder_preset->method) {
                     case DDB_ENCODER_METHOD_FILE:
                     {
+#ifndef _WIN32
+                        if (encoder_preset->encoder[0] && _can_stream_to_encoder (it, dsp_preset)) {
+                            int res = _encode_via_fifo (it, dec, fileinfo, encoder_preset, escaped_out, output_bps, output_is_float, pabort);
+                            if (res <= 0) {
+                                err = res;
+                                goto error;
+                            }
+                            // the encoder may have written a partial file
+                            unlink (out);
+                            // the decoder needs to start over
+                            dec->free (fileinfo);
+                            fileinfo = dec->open (DDB_DECODER_HINT_RAW_SIGNAL);
+                            if (!fileinfo || dec->init (fileinfo, DB_PLAYITEM (it)) != 0) {
+                                trace ("Failed to decode file %s\n", fname);
+                                goto error;
+                            }
+                        }
+#endif
                         const char *tmp = getenv ("TMPDIR");
                         if (!tmp) {
                             tmp = "/tmp";
@@ -1482,7 +1736,7 @@ convert2 (ddb_converter_settings_t *settings, DB_playItem_t *it, const char *out
                 }
 
                 if (temp_file > 0) {
-                    int64_t outsize = _write_wav (it, dec, fileinfo, dsp_preset, encoder_preset, pabort, temp_file, output_bps, output_is_float);
+                    int64_t outsize = _write_wav (it, dec, fileinfo, dsp_preset, encoder_preset, pabort, temp_file, output_bps, output_is_float, -1);
 
                     if (outsize < 0) {
                         goto error;
@@ -1546,6 +1800,230 @@ error:
     return err;
 }
 
+// batch conversion
+
+#define MAX_BATCH_THREADS 64
+
+typedef struct {
+    ddb_converter_batch_t *batch;
+    uintptr_t mutex;
+    uintptr_t prepare_mutex;
+
+    // first item, which may still be pending
+    int next;
+
+    // BATCH_ITEM_*
+    char *state;
+
+    // output folder of each item, when preserving folder order
+    char **folders;
+
+    // output folders owned by the workers.
+    // A worker keeps its folder until it has converted all items going there, so nobody needs to wait for a folder.
+    const char *busy_folders[MAX_BATCH_THREADS];
+
+    int started;
+    int completed;
+    int failed;
+} batch_queue_t;
+
+enum {
+    BATCH_ITEM_PENDING,
+    BATCH_ITEM_RUNNING,
+    BATCH_ITEM_DONE,
+};
+
+typedef struct {
+    batch_queue_t *queue;
+    int slot;
+} batch_worker_t;
+
+static int
+_batch_folder_busy (batch_queue_t *q, const char *folder) {
+    for (int i = 0; i < MAX_BATCH_THREADS; i++) {
+        if (q->busy_folders[i] && !strcmp (q->busy_folders[i], folder)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Finds the next item to convert, must be called with the queue locked.
+// prev is the item previously converted by the worker, or -1.
+// Returns -1 when the worker has nothing left to do: the remaining items are either done,
+// or go to folders owned by other workers, which will convert them.
+static int
+_batch_take_item (batch_queue_t *q, int slot, int prev) {
+    ddb_converter_batch_t *batch = q->batch;
+    while (q->next < batch->count && q->state[q->next] != BATCH_ITEM_PENDING) {
+        q->next++;
+    }
+
+    int idx = -1;
+    if (!q->folders) {
+        if (q->next < batch->count) {
+            idx = q->next++;
+        }
+    }
+    else {
+        // continue with the next item of the owned folder, to keep the order
+        if (prev >= 0) {
+            for (int i = prev + 1; i < batch->count; i++) {
+                if (q->state[i] == BATCH_ITEM_PENDING && !strcmp (q->folders[i], q->folders[prev])) {
+                    idx = i;
+                    break;
+                }
+            }
+        }
+        if (idx < 0) {
+            q->busy_folders[slot] = NULL;
+            for (int i = q->next; i < batch->count; i++) {
+                if (q->state[i] == BATCH_ITEM_PENDING && !_batch_folder_busy (q, q->folders[i])) {
+                    q->busy_folders[slot] = q->folders[i];
+                    idx = i;
+                    break;
+                }
+            }
+        }
+    }
+
+    if (idx >= 0) {
+        q->state[idx] = BATCH_ITEM_RUNNING;
+    }
+    return idx;
+}
+
+static void
+_batch_worker (void *ctx) {
+    batch_worker_t *worker = ctx;
+    batch_queue_t *q = worker->queue;
+    ddb_converter_batch_t *batch = q->batch;
+
+    // the DSP plugins keep the state in their contexts, so each worker needs its own chain
+    ddb_converter_settings_t settings = *batch->settings;
+    if (batch->settings->dsp_preset) {
+        settings.dsp_preset = dsp_preset_alloc ();
+        dsp_preset_copy (settings.dsp_preset, batch->settings->dsp_preset);
+    }
+
+    int idx = -1;
+    deadbeef->mutex_lock (q->mutex);
+    for (;;) {
+        if (batch->pabort && *batch->pabort) {
+            break;
+        }
+        idx = _batch_take_item (q, worker->slot, idx);
+        if (idx < 0) {
+            break;
+        }
+        int position = q->started++;
+        deadbeef->mutex_unlock (q->mutex);
+
+        int res = 1;
+        int convert = 1;
+        if (batch->prepare || batch->progress) {
+            deadbeef->mutex_lock (q->prepare_mutex);
+            if (batch->prepare) {
+                convert = batch->prepare (batch, idx);
+            }
+            if (convert && batch->progress) {
+                batch->progress (batch, idx, 1, 0, position);
+            }
+            deadbeef->mutex_unlock (q->prepare_mutex);
+        }
+
+        if (convert) {
+            res = convert2 (&settings, batch->items[idx], batch->outpaths[idx], batch->pabort);
+        }
+
+        deadbeef->mutex_lock (q->mutex);
+        q->state[idx] = BATCH_ITEM_DONE;
+        q->completed++;
+        if (res < 0) {
+            q->failed++;
+        }
+        int completed = q->completed;
+        deadbeef->mutex_unlock (q->mutex);
+
+        if (batch->progress) {
+            deadbeef->mutex_lock (q->prepare_mutex);
+            batch->progress (batch, idx, 0, res, completed);
+            deadbeef->mutex_unlock (q->prepare_mutex);
+        }
+
+        deadbeef->mutex_lock (q->mutex);
+    }
+    q->busy_folders[worker->slot] = NULL;
+    deadbeef->mutex_unlock (q->mutex);
+
+    if (settings.dsp_preset != batch->settings->dsp_preset) {
+        dsp_preset_free (settings.dsp_preset);
+    }
+}
+
+static int
+convert_batch (ddb_converter_batch_t *batch) {
+    if (batch->_size < sizeof (ddb_converter_batch_t) || batch->count <= 0) {
+        return 0;
+    }
+
+    int numthreads = batch->numthreads;
+    if (numthreads <= 0) {
+        long ncpu = sysconf (_SC_NPROCESSORS_ONLN);
+        numthreads = ncpu > 0 ? (int)ncpu : 1;
+    }
+    numthreads = min (numthreads, MAX_BATCH_THREADS);
+    numthreads = min (numthreads, batch->count);
+
+    batch_queue_t q;
+    memset (&q, 0, sizeof (q));
+    q.batch = batch;
+    q.mutex = deadbeef->mutex_create ();
+    q.prepare_mutex = deadbeef->mutex_create ();
+    q.state = calloc (batch->count, 1);
+
+    if (batch->preserve_folder_order) {
+        q.folders = calloc (batch->count, sizeof (char *));
+        for (int i = 0; i < batch->count; i++) {
+            q.folders[i] = strdup (batch->outpaths[i]);
+            char *sep = strrchr (q.folders[i], '/');
+            if (sep) {
+                *sep = 0;
+            }
+        }
+    }
+
+    trace ("converter: converting %d tracks using %d threads\n", batch->count, numthreads);
+
+    batch_worker_t workers[MAX_BATCH_THREADS];
+    intptr_t tids[MAX_BATCH_THREADS];
+    for (int i = 0; i < numthreads; i++) {
+        workers[i].queue = &q;
+        workers[i].slot = i;
+        tids[i] = deadbeef->thread_start (_batch_worker, &workers[i]);
+    }
+    for (int i = 0; i < numthreads; i++) {
+        if (tids[i]) {
+            deadbeef->thread_join (tids[i]);
+        }
+    }
+
+    if (q.folders) {
+        for (int i = 0; i < batch->count; i++) {
+            free (q.folders[i]);
+        }
+        free (q.folders);
+    }
+    free (q.state);
+    deadbeef->mutex_free (q.mutex);
+    deadbeef->mutex_free (q.prepare_mutex);
+
+    if (batch->pabort && *batch->pabort) {
+        return -1;
+    }
+    return q.failed;
+}
+
 static int
 convert (DB_playItem_t *it, const char *out, int output_bps, int output_is_float, ddb_encoder_preset_t *encoder_preset, ddb_dsp_preset_t *dsp_preset, int *abort) {
     ddb_converter_settings_t settings = {
@@ -1590,7 +2068,7 @@ static ddb_converter_t plugin = {
     .misc.plugin.api_vmajor = DB_API_VERSION_MAJOR,
     .misc.plugin.api_vminor = DB_API_VERSION_MINOR,
     .misc.plugin.version_major = 1,
-    .misc.plugin.version_minor = 5,
+    .misc.plugin.version_minor = 6,
     .misc.plugin.flags = DDB_PLUGIN_FLAG_LOGGING,
     .misc.plugin.type = DB_PLUGIN_MISC,
     .misc.plugin.name = "Converter",
@@ -1657,6 +2135,8 @@ static ddb_converter_t plugin = {
     .get_output_path2 = get_output_path2,
     // 1.5 entry points
     .convert2 = convert2,
+    // 1.6 entry points
+    .convert_batch = convert_batch,
 };
 
 DB_plugin_t *
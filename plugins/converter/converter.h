@@ -25,6 +25,8 @@
 
 #include <stdint.h>
 
+// changes in 1.6:
+//   added `convert_batch` function, for converting multiple tracks concurrently
 // changes in 1.5:
 //   added mp4 tagging support
 //   added converter option to copy files without conversion, if file format isn't changing
@@ -101,6 +103,45 @@ typedef struct ddb_converter_settings_s {
     int rewrite_tags_after_copy;
 } ddb_converter_settings_t;
 
+// added in converter-1.6
+typedef struct ddb_converter_batch_s {
+    // must be set to sizeof (ddb_converter_batch_t)
+    size_t _size;
+
+    ddb_converter_settings_t *settings;
+
+    // number of tracks to convert at the same time, 0 means the number of CPU cores
+    int numthreads;
+
+    // convert the tracks going to the same output folder one by one, in the given order,
+    // so that the files are created in that order (useful for portable players, which sort by creation order).
+    // All tracks of a folder are converted by one worker, so only different folders are converted in parallel,
+    // and e.g. a single album doesn't benefit from numthreads.
+    int preserve_folder_order;
+
+    // tracks, and the corresponding output paths, as returned by get_output_path2
+    int count;
+    DB_playItem_t **items;
+    char **outpaths;
+
+    // *pabort will be checked regularly, conversion will be interrupted if it's non-zero
+    int *pabort;
+
+    void *user_data;
+
+    // optional, called from a worker thread before converting each track,
+    // never concurrently with itself.
+    // returns 0 to skip the track (e.g. when the output file exists)
+    int (*prepare) (struct ddb_converter_batch_s *batch, int idx);
+
+    // optional, called from a worker thread when a track is started (started == 1),
+    // and when it's finished (started == 0, result is the return value of convert2, or 1 if skipped),
+    // never concurrently with itself.
+    // count is the number of tracks started before this one when started == 1, which is unique for each track,
+    // and the number of finished tracks when started == 0.
+    void (*progress) (struct ddb_converter_batch_s *batch, int idx, int started, int result, int count);
+} ddb_converter_batch_t;
+
 typedef struct {
     DB_misc_t misc;
 
@@ -265,6 +306,13 @@ typedef struct {
          // *pabort will be checked regularly, conversion will be interrupted if it's non-zero
          int *pabort
     );
+
+    // since 1.6
+    // Converts all tracks of the batch using a pool of worker threads, and returns after all threads finish.
+    // Each worker decodes, processes and encodes its own track, using its own copy of the DSP chain.
+    // Returns the number of tracks which failed to convert, or -1 if aborted.
+    int
+    (*convert_batch) (ddb_converter_batch_t *batch);
 } ddb_converter_t;
 
 #endif
@@ -169,6 +169,49 @@ overwrite_prompt (const char *outpath) {
     return ctl.result;
 }
 
+static int
+converter_batch_prepare (ddb_converter_batch_t *batch, int idx) {
+    converter_ctx_t *conv = batch->user_data;
+    const char *outpath = batch->outpaths[idx];
+
+    int skip = 0;
+    char *real_out = realpath(outpath, NULL);
+    if (real_out) {
+        skip = 1;
+        deadbeef->pl_lock();
+        char *real_in = realpath(deadbeef->pl_find_meta(batch->items[idx], ":URI"), NULL);
+        deadbeef->pl_unlock();
+        const int paths_match = real_in && !strcmp(real_in, real_out);
+        free(real_in);
+        free(real_out);
+        if (paths_match) {
+            fprintf (stderr, "converter: destination file is the same as source file, skipping\n");
+        }
+        else if (conv->overwrite_action == 2 || (conv->overwrite_action == 1 && overwrite_prompt(outpath))) {
+            unlink (outpath);
+            skip = 0;
+        }
+    }
+    return !skip;
+}
+
+static void
+converter_batch_progress (ddb_converter_batch_t *batch, int idx, int started, int result, int count) {
+    if (!started) {
+        return;
+    }
+    converter_ctx_t *conv = batch->user_data;
+    update_progress_info_t *info = malloc (sizeof (update_progress_info_t));
+    info->entry = conv->progress_entry;
+    g_object_ref (info->entry);
+    char text[2000];
+    deadbeef->pl_lock ();
+    snprintf (text, sizeof (text), "%d/%d: %s", count + 1, batch->count, deadbeef->pl_find_meta (batch->items[idx], ":URI"));
+    deadbeef->pl_unlock ();
+    info->text = strdup (text);
+    g_idle_add (update_progress_cb, info);
+}
+
 static void
 converter_worker (void *ctx) {
     deadbeef->background_job_increment ();
@@ -219,48 +262,33 @@ converter_worker (void *ctx) {
         .rewrite_tags_after_copy = conv->retag_after_copy,
     };
 
+    char **outpaths = calloc (conv->convert_items_count, sizeof (char *));
     for (int n = 0; n < conv->convert_items_count; n++) {
-        update_progress_info_t *info = malloc (sizeof (update_progress_info_t));
-        info->entry = conv->progress_entry;
-        g_object_ref (info->entry);
-        deadbeef->pl_lock ();
-        info->text = strdup (deadbeef->pl_find_meta (conv->convert_items[n], ":URI"));
-        deadbeef->pl_unlock ();
-        g_idle_add (update_progress_cb, info);
-
         char outpath[2000];
         converter_plugin->get_output_path2 (conv->convert_items[n], conv->convert_playlist, conv->outfolder, conv->outfile, conv->encoder_preset, conv->preserve_folder_structure, root, conv->write_to_source_folder, outpath, sizeof (outpath));
+        outpaths[n] = strdup (outpath);
+    }
+
+    ddb_converter_batch_t batch = {
+        ._size = sizeof (ddb_converter_batch_t),
+        .settings = &settings,
+        .numthreads = deadbeef->conf_get_int ("converter.threads", 0),
+        .preserve_folder_order = deadbeef->conf_get_int ("converter.preserve_folder_order", 0),
+        .count = conv->convert_items_count,
+        .items = conv->convert_items,
+        .outpaths = outpaths,
+        .pabort = &conv->cancelled,
+        .user_data = conv,
+        .prepare = converter_batch_prepare,
+        .progress = converter_batch_progress,
+    };
+    converter_plugin->convert_batch (&batch);
 
-        int skip = 0;
-        char *real_out = realpath(outpath, NULL);
-        if (real_out) {
-            skip = 1;
-            deadbeef->pl_lock();
-            char *real_in = realpath(deadbeef->pl_find_meta(conv->convert_items[n], ":URI"), NULL);
-            deadbeef->pl_unlock();
-            const int paths_match = real_in && !strcmp(real_in, real_out);
-            free(real_in);
-            free(real_out);
-            if (paths_match) {
-                fprintf (stderr, "converter: destination file is the same as source file, skipping\n");
-            }
-            else if (conv->overwrite_action == 2 || (conv->overwrite_action == 1 && overwrite_prompt(outpath))) {
-                unlink (outpath);
-                skip = 0;
-            }
-        }
-
-        if (!skip) {
-            converter_plugin->convert2 (&settings, conv->convert_items[n], outpath, &conv->cancelled);
-        }
-        if (conv->cancelled) {
-            for (; n < conv->convert_items_count; n++) {
-                deadbeef->pl_item_unref (conv->convert_items[n]);
-            }
-            break;
-        }
+    for (int n = 0; n < conv->convert_items_count; n++) {
+        free (outpaths[n]);
         deadbeef->pl_item_unref (conv->convert_items[n]);
     }
+    free (outpaths);
     g_idle_add (destroy_progress_cb, conv->progress);
     if (conv->convert_items) {
         free (conv->convert_items);
@@ -601,6 +629,7 @@ converter_show_cb (void *data) {
     gtk_widget_set_sensitive (lookup_widget (conv->converter, "output_folder"), !write_to_source_folder);
     gtk_widget_set_sensitive (lookup_widget (conv->converter, "preserve_folders"), !write_to_source_folder);
     gtk_combo_box_set_active (GTK_COMBO_BOX (lookup_widget (conv->converter, "overwrite_action")), deadbeef->conf_get_int ("converter.overwrite_action", 0));
+    gtk_spin_button_set_value (GTK_SPIN_BUTTON (lookup_widget (conv->converter, "numthreads")), deadbeef->conf_get_int ("converter.threads", 0));
     deadbeef->conf_unlock ();
 
     GtkComboBox *combo;
@@ -1827,7 +1856,7 @@ convgui_connect (void) {
         fprintf (stderr, "convgui: converter plugin not found\n");
         return -1;
     }
-#define REQ_CONV_VERSION 4
+#define REQ_CONV_VERSION 6
     if (!PLUG_TEST_COMPAT(&converter_plugin->misc.plugin, 1, REQ_CONV_VERSION)) {
         fprintf (stderr, "convgui: need converter>=1.%d, but found %d.%d\n", REQ_CONV_VERSION, converter_plugin->misc.plugin.version_major, converter_plugin->misc.plugin.version_minor);
         return -1;
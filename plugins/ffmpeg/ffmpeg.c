@@ -25,6 +25,7 @@
 
 #include <deadbeef/deadbeef.h>
 #include <deadbeef/strdupa.h>
+#include "../../shared/pcmpack.h"
 
 #include <libavformat/avformat.h>
 #include <libavcodec/avcodec.h>
@@ -65,9 +66,11 @@ typedef struct {
     AVCodecContext *codec_context;
     int need_to_free_codec_context;
     AVFormatContext *format_context;
+    AVIOContext *avio;
     AVPacket pkt;
     AVFrame *frame;
     int stream_id;
+    int probe_result_used; // the stream was opened using the probe result stored in the track
 
     int left_in_packet;
     int have_packet;
@@ -140,6 +143,251 @@ _get_audio_codec_from_stream(AVFormatContext *format_context, int stream_index,
     return 1;
 }
 
+#define AVIO_BUFFER_SIZE (256*1024)
+
+// AVIOContext callbacks, which let libavformat read through deadbeef vfs,
+// instead of opening the file by itself.
+static int
+_avio_read_packet (void *opaque, uint8_t *buf, int buf_size) {
+    DB_FILE *fp = opaque;
+    size_t rb = deadbeef->fread (buf, 1, buf_size, fp);
+    if (rb == 0) {
+        return AVERROR_EOF;
+    }
+    return (int)rb;
+}
+
+static int64_t
+_avio_seek (void *opaque, int64_t offset, int whence) {
+    DB_FILE *fp = opaque;
+    if (whence & AVSEEK_SIZE) {
+        return deadbeef->fgetlength (fp);
+    }
+    whence &= ~AVSEEK_FORCE;
+    if (deadbeef->fseek (fp, offset, whence)) {
+        return AVERROR(EIO);
+    }
+    return deadbeef->ftell (fp);
+}
+
+static int
+_avio_open (ffmpeg_info_t *info, const char *uri) {
+    info->info.file = deadbeef->fopen (uri);
+    if (!info->info.file) {
+        return AVERROR(ENOENT);
+    }
+
+    // av_malloc returns memory aligned for SIMD use by the demuxers
+    unsigned char *buffer = av_malloc (AVIO_BUFFER_SIZE);
+    if (!buffer) {
+        return AVERROR(ENOMEM);
+    }
+    int seekable = !info->info.file->vfs->is_streaming ();
+    info->avio = avio_alloc_context (buffer, AVIO_BUFFER_SIZE, 0, info->info.file, _avio_read_packet, NULL, seekable ? _avio_seek : NULL);
+    if (!info->avio) {
+        av_free (buffer);
+        return AVERROR(ENOMEM);
+    }
+    return 0;
+}
+
+// Opens the format context on top of the vfs file.
+// iformat can be passed to skip format probing.
+static int
+_open_format_context (ffmpeg_info_t *info, const char *uri, const AVInputFormat *iformat) {
+    info->format_context = avformat_alloc_context ();
+    info->format_context->pb = info->avio;
+    info->format_context->flags |= AVFMT_FLAG_CUSTOM_IO;
+    info->format_context->max_analyze_duration = AV_TIME_BASE;
+
+    // on failure, the format context is freed and set to NULL, the avio is left to us
+    return avformat_open_input (&info->format_context, uri, (AVInputFormat *)iformat, NULL);
+}
+
+// Frees the codec and format contexts, and closes the file
+static void
+_close_input (ffmpeg_info_t *info) {
+    if (info->codec_context) {
+        avcodec_close (info->codec_context);
+
+        // The ctx is owned by AVFormatContext in legacy mode
+        if (info->need_to_free_codec_context) {
+            avcodec_free_context (&info->codec_context);
+        }
+        info->codec_context = NULL;
+        info->need_to_free_codec_context = 0;
+    }
+    info->codec = NULL;
+    if (info->format_context) {
+        avformat_close_input (&info->format_context);
+    }
+    if (info->avio) {
+        av_freep (&info->avio->buffer);
+#if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT(57, 80, 100)
+        avio_context_free (&info->avio);
+#else
+        av_freep (&info->avio);
+#endif
+    }
+    if (info->info.file) {
+        deadbeef->fclose (info->info.file);
+        info->info.file = NULL;
+    }
+}
+
+#if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT(57, 33, 0)
+#define USE_PROBE_RESULT 1
+#endif
+
+#ifdef USE_PROBE_RESULT
+// The results of probing are stored in the track as hidden metadata, in the form
+// "<input format> <stream index> <file size> <duration>", so that they are saved with the playlist,
+// and ffmpeg_init can skip the format probing and the stream analysis.
+#define PROBE_RESULT_META ":FFMPEG_PROBE"
+
+static void
+_probe_result_store (DB_playItem_t *it, ffmpeg_info_t *info) {
+    if (info->info.file->vfs->is_streaming ()) {
+        return;
+    }
+    int64_t size = deadbeef->fgetlength (info->info.file);
+    if (size < 0) {
+        return;
+    }
+
+    // the input format is found by its first name, e.g. "mov" for "mov,mp4,m4a,3gp,3g2,mj2"
+    const char *names = info->format_context->iformat->name;
+    char name[64];
+    size_t len = strcspn (names, ",");
+    if (len >= sizeof (name)) {
+        return;
+    }
+    memcpy (name, names, len);
+    name[len] = 0;
+
+    char s[200];
+    snprintf (s, sizeof (s), "%s %d %lld %lld", name, info->stream_id, (long long)size, (long long)info->format_context->duration);
+    deadbeef->pl_replace_meta (it, PROBE_RESULT_META, s);
+}
+
+// Opens the file with the input format from the probe result, without analyzing the streams.
+// Returns 0 on success, and -1 if the file doesn't match the probe result anymore,
+// or if the container header doesn't describe the stream well enough.
+static int
+_open_from_probe_result (ffmpeg_info_t *info, const char *uri, const char *probe_result) {
+    char name[64];
+    int stream_id;
+    long long size;
+    long long duration;
+    if (sscanf (probe_result, "%63s %d %lld %lld", name, &stream_id, &size, &duration) != 4) {
+        return -1;
+    }
+    if (info->info.file->vfs->is_streaming () || deadbeef->fgetlength (info->info.file) != size) {
+        return -1;
+    }
+    const AVInputFormat *iformat = av_find_input_format (name);
+    if (!iformat) {
+        return -1;
+    }
+
+    if (_open_format_context (info, uri, iformat) < 0) {
+        return -1;
+    }
+    if (stream_id < 0 || stream_id >= info->format_context->nb_streams) {
+        return -1;
+    }
+    AVCodecParameters *codecpar = info->format_context->streams[stream_id]->codecpar;
+    if (codecpar->codec_id == AV_CODEC_ID_NONE || codecpar->sample_rate <= 0 || codecpar->channels <= 0) {
+        return -1;
+    }
+    if (!_get_audio_codec_from_stream (info->format_context, stream_id, info)) {
+        return -1;
+    }
+    if (info->format_context->duration == AV_NOPTS_VALUE) {
+        info->format_context->duration = duration;
+    }
+    return 0;
+}
+#endif
+
+// Opens the file and finds the audio stream to decode.
+// With probe_result set, it's used to open the file when it still matches,
+// otherwise the file is probed and analyzed.
+// Everything allocated here is released by _free_info_data, including on failure.
+static int
+_open_and_find_stream (ffmpeg_info_t *info, const char *uri, const char *probe_result) {
+    info->stream_id = -1;
+    info->probe_result_used = 0;
+
+    int ret = _avio_open (info, uri);
+    if (ret < 0) {
+        return ret;
+    }
+
+#ifdef USE_PROBE_RESULT
+    if (probe_result) {
+        if (!_open_from_probe_result (info, uri, probe_result)) {
+            trace ("ffmpeg: using stored probe results for %s\n", uri);
+            info->probe_result_used = 1;
+            return 0;
+        }
+        // the file has changed, or needs analysis: start over
+        _close_input (info);
+        ret = _avio_open (info, uri);
+        if (ret < 0) {
+            return ret;
+        }
+    }
+#endif
+
+    ret = _open_format_context (info, uri, NULL);
+    if (ret < 0) {
+        return ret;
+    }
+
+    ret = avformat_find_stream_info (info->format_context, NULL);
+    if (ret < 0) {
+        trace ("avformat_find_stream_info ret: %d/%s\n", ret, strerror(-ret));
+    }
+
+    for (int i = 0; i < info->format_context->nb_streams; i++) {
+        if (!info->format_context->streams[i]) {
+            continue;
+        }
+        if (_get_audio_codec_from_stream (info->format_context, i, info)) {
+            break;
+        }
+    }
+
+    if (info->codec == NULL) {
+        return AVERROR_DECODER_NOT_FOUND;
+    }
+
+    return 0;
+}
+
+// Opens the file and the decoder, and checks that the output format is known.
+// When the stream was opened using the probe result, and the decoder needs more information than the header has,
+// the file is probed again.
+static int
+_open_decoder (ffmpeg_info_t *info, const char *uri, const char *probe_result) {
+    int ret = _open_and_find_stream (info, uri, probe_result);
+    if (ret >= 0) {
+        ret = avcodec_open2 (info->codec_context, info->codec, NULL);
+    }
+    if (ret >= 0
+        && (av_get_bytes_per_sample (info->codec_context->sample_fmt) <= 0
+            || info->codec_context->channels <= 0
+            || info->codec_context->sample_rate <= 0)) {
+        ret = AVERROR_INVALIDDATA;
+    }
+    if (ret < 0 && info->probe_result_used) {
+        _close_input (info);
+        return _open_decoder (info, uri, NULL);
+    }
+    return ret;
+}
+
 static int
 ffmpeg_init (DB_fileinfo_t *_info, DB_playItem_t *it) {
     // Don't allow playing network streams.
@@ -156,60 +404,41 @@ ffmpeg_init (DB_fileinfo_t *_info, DB_playItem_t *it) {
 
     int ret;
     char *uri = NULL;
-    int i;
+    char *probe_result = NULL;
 
     deadbeef->pl_lock ();
     {
         const char *fname = deadbeef->pl_find_meta (it, ":URI");
         uri = strdupa (fname);
+#ifdef USE_PROBE_RESULT
+        const char *probe = deadbeef->pl_find_meta (it, PROBE_RESULT_META);
+        if (probe) {
+            probe_result = strdupa (probe);
+        }
+#endif
     }
     deadbeef->pl_unlock ();
     trace ("ffmpeg: uri: %s\n", uri);
 
-    // open file
-    trace ("\033[0;31mffmpeg av_open_input_file\033[37;0m\n");
-
-    info->format_context = avformat_alloc_context ();
-
-    if ((ret = avformat_open_input(&info->format_context, uri, NULL, NULL)) < 0) {
-        trace ("\033[0;31minfo->fctx is %p, ret %d/%s\033[0;31m\n", info->fctx, ret, strerror(-ret));
-        return -1;
-    }
-    trace ("\033[0;31mav_open_input_file done, ret=%d\033[0;31m\n", ret);
-
-    trace ("\033[0;31mffmpeg avformat_find_stream_info\033[37;0m\n");
-    info->stream_id = -1;
-    info->format_context->max_analyze_duration = AV_TIME_BASE;
-    avformat_find_stream_info(info->format_context, NULL);
-    AVFormatContext *fctx = info->format_context;
-    for (i = 0; i < info->format_context->nb_streams; i++) {
-        if (_get_audio_codec_from_stream (fctx, i, info)) {
-            break;
-        }
-    }
-
-    if (info->codec == NULL)
-    {
-        trace ("ffmpeg can't decode %s\n", deadbeef->pl_find_meta (it, ":URI"));
+    // open file and decoder
+    if ((ret = _open_decoder (info, uri, probe_result)) < 0) {
+        trace ("ffmpeg can't decode %s: %d/%s\n", uri, ret, strerror(-ret));
         return -1;
     }
-    trace ("ffmpeg can decode %s\n", deadbeef->pl_find_meta (it, ":URI"));
-    trace ("ffmpeg: codec=%s, stream=%d\n", info->codec->name, i);
+    trace ("ffmpeg can decode %s\n", uri);
+    trace ("ffmpeg: codec=%s, stream=%d\n", info->codec->name, info->stream_id);
 
-    if (avcodec_open2 (info->codec_context, info->codec, NULL) < 0) {
-        trace ("ffmpeg: avcodec_open2 failed\n");
-        return -1;
+#ifdef USE_PROBE_RESULT
+    if (!info->probe_result_used) {
+        _probe_result_store (it, info);
     }
+#endif
 
     deadbeef->pl_replace_meta (it, "!FILETYPE", info->codec->name);
 
     int bps = av_get_bytes_per_sample (info->codec_context->sample_fmt)*8;
     int samplerate = info->codec_context->sample_rate;
 
-    if (bps <= 0 || info->codec_context->channels <= 0 || samplerate <= 0) {
-        return -1;
-    }
-
     int64_t totalsamples = info->format_context->duration * samplerate / AV_TIME_BASE;
     info->left_in_packet = 0;
     info->left_in_buffer = 0;
@@ -263,17 +492,7 @@ _free_info_data(ffmpeg_info_t *info) {
     if (info->have_packet) {
         av_packet_unref (&info->pkt);
     }
-    if (info->codec_context) {
-        avcodec_close (info->codec_context);
-
-        // The ctx is owned by AVFormatContext in legacy mode
-        if (info->need_to_free_codec_context) {
-            avcodec_free_context (&info->codec_context);
-        }
-    }
-    if (info->format_context) {
-        avformat_close_input (&info->format_context);
-    }
+    _close_input (info);
 }
 
 static void
@@ -353,29 +572,8 @@ ffmpeg_read (DB_fileinfo_t *_info, char *bytes, int size) {
                     return -1;
                 }
                 if (av_sample_fmt_is_planar(info->codec_context->sample_fmt)) {
-                    out_size = 0;
-                    for (int c = 0; c < info->codec_context->channels; c++) {
-                        for (int i = 0; i < info->frame->nb_samples; i++) {
-                            if (_info->fmt.bps == 8) {
-                                info->buffer[i*info->codec_context->channels+c] = ((int8_t *)info->frame->extended_data[c])[i];
-                                out_size++;
-                            }
-                            else if (_info->fmt.bps == 16) {
-                                int16_t outsample = ((int16_t *)info->frame->extended_data[c])[i];
-                                ((int16_t*)info->buffer)[i*info->codec_context->channels+c] = outsample;
-                                out_size += 2;
-                            }
-                            else if (_info->fmt.bps == 24) {
-                                memcpy (&info->buffer[(i*info->codec_context->channels+c)*3], &((int8_t*)info->frame->extended_data[c])[i*3], 3);
-                                out_size += 3;
-                            }
-                            else if (_info->fmt.bps == 32) {
-                                int32_t sample = ((int32_t *)info->frame->extended_data[c])[i];
-                                ((int32_t*)info->buffer)[i*info->codec_context->channels+c] = sample;
-                                out_size += 4;
-                            }
-                        }
-                    }
+                    out_size = info->frame->nb_samples * (_info->fmt.bps >> 3) * _info->fmt.channels;
+                    ddb_pcm_interleave (info->buffer, (const void * const *)info->frame->extended_data, info->codec_context->channels, info->frame->nb_samples, _info->fmt.bps >> 3);
                 }
                 else {
                     out_size = info->frame->nb_samples * (_info->fmt.bps >> 3) * _info->fmt.channels;
@@ -621,44 +819,20 @@ ffmpeg_insert (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) {
 
     int ret;
     char *uri = NULL;
-    int i;
 
     // construct uri
     uri = strdupa (fname);
     trace ("ffmpeg: uri: %s\n", uri);
 
     // open file
-    info.format_context = avformat_alloc_context ();
-    info.format_context->max_analyze_duration = AV_TIME_BASE;
-    if ((ret = avformat_open_input(&info.format_context, uri, NULL, NULL)) < 0) {
-        print_error (uri, ret);
-        goto error;
-    }
-
-    trace ("fctx is %p, ret %d/%s\n", info.format_context, ret, strerror(-ret));
-    ret = avformat_find_stream_info(info.format_context, NULL);
-    if (ret < 0) {
-        trace ("avformat_find_stream_info ret: %d/%s\n", ret, strerror(-ret));
-    }
-    trace ("nb_streams=%x\n", nb_streams);
-
-    for (i = 0; i < info.format_context->nb_streams; i++)
-    {
-        if (!info.format_context->streams[i]) {
-            continue;
-        }
-        if (_get_audio_codec_from_stream(info.format_context, i, &info)) {
-            break;
+    if ((ret = _open_and_find_stream (&info, uri, NULL)) < 0) {
+        if (ret != AVERROR_DECODER_NOT_FOUND) {
+            print_error (uri, ret);
         }
-    }
-
-    if (info.codec == NULL)
-    {
-        trace ("ffmpeg can't decode %s\n", fname);
         goto error;
     }
     trace ("ffmpeg can decode %s\n", fname);
-    trace ("ffmpeg: codec=%s, stream=%d\n", codec->name, i);
+    trace ("ffmpeg: codec=%s, stream=%d\n", info.codec->name, info.stream_id);
 
     int avcodec_open2_ret = avcodec_open2 (info.codec_context, info.codec, NULL);
     if (avcodec_open2_ret < 0) {
@@ -682,6 +856,9 @@ ffmpeg_insert (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) {
 
     DB_playItem_t *it = deadbeef->pl_item_alloc_init (fname, plugin.decoder.plugin.id);
     deadbeef->pl_replace_meta (it, ":FILETYPE", info.codec->name);
+#ifdef USE_PROBE_RESULT
+    _probe_result_store (it, &info);
+#endif
 
     if (!deadbeef->is_local_file (fname)) {
         deadbeef->plt_set_item_duration (plt, it, -1);
@@ -694,13 +871,8 @@ ffmpeg_insert (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) {
     ffmpeg_read_metadata_internal (it, info.format_context);
     
     int64_t fsize = -1;
-
-    DB_FILE *fp = deadbeef->fopen (fname);
-    if (fp) {
-        if (!fp->vfs->is_streaming ()) {
-            fsize = deadbeef->fgetlength (fp);
-        }
-        deadbeef->fclose (fp);
+    if (!info.info.file->vfs->is_streaming ()) {
+        fsize = deadbeef->fgetlength (info.info.file);
     }
 
     if (fsize >= 0 && duration > 0) {
@@ -877,7 +1049,6 @@ ffmpeg_read_metadata (DB_playItem_t *it) {
     ffmpeg_info_t info = {0};
     int ret;
     char *uri = NULL;
-    int i;
 
     deadbeef->pl_lock ();
     const char *fname = deadbeef->pl_find_meta (it, ":URI");
@@ -886,19 +1057,8 @@ ffmpeg_read_metadata (DB_playItem_t *it) {
     trace ("ffmpeg: uri: %s\n", uri);
 
     // open file
-    if ((ret = avformat_open_input(&info.format_context, uri, NULL, NULL)) < 0) {
-        trace ("fctx is %p, ret %d/%s", info.format_context, ret, strerror(-ret));
-        return -1;
-    }
-
-    avformat_find_stream_info(info.format_context, NULL);
-    for (i = 0; i < info.format_context->nb_streams; i++) {
-        if (_get_audio_codec_from_stream(info.format_context, i, &info)) {
-            break;
-        }
-    }
-    if (info.codec == NULL) {
-        trace ("ffmpeg can't decode %s\n", deadbeef->pl_find_meta (it, ":URI"));
+    if ((ret = _open_and_find_stream (&info, uri, NULL)) < 0) {
+        trace ("ffmpeg can't decode %s: %d/%s\n", uri, ret, strerror(-ret));
         goto error;
     }
     if (avcodec_open2 (info.codec_context, info.codec, NULL) < 0) {
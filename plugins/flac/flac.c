@@ -43,6 +43,7 @@
 #include <limits.h>
 #include <deadbeef/deadbeef.h>
 #include "../liboggedit/oggedit.h"
+#include "../../shared/pcmpack.h"
 #include <deadbeef/strdupa.h>
 
 static ddb_decoder2_t plugin;
@@ -149,67 +150,15 @@ cflac_write_callback (const FLAC__StreamDecoder *decoder, const FLAC__Frame *fra
 
     unsigned bps = FLAC__stream_decoder_get_bits_per_sample(decoder);
 
-    if (bps == 16) {
-        for (int i = 0; i <  nsamples; i++) {
-            for (int c = 0; c < channels; c++) {
-                int32_t sample = inputbuffer[c][i];
-                *bufptr++ = sample&0xff;
-                *bufptr++ = (sample&0xff00)>>8;
-            }
-        }
-    }
-    else if (bps == 24) {
-        for (int i = 0; i <  nsamples; i++) {
-            for (int c = 0; c < channels; c++) {
-                int32_t sample = inputbuffer[c][i];
-                *bufptr++ = sample&0xff;
-                *bufptr++ = (sample&0xff00)>>8;
-                *bufptr++ = (sample&0xff0000)>>16;
-            }
-        }
-    }
-    else if (bps == 32) {
-        for (int i = 0; i <  nsamples; i++) {
-            for (int c = 0; c < channels; c++) {
-                int32_t sample = inputbuffer[c][i];
-                *((int32_t*)bufptr) = sample;
-                bufptr += 4;
-            }
-        }
-    }
-    else if (bps == 8) {
-        for (int i = 0; i <  nsamples; i++) {
-            for (int c = 0; c < channels; c++) {
-                int32_t sample = inputbuffer[c][i];
-                *bufptr++ = sample&0xff;
-            }
-        }
-    }
-    else if (bps & 7) {
-        // support for non-byte-aligned bps
-        unsigned shift = _info->fmt.bps - bps;
-        bps = _info->fmt.bps;
-        int nsamples = min(bufsize / samplesize, frame->header.blocksize);
-        for (int s = 0; s < nsamples; s++) {
-            for (int c = 0; c < channels; c++) {
-                FLAC__int32 sample = inputbuffer[c][s] << shift;
-                *bufptr++ = sample & 0xff;
-                if (bps > 8) {
-                    *bufptr++ = (sample>>8) & 0xff;
-                    if (bps > 16) {
-                        *bufptr++ = (sample>>16) & 0xff;
-                        if (bps > 24) {
-                            *bufptr++ = (sample>>24) & 0xff;
-                        }
-                    }
-                 }
-             }
-         }
-    }
-    else {
+    // non-byte-aligned bps is padded to the next byte;
+    // the buffer was sized for the format bps, so it must not be exceeded
+    unsigned outbps = (bps + 7) & ~7;
+    if (outbps < 8 || outbps > 32 || outbps > (unsigned)_info->fmt.bps) {
         trace ("flac: unsupported bits per sample: %d\n", bps);
         return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
     }
+    ddb_pcm_pack_planar_int32 (bufptr, (const int32_t * const *)inputbuffer, channels, nsamples, outbps, outbps - bps);
+    bufptr += nsamples * channels * (outbps / 8);
 
     info->remaining = (int)(bufptr - info->buffer);
 
@@ -693,10 +642,42 @@ cflac_add_metadata (DB_playItem_t *it, const char *s, int length) {
     }
 }
 
+static void
+cflac_set_streaminfo (flac_info_t *info, int samplerate, int channels, int bps, uint64_t totalsamples) {
+    DB_fileinfo_t *_info = &info->info;
+    trace ("flac: samplerate=%d, channels=%d, totalsamples=%d\n", samplerate, channels, (int)totalsamples);
+    _info->fmt.samplerate = samplerate;
+    _info->fmt.channels = channels;
+    _info->fmt.bps = fix_bps (bps);
+    info->totalsamples = totalsamples;
+    if (!info->plt) {
+        // re-reading metadata of a track which is already in a playlist
+        return;
+    }
+    if (totalsamples > 0) {
+        deadbeef->plt_set_item_duration (info->plt, info->it, totalsamples / (float)samplerate);
+    }
+    else {
+        deadbeef->plt_set_item_duration (info->plt, info->it, -1);
+    }
+}
+
+static void
+cflac_vorbis_comments_done (flac_info_t *info, int num_comments) {
+    DB_playItem_t *it = info->it;
+    deadbeef->pl_add_meta (it, "title", NULL);
+    if (num_comments > 0) {
+        uint32_t f = deadbeef->pl_get_item_flags (it);
+        f &= ~DDB_TAG_MASK;
+        f |= DDB_TAG_VORBISCOMMENTS;
+        deadbeef->pl_set_item_flags (it, f);
+    }
+    info->got_vorbis_comments = 1;
+}
+
 static void
 cflac_init_metadata_callback(const FLAC__StreamDecoder *decoder, const FLAC__StreamMetadata *metadata, void *client_data) {
     flac_info_t *info = (flac_info_t *)client_data;
-    DB_fileinfo_t *_info = &info->info;
     if (info->init_stop_decoding) {
         trace ("error flag is set, ignoring init_metadata callback..\n");
         return;
@@ -704,17 +685,7 @@ cflac_init_metadata_callback(const FLAC__StreamDecoder *decoder, const FLAC__Str
     DB_playItem_t *it = info->it;
     //it->tracknum = 0;
     if (metadata->type == FLAC__METADATA_TYPE_STREAMINFO) {
-        trace ("flac: samplerate=%d, channels=%d, totalsamples=%d\n", metadata->data.stream_info.sample_rate, metadata->data.stream_info.channels, metadata->data.stream_info.total_samples);
-        _info->fmt.samplerate = metadata->data.stream_info.sample_rate;
-        _info->fmt.channels = metadata->data.stream_info.channels;
-        _info->fmt.bps = fix_bps (metadata->data.stream_info.bits_per_sample);
-        info->totalsamples = metadata->data.stream_info.total_samples;
-        if (metadata->data.stream_info.total_samples > 0) {
-            deadbeef->plt_set_item_duration (info->plt, it, metadata->data.stream_info.total_samples / (float)metadata->data.stream_info.sample_rate);
-        }
-        else {
-            deadbeef->plt_set_item_duration (info->plt, it, -1);
-        }
+        cflac_set_streaminfo (info, metadata->data.stream_info.sample_rate, metadata->data.stream_info.channels, metadata->data.stream_info.bits_per_sample, metadata->data.stream_info.total_samples);
     }
     else if (metadata->type == FLAC__METADATA_TYPE_VORBIS_COMMENT) {
         const FLAC__StreamMetadata_VorbisComment *vc = &metadata->data.vorbis_comment;
@@ -725,14 +696,7 @@ cflac_init_metadata_callback(const FLAC__StreamDecoder *decoder, const FLAC__Str
                 cflac_add_metadata (it, s, c->length);
             }
         }
-        deadbeef->pl_add_meta (it, "title", NULL);
-        if (vc->num_comments > 0) {
-            uint32_t f = deadbeef->pl_get_item_flags (it);
-            f &= ~DDB_TAG_MASK;
-            f |= DDB_TAG_VORBISCOMMENTS;
-            deadbeef->pl_set_item_flags (it, f);
-        }
-        info->got_vorbis_comments = 1;
+        cflac_vorbis_comments_done (info, vc->num_comments);
     }
     else if (metadata->type == FLAC__METADATA_TYPE_CUESHEET) {
         if (!info->flac_cue_sheet) {
@@ -741,6 +705,216 @@ cflac_init_metadata_callback(const FLAC__StreamDecoder *decoder, const FLAC__Str
     }
 }
 
+// Metadata block walker for native FLAC files.
+// Unlike the stream decoder, it seeks past the blocks which are not needed for the playlist
+// (PICTURE, PADDING, SEEKTABLE, APPLICATION), so that big embedded pictures are never read.
+// The position of the first PICTURE block is stored in the track, for the artwork plugin.
+
+#define FLAC_METADATA_MAX_LOADED_BLOCK (16*1024*1024)
+
+static inline uint32_t
+_read_be32 (const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static inline uint64_t
+_read_be64 (const uint8_t *p) {
+    return ((uint64_t)_read_be32 (p) << 32) | _read_be32 (p + 4);
+}
+
+static inline uint32_t
+_read_le32 (const uint8_t *p) {
+    return ((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16) | ((uint32_t)p[1] << 8) | p[0];
+}
+
+static int
+cflac_parse_vorbis_comment (flac_info_t *info, uint8_t *data, uint32_t size) {
+    uint8_t *end = data + size;
+    if (size < 8) {
+        return -1;
+    }
+    uint32_t vendor_length = _read_le32 (data);
+    if (vendor_length > size - 8) {
+        return -1;
+    }
+    data += 4 + vendor_length;
+    uint32_t num_comments = _read_le32 (data);
+    data += 4;
+    for (uint32_t i = 0; i < num_comments; i++) {
+        if (end - data < 4) {
+            return -1;
+        }
+        uint32_t length = _read_le32 (data);
+        data += 4;
+        if (length > end - data) {
+            return -1;
+        }
+        if (length > 0) {
+            // zero-terminate in place, the byte after the comment is either the next length, or the padding byte after the block
+            uint8_t next = data[length];
+            data[length] = 0;
+            cflac_add_metadata (info->it, (const char *)data, length);
+            data[length] = next;
+        }
+        data += length;
+    }
+    cflac_vorbis_comments_done (info, num_comments);
+    return 0;
+}
+
+static int
+cflac_parse_cuesheet (flac_info_t *info, const uint8_t *data, uint32_t size) {
+    const uint8_t *end = data + size;
+    if (size < 396) {
+        return -1;
+    }
+    FLAC__StreamMetadata *cue = FLAC__metadata_object_new (FLAC__METADATA_TYPE_CUESHEET);
+    if (!cue) {
+        return -1;
+    }
+    FLAC__StreamMetadata_CueSheet *cs = &cue->data.cue_sheet;
+    memcpy (cs->media_catalog_number, data, 128);
+    cs->media_catalog_number[128] = 0;
+    cs->lead_in = _read_be64 (data + 128);
+    cs->is_cd = (data + 136)[0] >> 7;
+    unsigned num_tracks = data[395];
+    data += 396;
+    if (!FLAC__metadata_object_cuesheet_resize_tracks (cue, num_tracks)) {
+        goto error;
+    }
+    for (unsigned i = 0; i < num_tracks; i++) {
+        if (end - data < 36) {
+            goto error;
+        }
+        FLAC__StreamMetadata_CueSheet_Track *track = &cs->tracks[i];
+        track->offset = _read_be64 (data);
+        track->number = data[8];
+        memcpy (track->isrc, data + 9, 12);
+        track->isrc[12] = 0;
+        track->type = data[21] >> 7;
+        track->pre_emphasis = (data[21] >> 6) & 1;
+        unsigned num_indices = data[35];
+        data += 36;
+        if (end - data < num_indices * 12) {
+            goto error;
+        }
+        if (!FLAC__metadata_object_cuesheet_track_resize_indices (cue, i, num_indices)) {
+            goto error;
+        }
+        for (unsigned j = 0; j < num_indices; j++) {
+            track->indices[j].offset = _read_be64 (data);
+            track->indices[j].number = data[8];
+            data += 12;
+        }
+    }
+    if (info->flac_cue_sheet) {
+        FLAC__metadata_object_delete (cue);
+    }
+    else {
+        info->flac_cue_sheet = cue;
+    }
+    return 0;
+error:
+    FLAC__metadata_object_delete (cue);
+    return -1;
+}
+
+// Reads the metadata of a native FLAC file, starting at the fLaC signature.
+// STREAMINFO and CUESHEET are stored in info, VORBIS_COMMENT in info->it.
+// Returns 0 on success, and the position of the first audio frame in audio_offset.
+static int
+cflac_walk_metadata (flac_info_t *info, int64_t *audio_offset) {
+    DB_FILE *fp = info->file;
+    uint8_t hdr[4];
+    int got_streaminfo = 0;
+    int64_t picture_offset = -1;
+    uint32_t picture_size = 0;
+
+    if (deadbeef->fread (hdr, 1, 4, fp) != 4 || memcmp (hdr, "fLaC", 4)) {
+        return -1;
+    }
+
+    int last = 0;
+    while (!last) {
+        if (deadbeef->fread (hdr, 1, 4, fp) != 4) {
+            return -1;
+        }
+        last = hdr[0] & 0x80;
+        int type = hdr[0] & 0x7f;
+        uint32_t length = ((uint32_t)hdr[1] << 16) | ((uint32_t)hdr[2] << 8) | hdr[3];
+        int64_t offset = deadbeef->ftell (fp);
+        if (offset < 0) {
+            return -1;
+        }
+
+        if (type == FLAC__METADATA_TYPE_STREAMINFO || type == FLAC__METADATA_TYPE_VORBIS_COMMENT || type == FLAC__METADATA_TYPE_CUESHEET) {
+            if (length > FLAC_METADATA_MAX_LOADED_BLOCK) {
+                return -1;
+            }
+            uint8_t *data = malloc (length + 1);
+            if (!data) {
+                return -1;
+            }
+            if (deadbeef->fread (data, 1, length, fp) != length) {
+                free (data);
+                return -1;
+            }
+            int res = 0;
+            if (type == FLAC__METADATA_TYPE_STREAMINFO) {
+                if (length < 34) {
+                    res = -1;
+                }
+                else {
+                    // 20 bits samplerate, 3 bits channels-1, 5 bits bps-1, 36 bits total samples
+                    int samplerate = (data[10] << 12) | (data[11] << 4) | (data[12] >> 4);
+                    int channels = ((data[12] >> 1) & 7) + 1;
+                    int bps = (((data[12] & 1) << 4) | (data[13] >> 4)) + 1;
+                    uint64_t totalsamples = ((uint64_t)(data[13] & 0x0f) << 32) | _read_be32 (data + 14);
+                    cflac_set_streaminfo (info, samplerate, channels, bps, totalsamples);
+                    got_streaminfo = 1;
+                }
+            }
+            else if (type == FLAC__METADATA_TYPE_VORBIS_COMMENT) {
+                if (!info->got_vorbis_comments) {
+                    res = cflac_parse_vorbis_comment (info, data, length);
+                }
+            }
+            else {
+                res = cflac_parse_cuesheet (info, data, length);
+            }
+            free (data);
+            if (res < 0) {
+                return -1;
+            }
+        }
+        else {
+            if (type == FLAC__METADATA_TYPE_PICTURE && picture_offset < 0) {
+                picture_offset = offset;
+                picture_size = length;
+            }
+            if (deadbeef->fseek (fp, offset + length, SEEK_SET)) {
+                return -1;
+            }
+        }
+    }
+
+    if (!got_streaminfo) {
+        return -1;
+    }
+
+    if (picture_offset >= 0 && picture_offset <= INT_MAX) {
+        deadbeef->pl_set_meta_int (info->it, ":FLAC_PICTURE_OFFSET", (int)picture_offset);
+        deadbeef->pl_set_meta_int (info->it, ":FLAC_PICTURE_SIZE", (int)picture_size);
+    }
+    else {
+        deadbeef->pl_delete_meta (info->it, ":FLAC_PICTURE_OFFSET");
+        deadbeef->pl_delete_meta (info->it, ":FLAC_PICTURE_SIZE");
+    }
+
+    *audio_offset = deadbeef->ftell (fp);
+    return 0;
+}
+
 static DB_playItem_t *
 cflac_insert_with_embedded_cue (ddb_playlist_t *plt, DB_playItem_t *after, DB_playItem_t *origin, const FLAC__StreamMetadata_CueSheet *cuesheet, uint64_t totalsamples, int samplerate) {
     deadbeef->pl_lock ();
@@ -886,33 +1060,54 @@ cflac_insert (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) {
     }
     info.init_stop_decoding = 0;
 
-    // open decoder for metadata reading
-    FLAC__StreamDecoderInitStatus status;
-    decoder = FLAC__stream_decoder_new();
-    if (!decoder) {
-        trace ("flac: failed to create decoder\n");
-        goto cflac_insert_fail;
+    it = info.it = deadbeef->pl_item_alloc_init (fname, plugin.decoder.plugin.id);
+
+    int64_t audio_offset = -1;
+    if (!isogg && !info.file->vfs->is_streaming ()) {
+        // walk the metadata blocks directly, skipping the pictures
+        if (cflac_walk_metadata (&info, &audio_offset) < 0) {
+            trace ("flac: failed to walk metadata of %s, retrying with the decoder\n", fname);
+            audio_offset = -1;
+            deadbeef->pl_item_unref (it);
+            it = info.it = deadbeef->pl_item_alloc_init (fname, plugin.decoder.plugin.id);
+            memset (&info.info.fmt, 0, sizeof (info.info.fmt));
+            info.totalsamples = 0;
+            info.got_vorbis_comments = 0;
+            if (info.flac_cue_sheet) {
+                FLAC__metadata_object_delete (info.flac_cue_sheet);
+                info.flac_cue_sheet = NULL;
+            }
+            deadbeef->fseek (info.file, skip, SEEK_SET);
+        }
     }
 
-    // read all metadata
-    FLAC__stream_decoder_set_md5_checking(decoder, 0);
-    FLAC__stream_decoder_set_metadata_respond_all (decoder);
+    if (audio_offset < 0) {
+        // open decoder for metadata reading
+        FLAC__StreamDecoderInitStatus status;
+        decoder = FLAC__stream_decoder_new();
+        if (!decoder) {
+            trace ("flac: failed to create decoder\n");
+            goto cflac_insert_fail;
+        }
 
-    it = info.it = deadbeef->pl_item_alloc_init (fname, plugin.decoder.plugin.id);;
+        // read all metadata
+        FLAC__stream_decoder_set_md5_checking(decoder, 0);
+        FLAC__stream_decoder_set_metadata_respond_all (decoder);
 
-    if (isogg) {
-        status = FLAC__stream_decoder_init_ogg_stream (decoder, flac_read_cb, flac_seek_cb, flac_tell_cb, flac_length_cb, flac_eof_cb, cflac_init_write_callback, cflac_init_metadata_callback, cflac_init_error_callback, &info);
-    }
-    else {
-        status = FLAC__stream_decoder_init_stream (decoder, flac_read_cb, flac_seek_cb, flac_tell_cb, flac_length_cb, flac_eof_cb, cflac_init_write_callback, cflac_init_metadata_callback, cflac_init_error_callback, &info);
-    }
-    if (status != FLAC__STREAM_DECODER_INIT_STATUS_OK || info.init_stop_decoding) {
-        trace ("flac: FLAC__stream_decoder_init_stream [2] failed\n");
-        goto cflac_insert_fail;
-    }
-    if (!FLAC__stream_decoder_process_until_end_of_metadata (decoder) || info.init_stop_decoding) {
-        trace ("flac: FLAC__stream_decoder_process_until_end_of_metadata [2] failed\n");
-        goto cflac_insert_fail;
+        if (isogg) {
+            status = FLAC__stream_decoder_init_ogg_stream (decoder, flac_read_cb, flac_seek_cb, flac_tell_cb, flac_length_cb, flac_eof_cb, cflac_init_write_callback, cflac_init_metadata_callback, cflac_init_error_callback, &info);
+        }
+        else {
+            status = FLAC__stream_decoder_init_stream (decoder, flac_read_cb, flac_seek_cb, flac_tell_cb, flac_length_cb, flac_eof_cb, cflac_init_write_callback, cflac_init_metadata_callback, cflac_init_error_callback, &info);
+        }
+        if (status != FLAC__STREAM_DECODER_INIT_STATUS_OK || info.init_stop_decoding) {
+            trace ("flac: FLAC__stream_decoder_init_stream [2] failed\n");
+            goto cflac_insert_fail;
+        }
+        if (!FLAC__stream_decoder_process_until_end_of_metadata (decoder) || info.init_stop_decoding) {
+            trace ("flac: FLAC__stream_decoder_process_until_end_of_metadata [2] failed\n");
+            goto cflac_insert_fail;
+        }
     }
 
     if (info.info.fmt.samplerate <= 0) {
@@ -933,7 +1128,10 @@ cflac_insert (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) {
     snprintf (s, sizeof (s), "%d", info.info.fmt.samplerate);
     deadbeef->pl_add_meta (it, ":SAMPLERATE", s);
     if ( deadbeef->pl_get_item_duration (it) > 0) {
-        if (!isogg) {
+        if (audio_offset >= 0) {
+            fsize -= audio_offset;
+        }
+        else if (!isogg) {
             FLAC__uint64 position;
             if (FLAC__stream_decoder_get_decode_position (decoder, &position))
                 fsize -= position;
@@ -947,8 +1145,10 @@ cflac_insert (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) {
 #endif
         deadbeef->pl_set_meta_int (it, ":BITRATE", (int)roundf(fsize / deadbeef->pl_get_item_duration (it) * 8 / 1000));
     }
-    FLAC__stream_decoder_delete(decoder);
-    decoder = NULL;
+    if (decoder) {
+        FLAC__stream_decoder_delete(decoder);
+        decoder = NULL;
+    }
 
     deadbeef->fclose (info.file);
     info.file = NULL;
@@ -1020,17 +1220,44 @@ static FLAC__IOCallbacks iocb = {
     .close = flac_io_close,
 };
 
+// Reads the tags using the metadata block walker, which skips the pictures.
+// Returns -1 if the file is not a native FLAC, or the metadata is not valid.
+static int
+cflac_read_metadata_native (DB_playItem_t *it, DB_FILE *file) {
+    int skip = deadbeef->junk_get_leading_size (file);
+    if (deadbeef->fseek (file, skip > 0 ? skip : 0, SEEK_SET)) {
+        return -1;
+    }
+
+    flac_info_t info;
+    memset (&info, 0, sizeof (info));
+    info.file = file;
+    info.it = it;
+    int64_t audio_offset;
+
+    deadbeef->pl_delete_all_meta (it);
+    int res = cflac_walk_metadata (&info, &audio_offset);
+    if (info.flac_cue_sheet) {
+        FLAC__metadata_object_delete (info.flac_cue_sheet);
+    }
+    if (res < 0) {
+        return -1;
+    }
+
+    deadbeef->pl_add_meta (it, "title", NULL);
+    uint32_t f = deadbeef->pl_get_item_flags (it);
+    f &= ~DDB_TAG_MASK;
+    f |= DDB_TAG_VORBISCOMMENTS;
+    deadbeef->pl_set_item_flags (it, f);
+    return 0;
+}
+
 static int
 cflac_read_metadata (DB_playItem_t *it) {
     int err = -1;
     FLAC__Metadata_Chain *chain = NULL;
     FLAC__Metadata_Iterator *iter = NULL;
 
-    chain = FLAC__metadata_chain_new ();
-    if (!chain) {
-        trace ("cflac_read_metadata: FLAC__metadata_chain_new failed\n");
-        return -1;
-    }
     deadbeef->pl_lock ();
     const char *uri = strdupa (deadbeef->pl_find_meta (it, ":URI"));
     deadbeef->pl_unlock ();
@@ -1038,6 +1265,21 @@ cflac_read_metadata (DB_playItem_t *it) {
     if (!file) {
         return -1;
     }
+
+    if (!file->vfs->is_streaming ()) {
+        if (!cflac_read_metadata_native (it, file)) {
+            deadbeef->fclose (file);
+            return 0;
+        }
+        deadbeef->fseek (file, 0, SEEK_SET);
+    }
+
+    chain = FLAC__metadata_chain_new ();
+    if (!chain) {
+        trace ("cflac_read_metadata: FLAC__metadata_chain_new failed\n");
+        deadbeef->fclose (file);
+        return -1;
+    }
     FLAC__bool res = FLAC__metadata_chain_read_with_callbacks (chain, (FLAC__IOHandle)file, iocb);
     if (!res && FLAC__metadata_chain_status(chain) == FLAC__METADATA_SIMPLE_ITERATOR_STATUS_NOT_A_FLAC_FILE) {
         res = FLAC__metadata_chain_read_ogg_with_callbacks (chain, (FLAC__IOHandle)file, iocb);
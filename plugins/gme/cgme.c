@@ -40,6 +40,7 @@
 #include <unistd.h>
 #include <sys/stat.h>
 #include "gmewrap.h"
+#include "gmeprobe.h"
 
 #define trace(...) { deadbeef->log_detailed (&plugin.plugin, 0, __VA_ARGS__); }
 
@@ -63,6 +64,7 @@ typedef struct {
     int can_loop;
     int rawsignal;
     int fade_set;
+    int probed_length; // the song ends by itself, no fadeout needed
 } gme_fileinfo_t;
 
 static DB_fileinfo_t *
@@ -237,6 +239,7 @@ cgme_init (DB_fileinfo_t *_info, DB_playItem_t *it) {
     _info->fmt.channelmask = _info->fmt.channels == 1 ? DDB_SPEAKER_FRONT_LEFT : (DDB_SPEAKER_FRONT_LEFT | DDB_SPEAKER_FRONT_RIGHT);
     info->duration = deadbeef->pl_get_item_duration (it);
     info->reallength = inf->length; 
+    info->probed_length = deadbeef->pl_find_meta_int (it, ":GME_PROBED_LENGTH", 0) > 0;
     _info->readpos = 0;
     info->eof = 0;
     return 0;
@@ -279,7 +282,7 @@ cgme_read (DB_fileinfo_t *_info, char *bytes, int size) {
         gme_set_fade(info->emu, -1, 0);
         info->fade_set = 0;
     }
-    else if (!playForever && !info->fade_set && conf_fadeout > 0 && info->duration >= conf_fadeout && _info->readpos >= info->duration - conf_fadeout) {
+    else if (!playForever && !info->fade_set && !info->probed_length && conf_fadeout > 0 && info->duration >= conf_fadeout && _info->readpos >= info->duration - conf_fadeout) {
         gme_set_fade(info->emu, (int)(_info->readpos * 1000), conf_fadeout * 1000);
         info->fade_set = 1;
     }
@@ -343,11 +346,14 @@ cgme_insert (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) {
 
     char *buffer = NULL;
     int sz;
+    int datasize = 0;
     if (!read_gzfile (fname, &buffer, &sz)) {
         res = gme_open_data (buffer, sz, &emu, gme_info_only);
+        datasize = sz;
     }
-    free (buffer);
     if (res) {
+        free (buffer);
+        buffer = NULL;
         DB_FILE *f = deadbeef->fopen (fname);
         if (!f) {
             return NULL;
@@ -370,9 +376,12 @@ cgme_insert (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) {
         }
 
         res = gme_open_data (buf, sz, &emu, gme_info_only);
-        free (buf);
+        buffer = buf;
+        datasize = (int)sz;
     }
 
+    int probe = deadbeef->conf_get_int ("gme.probe_durations", 0);
+    gme_probe_file_t *probe_file = NULL;
 
     if (!res) {
         int cnt = gme_track_count (emu);
@@ -423,10 +432,21 @@ cgme_insert (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) {
                 deadbeef->pl_add_meta (it, ":GME_INTRO_LENGTH", str);
                 snprintf (str, sizeof(str), "%d", inf->loop_length);
                 deadbeef->pl_add_meta (it, ":GME_LOOP_LENGTH", str);
+                int probe_track = 0;
                 if (inf->length == -1 || inf->length == 0) {
                     float songlength;
-                    
-                    if (inf->loop_length > 0 && conf_loopcount > 0) {
+                    int probed_length = GME_PROBE_UNKNOWN;
+                    if (probe && !(inf->loop_length > 0 && conf_loopcount > 0)) {
+                        probed_length = gme_probe_cached_length (fname, i);
+                        probe_track = probed_length == GME_PROBE_UNKNOWN;
+                    }
+
+                    if (probed_length > 0) {
+                        snprintf (str, sizeof(str), "%d", probed_length);
+                        deadbeef->pl_add_meta (it, ":GME_PROBED_LENGTH", str);
+                        songlength = probed_length / 1000.f + 1;
+                    }
+                    else if (inf->loop_length > 0 && conf_loopcount > 0) {
                         songlength = inf->intro_length / 1000.f;
                         if (songlength < 0) {
                             songlength = 0;
@@ -459,6 +479,13 @@ cgme_insert (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) {
                     deadbeef->pl_set_item_flags (it, deadbeef->pl_get_item_flags (it) | DDB_IS_SUBTRACK);
                 }
                 after = deadbeef->plt_insert_item (plt, after, it);
+                if (probe_track && buffer) {
+                    if (!probe_file) {
+                        probe_file = gme_probe_file_alloc (fname, buffer, datasize);
+                        buffer = NULL;
+                    }
+                    gme_probe_enqueue (probe_file, it, i);
+                }
                 deadbeef->pl_item_unref (it);
             }
             else {
@@ -472,6 +499,10 @@ cgme_insert (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) {
     else {
         trace ("gme_open_file/data failed with error %s\n", res);
     }
+    if (probe_file) {
+        gme_probe_file_unref (probe_file);
+    }
+    free (buffer);
     return after;
 }
 
@@ -482,11 +513,13 @@ static const char * exts[]=
 
 static int
 cgme_start (void) {
+    gme_probe_init (deadbeef, &plugin.plugin);
     return 0;
 }
 
 static int
 cgme_stop (void) {
+    gme_probe_free ();
     if (coleco_rom) {
         free (coleco_rom);
         coleco_rom = NULL;
@@ -550,6 +583,8 @@ static const char settings_dlg[] =
     "property \"Fadeout length (seconds)\" entry gme.fadeout 10;\n"
     "property \"Play loops nr. of times (if available)\" entry gme.loopcount 2;\n"
     "property \"ColecoVision BIOS (for SGC file format)\" file gme.coleco_rom \"\";\n"
+    "property \"Measure lengths of songs without length info in background\" checkbox gme.probe_durations 0;\n"
+    "property \"Max measured song length (in minutes)\" entry gme.probe_max_length 20;\n"
 ;
 
 // define plugin interface
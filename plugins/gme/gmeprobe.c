@@ -0,0 +1,533 @@
+/*
+    DeaDBeeF -- the music player
+    Copyright (C) 2009-2023 Oleksiy Yakovenko and other contributors
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <time.h>
+#include "gme/gme.h"
+#include "gmeprobe.h"
+
+#define trace(...) { deadbeef->log_detailed (probe_plugin, 0, __VA_ARGS__); }
+
+#define PROBE_SAMPLERATE 32000
+#define PROBE_BLOCK 1024 // samples per channel
+#define PROBE_SILENCE_LEVEL 8
+#define PROBE_SILENCE_SECONDS 5
+#define PROBE_MAX_THREADS 8
+#define CACHE_HASH_SIZE 1024
+#define CACHE_MAX_ENTRIES 50000
+#define NOTIFY_MAX_TRACKS 64
+
+static DB_functions_t *deadbeef;
+static DB_plugin_t *probe_plugin;
+
+struct gme_probe_file_s {
+    int refc;
+    char *fname;
+    char *data;
+    int size;
+    int64_t mtime;
+};
+
+typedef struct probe_task_s {
+    gme_probe_file_t *file;
+    DB_playItem_t *it;
+    int track;
+    struct probe_task_s *next;
+} probe_task_t;
+
+typedef struct cache_entry_s {
+    char *fname;
+    int64_t mtime;
+    int track;
+    int length;
+    // line number in the cache file, newer entries have higher numbers
+    int seq;
+    struct cache_entry_s *next;
+} cache_entry_t;
+
+// The workers are started on demand, and exit when the queue is empty.
+// A thread id stays in `threads` until the thread is joined, `running` is cleared by the exiting worker.
+static uintptr_t mutex;
+static probe_task_t *queue_head;
+static probe_task_t *queue_tail;
+static intptr_t threads[PROBE_MAX_THREADS];
+static int running[PROBE_MAX_THREADS];
+static int terminate;
+
+// measured tracks, which are sent in one change notification
+static DB_playItem_t **changed_tracks;
+static int changed_count;
+static time_t changed_time;
+
+static cache_entry_t *cache[CACHE_HASH_SIZE];
+static int cache_count;
+static int cache_seq;
+static int cache_loaded;
+
+static int64_t
+_file_mtime (const char *fname) {
+    struct stat st;
+    if (!deadbeef->is_local_file (fname) || stat (fname, &st)) {
+        return 0;
+    }
+    return (int64_t)st.st_mtime;
+}
+
+static uint32_t
+_cache_hash (const char *fname, int track) {
+    uint32_t h = 2166136261u;
+    for (const char *p = fname; *p; p++) {
+        h = (h ^ (uint8_t)*p) * 16777619u;
+    }
+    h = (h ^ (uint32_t)track) * 16777619u;
+    return h % CACHE_HASH_SIZE;
+}
+
+static void
+_cache_get_path (char *path, size_t size) {
+    snprintf (path, size, "%s/gme_lengths", deadbeef->get_system_dir (DDB_SYS_DIR_CACHE));
+}
+
+// must be called with the mutex locked
+static cache_entry_t *
+_cache_lookup (const char *fname, int track) {
+    for (cache_entry_t *e = cache[_cache_hash (fname, track)]; e; e = e->next) {
+        if (e->track == track && !strcmp (e->fname, fname)) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+// must be called with the mutex locked
+static cache_entry_t *
+_cache_find (const char *fname, int64_t mtime, int track) {
+    cache_entry_t *e = _cache_lookup (fname, track);
+    return e && e->mtime == mtime ? e : NULL;
+}
+
+// Only the last result is kept for each subsong, so the entries of modified files are replaced.
+// must be called with the mutex locked
+static void
+_cache_add (const char *fname, int64_t mtime, int track, int length) {
+    cache_entry_t *e = _cache_lookup (fname, track);
+    if (!e) {
+        uint32_t h = _cache_hash (fname, track);
+        e = calloc (1, sizeof (cache_entry_t));
+        e->fname = strdup (fname);
+        e->track = track;
+        e->next = cache[h];
+        cache[h] = e;
+        cache_count++;
+    }
+    e->mtime = mtime;
+    e->length = length;
+    e->seq = cache_seq++;
+}
+
+static int
+_cache_entry_cmp (const void *a, const void *b) {
+    const cache_entry_t *ea = *(const cache_entry_t **)a;
+    const cache_entry_t *eb = *(const cache_entry_t **)b;
+    return ea->seq - eb->seq;
+}
+
+// Rewrites the cache file from the loaded entries, dropping the entries of missing or modified files,
+// and keeping at most CACHE_MAX_ENTRIES newest ones.
+// must be called with the mutex locked
+static void
+_cache_rewrite (void) {
+    cache_entry_t **entries = malloc (cache_count * sizeof (cache_entry_t *));
+    int n = 0;
+    for (int i = 0; i < CACHE_HASH_SIZE; i++) {
+        for (cache_entry_t *e = cache[i]; e; e = e->next) {
+            if (e->mtime == _file_mtime (e->fname)) {
+                entries[n++] = e;
+            }
+        }
+    }
+    qsort (entries, n, sizeof (cache_entry_t *), _cache_entry_cmp);
+    int first = n > CACHE_MAX_ENTRIES ? n - CACHE_MAX_ENTRIES : 0;
+
+    char path[PATH_MAX];
+    char tmppath[PATH_MAX];
+    _cache_get_path (path, sizeof (path));
+    snprintf (tmppath, sizeof (tmppath), "%s.part", path);
+    FILE *fp = fopen (tmppath, "wt");
+    if (fp) {
+        int err = 0;
+        for (int i = first; i < n && !err; i++) {
+            cache_entry_t *e = entries[i];
+            err = fprintf (fp, "%lld %d %d %s\n", (long long)e->mtime, e->track, e->length, e->fname) < 0;
+        }
+        if (fclose (fp) || err || rename (tmppath, path)) {
+            unlink (tmppath);
+        }
+        else {
+            trace ("gme: compacted %s to %d entries\n", path, n - first);
+        }
+    }
+    free (entries);
+}
+
+// The cache file has one line per subsong: mtime, track, length in ms and file name.
+// Newer lines override the older ones, so the file is rewritten when it has superseded lines,
+// or too many entries.
+static void
+_cache_load (void) {
+    cache_loaded = 1;
+    char path[PATH_MAX];
+    _cache_get_path (path, sizeof (path));
+    FILE *fp = fopen (path, "rt");
+    if (!fp) {
+        return;
+    }
+    int lines = 0;
+    char line[PATH_MAX + 100];
+    while (fgets (line, sizeof (line), fp)) {
+        lines++;
+        long long mtime;
+        int track, length, n;
+        if (sscanf (line, "%lld %d %d %n", &mtime, &track, &length, &n) != 3) {
+            continue;
+        }
+        char *fname = line + n;
+        size_t len = strlen (fname);
+        while (len > 0 && (fname[len-1] == '\n' || fname[len-1] == '\r')) {
+            fname[--len] = 0;
+        }
+        if (len > 0) {
+            _cache_add (fname, mtime, track, length);
+        }
+    }
+    fclose (fp);
+
+    if (lines > cache_count || cache_count > CACHE_MAX_ENTRIES) {
+        _cache_rewrite ();
+    }
+}
+
+// must be called with the mutex locked
+static void
+_cache_store (const char *fname, int64_t mtime, int track, int length) {
+    _cache_add (fname, mtime, track, length);
+    char path[PATH_MAX];
+    _cache_get_path (path, sizeof (path));
+    FILE *fp = fopen (path, "at");
+    if (!fp) {
+        return;
+    }
+    fprintf (fp, "%lld %d %d %s\n", (long long)mtime, track, length, fname);
+    fclose (fp);
+}
+
+static void
+_cache_free (void) {
+    for (int i = 0; i < CACHE_HASH_SIZE; i++) {
+        while (cache[i]) {
+            cache_entry_t *next = cache[i]->next;
+            free (cache[i]->fname);
+            free (cache[i]);
+            cache[i] = next;
+        }
+    }
+    cache_count = 0;
+    cache_seq = 0;
+    cache_loaded = 0;
+}
+
+int
+gme_probe_cached_length (const char *fname, int track) {
+    int64_t mtime = _file_mtime (fname);
+    int length = GME_PROBE_UNKNOWN;
+    deadbeef->mutex_lock (mutex);
+    if (!cache_loaded) {
+        _cache_load ();
+    }
+    cache_entry_t *e = _cache_find (fname, mtime, track);
+    if (e) {
+        length = e->length;
+    }
+    deadbeef->mutex_unlock (mutex);
+    return length;
+}
+
+gme_probe_file_t *
+gme_probe_file_alloc (const char *fname, char *data, int size) {
+    gme_probe_file_t *file = calloc (1, sizeof (gme_probe_file_t));
+    file->refc = 1;
+    file->fname = strdup (fname);
+    file->data = data;
+    file->size = size;
+    file->mtime = _file_mtime (fname);
+    return file;
+}
+
+static void
+_file_unref (gme_probe_file_t *file) {
+    if (--file->refc == 0) {
+        free (file->fname);
+        free (file->data);
+        free (file);
+    }
+}
+
+void
+gme_probe_file_unref (gme_probe_file_t *file) {
+    deadbeef->mutex_lock (mutex);
+    _file_unref (file);
+    deadbeef->mutex_unlock (mutex);
+}
+
+// Emulates the subsong until it ends with silence.
+// Returns the length in milliseconds, GME_PROBE_LOOPS if it plays for longer than the max length, or GME_PROBE_UNKNOWN on error.
+static int
+_probe_length (gme_probe_file_t *file, int track, int max_seconds) {
+    Music_Emu *emu = NULL;
+    if (gme_open_data (file->data, file->size, &emu, PROBE_SAMPLERATE)) {
+        return GME_PROBE_UNKNOWN;
+    }
+    // silence is detected here, to find where exactly it starts
+    gme_ignore_silence (emu, 1);
+    if (gme_start_track (emu, track)) {
+        gme_delete (emu);
+        return GME_PROBE_UNKNOWN;
+    }
+
+    short buffer[PROBE_BLOCK * 2];
+    int64_t pos = 0;
+    int64_t last_sound = 0;
+    int64_t max_samples = (int64_t)max_seconds * PROBE_SAMPLERATE;
+    int res = GME_PROBE_LOOPS;
+
+    while (pos < max_samples && !terminate) {
+        if (gme_play (emu, PROBE_BLOCK * 2, buffer)) {
+            res = GME_PROBE_UNKNOWN;
+            break;
+        }
+        for (int i = PROBE_BLOCK * 2 - 1; i >= 0; i--) {
+            if (buffer[i] > PROBE_SILENCE_LEVEL || buffer[i] < -PROBE_SILENCE_LEVEL) {
+                last_sound = pos + i / 2 + 1;
+                break;
+            }
+        }
+        pos += PROBE_BLOCK;
+        if (gme_track_ended (emu) || pos - last_sound >= PROBE_SILENCE_SECONDS * PROBE_SAMPLERATE) {
+            res = last_sound > 0 ? (int)(last_sound * 1000 / PROBE_SAMPLERATE) : GME_PROBE_UNKNOWN;
+            break;
+        }
+    }
+    if (terminate) {
+        res = GME_PROBE_UNKNOWN;
+    }
+
+    gme_delete (emu);
+    return res;
+}
+
+static void
+_apply_length (DB_playItem_t *it, int length) {
+    char s[20];
+    snprintf (s, sizeof (s), "%d", length);
+    deadbeef->pl_replace_meta (it, ":GME_PROBED_LENGTH", s);
+
+    // leave a bit of the silence, to not cut off the release of the last note
+    float duration = length / 1000.f + 1;
+
+    ddb_playlist_t *plt = deadbeef->pl_get_playlist (it);
+    deadbeef->plt_set_item_duration (plt, it, duration);
+    if (plt) {
+        deadbeef->plt_modified (plt);
+        deadbeef->plt_unref (plt);
+    }
+}
+
+// must be called with the mutex locked
+static void
+_changed_add (DB_playItem_t *it) {
+    if (!changed_tracks) {
+        changed_tracks = malloc (NOTIFY_MAX_TRACKS * sizeof (DB_playItem_t *));
+        changed_time = time (NULL);
+    }
+    deadbeef->pl_item_ref (it);
+    changed_tracks[changed_count++] = it;
+}
+
+// Sends the change notification for the measured tracks, taking over the references.
+static void
+_changed_send (DB_playItem_t **tracks, int count) {
+    if (count == 1) {
+        ddb_event_track_t *ev = (ddb_event_track_t *)deadbeef->event_alloc (DB_EV_TRACKINFOCHANGED);
+        ev->track = tracks[0];
+        free (tracks);
+        deadbeef->event_send ((ddb_event_t *)ev, 0, 0);
+    }
+    else {
+        ddb_event_tracks_t *ev = (ddb_event_tracks_t *)deadbeef->event_alloc (DB_EV_TRACKSINFOCHANGED);
+        ev->tracks = tracks;
+        ev->count = count;
+        deadbeef->event_send ((ddb_event_t *)ev, 0, 0);
+    }
+}
+
+static void
+_probe_worker (void *ctx) {
+    int slot = (int)(intptr_t)ctx;
+    deadbeef->mutex_lock (mutex);
+    for (;;) {
+        if (!queue_head || terminate) {
+            break;
+        }
+        probe_task_t *task = queue_head;
+        queue_head = task->next;
+        if (!queue_head) {
+            queue_tail = NULL;
+        }
+        deadbeef->mutex_unlock (mutex);
+
+        int max_seconds = deadbeef->conf_get_int ("gme.probe_max_length", 20) * 60;
+        int length = _probe_length (task->file, task->track, max_seconds);
+        trace ("gme: %s subsong %d length: %d ms\n", task->file->fname, task->track, length);
+        if (length > 0) {
+            _apply_length (task->it, length);
+        }
+
+        deadbeef->mutex_lock (mutex);
+        if (length != GME_PROBE_UNKNOWN) {
+            _cache_store (task->file->fname, task->file->mtime, task->track, length);
+        }
+        if (length > 0) {
+            _changed_add (task->it);
+        }
+        _file_unref (task->file);
+        deadbeef->pl_item_unref (task->it);
+        free (task);
+
+        // the tracks are sent together, when the queue is done, or at least once per second
+        if (changed_count > 0 && (!queue_head || changed_count == NOTIFY_MAX_TRACKS || time (NULL) - changed_time >= 1)) {
+            DB_playItem_t **tracks = changed_tracks;
+            int count = changed_count;
+            changed_tracks = NULL;
+            changed_count = 0;
+            deadbeef->mutex_unlock (mutex);
+            _changed_send (tracks, count);
+            deadbeef->mutex_lock (mutex);
+        }
+    }
+    running[slot] = 0;
+    deadbeef->mutex_unlock (mutex);
+}
+
+// must be called with the mutex locked
+static void
+_start_worker (void) {
+    long ncpu = sysconf (_SC_NPROCESSORS_ONLN);
+    int max_threads = ncpu > 0 ? (int)ncpu : 1;
+    if (max_threads > PROBE_MAX_THREADS) {
+        max_threads = PROBE_MAX_THREADS;
+    }
+    for (int i = 0; i < max_threads; i++) {
+        if (running[i]) {
+            continue;
+        }
+        if (threads[i]) {
+            // the worker has finished, and doesn't need the mutex anymore
+            deadbeef->thread_join (threads[i]);
+            threads[i] = 0;
+        }
+        running[i] = 1;
+        threads[i] = deadbeef->thread_start_low_priority (_probe_worker, (void *)(intptr_t)i);
+        if (!threads[i]) {
+            running[i] = 0;
+        }
+        return;
+    }
+}
+
+void
+gme_probe_enqueue (gme_probe_file_t *file, DB_playItem_t *it, int track) {
+    probe_task_t *task = calloc (1, sizeof (probe_task_t));
+    task->file = file;
+    task->it = it;
+    task->track = track;
+    deadbeef->pl_item_ref (it);
+
+    deadbeef->mutex_lock (mutex);
+    file->refc++;
+    if (queue_tail) {
+        queue_tail->next = task;
+    }
+    else {
+        queue_head = task;
+    }
+    queue_tail = task;
+    _start_worker ();
+    deadbeef->mutex_unlock (mutex);
+}
+
+void
+gme_probe_init (DB_functions_t *api, DB_plugin_t *plugin) {
+    deadbeef = api;
+    probe_plugin = plugin;
+    mutex = deadbeef->mutex_create ();
+    terminate = 0;
+}
+
+void
+gme_probe_free (void) {
+    deadbeef->mutex_lock (mutex);
+    terminate = 1;
+    deadbeef->mutex_unlock (mutex);
+
+    for (int i = 0; i < PROBE_MAX_THREADS; i++) {
+        if (threads[i]) {
+            deadbeef->thread_join (threads[i]);
+            threads[i] = 0;
+        }
+        running[i] = 0;
+    }
+
+    while (queue_head) {
+        probe_task_t *next = queue_head->next;
+        _file_unref (queue_head->file);
+        deadbeef->pl_item_unref (queue_head->it);
+        free (queue_head);
+        queue_head = next;
+    }
+    queue_tail = NULL;
+    for (int i = 0; i < changed_count; i++) {
+        deadbeef->pl_item_unref (changed_tracks[i]);
+    }
+    free (changed_tracks);
+    changed_tracks = NULL;
+    changed_count = 0;
+    _cache_free ();
+
+    deadbeef->mutex_free (mutex);
+    mutex = 0;
+}
@@ -0,0 +1,61 @@
+/*
+    DeaDBeeF -- the music player
+    Copyright (C) 2009-2023 Oleksiy Yakovenko and other contributors
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef gmeprobe_h
+#define gmeprobe_h
+
+#include <deadbeef/deadbeef.h>
+
+// Background measurement of subsong lengths, for tracks without a known length.
+// Each subsong is emulated until it ends with silence, on a pool of worker threads,
+// and the result is written to the track duration.
+
+#define GME_PROBE_UNKNOWN 0
+#define GME_PROBE_LOOPS -1
+
+void
+gme_probe_init (DB_functions_t *api, DB_plugin_t *plugin);
+
+// stops the workers, and drops the pending tracks
+void
+gme_probe_free (void);
+
+// Returns the cached length of the subsong in milliseconds,
+// GME_PROBE_LOOPS if the subsong never ends, or GME_PROBE_UNKNOWN.
+int
+gme_probe_cached_length (const char *fname, int track);
+
+typedef struct gme_probe_file_s gme_probe_file_t;
+
+// takes ownership of the malloc'ed data
+gme_probe_file_t *
+gme_probe_file_alloc (const char *fname, char *data, int size);
+
+void
+gme_probe_file_unref (gme_probe_file_t *file);
+
+// queues the subsong for measuring, adding a reference to the file and the track
+void
+gme_probe_enqueue (gme_probe_file_t *file, DB_playItem_t *it, int track);
+
+#endif /* gmeprobe_h */
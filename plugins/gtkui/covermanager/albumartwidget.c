@@ -47,7 +47,7 @@ typedef struct {
     ddb_gtkui_widget_extended_api_t exapi;
     ddb_artwork_plugin_t *plugin;
     GtkWidget *drawing_area;
-    GdkPixbuf *image;
+    cairo_surface_t *image;
     int64_t source_id;
     guint throttle_id;
     int64_t request_index;
@@ -111,7 +111,7 @@ _update (w_albumart_t *w) {
 
     if (it == NULL) {
         if (w->image != NULL) {
-            gobj_unref(w->image);
+            cairo_surface_destroy(w->image);
             w->image = NULL;
         }
         gtk_widget_queue_draw(w->drawing_area);
@@ -127,23 +127,16 @@ _update (w_albumart_t *w) {
 
     covermanager_t *cm = covermanager_shared();
 
-    GdkPixbuf *image = covermanager_cover_for_track(cm, it, w->source_id, ^(GdkPixbuf *img) {
+    cairo_surface_t *image = covermanager_surface_for_track(cm, it, w->source_id, availableSize, ^(cairo_surface_t *img) {
         if (currentIndex != w->request_index-1) {
             return;
         }
-        if (img != NULL) {
-            GtkAllocation originalSize = {0};
-            originalSize.width = gdk_pixbuf_get_width(img);
-            originalSize.height = gdk_pixbuf_get_height(img);
-            GtkAllocation desired_size = covermanager_desired_size_for_image_size(cm, originalSize, availableSize);
-            GdkPixbuf *scaled_image = covermanager_create_scaled_image(cm, img, desired_size);
-            w->image = scaled_image;
+        if (w->image != NULL) {
+            cairo_surface_destroy(w->image);
+            w->image = NULL;
         }
-        else {
-            if (w->image != NULL) {
-                gobj_unref(w->image);
-                w->image = NULL;
-            }
+        if (img != NULL) {
+            w->image = cairo_surface_reference(img);
         }
         gtk_widget_queue_draw(w->drawing_area);
     });
@@ -151,15 +144,12 @@ _update (w_albumart_t *w) {
     deadbeef->pl_item_unref (it);
     it = NULL;
 
+    // when loading a new size, this is the same cover at the previous size, drawn scaled meanwhile
     if (image != NULL) {
-        GtkAllocation originalSize = {0};
-        originalSize.width = gdk_pixbuf_get_width(image);
-        originalSize.height = gdk_pixbuf_get_height(image);
-        GtkAllocation desired_size = covermanager_desired_size_for_image_size(cm, originalSize, availableSize);
-
-        GdkPixbuf *scaled_image = covermanager_create_scaled_image(cm, image, desired_size);
-        w->image = scaled_image;
-        gobj_unref(image);
+        if (w->image != NULL) {
+            cairo_surface_destroy(w->image);
+        }
+        w->image = image;
     }
 
     gtk_widget_queue_draw(w->drawing_area);
@@ -230,8 +220,8 @@ _draw_event (GtkWidget *widget, cairo_t *cr, gpointer user_data) {
         return TRUE;
     }
 
-    const int pw = gdk_pixbuf_get_width(w->image);
-    const int ph = gdk_pixbuf_get_height(w->image);
+    const int pw = cairo_image_surface_get_width(w->image);
+    const int ph = cairo_image_surface_get_height(w->image);
     cairo_rectangle(cr, 0, 0, a.width, a.height);
     if (pw > a.width || ph > a.height || (pw < a.width && ph < a.height)) {
         const double scale = min(a.width/(double)pw, a.height/(double)ph);
@@ -239,7 +229,7 @@ _draw_event (GtkWidget *widget, cairo_t *cr, gpointer user_data) {
         cairo_scale(cr, scale, scale);
         cairo_pattern_set_filter(cairo_get_source(cr), CAIRO_FILTER_FAST);
     }
-    gdk_cairo_set_source_pixbuf(cr, w->image, (a.width - pw)/2., (a.height - ph)/2.);
+    cairo_set_source_surface(cr, w->image, (a.width - pw)/2., (a.height - ph)/2.);
     cairo_fill(cr);
 
     return TRUE;
@@ -350,6 +340,10 @@ _destroy (ddb_gtkui_widget_t *base) {
     if (w->plugin != NULL) {
         w->plugin->remove_listener (_artwork_listener, w);
     }
+    if (w->image != NULL) {
+        cairo_surface_destroy(w->image);
+        w->image = NULL;
+    }
 }
 
 ddb_gtkui_widget_t *
@@ -21,8 +21,11 @@
     3. This notice may not be removed or altered from any source distribution.
 */
 
+#include <limits.h>
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include <deadbeef/deadbeef.h>
 #include "../../artwork/artwork.h"
 #include "covermanager.h"
@@ -36,10 +39,12 @@
 extern DB_functions_t *deadbeef;
 
 #define CACHE_SIZE 50
+#define SURFACE_CACHE_SIZE 100
 
 struct covermanager_s {
     ddb_artwork_plugin_t *plugin;
     gobj_cache_t *cache;
+    gobj_cache_t *surface_cache; // scaled surfaces, per cover and size
     dispatch_queue_t loader_queue;
     char *name_tf;
     char *default_cover_path;
@@ -53,6 +58,15 @@ typedef struct {
     dispatch_block_t completion_block;
 } query_userdata_t;
 
+typedef struct {
+    covermanager_t *impl;
+    char *key; // cache key of the cover
+    char *sized_key; // cache key of the cover at the requested size
+    GtkAllocation size;
+    char *default_cover_path;
+    dispatch_block_t completion_block;
+} surface_query_userdata_t;
+
 static covermanager_t *_shared;
 
 static gboolean
@@ -82,6 +96,34 @@ _cache_key_for_track (covermanager_t *impl, ddb_playItem_t *track)  {
     return strdup (buffer);
 }
 
+static char *
+_sized_cache_key (const char *key, GtkAllocation size) {
+    size_t len = strlen (key) + 32;
+    char *sized_key = malloc (len);
+    snprintf (sized_key, len, "%s\n%dx%d", key, size.width, size.height);
+    return sized_key;
+}
+
+// gobj_cache holds GObjects, so the surfaces are attached to a plain GObject
+static GObject *
+_surface_object_new (cairo_surface_t *surface) {
+    GObject *obj = g_object_new (G_TYPE_OBJECT, NULL);
+    g_object_set_data_full (obj, "surface", cairo_surface_reference (surface), (GDestroyNotify)cairo_surface_destroy);
+    return obj;
+}
+
+// Returns retained surface
+static cairo_surface_t *
+_surface_cache_get (covermanager_t *impl, const char *key) {
+    GObject *obj = gobj_cache_get (impl->surface_cache, key);
+    if (obj == NULL) {
+        return NULL;
+    }
+    cairo_surface_t *surface = cairo_surface_reference (g_object_get_data (obj, "surface"));
+    gobj_unref (obj);
+    return surface;
+}
+
 static void
 _update_default_cover (covermanager_t *impl) {
     if (impl->plugin == NULL) {
@@ -115,6 +157,8 @@ _settings_did_change_for_track(covermanager_t *manager, ddb_playItem_t *track) {
         gobj_cache_remove(impl->cache, key);
         free (key);
     }
+    // the sized keys of a track can't be enumerated, and this is rare enough to drop them all
+    gobj_cache_remove_all(impl->surface_cache);
 }
 
 static void
@@ -214,6 +258,177 @@ _load_image_from_cover(covermanager_t *impl, ddb_cover_info_t *cover) {
     return img;
 }
 
+static void
+_size_prepared (GdkPixbufLoader *loader, gint width, gint height, gpointer user_data) {
+    const GtkAllocation *available = user_data;
+    GtkAllocation size = {
+        .width = width,
+        .height = height,
+    };
+    GtkAllocation desired = covermanager_desired_size_for_image_size (NULL, size, *available);
+    if (desired.width == width && desired.height == height) {
+        return;
+    }
+    // let the decoder scale while decoding, e.g. JPEG decodes at 1/2, 1/4 or 1/8 size directly;
+    // the small images are scaled up the same way
+    gdk_pixbuf_loader_set_size (loader, desired.width > 0 ? desired.width : 1, desired.height > 0 ? desired.height : 1);
+}
+
+// Converts to the premultiplied native-endian ARGB, which cairo can paint without conversion
+static cairo_surface_t *
+_surface_from_pixbuf (GdkPixbuf *pixbuf) {
+    int width = gdk_pixbuf_get_width (pixbuf);
+    int height = gdk_pixbuf_get_height (pixbuf);
+    int channels = gdk_pixbuf_get_n_channels (pixbuf);
+    int src_stride = gdk_pixbuf_get_rowstride (pixbuf);
+    gboolean has_alpha = gdk_pixbuf_get_has_alpha (pixbuf);
+    const guchar *src = gdk_pixbuf_get_pixels (pixbuf);
+
+    if (gdk_pixbuf_get_bits_per_sample (pixbuf) != 8 || channels < (has_alpha ? 4 : 3)) {
+        return NULL;
+    }
+
+    cairo_surface_t *surface = cairo_image_surface_create (has_alpha ? CAIRO_FORMAT_ARGB32 : CAIRO_FORMAT_RGB24, width, height);
+    if (cairo_surface_status (surface) != CAIRO_STATUS_SUCCESS) {
+        cairo_surface_destroy (surface);
+        return NULL;
+    }
+    cairo_surface_flush (surface);
+    unsigned char *dst = cairo_image_surface_get_data (surface);
+    int dst_stride = cairo_image_surface_get_stride (surface);
+
+    for (int y = 0; y < height; y++) {
+        const guchar *s = src + y * src_stride;
+        uint32_t *d = (uint32_t *)(dst + y * dst_stride);
+        if (has_alpha) {
+            for (int x = 0; x < width; x++, s += channels) {
+                uint32_t a = s[3];
+                // x*a/255 with rounding
+                uint32_t r = s[0] * a + 0x80; r = (r + (r >> 8)) >> 8;
+                uint32_t g = s[1] * a + 0x80; g = (g + (g >> 8)) >> 8;
+                uint32_t b = s[2] * a + 0x80; b = (b + (b >> 8)) >> 8;
+                d[x] = (a << 24) | (r << 16) | (g << 8) | b;
+            }
+        }
+        else {
+            for (int x = 0; x < width; x++, s += channels) {
+                d[x] = 0xff000000 | ((uint32_t)s[0] << 16) | ((uint32_t)s[1] << 8) | s[2];
+            }
+        }
+    }
+    cairo_surface_mark_dirty (surface);
+    return surface;
+}
+
+// Decodes the image at the size which fits into `available`; safe to call on any thread
+static GdkPixbuf *
+_load_pixbuf_from_file (const char *fname, GtkAllocation available) {
+    long size = 0;
+    char *buf = _buffer_from_file (fname, &size);
+    if (buf == NULL) {
+        return NULL;
+    }
+
+    GdkPixbufLoader *loader = gdk_pixbuf_loader_new ();
+    g_signal_connect (loader, "size-prepared", G_CALLBACK (_size_prepared), &available);
+    gboolean res = gdk_pixbuf_loader_write (loader, (const guchar *)buf, size, NULL);
+    res = gdk_pixbuf_loader_close (loader, NULL) && res;
+    free (buf);
+
+    GdkPixbuf *pixbuf = res ? gdk_pixbuf_loader_get_pixbuf (loader) : NULL;
+    if (pixbuf != NULL) {
+        gobj_ref (pixbuf);
+    }
+    g_object_unref (loader);
+    return pixbuf;
+}
+
+static cairo_surface_t *
+_load_surface_from_file (const char *fname, GtkAllocation available) {
+    GdkPixbuf *pixbuf = _load_pixbuf_from_file (fname, available);
+    if (pixbuf == NULL) {
+        return NULL;
+    }
+    cairo_surface_t *surface = _surface_from_pixbuf (pixbuf);
+    gobj_unref (pixbuf);
+    return surface;
+}
+
+static gboolean
+_save_thumbnail (GdkPixbuf *pixbuf, const char *path) {
+    static gint counter;
+    char temp_path[PATH_MAX];
+    if (sizeof (temp_path) <= snprintf (temp_path, sizeof (temp_path), "%s.%d.part", path, g_atomic_int_add (&counter, 1))) {
+        return FALSE;
+    }
+
+    // JPEG is several times smaller for photos, PNG is only needed to keep the alpha channel
+    gboolean res;
+    if (gdk_pixbuf_get_has_alpha (pixbuf)) {
+        res = gdk_pixbuf_save (pixbuf, temp_path, "png", NULL, NULL);
+    }
+    else {
+        res = gdk_pixbuf_save (pixbuf, temp_path, "jpeg", NULL, "quality", "90", NULL);
+    }
+
+    // the rename is atomic, so that the concurrent loaders never see a partially written thumbnail
+    if (!res || rename (temp_path, path)) {
+        (void)unlink (temp_path);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+// Loads the image through the thumbnail tier of the artwork disk cache, creating the thumbnail when missing
+static cairo_surface_t *
+_load_surface_with_thumbnail (covermanager_t *impl, const char *fname, GtkAllocation available) {
+    if (impl->plugin->plugin.plugin.version_minor < 1) {
+        return _load_surface_from_file (fname, available);
+    }
+
+    char thumbnail_path[PATH_MAX];
+    int thumbnail_size = 0;
+    int res = impl->plugin->thumbnail_path (fname, available.width, available.height, thumbnail_path, sizeof (thumbnail_path), &thumbnail_size);
+    if (res > 0) {
+        // scaled to `available` while decoding, up or down, the same as a new thumbnail below
+        cairo_surface_t *surface = _load_surface_from_file (thumbnail_path, available);
+        if (surface != NULL) {
+            return surface;
+        }
+    }
+    else if (res < 0) {
+        return _load_surface_from_file (fname, available);
+    }
+
+    GtkAllocation box = {
+        .width = thumbnail_size,
+        .height = thumbnail_size,
+    };
+    GdkPixbuf *pixbuf = _load_pixbuf_from_file (fname, box);
+    if (pixbuf == NULL) {
+        return NULL;
+    }
+    (void)_save_thumbnail (pixbuf, thumbnail_path);
+
+    GtkAllocation image_size = {
+        .width = gdk_pixbuf_get_width (pixbuf),
+        .height = gdk_pixbuf_get_height (pixbuf),
+    };
+    GtkAllocation desired = covermanager_desired_size_for_image_size (impl, image_size, available);
+    if (desired.width < 1) {
+        desired.width = 1;
+    }
+    if (desired.height < 1) {
+        desired.height = 1;
+    }
+    GdkPixbuf *scaled = covermanager_create_scaled_image (impl, pixbuf, desired);
+    gobj_unref (pixbuf);
+
+    cairo_surface_t *surface = _surface_from_pixbuf (scaled);
+    gobj_unref (scaled);
+    return surface;
+}
+
 static void
 _add_cover_for_track(covermanager_t *impl, ddb_playItem_t *track, GdkPixbuf *img) {
     char *key = _cache_key_for_track(impl, track);
@@ -319,6 +534,91 @@ _cover_loaded_callback (int error, ddb_cover_query_t *query, ddb_cover_info_t *c
     });
 }
 
+static void
+_surface_query_free (ddb_cover_query_t *query) {
+    surface_query_userdata_t *user_data = query->user_data;
+    Block_release(user_data->completion_block);
+    free (user_data->key);
+    free (user_data->sized_key);
+    free (user_data->default_cover_path);
+    free (user_data);
+
+    deadbeef->pl_item_unref (query->track);
+    free (query);
+}
+
+static void
+_surface_callback_and_cleanup (ddb_cover_query_t *query, cairo_surface_t *surface) {
+    surface_query_userdata_t *user_data = query->user_data;
+    covermanager_t *impl = user_data->impl;
+
+    if (impl->is_terminating) {
+        if (surface != NULL) {
+            cairo_surface_destroy (surface);
+        }
+        _surface_query_free (query);
+        return;
+    }
+
+    if (query->flags & DDB_ARTWORK_FLAG_CANCELLED) {
+        // allow requesting again
+        gobj_cache_remove (impl->surface_cache, user_data->sized_key);
+    }
+    else if (surface != NULL) {
+        GObject *obj = _surface_object_new (surface);
+        gobj_cache_set (impl->surface_cache, user_data->sized_key, obj);
+        // also the fallback for other sizes, see covermanager_surface_for_track
+        gobj_cache_set (impl->surface_cache, user_data->key, obj);
+        gobj_unref (obj);
+    }
+    // With no image, the sized key stays in the waiting state, so that the redraw doesn't request it again.
+    // It's reset when the artwork settings change.
+
+    void (^completion_block)(cairo_surface_t *) = (void (^)(cairo_surface_t *))user_data->completion_block;
+    completion_block (surface);
+
+    if (surface != NULL) {
+        cairo_surface_destroy (surface);
+    }
+    _surface_query_free (query);
+}
+
+static void
+_cover_surface_loaded_callback (int error, ddb_cover_query_t *query, ddb_cover_info_t *cover) {
+    surface_query_userdata_t *user_data = query->user_data;
+    covermanager_t *impl = user_data->impl;
+
+    if (impl->is_terminating) {
+        _dispatch_on_main(^{
+            _surface_query_free (query);
+        });
+        if (cover != NULL) {
+            impl->plugin->cover_info_release (cover);
+        }
+        return;
+    }
+
+    // Decode and scale on the global concurrent queue, which runs up to one job per CPU
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        cairo_surface_t *surface = NULL;
+        if (!(query->flags & DDB_ARTWORK_FLAG_CANCELLED) && !impl->is_terminating) {
+            if (cover != NULL && cover->image_filename != NULL) {
+                surface = _load_surface_with_thumbnail (impl, cover->image_filename, user_data->size);
+            }
+            if (surface == NULL && user_data->default_cover_path != NULL) {
+                surface = _load_surface_with_thumbnail (impl, user_data->default_cover_path, user_data->size);
+            }
+        }
+        if (cover != NULL) {
+            impl->plugin->cover_info_release (cover);
+        }
+
+        _dispatch_on_main(^{
+            _surface_callback_and_cleanup (query, surface);
+        });
+    });
+}
+
 covermanager_t *
 covermanager_shared(void) {
     if (_shared == NULL) {
@@ -346,6 +646,7 @@ covermanager_new(void) {
     }
 
     impl->cache = gobj_cache_new(CACHE_SIZE);
+    impl->surface_cache = gobj_cache_new(SURFACE_CACHE_SIZE);
 
     impl->image_size = deadbeef->conf_get_int("artwork.image_size", 256);
 
@@ -376,6 +677,10 @@ covermanager_free (covermanager_t *impl) {
         gobj_cache_free(impl->cache);
         impl->cache = NULL;
     }
+    if (impl->surface_cache != NULL) {
+        gobj_cache_free(impl->surface_cache);
+        impl->surface_cache = NULL;
+    }
 
     free (impl->default_cover_path);
     impl->default_cover_path = NULL;
@@ -426,6 +731,52 @@ covermanager_cover_for_track(covermanager_t *impl, DB_playItem_t *track, int64_t
     return NULL;
 }
 
+cairo_surface_t *
+covermanager_surface_for_track (covermanager_t *impl, DB_playItem_t *track, int64_t source_id, GtkAllocation size, covermanager_surface_completion_block_t completion_block) {
+    if (!impl->plugin || size.width <= 0 || size.height <= 0) {
+        return NULL;
+    }
+
+    char *key = _cache_key_for_track(impl, track);
+    char *sized_key = _sized_cache_key (key, size);
+
+    cairo_surface_t *surface = _surface_cache_get (impl, sized_key);
+    if (surface != NULL) {
+        free (key);
+        free (sized_key);
+        return surface;
+    }
+
+    // Meanwhile, the same cover at another size can be drawn scaled
+    surface = _surface_cache_get (impl, key);
+
+    if (gobj_cache_get_should_wait(impl->surface_cache, sized_key)) {
+        free (key);
+        free (sized_key);
+        return surface;
+    }
+    gobj_cache_set_should_wait(impl->surface_cache, sized_key, TRUE);
+
+    ddb_cover_query_t *query = calloc (1, sizeof (ddb_cover_query_t));
+    query->_size = sizeof (ddb_cover_query_t);
+    query->track = track;
+    deadbeef->pl_item_ref (track);
+    query->source_id = source_id;
+
+    surface_query_userdata_t *data = calloc (1, sizeof (surface_query_userdata_t));
+    data->impl = impl;
+    data->key = key;
+    data->sized_key = sized_key;
+    data->size = size;
+    data->default_cover_path = impl->default_cover_path ? strdup (impl->default_cover_path) : NULL;
+    data->completion_block = (dispatch_block_t)Block_copy(completion_block);
+    query->user_data = (void *)data;
+
+    impl->plugin->cover_get (query, _cover_surface_loaded_callback);
+
+    return surface;
+}
+
 GdkPixbuf *
 covermanager_create_scaled_image (covermanager_t *manager, GdkPixbuf *image, GtkAllocation size) {
     int originalWidth = gdk_pixbuf_get_width(image);
@@ -54,6 +54,19 @@ covermanager_free (covermanager_t *manager);
 GdkPixbuf *
 covermanager_cover_for_track(covermanager_t *manager, DB_playItem_t *track, int64_t source_id, covermanager_completion_block_t completion_block);
 
+/// Called by @c covermanager_surface_for_track when the surface is ready, on the main thread.
+/// The @c surface argument is not retained, and will be released after the block completes. It's NULL if there's no image.
+typedef void (^covermanager_surface_completion_block_t)(cairo_surface_t *surface);
+
+/// Gets the cover as a premultiplied image surface, decoded at the size which fits into @c size.
+///
+/// If the surface of that size is in the cache, it is returned (retained), and the @c completion_block will not be called.
+/// Otherwise the request is started, unless it's already pending, and the @c completion_block is called when the surface is ready.
+/// In that case, the same cover at another size may be returned (retained) meanwhile, to be drawn scaled.
+/// Decoding and scaling happen on background threads.
+cairo_surface_t *
+covermanager_surface_for_track (covermanager_t *manager, DB_playItem_t *track, int64_t source_id, GtkAllocation size, covermanager_surface_completion_block_t completion_block);
+
 /// Create scaled image with specified dimensions. Returns retained object.
 GdkPixbuf *
 covermanager_create_scaled_image (covermanager_t *manager, GdkPixbuf *image, GtkAllocation size);
@@ -797,9 +797,23 @@ send_messages_to_widgets (ddb_gtkui_widget_t *w, uint32_t id, uintptr_t ctx, uin
     for (ddb_gtkui_widget_t *c = w->children; c; c = c->next) {
         send_messages_to_widgets (c, id, ctx, p1, p2);
     }
-    if (w->message) {
-        w->message (w, id, ctx, p1, p2);
+    if (!w->message) {
+        return;
     }
+    if (id == DB_EV_TRACKSINFOCHANGED && !(w->flags & DDB_GTKUI_WIDGET_FLAG_TRACKS_BATCH)) {
+        // widgets that don't know the batched event get the tracks one by one
+        ddb_event_tracks_t *ev = (ddb_event_tracks_t *)ctx;
+        for (int i = 0; i < ev->count; i++) {
+            ddb_event_track_t track_ev = {
+                .ev.event = DB_EV_TRACKINFOCHANGED,
+                .ev.size = sizeof (ddb_event_track_t),
+                .track = ev->tracks[i],
+            };
+            w->message (w, DB_EV_TRACKINFOCHANGED, (uintptr_t)&track_ev, 0, 0);
+        }
+        return;
+    }
+    w->message (w, id, ctx, p1, p2);
 }
 
 gboolean
@@ -980,6 +994,23 @@ gtkui_message (uint32_t id, uintptr_t ctx, uint32_t p1, uint32_t p2) {
             }
         }
         break;
+    case DB_EV_TRACKSINFOCHANGED:
+        {
+            // only the playing track is shown in the titlebar
+            ddb_event_tracks_t *ev = (ddb_event_tracks_t *)ctx;
+            DB_playItem_t *curr = deadbeef->streamer_get_playing_track_safe ();
+            for (int i = 0; curr && i < ev->count; i++) {
+                if (ev->tracks[i] == curr) {
+                    deadbeef->pl_item_ref (curr);
+                    g_idle_add (trackinfochanged_cb, curr);
+                    break;
+                }
+            }
+            if (curr) {
+                deadbeef->pl_item_unref (curr);
+            }
+        }
+        break;
     case DB_EV_PLAYLISTCHANGED:
         if (p1 == DDB_PLAYLIST_CHANGE_CONTENT) {
             g_idle_add (playlistcontentchanged_cb, NULL);
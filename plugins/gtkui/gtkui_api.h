@@ -92,9 +92,12 @@ typedef void GtkWidget;
 #define DEPRECATED_205
 #endif
 
-// this flag tells that the widget should be added to h/vboxes with expand=FALSE
+// DDB_GTKUI_WIDGET_FLAG_NON_EXPANDABLE tells that the widget should be added to h/vboxes with expand=FALSE
+// DDB_GTKUI_WIDGET_FLAG_TRACKS_BATCH tells that the widget handles DB_EV_TRACKSINFOCHANGED,
+// otherwise it gets one DB_EV_TRACKINFOCHANGED per track of the batch
 enum {
     DDB_GTKUI_WIDGET_FLAG_NON_EXPANDABLE = 1<<0,
+    DDB_GTKUI_WIDGET_FLAG_TRACKS_BATCH = 1<<1,
 };
 
 // widget config string must look like that:
@@ -131,6 +131,29 @@ trackinfochanged_cb (gpointer data) {
     return FALSE;
 }
 
+typedef struct {
+    DdbListview *listview;
+    DB_playItem_t **tracks;
+    int count;
+} w_tracksdata_t;
+
+// redraws the rows of all tracks from one DB_EV_TRACKSINFOCHANGED in a single idle callback
+static gboolean
+tracksinfochanged_cb (gpointer data) {
+    w_tracksdata_t *d = data;
+    for (int i = 0; i < d->count; i++) {
+        int idx = deadbeef->pl_get_idx_of (d->tracks[i]);
+        if (idx != -1) {
+            ddb_listview_draw_row (d->listview, idx, d->tracks[i]);
+        }
+        deadbeef->pl_item_unref (d->tracks[i]);
+    }
+    g_object_unref(d->listview);
+    free (d->tracks);
+    free (d);
+    return FALSE;
+}
+
 static gboolean
 paused_cb (gpointer data) {
     DB_playItem_t *it = deadbeef->streamer_get_playing_track_safe ();
@@ -344,6 +367,22 @@ playlist_controller_message (playlist_controller_t *ctl, uint32_t id, uintptr_t
             }
         }
         break;
+    case DB_EV_TRACKSINFOCHANGED:
+        {
+            ddb_event_tracks_t *ev = (ddb_event_tracks_t *)ctx;
+            g_idle_add (playlist_sort_reset_cb, ctl->listview);
+            w_tracksdata_t *td = malloc (sizeof (w_tracksdata_t));
+            td->listview = ctl->listview;
+            g_object_ref(ctl->listview);
+            td->tracks = malloc (ev->count * sizeof (DB_playItem_t *));
+            td->count = ev->count;
+            for (int i = 0; i < ev->count; i++) {
+                td->tracks[i] = ev->tracks[i];
+                deadbeef->pl_item_ref (td->tracks[i]);
+            }
+            g_idle_add (tracksinfochanged_cb, td);
+        }
+        break;
     case DB_EV_PLAYLISTCHANGED:
         if (p1 == DDB_PLAYLIST_CHANGE_CONTENT || p1 == DDB_PLAYLIST_CHANGE_PLAYQUEUE) {
             g_idle_add (playlist_sort_reset_cb, ctl->listview);
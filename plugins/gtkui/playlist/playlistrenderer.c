@@ -247,9 +247,9 @@ main_draw_group_title (DdbListview *listview, cairo_t *drawable, DdbListviewIter
 }
 
 static void
-cover_draw_cairo (GdkPixbuf *pixbuf, int x, int min_y, int max_y, int width, int height, cairo_t *cr, int filter) {
-    int pw = gdk_pixbuf_get_width(pixbuf);
-    int ph = gdk_pixbuf_get_height(pixbuf);
+cover_draw_cairo (cairo_surface_t *surface, int x, int min_y, int max_y, int width, int height, cairo_t *cr, int filter) {
+    int pw = cairo_image_surface_get_width(surface);
+    int ph = cairo_image_surface_get_height(surface);
     int real_y = min(min_y, max_y - ph);
     cairo_save(cr);
     cairo_rectangle(cr, x, min_y, width, max_y - min_y);
@@ -260,7 +260,7 @@ cover_draw_cairo (GdkPixbuf *pixbuf, int x, int min_y, int max_y, int width, int
         cairo_scale(cr, scale, scale);
         cairo_pattern_set_filter(cairo_get_source(cr), filter);
     }
-    gdk_cairo_set_source_pixbuf(cr, pixbuf, (width - pw)/2., 0);
+    cairo_set_source_surface(cr, surface, (width - pw)/2., 0);
     cairo_fill(cr);
     cairo_restore(cr);
 }
@@ -280,55 +280,41 @@ pl_common_draw_album_art (DdbListview *listview, cairo_t *cr, DdbListviewGroup *
 
     covermanager_t *cm = covermanager_shared();
 
-    GdkPixbuf *image = NULL;
-
-    deadbeef->pl_item_ref (it);
-    image = covermanager_cover_for_track(cm, it, 0, ^(GdkPixbuf *img) { // img only valid in this block
-        deadbeef->pl_item_unref (it);
+    GtkAllocation availableSize = {0};
+    availableSize.width = art_width;
+    availableSize.height = art_height;
 
+    cairo_surface_t *surface = covermanager_surface_for_track(cm, it, 0, availableSize, ^(cairo_surface_t *img) {
         gtk_widget_queue_draw(GTK_WIDGET(listview));
         // FIXME: redraw only the group rect
     });
-    if (image != NULL) { // completion block won't be called
-        deadbeef->pl_item_unref (it);
-        it = NULL;
-    }
-    if (image == NULL) {
+    if (surface == NULL) {
         // FIXME: the problem here is that if the cover is not found (yet) -- it won't draw anything, but the rect is already invalidated, and will come out as background color
         return;
     }
 
-    // image is retained: release at the end
-
     int art_x = x + ART_PADDING_HORZ;
     min_y += ART_PADDING_VERT;
 
+    // the surface is normally decoded at the desired size already, and gets scaled here while a different size of the same cover is loading
     GtkAllocation size = {0};
-    size.width = gdk_pixbuf_get_width(image);
-    size.height = gdk_pixbuf_get_height(image);
-    GtkAllocation availableSize = {0};
-    availableSize.width = art_width;
-    availableSize.height = art_height;
+    size.width = cairo_image_surface_get_width(surface);
+    size.height = cairo_image_surface_get_height(surface);
     GtkAllocation desiredSize = covermanager_desired_size_for_image_size(cm, size, availableSize);
 
-    GdkPixbuf *scaled_image = covermanager_create_scaled_image(cm, image, desiredSize);
-    int scaled_image_width = gdk_pixbuf_get_width(scaled_image);
-    int scaled_image_height = gdk_pixbuf_get_height(scaled_image);
-
     // center horizontally
     if (size.width < size.height) {
         if (alignment == 1) { // align
-            art_x += art_width - scaled_image_width;
+            art_x += art_width - desiredSize.width;
         }
         else if (alignment == 2) { // center
-            art_x += art_width/2 - scaled_image_width/2;
+            art_x += art_width/2 - desiredSize.width/2;
         }
     }
 
-    cover_draw_cairo(scaled_image, art_x, min_y, next_y, scaled_image_width, scaled_image_height, cr, CAIRO_FILTER_FAST);
-    g_object_unref(scaled_image);
+    cover_draw_cairo(surface, art_x, min_y, next_y, desiredSize.width, desiredSize.height, cr, CAIRO_FILTER_FAST);
 
-    gobj_unref(image);
-    image = NULL;
+    cairo_surface_destroy(surface);
+    surface = NULL;
 }
 
@@ -346,6 +346,9 @@ search_message (uint32_t id, uintptr_t ctx, uint32_t p1, uint32_t p2) {
                 search_submit_refresh();
             }
             break;
+        case DB_EV_TRACKSINFOCHANGED:
+            search_submit_refresh();
+            break;
         case DB_EV_PLAYLISTCHANGED:
             if ((p1 == DDB_PLAYLIST_CHANGE_SELECTION && p2 != PL_SEARCH) || p1 == DDB_PLAYLIST_CHANGE_PLAYQUEUE) {
                 g_idle_add(list_redraw_cb, listview);
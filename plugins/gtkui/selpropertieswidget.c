@@ -149,6 +149,7 @@ static int
 _message (ddb_gtkui_widget_t *w, uint32_t id, uintptr_t ctx, uint32_t p1, uint32_t p2) {
     switch (id) {
     case DB_EV_TRACKINFOCHANGED:
+    case DB_EV_TRACKSINFOCHANGED:
     case DB_EV_PLAYLISTCHANGED:
         if (p1 == DDB_PLAYLIST_CHANGE_CONTENT || p1 == DDB_PLAYLIST_CHANGE_SELECTION) {
             selection_changed (w);
@@ -279,6 +280,7 @@ w_selproperties_create (void) {
 
     w->base.widget = gtk_event_box_new ();
     w->base.init = _init;
+    w->base.flags = DDB_GTKUI_WIDGET_FLAG_TRACKS_BATCH;
     w->base.message = _message;
     w->base.initmenu = _initmenu;
     w->visible_sections = SECTION_METADATA | SECTION_PROPERTIES;
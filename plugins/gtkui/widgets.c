@@ -2089,6 +2089,7 @@ w_tabstrip_message (ddb_gtkui_widget_t *w, uint32_t id, uintptr_t ctx, uint32_t
         }
     case DB_EV_PLAYLISTSWITCHED:
     case DB_EV_TRACKINFOCHANGED:
+    case DB_EV_TRACKSINFOCHANGED:
         g_idle_add (tabstrip_refresh_cb, w);
         break;
     }
@@ -2099,7 +2100,7 @@ ddb_gtkui_widget_t *
 w_tabstrip_create (void) {
     w_tabstrip_t *w = malloc (sizeof (w_tabstrip_t));
     memset (w, 0, sizeof (w_tabstrip_t));
-    w->base.flags = DDB_GTKUI_WIDGET_FLAG_NON_EXPANDABLE;
+    w->base.flags = DDB_GTKUI_WIDGET_FLAG_NON_EXPANDABLE | DDB_GTKUI_WIDGET_FLAG_TRACKS_BATCH;
     w->base.widget = gtk_event_box_new ();
     w->base.message = w_tabstrip_message;
     GtkWidget *ts = ddb_tabstrip_new ();
@@ -2142,6 +2143,7 @@ w_tabbed_playlist_message (ddb_gtkui_widget_t *w, uint32_t id, uintptr_t ctx, ui
         }
         break;
     case DB_EV_TRACKINFOCHANGED:
+    case DB_EV_TRACKSINFOCHANGED:
     case DB_EV_PLAYLISTSWITCHED: {
         w_tabbed_playlist_t *p = (w_tabbed_playlist_t *)w;
         g_object_ref (p->tabstrip);
@@ -2271,6 +2273,7 @@ w_tabbed_playlist_create (void) {
 
     w_override_signals (w->plt.base.widget, w);
 
+    w->plt.base.flags = DDB_GTKUI_WIDGET_FLAG_TRACKS_BATCH;
     w->plt.base.message = w_tabbed_playlist_message;
     return (ddb_gtkui_widget_t*)w;
 }
@@ -2306,6 +2309,7 @@ w_playlist_create (void) {
 
     gtk_container_add (GTK_CONTAINER (w->base.widget), GTK_WIDGET (listview));
     w_override_signals (w->base.widget, w);
+    w->base.flags = DDB_GTKUI_WIDGET_FLAG_TRACKS_BATCH;
     w->base.message = w_playlist_message;
     return (ddb_gtkui_widget_t*)w;
 }
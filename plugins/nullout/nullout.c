@@ -41,7 +41,7 @@ static int null_terminate;
 static int state;
 
 static void
-pnull_callback (char *stream, int len);
+pnull_callback (int len);
 
 static void
 pnull_thread (void *context);
@@ -146,22 +146,21 @@ pnull_thread (void *context) {
             continue;
         }
         
-        char buf[4096];
-        pnull_callback (buf, 1024);
+        pnull_callback (1024);
         usleep(1);
     }
 }
 
 static void
-pnull_callback (char *stream, int len) {
+pnull_callback (int len) {
     if (!deadbeef->streamer_ok_to_read (len)) {
-        memset (stream, 0, len);
         return;
     }
-    int bytesread = deadbeef->streamer_read (stream, len);
-
-    if (bytesread < len) {
-        memset (stream + bytesread, 0, len-bytesread);
+    // the data is discarded, so there's no need to copy it out of the streamer
+    const char *data;
+    int bytesread = deadbeef->streamer_read_acquire (&data, len);
+    if (bytesread > 0) {
+        deadbeef->streamer_read_commit (bytesread);
     }
 }
 
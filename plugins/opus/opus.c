@@ -28,6 +28,7 @@
 #include <deadbeef/deadbeef.h>
 #include <stdbool.h>
 #include "../liboggedit/oggedit.h"
+#include "../../shared/pcmpack.h"
 #include <deadbeef/strdupa.h>
 
 #define trace(...) { deadbeef->log_detailed (&plugin.decoder.plugin, 0, __VA_ARGS__); }
@@ -447,7 +448,10 @@ opusdec_read (DB_fileinfo_t *_info, char *bytes, int size) {
     while (samples_read < samples_to_read && (ret > 0 || ret == OP_HOLE))
     {
         int nframes = samples_to_read-samples_read;
-        float pcm[nframes * _info->fmt.channels];
+        float *out = (float *)bytes + samples_read*_info->fmt.channels;
+        // without a channel map, decode straight into the output buffer
+        float map_buffer[info->channelmap ? nframes * _info->fmt.channels : 1];
+        float *pcm = info->channelmap ? map_buffer : out;
         int new_link = -1;
         ret = op_read_float(info->opusfile, pcm, nframes * _info->fmt.channels, &new_link);
 
@@ -458,13 +462,8 @@ opusdec_read (DB_fileinfo_t *_info, char *bytes, int size) {
             break;
         }
         else if (ret > 0) {
-            for (int channel = 0; channel < _info->fmt.channels; channel++) {
-                const float *pcm_channel = &pcm[info->channelmap ? info->channelmap[channel] : channel];
-                float *ptr = ((float *)bytes + samples_read*_info->fmt.channels) + channel;
-                for (int sample = 0; sample < ret; sample ++, pcm_channel += _info->fmt.channels) {
-                    *ptr = *pcm_channel;
-                    ptr += _info->fmt.channels;
-                }
+            if (info->channelmap) {
+                ddb_pcm_remap_channels ((char *)out, (const char *)pcm, _info->fmt.channels, ret, sizeof (float), info->channelmap);
             }
             samples_read += ret;
         }
@@ -275,6 +275,7 @@ oss_thread (void *context) {
 #ifdef __linux__
     prctl (PR_SET_NAME, "deadbeef-oss", 0, 0, 0, 0);
 #endif
+    deadbeef->thread_promote_realtime ();
     for (;;) {
         if (oss_terminate) {
             break;
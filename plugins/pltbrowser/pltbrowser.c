@@ -307,6 +307,7 @@ pltbrowser_message (ddb_gtkui_widget_t *w, uint32_t id, uintptr_t ctx, uint32_t
     case DB_EV_PAUSED:
     case DB_EV_STOP:
     case DB_EV_TRACKINFOCHANGED:
+    case DB_EV_TRACKSINFOCHANGED:
         g_idle_add (update_pltbrowser_cb, w);
         break;
     case DB_EV_PLAYLISTCHANGED:
@@ -820,6 +821,7 @@ w_pltbrowser_create (void) {
 
     w->base.widget = gtk_event_box_new ();
     w->base.init = w_pltbrowser_init;
+    w->base.flags = DDB_GTKUI_WIDGET_FLAG_TRACKS_BATCH;
     w->base.message = pltbrowser_message;
     w->base.initmenu = w_pltbrowser_initmenu;
 
@@ -227,6 +227,13 @@ int ao_decode (uint32 type, void *handle, int16 *buffer, uint32 size);
 
 int ao_command (uint32 type, void *handle, int32 command, int32 param);
 
+// returns 0 if the engine can't save its state
+uint32 ao_get_state_size (uint32 type, void *handle);
+
+int ao_save_state (uint32 type, void *handle, void *state);
+
+int ao_restore_state (uint32 type, void *handle, const void *state);
+
 void ao_getlibpath (const char *path, const char *libname, char *libpath, int size);
 
 #endif // AO_H
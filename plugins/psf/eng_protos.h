@@ -14,6 +14,9 @@ int32 psf_gen(void *, int16 *, uint32);
 int32 psf_stop(void *);
 int32 psf_command(void *, int32, int32);
 int32 psf_fill_info(void *, ao_display_info *);
+uint32 psf_state_size(void *);
+int32 psf_save_state(void *, void *);
+int32 psf_restore_state(void *, const void *);
 
 void *psf2_start(const char *path, uint8 *, uint32 length);
 int32 psf2_gen(void *, int16 *, uint32);
@@ -32,6 +35,9 @@ int32 ssf_gen(void *, int16 *, uint32);
 int32 ssf_stop(void *);
 int32 ssf_command(void *, int32, int32);
 int32 ssf_fill_info(void *, ao_display_info *);
+uint32 ssf_state_size(void *);
+int32 ssf_save_state(void *, void *);
+int32 ssf_restore_state(void *, const void *);
 
 void *spu_start(const char *path, uint8 *, uint32 length);
 int32 spu_gen(void *, int16 *, uint32);
@@ -27,6 +27,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stddef.h>
 
 #include "ao.h"
 #include "eng_protos.h"
@@ -440,6 +441,57 @@ int32 psf_command(void *handle, int32 command, int32 parameter)
 	return AO_FAIL;
 }
 
+// The state excludes the initial RAM image, which never changes, and is restored
+// into the same instance it was saved from.
+#define PSF_STATE_HEAD offsetof(mips_cpu_context, initial_ram)
+#define PSF_STATE_TAIL_OFFSET offsetof(mips_cpu_context, spu)
+#define PSF_STATE_TAIL (sizeof(mips_cpu_context) - PSF_STATE_TAIL_OFFSET)
+
+uint32 psf_state_size(void *handle)
+{
+	return (uint32)(PSF_STATE_HEAD + PSF_STATE_TAIL + SPUgetStateSize());
+}
+
+int32 psf_save_state(void *handle, void *state)
+{
+    psf_synth_t *s = handle;
+	uint8 *p = state;
+
+	if (!s->mips_cpu->spu)
+		return AO_FAIL;
+
+	memcpy(p, s->mips_cpu, PSF_STATE_HEAD);
+	memcpy(p + PSF_STATE_HEAD, (uint8 *)s->mips_cpu + PSF_STATE_TAIL_OFFSET, PSF_STATE_TAIL);
+	SPUsaveState(s->mips_cpu, p + PSF_STATE_HEAD + PSF_STATE_TAIL);
+
+	return AO_SUCCESS;
+}
+
+int32 psf_restore_state(void *handle, const void *state)
+{
+    psf_synth_t *s = handle;
+	mips_cpu_context *cpu = s->mips_cpu;
+	const uint8 *p = state;
+
+	if (!cpu->spu)
+		return AO_FAIL;
+
+	// the SPU is reallocated on restart
+	struct spu_state_s *spu = cpu->spu;
+	struct spu2_state_s *spu2 = cpu->spu2;
+
+	memcpy(cpu, p, PSF_STATE_HEAD);
+	memcpy((uint8 *)cpu + PSF_STATE_TAIL_OFFSET, p + PSF_STATE_HEAD, PSF_STATE_TAIL);
+
+	cpu->spu = spu;
+	cpu->spu2 = spu2;
+	cpu->spu_callback = spu_update;
+	cpu->spu_callback_data = s;
+	SPUrestoreState(cpu, p + PSF_STATE_HEAD + PSF_STATE_TAIL);
+
+	return AO_SUCCESS;
+}
+
 int32 psf_fill_info(void *handle, ao_display_info *info)
 {
     psf_synth_t *s = handle;
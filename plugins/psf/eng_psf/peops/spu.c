@@ -626,3 +626,48 @@ void SPUinjectRAMImage(mips_cpu_context *cpu, u16 *pIncoming)
 		spu->spuMem[i] = pIncoming[i];
 	}
 }
+
+
+////////////////////////////////////////////////////////////////////////
+// SPU state snapshots, taken between two gen calls, when the mixing
+// buffer is empty
+////////////////////////////////////////////////////////////////////////
+
+int SPUgetStateSize(void)
+{
+ return sizeof(spu_state_t);
+}
+
+void SPUsaveState(mips_cpu_context *cpu, void *state)
+{
+ memcpy(state, cpu->spu, sizeof(spu_state_t));
+}
+
+static u8 *RelocateSoundPtr(spu_state_t *spu, const spu_state_t *saved, u8 *ptr)
+{
+ if(!ptr || ptr == (u8*)-1) return ptr;                      // "stop" sign
+ return spu->spuMemC + (ptr - saved->spuMemC);
+}
+
+void SPUrestoreState(mips_cpu_context *cpu, const void *state)
+{
+ spu_state_t *spu = cpu->spu;
+ const spu_state_t *saved = state;
+ u8 *pSpuBuffer = spu->pSpuBuffer;
+ int i;
+
+ memcpy(spu, saved, sizeof(spu_state_t));
+
+ // the sound memory pointers refer to the saved instance
+ spu->spuMemC=(u8*)spu->spuMem;
+ spu->pSpuIrq=RelocateSoundPtr(spu, saved, saved->pSpuIrq);
+ for(i=0;i<MAXCHAN+1;i++)
+  {
+   spu->s_chan[i].pStart=RelocateSoundPtr(spu, saved, saved->s_chan[i].pStart);
+   spu->s_chan[i].pCurr=RelocateSoundPtr(spu, saved, saved->s_chan[i].pCurr);
+   spu->s_chan[i].pLoop=RelocateSoundPtr(spu, saved, saved->s_chan[i].pLoop);
+  }
+
+ spu->pSpuBuffer=pSpuBuffer;
+ spu->pS=(s16 *)pSpuBuffer;
+}
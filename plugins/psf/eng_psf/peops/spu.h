@@ -68,6 +68,9 @@ int SPUopen(mips_cpu_context *cpu);
 int SPUclose(mips_cpu_context *cpu);
 int SPUshutdown(mips_cpu_context *cpu);
 void SPUinjectRAMImage(mips_cpu_context *cpu, u16 *pIncoming);
+int SPUgetStateSize(void);
+void SPUsaveState(mips_cpu_context *cpu, void *state);
+void SPUrestoreState(mips_cpu_context *cpu, const void *state);
 void SPUreadDMAMem(mips_cpu_context *cpu, u32 usPSXMem,int iSize);
 void SPUwriteDMAMem(mips_cpu_context *cpu, u32 usPSXMem,int iSize);
 u16 SPUreadRegister(mips_cpu_context *cpu, u32 reg);
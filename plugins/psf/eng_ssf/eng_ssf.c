@@ -313,6 +313,37 @@ int32 ssf_command(void *handle, int32 command, int32 parameter)
 	return AO_FAIL;
 }
 
+uint32 ssf_state_size(void *handle)
+{
+	return (uint32)(sizeof(uint32) + sizeof(m68ki_cpu_core) + SCSP_GetStateSize());
+}
+
+int32 ssf_save_state(void *handle, void *state)
+{
+    ssf_synth_t *s = handle;
+	uint8 *p = state;
+
+	memcpy(p, &s->total_samples, sizeof(uint32));
+	memcpy(p + sizeof(uint32), s->cpu, sizeof(m68ki_cpu_core));
+	SCSP_SaveState(s->cpu->SCSP, p + sizeof(uint32) + sizeof(m68ki_cpu_core));
+
+	return AO_SUCCESS;
+}
+
+int32 ssf_restore_state(void *handle, const void *state)
+{
+    ssf_synth_t *s = handle;
+	const uint8 *p = state;
+	void *scsp = s->cpu->SCSP;
+
+	memcpy(&s->total_samples, p, sizeof(uint32));
+	memcpy(s->cpu, p + sizeof(uint32), sizeof(m68ki_cpu_core));
+	s->cpu->SCSP = scsp;
+	SCSP_RestoreState(scsp, p + sizeof(uint32) + sizeof(m68ki_cpu_core));
+
+	return AO_SUCCESS;
+}
+
 int32 ssf_fill_info(void *handle, ao_display_info *info)
 {
     ssf_synth_t *s = handle;
@@ -23,6 +23,8 @@
 
 #include <math.h>
 #include <string.h>
+#include <stddef.h>
+#include <stdint.h>
 #include "ao.h"
 #include "cpuintrf.h"
 #include "scsp.h"
@@ -1178,6 +1180,51 @@ void SCSP_Exit (void *param) {
     }
 }
 
+// State snapshots skip the pan tables, which don't change after init.
+#define SCSP_STATE_HEAD offsetof(struct _SCSP, LPANTABLE)
+#define SCSP_STATE_TAIL_OFFSET offsetof(struct _SCSP, TimPris)
+#define SCSP_STATE_TAIL (sizeof(struct _SCSP) - SCSP_STATE_TAIL_OFFSET)
+
+int SCSP_GetStateSize(void)
+{
+	return (int)(sizeof(void *) + SCSP_STATE_HEAD + SCSP_STATE_TAIL);
+}
+
+void SCSP_SaveState(void *param, void *state)
+{
+	UINT8 *p = state;
+	memcpy(p, &param, sizeof(void *));
+	memcpy(p + sizeof(void *), param, SCSP_STATE_HEAD);
+	memcpy(p + sizeof(void *) + SCSP_STATE_HEAD, (UINT8 *)param + SCSP_STATE_TAIL_OFFSET, SCSP_STATE_TAIL);
+}
+
+static void *SCSP_Relocate(void *ptr, const void *from, size_t size, void *to)
+{
+	if ((uintptr_t)ptr >= (uintptr_t)from && (uintptr_t)ptr <= (uintptr_t)from + size)
+		return (UINT8 *)to + ((uintptr_t)ptr - (uintptr_t)from);
+	return ptr;
+}
+
+void SCSP_RestoreState(void *param, const void *state)
+{
+	struct _SCSP *SCSP = param;
+	const UINT8 *p = state;
+	const struct _SCSP *saved;
+	INT32 *buffertmpl = SCSP->buffertmpl;
+	INT32 *buffertmpr = SCSP->buffertmpr;
+
+	// the SCSP is reallocated on restart
+	memcpy(&saved, p, sizeof(void *));
+	memcpy(SCSP, p + sizeof(void *), SCSP_STATE_HEAD);
+	memcpy((UINT8 *)SCSP + SCSP_STATE_TAIL_OFFSET, p + sizeof(void *) + SCSP_STATE_HEAD, SCSP_STATE_TAIL);
+
+	SCSP->buffertmpl = buffertmpl;
+	SCSP->buffertmpr = buffertmpr;
+	SCSP->bufferl = NULL;
+	SCSP->bufferr = NULL;
+	SCSP->RBUFDST = SCSP_Relocate(SCSP->RBUFDST, saved, sizeof(struct _SCSP), SCSP);
+}
+
 
 void SCSP_set_ram_base(struct _SCSP *SCSP, int which, void *base)
 {
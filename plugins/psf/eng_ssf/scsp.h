@@ -29,6 +29,10 @@ struct SCSPinterface
 void *SCSP_Start(const void *config);
 void SCSP_Exit (void *param);
 
+int SCSP_GetStateSize(void);
+void SCSP_SaveState(void *param, void *state);
+void SCSP_RestoreState(void *param, const void *state);
+
 void SCSP_Update(void *param, INT16 **inputs, INT16 **buf, int samples);
 
 #define READ16_HANDLER(name)	data16_t name(void *param, offs_t offset, data16_t mem_mask)
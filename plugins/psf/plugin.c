@@ -33,6 +33,11 @@ static DB_decoder_t plugin;
 
 static const char * exts[] = { "psf", "psf2", "spu", "ssf", "qsf", "dsf", "minipsf", "minipsf2", "minissf", "miniqsf", "minidsf", NULL };
 
+typedef struct {
+    int sample;
+    void *state;
+} psfplug_snapshot_t;
+
 typedef struct {
     DB_fileinfo_t info;
     int currentsample;
@@ -44,8 +49,105 @@ typedef struct {
     int remaining;
     int skipsamples;
     float duration;
+
+    // number of samples generated by the emulator since start
+    int emusample;
+
+    // emulator state snapshots, sorted by position, for seeking backwards
+    psfplug_snapshot_t *snapshots;
+    int num_snapshots;
+    int max_snapshots;
+    int snapshot_interval;
+    uint32_t snapshot_size;
 } psfplug_info_t;
 
+static void
+psfplug_init_snapshots (psfplug_info_t *info) {
+    info->snapshot_size = ao_get_state_size (info->type, info->decoder);
+    if (!info->snapshot_size) {
+        return;
+    }
+    int interval = deadbeef->conf_get_int ("psf.snapshot_interval", 10);
+    int64_t budget = (int64_t)deadbeef->conf_get_int ("psf.snapshot_memory", 64) * 1024 * 1024;
+    info->max_snapshots = (int)(budget / info->snapshot_size);
+    if (interval <= 0 || info->max_snapshots < 2) {
+        info->max_snapshots = 0;
+        return;
+    }
+    info->snapshot_interval = interval * info->info.fmt.samplerate;
+    info->snapshots = calloc (info->max_snapshots, sizeof (psfplug_snapshot_t));
+}
+
+static void
+psfplug_free_snapshots (psfplug_info_t *info) {
+    for (int i = 0; i < info->num_snapshots; i++) {
+        free (info->snapshots[i].state);
+    }
+    free (info->snapshots);
+    info->snapshots = NULL;
+    info->num_snapshots = 0;
+}
+
+// Called before generating the next block, when the emulator reaches a position not covered by snapshots yet.
+static void
+psfplug_take_snapshot (psfplug_info_t *info) {
+    if (!info->max_snapshots) {
+        return;
+    }
+    int last = info->num_snapshots > 0 ? info->snapshots[info->num_snapshots-1].sample : 0;
+    if (info->emusample < last + info->snapshot_interval) {
+        return;
+    }
+
+    if (info->num_snapshots == info->max_snapshots) {
+        // out of budget: drop every other snapshot, and take them twice as rarely
+        int n = 0;
+        for (int i = 0; i < info->num_snapshots; i++) {
+            if (i & 1) {
+                info->snapshots[n++] = info->snapshots[i];
+            }
+            else {
+                free (info->snapshots[i].state);
+            }
+        }
+        info->num_snapshots = n;
+        info->snapshot_interval *= 2;
+        return;
+    }
+
+    void *state = malloc (info->snapshot_size);
+    if (!state) {
+        return;
+    }
+    if (ao_save_state (info->type, info->decoder, state) != AO_SUCCESS) {
+        free (state);
+        info->max_snapshots = 0;
+        psfplug_free_snapshots (info);
+        return;
+    }
+    info->snapshots[info->num_snapshots].sample = info->emusample;
+    info->snapshots[info->num_snapshots].state = state;
+    info->num_snapshots++;
+}
+
+// Returns the latest snapshot at or before the sample
+static psfplug_snapshot_t *
+psfplug_find_snapshot (psfplug_info_t *info, int sample) {
+    psfplug_snapshot_t *res = NULL;
+    for (int i = 0; i < info->num_snapshots && info->snapshots[i].sample <= sample; i++) {
+        res = &info->snapshots[i];
+    }
+    return res;
+}
+
+static void
+psfplug_decode (psfplug_info_t *info) {
+    psfplug_take_snapshot (info);
+    ao_decode (info->type, info->decoder, (int16_t *)info->buffer, 735);
+    info->remaining = 735;
+    info->emusample += 735;
+}
+
 static DB_fileinfo_t *
 psfplug_open (uint32_t hints) {
     psfplug_info_t *info = calloc (1, sizeof (psfplug_info_t));
@@ -104,6 +206,8 @@ psfplug_init (DB_fileinfo_t *_info, DB_playItem_t *it) {
         return -1;
     }
 
+    psfplug_init_snapshots (info);
+
     return 0;
 }
 
@@ -111,6 +215,7 @@ static void
 psfplug_free (DB_fileinfo_t *_info) {
     psfplug_info_t *info = (psfplug_info_t *)_info;
     if (info) {
+        psfplug_free_snapshots (info);
         if (info->type >= 0) {
             ao_stop (info->type, info->decoder);
         }
@@ -155,8 +260,7 @@ psfplug_read (DB_fileinfo_t *_info, char *bytes, int size) {
             size -= n*4;
         }
         if (!info->remaining) {
-            ao_decode (info->type, info->decoder, (int16_t *)info->buffer, 735);
-            info->remaining = 735;
+            psfplug_decode (info);
         }
     }
     info->currentsample += (initsize-size) / (_info->fmt.channels * _info->fmt.bps/8);
@@ -167,12 +271,24 @@ psfplug_read (DB_fileinfo_t *_info, char *bytes, int size) {
 static int
 psfplug_seek_sample (DB_fileinfo_t *_info, int sample) {
     psfplug_info_t *info = (psfplug_info_t *)_info;
-    if (sample > info->currentsample) {
-        info->skipsamples = sample-info->currentsample;
+    // position of the first buffered sample
+    int bufferpos = info->emusample - info->remaining;
+    psfplug_snapshot_t *snapshot = psfplug_find_snapshot (info, sample);
+
+    if (sample >= bufferpos && (!snapshot || snapshot->sample <= info->emusample)) {
+        info->skipsamples = sample - bufferpos;
+    }
+    else if (snapshot && ao_restore_state (info->type, info->decoder, snapshot->state) == AO_SUCCESS) {
+        // continue from the nearest snapshot
+        info->emusample = snapshot->sample;
+        info->remaining = 0;
+        info->skipsamples = sample - snapshot->sample;
     }
     else {
         // restart song
         ao_command (info->type, info->decoder, COMMAND_RESTART, 0);
+        info->emusample = 0;
+        info->remaining = 0;
         info->skipsamples = sample;
     }
     info->currentsample = sample;
@@ -372,6 +488,11 @@ psfplug_stop (void) {
     return 0;
 }
 
+static const char settings_dlg[] =
+    "property \"Seek snapshot interval (seconds)\" entry psf.snapshot_interval 10;\n"
+    "property \"Seek snapshot memory limit (MB)\" entry psf.snapshot_memory 64;\n"
+;
+
 static DB_decoder_t plugin = {
     DDB_PLUGIN_SET_API_VERSION
     .plugin.version_major = 1,
@@ -405,6 +526,7 @@ static DB_decoder_t plugin = {
     .plugin.website = "http://deadbeef.sf.net",
     .plugin.start = psfplug_start,
     .plugin.stop = psfplug_stop,
+    .plugin.configdialog = settings_dlg,
     .open = psfplug_open,
     .init = psfplug_init,
     .free = psfplug_free,
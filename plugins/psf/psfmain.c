@@ -46,15 +46,19 @@ static struct
 	int32 (*command)(void *handle, int32, int32); 
 	uint32 rate; 
 	int32 (*fillinfo)(void *handle, ao_display_info *); 
+	// optional state snapshots
+	uint32 (*state_size)(void *handle);
+	int32 (*save_state)(void *handle, void *state);
+	int32 (*restore_state)(void *handle, const void *state);
 } types[] = {
-	{ 0x50534641, "Capcom QSound (.qsf)", qsf_start, qsf_gen, qsf_stop, qsf_command, 60, qsf_fill_info },
-	{ 0x50534611, "Sega Saturn (.ssf)", ssf_start, ssf_gen, ssf_stop, ssf_command, 60, ssf_fill_info },
-	{ 0x50534601, "Sony PlayStation (.psf)", psf_start, psf_gen, psf_stop, psf_command, 60, psf_fill_info },
-	{ 0x53505500, "Sony PlayStation (.spu)", spu_start, spu_gen, spu_stop, spu_command, 60, spu_fill_info },
-	{ 0x50534602, "Sony PlayStation 2 (.psf2)", psf2_start, psf2_gen, psf2_stop, psf2_command, 60, psf2_fill_info },
-	{ 0x50534612, "Sega Dreamcast (.dsf)", dsf_start, dsf_gen, dsf_stop, dsf_command, 60, dsf_fill_info },
-
-	{ 0xffffffff, "", NULL, NULL, NULL, NULL, 0, NULL }
+	{ 0x50534641, "Capcom QSound (.qsf)", qsf_start, qsf_gen, qsf_stop, qsf_command, 60, qsf_fill_info, NULL, NULL, NULL },
+	{ 0x50534611, "Sega Saturn (.ssf)", ssf_start, ssf_gen, ssf_stop, ssf_command, 60, ssf_fill_info, ssf_state_size, ssf_save_state, ssf_restore_state },
+	{ 0x50534601, "Sony PlayStation (.psf)", psf_start, psf_gen, psf_stop, psf_command, 60, psf_fill_info, psf_state_size, psf_save_state, psf_restore_state },
+	{ 0x53505500, "Sony PlayStation (.spu)", spu_start, spu_gen, spu_stop, spu_command, 60, spu_fill_info, NULL, NULL, NULL },
+	{ 0x50534602, "Sony PlayStation 2 (.psf2)", psf2_start, psf2_gen, psf2_stop, psf2_command, 60, psf2_fill_info, NULL, NULL, NULL },
+	{ 0x50534612, "Sega Dreamcast (.dsf)", dsf_start, dsf_gen, dsf_stop, dsf_command, 60, dsf_fill_info, NULL, NULL, NULL },
+
+	{ 0xffffffff, "", NULL, NULL, NULL, NULL, 0, NULL, NULL, NULL, NULL }
 };
 
 /* ao_get_lib: called to load secondary files */
@@ -261,6 +265,30 @@ ao_command (uint32 type, void *handle, int32 command, int32 param) {
 	return (*types[type].command)(handle, command, param);
 }
 
+uint32
+ao_get_state_size (uint32 type, void *handle) {
+	if (!types[type].state_size) {
+		return 0;
+	}
+	return (*types[type].state_size)(handle);
+}
+
+int
+ao_save_state (uint32 type, void *handle, void *state) {
+	if (!types[type].save_state) {
+		return AO_FAIL;
+	}
+	return (*types[type].save_state)(handle, state);
+}
+
+int
+ao_restore_state (uint32 type, void *handle, const void *state) {
+	if (!types[type].restore_state) {
+		return AO_FAIL;
+	}
+	return (*types[type].restore_state)(handle, state);
+}
+
 void
 ao_getlibpath (const char *path, const char *libname, char *libpath, int size) {
     const char *e = strrchr (path, '\\');
@@ -303,6 +303,7 @@ static void pulse_thread(void *context)
 #ifdef __linux__
     prctl(PR_SET_NAME, "deadbeef-pulse", 0, 0, 0, 0);
 #endif
+    deadbeef->thread_promote_realtime();
 
     trace ("pulse thread started \n");
     while (!pulse_terminate)
@@ -20,6 +20,12 @@
 #include <string.h>
 #include <ctype.h>
 #include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
 #ifdef HAVE_CONFIG_H
 #  include <config.h>
 #endif
@@ -61,77 +67,72 @@ le_int16 (int16_t in, unsigned char *out) {
 // NOTE: we know that current SLDB is larger than that, but we want the code to go into realloc path
 #define SLDB_PREALLOC_ITEMS 50000
 #define SLDB_PREALLOC_LENGTHS SLDB_PREALLOC_ITEMS
+
+// This is also the layout of the entries in the compiled index
 typedef struct {
     uint8_t digest[16];
-    size_t lengths_offset;
+    uint32_t lengths_offset;
     uint16_t subsongs;
+    uint16_t reserved;
 } sldb_item_t;
 
-static sldb_item_t *sldb;
-static size_t sldb_allocated_size;
+// The compiled index is kept in the cache dir, and consists of this header,
+// followed by `count` sldb_item_t sorted by digest, followed by `lengths_count` uint16_t.
+// It's rebuilt whenever path, size or mtime of the source file change.
+#define SLDB_INDEX_MAGIC "DDBSLDB"
+#define SLDB_INDEX_VERSION 1
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t legacy;
+    int64_t src_size;
+    int64_t src_mtime;
+    uint32_t count;
+    uint32_t lengths_count;
+    char src_path[1024];
+} sldb_index_header_t;
+
+static const sldb_item_t *sldb;
 static size_t sldb_count;
 
-static uint16_t *sldb_lengths;
-static size_t sldb_lengths_allocated_size;
+static const uint16_t *sldb_lengths;
 static size_t sldb_lengths_count;
 
+// either the index is mapped, or the parsed tables are kept in memory
+static void *sldb_map;
+static size_t sldb_map_size;
+static sldb_item_t *sldb_items_mem;
+static uint16_t *sldb_lengths_mem;
+
 static int sldb_loaded;
 static int sldb_disable;
 static int sldb_legacy;
 
 static int conf_hvsc_enable = 0;
 
-static void
-sldb_load()
-{
-    if (sldb_disable) {
-        return;
-    }
-    trace ("sldb_load\n");
-    if (sldb_loaded || !conf_hvsc_enable) {
-        sldb_disable = 1;
-        return;
-    }
-    char conf_hvsc_path[1000];
-    deadbeef->conf_get_str ("hvsc_path", "", conf_hvsc_path, sizeof (conf_hvsc_path));
-    if (!conf_hvsc_path[0]) {
-        sldb_disable = 1;
-        return;
-    }
-    sldb_loaded = 1;
-
-    const char *ext = conf_hvsc_path + strlen (conf_hvsc_path) - 4;
-    if (!strcmp (ext, ".txt")) {
-        sldb_legacy = 1;
-    }
-
-    const char *fname = conf_hvsc_path;
-    FILE *fp = fopen (fname, "r");
-    if (!fp) {
-        trace ("sid: failed to open file %s\n", fname);
-        sldb_disable = 1;
-        return;
-    }
+static int
+sldb_parse (FILE *fp, sldb_item_t **out_items, size_t *out_count, uint16_t **out_lengths, size_t *out_lengths_count) {
     char str[1024];
 
     int line = 1;
     if (fgets (str, 1024, fp) != str) {
-        goto fail; // eof
+        return -1; // eof
     }
     if (strncmp (str, "[Database]", 10)) {
-        goto fail; // bad format
+        return -1; // bad format
     }
 
-    if (!sldb) {
-        sldb = (sldb_item_t *)calloc (SLDB_PREALLOC_ITEMS, sizeof(sldb_item_t));
-        sldb_allocated_size = SLDB_PREALLOC_ITEMS;
-        sldb_lengths = (uint16_t *)calloc (SLDB_PREALLOC_LENGTHS, sizeof (uint16_t));
-        sldb_lengths_allocated_size = SLDB_PREALLOC_LENGTHS;
-    }
+    sldb_item_t *items = (sldb_item_t *)calloc (SLDB_PREALLOC_ITEMS, sizeof(sldb_item_t));
+    size_t allocated_size = SLDB_PREALLOC_ITEMS;
+    size_t count = 0;
+    uint16_t *lengths = (uint16_t *)calloc (SLDB_PREALLOC_LENGTHS, sizeof (uint16_t));
+    size_t lengths_allocated_size = SLDB_PREALLOC_LENGTHS;
+    size_t lengths_count = 0;
+
     while (fgets (str, 1024, fp) == str) {
-        if (sldb_count >= sldb_allocated_size) {
-            sldb_allocated_size += 10000;
-            sldb = (sldb_item_t *)realloc (sldb, sldb_allocated_size * sizeof (sldb_item_t));
+        if (count >= allocated_size) {
+            allocated_size += 10000;
+            items = (sldb_item_t *)realloc (items, allocated_size * sizeof (sldb_item_t));
         }
         line++;
         if (str[0] == ';') {
@@ -189,8 +190,9 @@ sldb_load()
             continue; // unexpected eol
         }
 
-        memcpy (sldb[sldb_count].digest, digest, 16);
-        sldb[sldb_count].lengths_offset = sldb_lengths_count;
+        memset (&items[count], 0, sizeof (sldb_item_t));
+        memcpy (items[count].digest, digest, 16);
+        items[count].lengths_offset = (uint32_t)lengths_count;
 
         while (*p >= ' ') {
             // read subsong lengths until eol
@@ -226,13 +228,13 @@ sldb_load()
                 time = atoi (minute) * 60 + atoi (second);
             }
 
-            if (sldb_lengths_count >= sldb_lengths_allocated_size) {
-                sldb_lengths_allocated_size += 10000;
-                sldb_lengths = (uint16_t *)realloc (sldb_lengths, sizeof (uint16_t) * sldb_lengths_allocated_size);
+            if (lengths_count >= lengths_allocated_size) {
+                lengths_allocated_size += 10000;
+                lengths = (uint16_t *)realloc (lengths, sizeof (uint16_t) * lengths_allocated_size);
             }
 
-            sldb_lengths[sldb_lengths_count++] = time;
-            sldb[sldb_count].subsongs++;
+            lengths[lengths_count++] = time;
+            items[count].subsongs++;
 
             // prepare for next timestamp
             if (*p == '(') {
@@ -252,13 +254,189 @@ sldb_load()
                 break; // eol
             }
         }
-        sldb_count++;
+        count++;
+    }
+
+    *out_items = items;
+    *out_count = count;
+    *out_lengths = lengths;
+    *out_lengths_count = lengths_count;
+    return 0;
+}
+
+static int
+sldb_item_cmp (const void *a, const void *b) {
+    const sldb_item_t *x = (const sldb_item_t *)a;
+    const sldb_item_t *y = (const sldb_item_t *)b;
+    int res = memcmp (x->digest, y->digest, 16);
+    if (res) {
+        return res;
+    }
+    // keep duplicates in file order, sldb_find returns the first one
+    return x->lengths_offset < y->lengths_offset ? -1 : (x->lengths_offset > y->lengths_offset);
+}
+
+static void
+sldb_get_index_path (char *path, size_t size) {
+    snprintf (path, size, "%s/sid_songlengths.idx", deadbeef->get_system_dir (DDB_SYS_DIR_CACHE));
+}
+
+static void
+sldb_init_index_header (sldb_index_header_t *hdr, const char *src_path, const struct stat *st) {
+    memset (hdr, 0, sizeof (sldb_index_header_t));
+    memcpy (hdr->magic, SLDB_INDEX_MAGIC, sizeof (hdr->magic));
+    hdr->version = SLDB_INDEX_VERSION;
+    hdr->legacy = sldb_legacy;
+    hdr->src_size = st->st_size;
+    hdr->src_mtime = st->st_mtime;
+    strncpy (hdr->src_path, src_path, sizeof (hdr->src_path) - 1);
+}
+
+#ifndef _WIN32
+// Maps the index if it matches the expected header, returns 0 on success
+static int
+sldb_map_index (const char *index_path, const sldb_index_header_t *expected) {
+    int fd = open (index_path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat (fd, &st) || st.st_size < (off_t)sizeof (sldb_index_header_t)) {
+        close (fd);
+        return -1;
+    }
+    size_t size = st.st_size;
+    void *map = mmap (NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close (fd);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+    const sldb_index_header_t *hdr = (const sldb_index_header_t *)map;
+    size_t expected_size = sizeof (sldb_index_header_t) + (size_t)hdr->count * sizeof (sldb_item_t) + (size_t)hdr->lengths_count * sizeof (uint16_t);
+    if (memcmp (hdr->magic, expected->magic, sizeof (hdr->magic))
+        || hdr->version != expected->version
+        || hdr->legacy != expected->legacy
+        || hdr->src_size != expected->src_size
+        || hdr->src_mtime != expected->src_mtime
+        || strncmp (hdr->src_path, expected->src_path, sizeof (hdr->src_path))
+        || size != expected_size) {
+        munmap (map, size);
+        return -1;
+    }
+    sldb_map = map;
+    sldb_map_size = size;
+    sldb = (const sldb_item_t *)((const char *)map + sizeof (sldb_index_header_t));
+    sldb_count = hdr->count;
+    sldb_lengths = (const uint16_t *)(sldb + sldb_count);
+    sldb_lengths_count = hdr->lengths_count;
+    return 0;
+}
+#endif
+
+static int
+sldb_write_index (const char *index_path, sldb_index_header_t *hdr, const sldb_item_t *items, size_t count, const uint16_t *lengths, size_t lengths_count) {
+    char tmp_path[PATH_MAX];
+    snprintf (tmp_path, sizeof (tmp_path), "%s.part", index_path);
+    FILE *fp = fopen (tmp_path, "wb");
+    if (!fp) {
+        return -1;
+    }
+    hdr->count = (uint32_t)count;
+    hdr->lengths_count = (uint32_t)lengths_count;
+    if (fwrite (hdr, sizeof (sldb_index_header_t), 1, fp) != 1
+        || fwrite (items, sizeof (sldb_item_t), count, fp) != count
+        || fwrite (lengths, sizeof (uint16_t), lengths_count, fp) != lengths_count) {
+        fclose (fp);
+        unlink (tmp_path);
+        return -1;
+    }
+    if (fclose (fp) || rename (tmp_path, index_path)) {
+        unlink (tmp_path);
+        return -1;
     }
+    return 0;
+}
 
-fail:
+static void
+sldb_load()
+{
+    if (sldb_disable) {
+        return;
+    }
+    trace ("sldb_load\n");
+    if (sldb_loaded || !conf_hvsc_enable) {
+        sldb_disable = 1;
+        return;
+    }
+    char conf_hvsc_path[1000];
+    deadbeef->conf_get_str ("hvsc_path", "", conf_hvsc_path, sizeof (conf_hvsc_path));
+    if (!conf_hvsc_path[0]) {
+        sldb_disable = 1;
+        return;
+    }
+    sldb_loaded = 1;
     sldb_disable = 1;
+
+    const char *ext = conf_hvsc_path + strlen (conf_hvsc_path) - 4;
+    if (!strcmp (ext, ".txt")) {
+        sldb_legacy = 1;
+    }
+
+    const char *fname = conf_hvsc_path;
+    struct stat st;
+    if (stat (fname, &st)) {
+        trace ("sid: failed to stat file %s\n", fname);
+        return;
+    }
+
+    sldb_index_header_t hdr;
+    sldb_init_index_header (&hdr, fname, &st);
+    char index_path[PATH_MAX];
+    sldb_get_index_path (index_path, sizeof (index_path));
+
+#ifndef _WIN32
+    if (!sldb_map_index (index_path, &hdr)) {
+        trace ("HVSC sldb index mapped, %d songs, %d subsongs total\n", (int)sldb_count, (int)sldb_lengths_count);
+        return;
+    }
+#endif
+
+    FILE *fp = fopen (fname, "r");
+    if (!fp) {
+        trace ("sid: failed to open file %s\n", fname);
+        return;
+    }
+    sldb_item_t *items = NULL;
+    uint16_t *lengths = NULL;
+    size_t count = 0;
+    size_t lengths_count = 0;
+    int res = sldb_parse (fp, &items, &count, &lengths, &lengths_count);
     fclose (fp);
-    trace ("HVSC sldb loaded %d songs, %d subsongs total\n", sldb->sldb_size, sldb->sldb_poolmark);
+    if (res) {
+        return;
+    }
+
+    qsort (items, count, sizeof (sldb_item_t), sldb_item_cmp);
+
+    // the parsed tables are only kept if the index couldn't be written or mapped
+    if (!sldb_write_index (index_path, &hdr, items, count, lengths, lengths_count)) {
+#ifndef _WIN32
+        if (!sldb_map_index (index_path, &hdr)) {
+            free (items);
+            free (lengths);
+            trace ("HVSC sldb index compiled, %d songs, %d subsongs total\n", (int)sldb_count, (int)sldb_lengths_count);
+            return;
+        }
+#endif
+    }
+
+    sldb_items_mem = items;
+    sldb_lengths_mem = lengths;
+    sldb = items;
+    sldb_count = count;
+    sldb_lengths = lengths;
+    sldb_lengths_count = lengths_count;
+    trace ("HVSC sldb loaded %d songs, %d subsongs total\n", (int)sldb_count, (int)sldb_lengths_count);
 }
 
 static int
@@ -267,11 +445,21 @@ sldb_find (const uint8_t *digest) {
         trace ("sldb not loaded\n");
         return -1;
     }
-    for (int i = 0; i < sldb_count; i++) {
-        if (!memcmp (digest, sldb[i].digest, 16)) {
-            return i;
+    // lower bound, so that the first of duplicate entries is found
+    size_t lo = 0;
+    size_t hi = sldb_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (memcmp (sldb[mid].digest, digest, 16) < 0) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
         }
     }
+    if (lo < sldb_count && !memcmp (digest, sldb[lo].digest, 16)) {
+        return (int)lo;
+    }
     return -1;
 }
 
@@ -589,13 +777,20 @@ csid_insert (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) {
 
 static void
 sldb_free (void) {
-    free (sldb);
+#ifndef _WIN32
+    if (sldb_map) {
+        munmap (sldb_map, sldb_map_size);
+    }
+#endif
+    sldb_map = NULL;
+    sldb_map_size = 0;
+    free (sldb_items_mem);
+    sldb_items_mem = NULL;
+    free (sldb_lengths_mem);
+    sldb_lengths_mem = NULL;
     sldb = NULL;
-    sldb_allocated_size = 0;
     sldb_count = 0;
-    free (sldb_lengths);
     sldb_lengths = NULL;
-    sldb_lengths_allocated_size = 0;
     sldb_lengths_count = 0;
     sldb_loaded = 0;
 }
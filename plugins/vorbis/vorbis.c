@@ -32,6 +32,7 @@
 #include <stdbool.h>
 #include <deadbeef/deadbeef.h>
 #include "../liboggedit/oggedit.h"
+#include "../../shared/pcmpack.h"
 #if TREMOR
     #include <tremor/ivorbisfile.h>
     #define FIXED_POINT 1
@@ -522,12 +523,11 @@ cvorbis_read (DB_fileinfo_t *_info, char *buffer, int bytes_to_read) {
         }
         else if (ret > 0) {
             float *ptr = (float *)buffer + samples_read*_info->fmt.channels;
-            for (int channel = 0; channel < _info->fmt.channels; channel++, ptr++) {
-                const float *pcm_channel = pcm[info->channel_map ? info->channel_map[channel] : channel];
-                for (int sample = 0; sample < ret; sample++) {
-                    ptr[sample*_info->fmt.channels] = pcm_channel[sample];
-                }
+            const float *planes[_info->fmt.channels];
+            for (int channel = 0; channel < _info->fmt.channels; channel++) {
+                planes[channel] = pcm[info->channel_map ? info->channel_map[channel] : channel];
             }
+            ddb_pcm_interleave ((char *)ptr, (const void * const *)planes, _info->fmt.channels, ret, sizeof (float));
             samples_read += ret;
         }
 
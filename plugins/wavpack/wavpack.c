@@ -44,6 +44,7 @@
 #include <math.h>
 #include <deadbeef/deadbeef.h>
 #include <deadbeef/strdupa.h>
+#include "../../shared/pcmpack.h"
 
 #define min(x,y) ((x)<(y)?(x):(y))
 #define max(x,y) ((x)>(y)?(x):(y))
@@ -249,34 +250,7 @@ wv_read (DB_fileinfo_t *_info, char *bytes, int size) {
         int32_t buffer[size/(_info->fmt.bps / 8)];
         n = WavpackUnpackSamples (info->ctx, (int32_t *)buffer, size / samplesize);
         size -= n * samplesize;
-        n *= _info->fmt.channels;
-
-        // convert from int32 to input (what???)
-        int32_t *p = buffer;
-        if (_info->fmt.bps == 16) {
-            while (n > 0) {
-                *((int16_t *)bytes) = (int16_t)(*p);
-                bytes += sizeof (int16_t);
-                p++;
-                n--;
-            }
-        }
-        else if (_info->fmt.bps == 8) {
-            while (n > 0) {
-                *bytes++ = (char)(*p);
-                p++;
-                n--;
-            }
-        }
-        else if (_info->fmt.bps == 24) {
-            while (n > 0) {
-                *bytes++ = (*p)&0xff;
-                *bytes++ = ((*p)&0xff00)>>8;
-                *bytes++ = ((*p)&0xff0000)>>16;
-                p++;
-                n--;
-            }
-        }
+        ddb_pcm_pack_int32 (bytes, buffer, n * _info->fmt.channels, _info->fmt.bps);
     }
     _info->readpos = (float)(WavpackGetSampleIndex (info->ctx)-info->startsample)/WavpackGetSampleRate (info->ctx);
 
@@ -184,6 +184,17 @@ project "libtftintutil"
   filter "platforms:not Windows"
     buildoptions {"-fPIC"}
 
+project "libpcmpack"
+  kind "StaticLib"
+  language "C"
+  targetdir "."
+  targetprefix ""
+  files {
+    "shared/pcmpack.c"
+  }
+  filter "platforms:not Windows"
+    buildoptions {"-fPIC"}
+
 -- DeaDBeeF
 
 project "deadbeef"
@@ -706,7 +717,7 @@ project "flac_plugin"
     "plugins/flac/*.c"
   }
   defines {"HAVE_OGG_STREAM_FLUSH_FILL"}
-  links {"FLAC", "ogg", "liboggedit"}
+  links {"FLAC", "ogg", "liboggedit", "libpcmpack"}
 end
 
 if option ("plugin-wavpack", "wavpack") then
@@ -715,7 +726,7 @@ project "wavpack_plugin"
   files {
     "plugins/wavpack/*.c",
   }
-  links {"wavpack"}
+  links {"wavpack", "libpcmpack"}
 end
 
 if option ("plugin-ffmpeg", "libavformat") then
@@ -725,6 +736,7 @@ project "ffmpeg"
     "plugins/ffmpeg/*.c",
   }
   pkgconfig ("libavformat")
+  links {"libpcmpack"}
   -- links {"avcodec", "pthread", "avformat", "avcodec", "avutil", "z", "opencore-amrnb", "opencore-amrwb", "opus"}
 end
 
@@ -736,7 +748,7 @@ project "vorbis_plugin"
   }
   defines {"HAVE_OGG_STREAM_FLUSH_FILL"}
   pkgconfig ("vorbisfile vorbis ogg")
-  links {"m", "liboggedit"}
+  links {"m", "liboggedit", "libpcmpack"}
   -- fix linking order with liboggedit
   filter "system:Windows"
     links {"libwin"}
@@ -750,7 +762,7 @@ project "opus_plugin"
   }
   defines {"HAVE_OGG_STREAM_FLUSH_FILL"}
   pkgconfig ("opusfile opus ogg")
-  links {"m", "ogg", "liboggedit"}
+  links {"m", "ogg", "liboggedit", "libpcmpack"}
   -- static deps
   filter "configurations:debug or release"
     includedirs {"static-deps/lib-x86-64/include/opus"}
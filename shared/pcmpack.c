@@ -0,0 +1,320 @@
+/*
+    DeaDBeeF -- the music player
+    Copyright (C) 2009-2023 Oleksiy Yakovenko and other contributors
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <string.h>
+#include "pcmpack.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define USE_SSE2 1
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define USE_AVX 1
+#define AVX_TARGET __attribute__((target("avx")))
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define USE_NEON 1
+#endif
+
+#ifdef USE_AVX
+static int
+_has_avx (void) {
+    static int has_avx = -1;
+    int res = __atomic_load_n (&has_avx, __ATOMIC_RELAXED);
+    if (res < 0) {
+        __builtin_cpu_init ();
+        res = __builtin_cpu_supports ("avx") ? 1 : 0;
+        __atomic_store_n (&has_avx, res, __ATOMIC_RELAXED);
+    }
+    return res;
+}
+
+AVX_TARGET static int
+_interleave2_32_avx (uint32_t *out, const uint32_t *l, const uint32_t *r, int nframes) {
+    int i = 0;
+    for (; i + 8 <= nframes; i += 8) {
+        // the float unpack/permute instructions are plain data moves, so they work for any 32 bit samples
+        __m256 a = _mm256_loadu_ps ((const float *)(l + i));
+        __m256 b = _mm256_loadu_ps ((const float *)(r + i));
+        __m256 lo = _mm256_unpacklo_ps (a, b);
+        __m256 hi = _mm256_unpackhi_ps (a, b);
+        _mm256_storeu_ps ((float *)(out + i * 2), _mm256_permute2f128_ps (lo, hi, 0x20));
+        _mm256_storeu_ps ((float *)(out + i * 2 + 8), _mm256_permute2f128_ps (lo, hi, 0x31));
+    }
+    return i;
+}
+#endif
+
+// Stereo kernels: each processes as many frames as it can, and returns the number of frames done
+
+static int
+_interleave2_32 (uint32_t *out, const uint32_t *l, const uint32_t *r, int nframes) {
+    int i = 0;
+#ifdef USE_AVX
+    if (_has_avx ()) {
+        i = _interleave2_32_avx (out, l, r, nframes);
+    }
+#endif
+#if defined(USE_SSE2)
+    for (; i + 4 <= nframes; i += 4) {
+        __m128i a = _mm_loadu_si128 ((const __m128i *)(l + i));
+        __m128i b = _mm_loadu_si128 ((const __m128i *)(r + i));
+        _mm_storeu_si128 ((__m128i *)(out + i * 2), _mm_unpacklo_epi32 (a, b));
+        _mm_storeu_si128 ((__m128i *)(out + i * 2 + 4), _mm_unpackhi_epi32 (a, b));
+    }
+#elif defined(USE_NEON)
+    for (; i + 4 <= nframes; i += 4) {
+        uint32x4x2_t v = { { vld1q_u32 (l + i), vld1q_u32 (r + i) } };
+        vst2q_u32 (out + i * 2, v);
+    }
+#endif
+    return i;
+}
+
+static int
+_interleave2_16 (uint16_t *out, const uint16_t *l, const uint16_t *r, int nframes) {
+    int i = 0;
+#if defined(USE_SSE2)
+    for (; i + 8 <= nframes; i += 8) {
+        __m128i a = _mm_loadu_si128 ((const __m128i *)(l + i));
+        __m128i b = _mm_loadu_si128 ((const __m128i *)(r + i));
+        _mm_storeu_si128 ((__m128i *)(out + i * 2), _mm_unpacklo_epi16 (a, b));
+        _mm_storeu_si128 ((__m128i *)(out + i * 2 + 8), _mm_unpackhi_epi16 (a, b));
+    }
+#elif defined(USE_NEON)
+    for (; i + 8 <= nframes; i += 8) {
+        uint16x8x2_t v = { { vld1q_u16 (l + i), vld1q_u16 (r + i) } };
+        vst2q_u16 (out + i * 2, v);
+    }
+#endif
+    return i;
+}
+
+static int
+_pack2_int32_to_16 (int16_t *out, const int32_t *l, const int32_t *r, int nframes, int shift) {
+    int i = 0;
+#if defined(USE_SSE2)
+    __m128i cnt = _mm_cvtsi32_si128 (shift);
+    for (; i + 4 <= nframes; i += 4) {
+        __m128i a = _mm_sll_epi32 (_mm_loadu_si128 ((const __m128i *)(l + i)), cnt);
+        __m128i b = _mm_sll_epi32 (_mm_loadu_si128 ((const __m128i *)(r + i)), cnt);
+        __m128i v = _mm_packs_epi32 (_mm_unpacklo_epi32 (a, b), _mm_unpackhi_epi32 (a, b));
+        _mm_storeu_si128 ((__m128i *)(out + i * 2), v);
+    }
+#elif defined(USE_NEON)
+    int32x4_t cnt = vdupq_n_s32 (shift);
+    for (; i + 4 <= nframes; i += 4) {
+        int16x4x2_t v = { {
+            vqmovn_s32 (vshlq_s32 (vld1q_s32 (l + i), cnt)),
+            vqmovn_s32 (vshlq_s32 (vld1q_s32 (r + i), cnt))
+        } };
+        vst2_s16 (out + i * 2, v);
+    }
+#endif
+    return i;
+}
+
+static int
+_pack_int32_to_16 (int16_t *out, const int32_t *in, int nsamples) {
+    int i = 0;
+#if defined(USE_SSE2)
+    for (; i + 8 <= nsamples; i += 8) {
+        __m128i a = _mm_loadu_si128 ((const __m128i *)(in + i));
+        __m128i b = _mm_loadu_si128 ((const __m128i *)(in + i + 4));
+        _mm_storeu_si128 ((__m128i *)(out + i), _mm_packs_epi32 (a, b));
+    }
+#elif defined(USE_NEON)
+    for (; i + 8 <= nsamples; i += 8) {
+        vst1q_s16 (out + i, vcombine_s16 (vqmovn_s32 (vld1q_s32 (in + i)), vqmovn_s32 (vld1q_s32 (in + i + 4))));
+    }
+#endif
+    return i;
+}
+
+static inline void
+_store24 (char *out, int32_t sample) {
+    out[0] = (char)sample;
+    out[1] = (char)(sample >> 8);
+    out[2] = (char)(sample >> 16);
+}
+
+void
+ddb_pcm_pack_planar_int32 (char *out, const int32_t * const *planes, int channels, int nframes, int bps, int shift) {
+    int i = 0;
+    switch (bps) {
+    case 8:
+        for (; i < nframes; i++) {
+            for (int c = 0; c < channels; c++) {
+                *out++ = (char)((uint32_t)planes[c][i] << shift);
+            }
+        }
+        break;
+    case 16: {
+        int16_t *out16 = (int16_t *)out;
+        if (channels == 2) {
+            i = _pack2_int32_to_16 (out16, planes[0], planes[1], nframes, shift);
+            out16 += i * 2;
+        }
+        for (; i < nframes; i++) {
+            for (int c = 0; c < channels; c++) {
+                *out16++ = (int16_t)((uint32_t)planes[c][i] << shift);
+            }
+        }
+        break;
+    }
+    case 24:
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        // store 4 bytes and advance by 3, the last frame is stored bytewise to stay within the buffer
+        for (; i < nframes - 1; i++) {
+            for (int c = 0; c < channels; c++) {
+                int32_t sample = (int32_t)((uint32_t)planes[c][i] << shift);
+                memcpy (out, &sample, 4);
+                out += 3;
+            }
+        }
+#endif
+        for (; i < nframes; i++) {
+            for (int c = 0; c < channels; c++) {
+                _store24 (out, (int32_t)((uint32_t)planes[c][i] << shift));
+                out += 3;
+            }
+        }
+        break;
+    case 32: {
+        int32_t *out32 = (int32_t *)out;
+        if (channels == 2 && shift == 0) {
+            i = _interleave2_32 ((uint32_t *)out32, (const uint32_t *)planes[0], (const uint32_t *)planes[1], nframes);
+            out32 += i * 2;
+        }
+        for (; i < nframes; i++) {
+            for (int c = 0; c < channels; c++) {
+                *out32++ = (int32_t)((uint32_t)planes[c][i] << shift);
+            }
+        }
+        break;
+    }
+    }
+}
+
+void
+ddb_pcm_pack_int32 (char *out, const int32_t *in, int nsamples, int bps) {
+    int i = 0;
+    switch (bps) {
+    case 8:
+        for (; i < nsamples; i++) {
+            out[i] = (char)in[i];
+        }
+        break;
+    case 16:
+        i = _pack_int32_to_16 ((int16_t *)out, in, nsamples);
+        for (; i < nsamples; i++) {
+            ((int16_t *)out)[i] = (int16_t)in[i];
+        }
+        break;
+    case 24:
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        for (; i < nsamples - 1; i++) {
+            memcpy (out + i * 3, in + i, 4);
+        }
+#endif
+        for (; i < nsamples; i++) {
+            _store24 (out + i * 3, in[i]);
+        }
+        break;
+    case 32:
+        if ((const char *)in != out) {
+            memmove (out, in, nsamples * sizeof (int32_t));
+        }
+        break;
+    }
+}
+
+void
+ddb_pcm_interleave (char *out, const void * const *planes, int channels, int nframes, int samplesize) {
+    if (channels == 1) {
+        memcpy (out, planes[0], (size_t)nframes * samplesize);
+        return;
+    }
+
+    int i = 0;
+    switch (samplesize) {
+    case 2: {
+        uint16_t *out16 = (uint16_t *)out;
+        if (channels == 2) {
+            i = _interleave2_16 (out16, planes[0], planes[1], nframes);
+            out16 += i * 2;
+        }
+        for (; i < nframes; i++) {
+            for (int c = 0; c < channels; c++) {
+                *out16++ = ((const uint16_t *)planes[c])[i];
+            }
+        }
+        break;
+    }
+    case 4: {
+        uint32_t *out32 = (uint32_t *)out;
+        if (channels == 2) {
+            i = _interleave2_32 (out32, planes[0], planes[1], nframes);
+            out32 += i * 2;
+        }
+        for (; i < nframes; i++) {
+            for (int c = 0; c < channels; c++) {
+                *out32++ = ((const uint32_t *)planes[c])[i];
+            }
+        }
+        break;
+    }
+    default:
+        for (; i < nframes; i++) {
+            for (int c = 0; c < channels; c++) {
+                memcpy (out, (const char *)planes[c] + (size_t)i * samplesize, samplesize);
+                out += samplesize;
+            }
+        }
+        break;
+    }
+}
+
+void
+ddb_pcm_remap_channels (char *out, const char *in, int channels, int nframes, int samplesize, const uint8_t *map) {
+    if (samplesize == 4) {
+        const uint32_t *in32 = (const uint32_t *)in;
+        uint32_t *out32 = (uint32_t *)out;
+        for (int i = 0; i < nframes; i++, in32 += channels) {
+            for (int c = 0; c < channels; c++) {
+                *out32++ = in32[map[c]];
+            }
+        }
+        return;
+    }
+    for (int i = 0; i < nframes; i++, in += channels * samplesize) {
+        for (int c = 0; c < channels; c++) {
+            memcpy (out, in + map[c] * samplesize, samplesize);
+            out += samplesize;
+        }
+    }
+}
@@ -0,0 +1,59 @@
+/*
+    DeaDBeeF -- the music player
+    Copyright (C) 2009-2023 Oleksiy Yakovenko and other contributors
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef pcmpack_h
+#define pcmpack_h
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Sample packing and interleaving helpers for decoders.
+// The output is in native byte order, and the samples are expected to fit into the output bit depth.
+// The stereo cases use SSE2/AVX (selected at runtime) or NEON kernels where available.
+
+// Interleave planar int32 samples into packed 8, 16, 24 or 32 bit samples.
+// Each sample is shifted left by `shift` bits first, which is used for non-byte-aligned bit depths.
+void
+ddb_pcm_pack_planar_int32 (char *out, const int32_t * const *planes, int channels, int nframes, int bps, int shift);
+
+// Pack interleaved int32 samples into 8, 16, 24 or 32 bit samples.
+void
+ddb_pcm_pack_int32 (char *out, const int32_t *in, int nsamples, int bps);
+
+// Interleave planar samples of samplesize bytes each (1, 2, 3, 4 or 8), without format conversion.
+void
+ddb_pcm_interleave (char *out, const void * const *planes, int channels, int nframes, int samplesize);
+
+// Reorder the channels of interleaved samples of samplesize bytes each.
+// Output channel `c` is taken from input channel `map[c]`.
+void
+ddb_pcm_remap_channels (char *out, const char *in, int channels, int nframes, int samplesize, const uint8_t *map);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* pcmpack_h */
@@ -28,6 +28,7 @@
 #include <ctype.h>
 #include <math.h>
 #include <sys/stat.h>
+#include <pthread.h>
 #include "plugins.h"
 #include <deadbeef/common.h>
 #include "plmeta.h"
@@ -77,6 +78,28 @@ const char *cue_field_map[] = {
 
 #define CUE_FIELD_LEN 255
 
+// Direct-mapped cache of cue files read from disk, indexed by path hash
+#define CUE_CACHE_SIZE 256
+
+struct cue_dir_index_s {
+    struct dirent **namelist;
+    int n;
+    int *slots; // namelist indices, -1 for empty slots
+    size_t nslots; // power of 2
+};
+
+typedef struct {
+    char *path;
+    time_t mtime;
+    off_t size;
+    char *text; // NUL-terminated, BOM stripped, recoded to UTF-8 when possible
+    int textsize;
+    const char *charset; // charset for per-field recoding, when the text couldn't be recoded as a whole
+} cue_cache_entry_t;
+
+static cue_cache_entry_t _cue_cache[CUE_CACHE_SIZE];
+static pthread_mutex_t _cue_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 typedef struct {
     // initial values
     const char *fname; // cue of parent file name
@@ -85,6 +108,7 @@ typedef struct {
     int embedded_samplerate;
     const char *cue_file_dir; // directory containing cue file or parent file (FIXME: looks like a dupe with `dirname`)
     const char *dirname; // directory path being loaded
+    cue_dir_index_t *dir; // index of the directory entries
     struct dirent **namelist;
     int n;
     int ncuefiles; // number of FILEs in cue
@@ -474,75 +498,210 @@ _set_last_item_region (playlist_t *plt, playItem_t *it, playItem_t *origin, int6
     return 0;
 }
 
-playItem_t *
-plt_load_cue_file (playlist_t *plt, playItem_t *after, const char *fname, const char *dirname, struct dirent **namelist, int n) {
-    char resolved_fname[PATH_MAX];
+static uint32_t
+_hash_name (const char *name) {
+    // FNV-1a
+    uint32_t h = 2166136261u;
+    for (const uint8_t *p = (const uint8_t *)name; *p; p++) {
+        h ^= *p;
+        h *= 16777619u;
+    }
+    return h;
+}
 
-    uint8_t *membuffer = NULL;
+cue_dir_index_t *
+cue_dir_index_alloc (struct dirent **namelist, int n) {
+    cue_dir_index_t *dir = calloc (1, sizeof (cue_dir_index_t));
+    dir->namelist = namelist;
+    dir->n = n;
+    dir->nslots = 16;
+    while (dir->nslots < (size_t)n * 2) {
+        dir->nslots <<= 1;
+    }
+    dir->slots = malloc (dir->nslots * sizeof (int));
+    memset (dir->slots, 0xff, dir->nslots * sizeof (int));
+    size_t mask = dir->nslots - 1;
+    for (int i = 0; i < n; i++) {
+        size_t idx = _hash_name (namelist[i]->d_name) & mask;
+        while (dir->slots[idx] != -1) {
+            idx = (idx + 1) & mask;
+        }
+        dir->slots[idx] = i;
+    }
+    return dir;
+}
 
-    char *res = realpath (fname, resolved_fname);
-    if (res) {
-        fname = resolved_fname;
+void
+cue_dir_index_free (cue_dir_index_t *dir) {
+    free (dir->slots);
+    free (dir);
+}
+
+// Returns the namelist index of the entry, or -1 if it's not there, or has already been used.
+// Used entries have their d_name cleared, and so never compare equal.
+static int
+_dir_index_find (cue_dir_index_t *dir, const char *name) {
+    if (!*name) {
+        return -1;
+    }
+    size_t mask = dir->nslots - 1;
+    size_t idx = _hash_name (name) & mask;
+    while (dir->slots[idx] != -1) {
+        int i = dir->slots[idx];
+        if (!strcmp (dir->namelist[i]->d_name, name)) {
+            return i;
+        }
+        idx = (idx + 1) & mask;
+    }
+    return -1;
+}
+
+void
+cue_cache_free (void) {
+    pthread_mutex_lock (&_cue_cache_mutex);
+    for (int i = 0; i < CUE_CACHE_SIZE; i++) {
+        free (_cue_cache[i].path);
+        free (_cue_cache[i].text);
+    }
+    memset (_cue_cache, 0, sizeof (_cue_cache));
+    pthread_mutex_unlock (&_cue_cache_mutex);
+}
+
+// Reads the cue file, strips the BOM, and recodes it to UTF-8.
+// The result is cached by path, size and modification time, so that rescans of unchanged folders skip this.
+// On success, returns a malloc'd NUL-terminated buffer, and sets `*pcharset` to the charset
+// which is still needed for recoding individual fields, or NULL.
+static char *
+_cue_file_read (const char *fname, int *psize, const char **pcharset) {
+    struct stat st;
+    int cacheable = !strstr (fname, "://") && !stat (fname, &st);
+    cue_cache_entry_t *entry = &_cue_cache[_hash_name (fname) & (CUE_CACHE_SIZE-1)];
+
+    if (cacheable) {
+        char *text = NULL;
+        pthread_mutex_lock (&_cue_cache_mutex);
+        if (entry->path && !strcmp (entry->path, fname) && entry->mtime == st.st_mtime && entry->size == st.st_size) {
+            text = malloc (entry->textsize + 1);
+            if (text) {
+                memcpy (text, entry->text, entry->textsize + 1);
+                *psize = entry->textsize;
+                *pcharset = entry->charset;
+            }
+        }
+        pthread_mutex_unlock (&_cue_cache_mutex);
+        if (text) {
+            return text;
+        }
     }
 
     DB_FILE *fp = vfs_fopen (fname);
     if (!fp) {
-        goto error;
+        return NULL;
     }
 
     int sz = (int)vfs_fgetlength (fp);
-    membuffer = malloc (sz + 1);
-    if (!membuffer) {
+    char *buffer = malloc (sz + 1);
+    if (!buffer) {
         vfs_fclose (fp);
         trace ("failed to allocate %d bytes to read the file %s\n", sz, fname);
-        goto error;
+        return NULL;
     }
-    uint8_t *buffer = membuffer;
     size_t rb = vfs_fread (buffer, sz, 1, fp);
     buffer[sz] = 0;
     vfs_fclose (fp);
-    fp = NULL;
     if (rb != 1) {
-        goto error;
+        free (buffer);
+        return NULL;
     }
 
-    after = plt_load_cuesheet_from_buffer (plt, after, fname, NULL, 0, 0, buffer, sz, dirname, namelist, n);
-error:
-    if (fp) {
-        vfs_fclose (fp);
+    if (sz >= 3 && !memcmp (buffer, "\xef\xbb\xbf", 3)) {
+        memmove (buffer, buffer + 3, sz - 3 + 1);
+        sz -= 3;
     }
-    if (membuffer) {
-        free (membuffer);
+
+    const char *charset = junk_detect_charset (buffer);
+    if (charset) {
+        // recode the whole file once, instead of every field on every load;
+        // if that fails, fall back to recoding per field, which allows partially broken files
+        int outsize = sz * 4 + 1;
+        char *recoded = malloc (outsize);
+        int res = recoded ? junk_recode (buffer, sz, recoded, outsize, charset) : -1;
+        if (res >= 0) {
+            free (buffer);
+            buffer = recoded;
+            sz = res;
+            charset = NULL;
+        }
+        else {
+            free (recoded);
+        }
     }
+
+    if (cacheable) {
+        char *path = strdup (fname);
+        char *text = malloc (sz + 1);
+        if (path && text) {
+            memcpy (text, buffer, sz + 1);
+            pthread_mutex_lock (&_cue_cache_mutex);
+            free (entry->path);
+            free (entry->text);
+            entry->path = path;
+            entry->mtime = st.st_mtime;
+            entry->size = st.st_size;
+            entry->text = text;
+            entry->textsize = sz;
+            entry->charset = charset;
+            pthread_mutex_unlock (&_cue_cache_mutex);
+        }
+        else {
+            free (path);
+            free (text);
+        }
+    }
+
+    *psize = sz;
+    *pcharset = charset;
+    return buffer;
+}
+
+static playItem_t *
+_load_cuesheet (playlist_t *plt, playItem_t *after, const char *fname, playItem_t *embedded_origin, int64_t embedded_numsamples, int embedded_samplerate, const uint8_t *buffer, int sz, const char *charset, const char *dirname, cue_dir_index_t *dir);
+
+playItem_t *
+plt_load_cue_file (playlist_t *plt, playItem_t *after, const char *fname, const char *dirname, cue_dir_index_t *dir) {
+    char resolved_fname[PATH_MAX];
+
+    char *res = realpath (fname, resolved_fname);
+    if (res) {
+        fname = resolved_fname;
+    }
+
+    int sz = 0;
+    const char *charset = NULL;
+    char *buffer = _cue_file_read (fname, &sz, &charset);
+    if (!buffer) {
+        return after;
+    }
+
+    after = _load_cuesheet (plt, after, fname, NULL, 0, 0, (const uint8_t *)buffer, sz, charset, dirname, dir);
+    free (buffer);
     return after;
 }
 
 static int
 _file_present_in_namelist (const char *fullpath, cueparser_t *cue) {
-    int i = 0;
-    for (i = 0; i < cue->n; i++) {
-        if (cue->namelist[i]->d_name[0]) {
-            char path[PATH_MAX];
-            snprintf (path, sizeof (path), "%s/%s", cue->dirname, cue->namelist[i]->d_name);
-            if (!strcmp (path, cue->fullpath)) {
-                // file present
-                break;
-            }
-            // poor's man vfs detection -- directory ends with ':'
-            snprintf (path, sizeof (path), "%s%s", cue->dirname, cue->namelist[i]->d_name);
-            if (!strcmp (path, cue->fullpath)) {
-                // file present
-                break;
-            }
-        }
-    }
-    if (i == cue->n) {
+    // the path is either "dirname/name", or "dirnamename" for vfs containers, where dirname ends with ':'
+    size_t l = strlen (cue->dirname);
+    if (strncmp (fullpath, cue->dirname, l)) {
         return 0;
     }
-    return 1;
+    const char *name = fullpath + l;
+    if (name[0] == '/' && _dir_index_find (cue->dir, name + 1) >= 0) {
+        return 1;
+    }
+    return _dir_index_find (cue->dir, name) >= 0;
 }
 
-
 static int
 cue_addfile_filter (cueparser_t *cue) {
     ddb_file_found_data_t dt;
@@ -680,11 +839,13 @@ _load_nextfile (cueparser_t *cue) {
                     fn_nonvfs = cue->fullpath;
                 }
 
-                for (int i = 0; i < cue->n; i++) {
-                    if (!strcmp (fn_vfs, cue->namelist[i]->d_name) || !strcmp (fn_nonvfs, cue->namelist[i]->d_name)) {
-                        cue->namelist[i]->d_name[0] = 0;
-                        break;
-                    }
+                int i = _dir_index_find (cue->dir, fn_vfs);
+                int i_nonvfs = _dir_index_find (cue->dir, fn_nonvfs);
+                if (i < 0 || (i_nonvfs >= 0 && i_nonvfs < i)) {
+                    i = i_nonvfs;
+                }
+                if (i >= 0) {
+                    cue->namelist[i]->d_name[0] = 0;
                 }
             }
         }
@@ -777,7 +938,18 @@ _is_audio_track (const char *track) {
 }
 
 playItem_t *
-plt_load_cuesheet_from_buffer (playlist_t *plt, playItem_t *after, const char *fname, playItem_t *embedded_origin, int64_t embedded_numsamples, int embedded_samplerate, const uint8_t *buffer, int sz, const char *dirname, struct dirent **namelist, int n) {
+plt_load_cuesheet_from_buffer (playlist_t *plt, playItem_t *after, const char *fname, playItem_t *embedded_origin, int64_t embedded_numsamples, int embedded_samplerate, const uint8_t *buffer, int sz, const char *dirname, cue_dir_index_t *dir) {
+    if (sz >= 3 && !memcmp (buffer, "\xef\xbb\xbf", 3)) {
+        buffer += 3;
+        sz -= 3;
+    }
+
+    const char *charset = junk_detect_charset ((const char *)buffer);
+    return _load_cuesheet (plt, after, fname, embedded_origin, embedded_numsamples, embedded_samplerate, buffer, sz, charset, dirname, dir);
+}
+
+static playItem_t *
+_load_cuesheet (playlist_t *plt, playItem_t *after, const char *fname, playItem_t *embedded_origin, int64_t embedded_numsamples, int embedded_samplerate, const uint8_t *buffer, int sz, const char *charset, const char *dirname, cue_dir_index_t *dir) {
     playItem_t *result = NULL;
     cueparser_t cue;
     memset (&cue, 0, sizeof (cue));
@@ -801,20 +973,18 @@ plt_load_cuesheet_from_buffer (playlist_t *plt, playItem_t *after, const char *f
 
 
     cue.dirname = dirname;
-    cue.namelist = namelist;
-    cue.n = n;
+    if (dir) {
+        cue.dir = dir;
+        cue.namelist = dir->namelist;
+        cue.n = dir->n;
+    }
 
     cue.target_playlist = plt;
 
     cue.temp_plt = calloc (1, sizeof (playlist_t));
     cue.temp_plt->loading_cue = 1;
 
-    if (sz >= 3 && !memcmp (buffer, "\xef\xbb\xbf", 3)) {
-        buffer += 3;
-        sz -= 3;
-    }
-
-    cue.charset = junk_detect_charset (buffer);
+    cue.charset = charset;
     cue.p = buffer;
 
     const uint8_t *end = buffer+sz;
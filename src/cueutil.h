@@ -23,22 +23,38 @@
 
 #include <deadbeef/deadbeef.h>
 
+// Hash set of the entries of a scanned directory, for looking up the files referenced by cuesheets.
+// Built once per directory, and shared by all cuesheets loaded from it.
+// Wraps the scandir `namelist`, which must outlive the index. Entries used by a cuesheet get their d_name cleared.
+typedef struct cue_dir_index_s cue_dir_index_t;
+
+cue_dir_index_t *
+cue_dir_index_alloc (struct dirent **namelist, int n);
+
+void
+cue_dir_index_free (cue_dir_index_t *dir);
+
+// Frees the cache of cue file contents
+void
+cue_cache_free (void);
+
 // Load cuesheet, find the corresponding audiofiles, and add them as tracks into playlist, if they can be found.
 //
-// If namelist is not NULL (result of scandir), it helps to find the audio files in the cuesheet directory,
+// If dir is not NULL, it helps to find the audio files in the cuesheet directory,
 // and allows to mark them as used to avoid adding the same files multiple times.
 //
 // Internally, the function finds and loads the cue file, and passes it to `plt_load_cuesheet_from_buffer`, see below for more information.
+// The file contents are cached by path and modification time, so unchanged cue files are not re-read and re-recoded on rescans.
 //
 // Argument breakdown:
 //  `playlist` where to add files.
 //  The item `after` which to insert the files. NULL means beginning of playlist.
 //  `fullname` is the fully qualified path to the cuesheet file.
 //  `dirname` is full directory path, in which scandir was performed.
-//  `namelist` and `n` is the scandir output.
-//  The `dirname`, `namelist` and `n` can be either all set to NULL, otherwise they all must be valid values.
+//  `dir` is the index of the scandir output.
+//  The `dirname` and `dir` can be either both set to NULL, otherwise they both must be valid values.
 playItem_t *
-plt_load_cue_file (playlist_t *playlist, playItem_t *after, const char *fullname, const char *dirname, struct dirent **namelist, int n);
+plt_load_cue_file (playlist_t *playlist, playItem_t *after, const char *fullname, const char *dirname, cue_dir_index_t *dir);
 
 // This is a more internal function, to load cuesheet from buffer.
 // Semantics are the same as `plt_load_cue_file`.
@@ -51,5 +67,4 @@ plt_load_cue_file (playlist_t *playlist, playItem_t *after, const char *fullname
 //  `buffer`: pointer to the string containing cuesheet.
 //  `buffersize`: size of the buffer.
 playItem_t *
-plt_load_cuesheet_from_buffer (playlist_t *playlist, playItem_t *after, const char *fname, playItem_t *embedded_origin, int64_t embedded_numsamples, int embedded_samplerate, const uint8_t *buffer, int buffersize, const char *dirname, struct dirent **namelist, int n);
-
+plt_load_cuesheet_from_buffer (playlist_t *playlist, playItem_t *after, const char *fname, playItem_t *embedded_origin, int64_t embedded_numsamples, int embedded_samplerate, const uint8_t *buffer, int buffersize, const char *dirname, cue_dir_index_t *dir);
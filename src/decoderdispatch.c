@@ -0,0 +1,327 @@
+/*
+    DeaDBeeF -- the music player
+    Copyright (C) 2009-2023 Oleksiy Yakovenko and other contributors
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <pthread.h>
+#include "decoderdispatch.h"
+#include "plugins.h"
+#include "conf.h"
+#include "vfs.h"
+
+#define SNIFF_SIZE 64
+#define MAX_EXT_LENGTH 32
+
+typedef struct {
+    char *ext; // lowercase
+    uint64_t decoders; // bit N is set when decoder N in the list handles the extension
+} dispatch_ext_t;
+
+// Formats which can be identified reliably from the first bytes of a file.
+// Containers shared by several decoders (MP4, Matroska) and ID3-prefixed files are not listed.
+typedef struct {
+    const char *plugin_id;
+    int offset;
+    const char *magic;
+    int offset2;
+    const char *magic2;
+} dispatch_signature_t;
+
+static const dispatch_signature_t _signatures[] = {
+    { "stdflac", 0, "fLaC", 0, NULL },
+    { "wv", 0, "wvpk", 0, NULL },
+    { "ffap", 0, "MAC ", 0, NULL },
+    { "musepack", 0, "MPCK", 0, NULL },
+    { "musepack", 0, "MP+", 0, NULL },
+    { "tta", 0, "TTA1", 0, NULL },
+    { "shn", 0, "ajkg", 0, NULL },
+    { "wma", 0, "\x30\x26\xb2\x75\x8e\x66\xcf\x11", 0, NULL },
+    { "sndfile", 0, "RIFF", 8, "WAVE" },
+    { "sndfile", 0, "FORM", 8, "AIFF" },
+    { "sndfile", 0, "FORM", 8, "AIFC" },
+    { NULL, 0, NULL, 0, NULL }
+};
+
+static pthread_mutex_t _dispatch_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int _table_valid;
+static DB_decoder_t *_decoders[DECODER_DISPATCH_MAX];
+static int _num_decoders;
+static dispatch_ext_t *_ext_table;
+static size_t _ext_table_size; // power of 2
+static uint64_t _wildcard_decoders;
+static uint64_t _prefix_decoders;
+
+static int _sniff_enabled = 1;
+
+static uint32_t
+_hash_ext (const char *ext) {
+    // FNV-1a
+    uint32_t h = 2166136261u;
+    for (const uint8_t *p = (const uint8_t *)ext; *p; p++) {
+        h ^= *p;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static dispatch_ext_t *
+_ext_slot (const char *ext) {
+    size_t mask = _ext_table_size - 1;
+    size_t idx = _hash_ext (ext) & mask;
+    while (_ext_table[idx].ext && strcmp (_ext_table[idx].ext, ext)) {
+        idx = (idx + 1) & mask;
+    }
+    return &_ext_table[idx];
+}
+
+static int
+_lowercase_ext (char *out, const char *ext) {
+    size_t len = strlen (ext);
+    if (len == 0 || len >= MAX_EXT_LENGTH) {
+        return -1;
+    }
+    for (size_t i = 0; i <= len; i++) {
+        out[i] = tolower ((uint8_t)ext[i]);
+    }
+    return 0;
+}
+
+static void
+_free_table (void) {
+    for (size_t i = 0; i < _ext_table_size; i++) {
+        free (_ext_table[i].ext);
+    }
+    free (_ext_table);
+    _ext_table = NULL;
+    _ext_table_size = 0;
+    _num_decoders = 0;
+    _wildcard_decoders = 0;
+    _prefix_decoders = 0;
+    _table_valid = 0;
+}
+
+static void
+_build_table (void) {
+    _free_table ();
+
+    DB_decoder_t **decoders = plug_get_decoder_list ();
+    size_t num_exts = 0;
+    for (int i = 0; i < DECODER_DISPATCH_MAX && decoders[i]; i++) {
+        if (!decoders[i]->insert) {
+            continue;
+        }
+        for (int e = 0; decoders[i]->exts && decoders[i]->exts[e]; e++) {
+            num_exts++;
+        }
+    }
+
+    _ext_table_size = 16;
+    while (_ext_table_size < num_exts * 2) {
+        _ext_table_size <<= 1;
+    }
+    _ext_table = calloc (_ext_table_size, sizeof (dispatch_ext_t));
+
+    for (int i = 0; i < DECODER_DISPATCH_MAX && decoders[i]; i++) {
+        _decoders[i] = decoders[i];
+        _num_decoders = i + 1;
+        if (!decoders[i]->insert) {
+            continue;
+        }
+        uint64_t bit = (uint64_t)1 << i;
+        for (int e = 0; decoders[i]->exts && decoders[i]->exts[e]; e++) {
+            const char *ext = decoders[i]->exts[e];
+            if (!strcmp (ext, "*")) {
+                _wildcard_decoders |= bit;
+                continue;
+            }
+            char lc[MAX_EXT_LENGTH];
+            if (_lowercase_ext (lc, ext) < 0) {
+                continue;
+            }
+            dispatch_ext_t *slot = _ext_slot (lc);
+            if (!slot->ext) {
+                slot->ext = strdup (lc);
+            }
+            slot->decoders |= bit;
+        }
+        if (decoders[i]->prefixes && decoders[i]->prefixes[0]) {
+            _prefix_decoders |= bit;
+        }
+    }
+    _table_valid = 1;
+}
+
+static int
+_match_prefix (DB_decoder_t *decoder, const char *fn) {
+    const char **prefixes = decoder->prefixes;
+    for (int e = 0; prefixes[e]; e++) {
+        size_t len = strlen (prefixes[e]);
+        if (!strncasecmp (prefixes[e], fn, len) && fn[len] == '.') {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static const char *
+_sniff_plugin_id (const char *fname) {
+    DB_FILE *fp = vfs_fopen (fname);
+    if (!fp) {
+        return NULL;
+    }
+    uint8_t buf[SNIFF_SIZE];
+    size_t size = vfs_fread (buf, 1, sizeof (buf), fp);
+    vfs_fclose (fp);
+
+    // Ogg streams are identified by the first packet, which follows the segment table of the first page
+    if (size >= 27 && !memcmp (buf, "OggS", 4)) {
+        size_t pos = 27 + buf[26];
+        if (pos + 8 > size) {
+            return NULL;
+        }
+        if (!memcmp (buf + pos, "\x01vorbis", 7)) {
+            return "stdogg";
+        }
+        if (!memcmp (buf + pos, "OpusHead", 8)) {
+            return "opus";
+        }
+        if (!memcmp (buf + pos, "\x7f" "FLAC", 5)) {
+            return "stdflac";
+        }
+        return NULL;
+    }
+
+    for (int i = 0; _signatures[i].plugin_id; i++) {
+        const dispatch_signature_t *s = &_signatures[i];
+        size_t len = strlen (s->magic);
+        if (s->offset + len > size || memcmp (buf + s->offset, s->magic, len)) {
+            continue;
+        }
+        if (s->magic2) {
+            size_t len2 = strlen (s->magic2);
+            if (s->offset2 + len2 > size || memcmp (buf + s->offset2, s->magic2, len2)) {
+                continue;
+            }
+        }
+        return s->plugin_id;
+    }
+    return NULL;
+}
+
+void
+decoder_dispatch_configchanged (void) {
+    _sniff_enabled = conf_get_int ("add_files_sniff_content", 1);
+    // decoders such as ffmpeg and gme recompute their extension lists from config
+    decoder_dispatch_invalidate ();
+}
+
+void
+decoder_dispatch_invalidate (void) {
+    pthread_mutex_lock (&_dispatch_mutex);
+    _table_valid = 0;
+    pthread_mutex_unlock (&_dispatch_mutex);
+}
+
+void
+decoder_dispatch_free (void) {
+    pthread_mutex_lock (&_dispatch_mutex);
+    _free_table ();
+    pthread_mutex_unlock (&_dispatch_mutex);
+}
+
+int
+decoder_dispatch_find (const char *fn, const char *ext, DB_decoder_t **decoders, int *ambiguous) {
+    char lc[MAX_EXT_LENGTH];
+    int have_ext = _lowercase_ext (lc, ext) == 0;
+
+    pthread_mutex_lock (&_dispatch_mutex);
+    if (!_table_valid) {
+        _build_table ();
+    }
+
+    uint64_t specific = 0;
+    if (have_ext) {
+        specific = _ext_slot (lc)->decoders;
+    }
+    uint64_t prefix = _prefix_decoders & ~specific;
+    for (int i = 0; prefix; i++, prefix >>= 1) {
+        if ((prefix & 1) && _match_prefix (_decoders[i], fn)) {
+            specific |= (uint64_t)1 << i;
+        }
+    }
+
+    // a single decoder claiming the extension is trusted without reading the file
+    *ambiguous = (specific & (specific - 1)) != 0 || (!specific && _wildcard_decoders);
+
+    uint64_t candidates = specific | _wildcard_decoders;
+    int n = 0;
+    for (int i = 0; candidates; i++, candidates >>= 1) {
+        if (candidates & 1) {
+            decoders[n++] = _decoders[i];
+        }
+    }
+    pthread_mutex_unlock (&_dispatch_mutex);
+    return n;
+}
+
+int
+decoder_dispatch_sniff (const char *fname, DB_decoder_t **decoders, int count, int tried) {
+    if (!_sniff_enabled) {
+        return count;
+    }
+    const char *sniffed_id = _sniff_plugin_id (fname);
+    if (!sniffed_id) {
+        return count;
+    }
+
+    DB_decoder_t *sniffed = NULL;
+    pthread_mutex_lock (&_dispatch_mutex);
+    for (int i = 0; i < _num_decoders; i++) {
+        if (_decoders[i]->insert && _decoders[i]->plugin.id && !strcmp (_decoders[i]->plugin.id, sniffed_id)) {
+            sniffed = _decoders[i];
+            break;
+        }
+    }
+    pthread_mutex_unlock (&_dispatch_mutex);
+    if (!sniffed) {
+        return count;
+    }
+
+    int pos;
+    for (pos = 0; pos < count && decoders[pos] != sniffed; pos++);
+    if (pos < tried) {
+        // the sniffed decoder has already failed
+        return count;
+    }
+    if (pos == count) {
+        if (count >= DECODER_DISPATCH_MAX) {
+            return count;
+        }
+        count++;
+    }
+    memmove (decoders + tried + 1, decoders + tried, (pos - tried) * sizeof (DB_decoder_t *));
+    decoders[tried] = sniffed;
+    return count;
+}
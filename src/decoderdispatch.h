@@ -0,0 +1,72 @@
+/*
+    DeaDBeeF -- the music player
+    Copyright (C) 2009-2023 Oleksiy Yakovenko and other contributors
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef decoderdispatch_h
+#define decoderdispatch_h
+
+#include <deadbeef/deadbeef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DECODER_DISPATCH_MAX 64
+
+// Reads the add_files_sniff_content setting
+void
+decoder_dispatch_configchanged (void);
+
+// Drops the extension table, which is rebuilt from the decoder list on next use.
+// Call whenever the decoder list, or the extensions of a decoder, might have changed.
+void
+decoder_dispatch_invalidate (void);
+
+void
+decoder_dispatch_free (void);
+
+// Finds the decoders which should be tried to insert a file, in order, without accessing the file.
+//
+// Decoders are matched by extension through a hash table, by "*" wildcard, and by filename prefix,
+// and are returned in decoder list order.
+// `*ambiguous` is set when the file content should decide which decoder goes first:
+// several decoders match the extension or prefix, or only wildcard decoders match.
+//
+// `fn` is the file name part of the path, and `ext` the extension without the dot.
+// @return number of decoders written into `decoders`, at most DECODER_DISPATCH_MAX
+int
+decoder_dispatch_find (const char *fn, const char *ext, DB_decoder_t **decoders, int *ambiguous);
+
+// If content sniffing is enabled, the first bytes of the file are compared with known signatures,
+// and the decoder which owns the format is moved to the front of the untried decoders, or inserted there.
+// The first `tried` decoders were tried already, and stay in place.
+// Meant for the files which decoder_dispatch_find reported as ambiguous before trying any decoder,
+// and for the other files after the first decoder failed, e.g. when the file has a wrong extension.
+// @return the new number of decoders
+int
+decoder_dispatch_sniff (const char *fname, DB_decoder_t **decoders, int count, int tried);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* decoderdispatch_h */
@@ -33,6 +33,8 @@
 #include "plugins.h"
 #include "conf.h"
 #include "premix.h"
+#include "dsppipeline.h"
+#include "realtime.h"
 
 static ddb_dsp_context_t *_current_dsp_chain;
 static DB_dsp_t *_eqplug;
@@ -57,6 +59,7 @@ dsp_free (void) {
     _current_dsp_chain = NULL;
 
     free_dsp_buffers ();
+    dsp_pipeline_free ();
 
     _eqplug = NULL;
     _eq = NULL;
@@ -84,6 +87,7 @@ ensure_dsp_input_buffer (int size) {
         return 0;
     }
     if (size != _dsp_input_buffer_size) {
+        rt_check_alloc ();
         _dsp_input_buffer = realloc (_dsp_input_buffer, size);
         _dsp_input_buffer_size = size;
     }
@@ -101,6 +105,7 @@ ensure_dsp_temp_buffer (int size) {
         return NULL;
     }
     if (size != _dsp_temp_buffer_size) {
+        rt_check_alloc ();
         _dsp_temp_buffer = realloc (_dsp_temp_buffer, size);
         _dsp_temp_buffer_size = size;
     }
@@ -331,8 +336,16 @@ streamer_dsp_postinit (void) {
 
 }
 
+void
+dsp_configchanged (void) {
+    dsp_pipeline_set_threaded (conf_get_int ("streamer.dsp_threads", 0));
+}
+
 void
 streamer_dsp_init (void) {
+    dsp_pipeline_init ();
+    dsp_configchanged ();
+
     // load dsp chain from file
     char fname[PATH_MAX];
     snprintf (fname, sizeof (fname), "%s/dspconfig", plug_get_config_dir ());
@@ -377,7 +390,7 @@ streamer_dsp_init (void) {
 
 
 int
-dsp_apply (ddb_waveformat_t *input_fmt, char *input, int inputsize,
+dsp_apply (ddb_waveformat_t *input_fmt, char *input, int inputsize, float gain,
            ddb_waveformat_t *out_fmt, char **out_bytes, int *out_numbytes, float *out_dsp_ratio) {
 
     *out_dsp_ratio = 1;
@@ -437,19 +450,15 @@ dsp_apply (ddb_waveformat_t *input_fmt, char *input, int inputsize,
     int tempbuf_size = inputsize/inputsamplesize * dspsamplesize * MAX_DSP_RATIO;
     char *tempbuf = ensure_dsp_temp_buffer (tempbuf_size);
 
-    // convert to float
-    /*int tempsize = */pcm_convert (input_fmt, input, &dspfmt, tempbuf, inputsize);
+    // convert to float, applying the gain in the same pass
+    /*int tempsize = */pcm_convert_with_gain (input_fmt, input, &dspfmt, tempbuf, inputsize, gain);
     int nframes = inputsize / inputsamplesize;
-    ddb_dsp_context_t *dsp = _current_dsp_chain;
     float ratio = 1.f;
     int maxframes = tempbuf_size / dspsamplesize;
-    while (dsp) {
-        if (dsp->enabled) {
-            float r = 1;
-            nframes = dsp->plugin->process (dsp, (float *)tempbuf, nframes, maxframes, &dspfmt, &r);
-            ratio *= r;
-        }
-        dsp = dsp->next;
+    nframes = dsp_pipeline_process (_current_dsp_chain, (float *)tempbuf, nframes, maxframes, &dspfmt, &ratio);
+    if (nframes < 0) {
+        fprintf (stderr, "dsp_apply: the output of the DSP chain didn't fit into the buffer, the block is dropped\n");
+        nframes = 0;
     }
 
     *out_dsp_ratio = ratio;
@@ -57,14 +57,19 @@ streamer_set_dsp_chain_real (ddb_dsp_context_t *chain);
 void
 streamer_dsp_init (void);
 
+// Reads the DSP settings from the config, must be called with the streamer locked
+void
+dsp_configchanged (void);
+
 void
 streamer_set_dsp_chain_real (ddb_dsp_context_t *chain);
 
 ddb_dsp_context_t *
 dsp_clone (ddb_dsp_context_t *from);
 
+// The `gain` is applied to the input while converting it to the DSP format
 int
-dsp_apply (ddb_waveformat_t *input_fmt, char *input, int inputsize,
+dsp_apply (ddb_waveformat_t *input_fmt, char *input, int inputsize, float gain,
            ddb_waveformat_t *out_fmt, char **out_bytes, int *out_numbytes, float *out_dsp_ratio);
 
 void
@@ -0,0 +1,366 @@
+/*
+    DeaDBeeF -- the music player
+    Copyright (C) 2009-2023 Oleksiy Yakovenko and other contributors
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <time.h>
+#include <sys/time.h>
+#include <deadbeef/deadbeef.h>
+#include "dsppipeline.h"
+#include "threading.h"
+#include "realtime.h"
+
+//#define trace(...) { fprintf(stderr, __VA_ARGS__); }
+#define trace(fmt,...)
+
+#define DSP_PIPELINE_MAX_STAGES 16
+#define DSP_PIPELINE_MAX_CHUNKS 16
+#define DSP_PIPELINE_CHUNK_FRAMES 512
+
+typedef struct {
+    float *buf;
+    int bufsize; // in bytes
+    int nframes;
+    int maxframes;
+    float ratio;
+    ddb_waveformat_t fmt;
+} dsp_chunk_t;
+
+// Single producer, single consumer queue of chunks between two stages.
+// NULL is pushed to make the consumer thread exit.
+typedef struct {
+    dsp_chunk_t *items[DSP_PIPELINE_MAX_CHUNKS + 1];
+    int head;
+    int tail;
+    uintptr_t mutex;
+    uintptr_t cond;
+} dsp_chunk_queue_t;
+
+typedef struct {
+    char id[64];
+    uint64_t calls;
+    uint64_t frames;
+    uint64_t cpu_ns;
+    uint64_t audio_ns;
+} dsp_stage_stats_t;
+
+static int _threaded;
+
+// the stages of the current dsp_pipeline_process call, set before any chunk is queued
+static ddb_dsp_context_t *_stages[DSP_PIPELINE_MAX_STAGES];
+static int _nstages;
+static uint64_t _stage_cpu_ns[DSP_PIPELINE_MAX_STAGES];
+static uint64_t _stage_frames[DSP_PIPELINE_MAX_STAGES];
+static uint64_t _stage_audio_ns[DSP_PIPELINE_MAX_STAGES];
+
+static dsp_chunk_t _chunks[DSP_PIPELINE_MAX_CHUNKS];
+
+// _queues[i] feeds the worker of stage i, _queues[0] receives the finished chunks
+static dsp_chunk_queue_t _queues[DSP_PIPELINE_MAX_STAGES];
+static intptr_t _workers[DSP_PIPELINE_MAX_STAGES];
+static int _nworkers;
+// the real-time role of the thread which started the workers, or -1
+static int _workers_role = -1;
+
+static dsp_stage_stats_t _stats[DSP_PIPELINE_MAX_STAGES];
+static uintptr_t _stats_mutex;
+
+static uint64_t
+_thread_cpu_time_ns (void) {
+#ifdef CLOCK_THREAD_CPUTIME_ID
+    struct timespec ts;
+    if (!clock_gettime (CLOCK_THREAD_CPUTIME_ID, &ts)) {
+        return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+    }
+#endif
+    struct timeval tm;
+    gettimeofday (&tm, NULL);
+    return (uint64_t)tm.tv_sec * 1000000000 + (uint64_t)tm.tv_usec * 1000;
+}
+
+static void
+_queue_init (dsp_chunk_queue_t *q) {
+    q->head = q->tail = 0;
+    q->mutex = mutex_create ();
+    q->cond = cond_create ();
+}
+
+static void
+_queue_free (dsp_chunk_queue_t *q) {
+    cond_free (q->cond);
+    mutex_free (q->mutex);
+    q->cond = 0;
+    q->mutex = 0;
+}
+
+static void
+_queue_push (dsp_chunk_queue_t *q, dsp_chunk_t *chunk) {
+    mutex_lock (q->mutex);
+    q->items[q->tail] = chunk;
+    q->tail = (q->tail + 1) % (DSP_PIPELINE_MAX_CHUNKS + 1);
+    cond_signal (q->cond);
+    mutex_unlock (q->mutex);
+}
+
+static dsp_chunk_t *
+_queue_pop (dsp_chunk_queue_t *q) {
+    mutex_lock (q->mutex);
+    while (q->head == q->tail) {
+        cond_wait_locked (q->cond, q->mutex);
+    }
+    dsp_chunk_t *chunk = q->items[q->head];
+    q->head = (q->head + 1) % (DSP_PIPELINE_MAX_CHUNKS + 1);
+    mutex_unlock (q->mutex);
+    return chunk;
+}
+
+static void
+_process_stage (int stage, dsp_chunk_t *chunk) {
+    ddb_dsp_context_t *dsp = _stages[stage];
+    uint64_t start = _thread_cpu_time_ns ();
+    _stage_frames[stage] += chunk->nframes;
+    if (chunk->fmt.samplerate > 0) {
+        _stage_audio_ns[stage] += chunk->nframes * 1000000000ull / chunk->fmt.samplerate;
+    }
+    float r = 1;
+    chunk->nframes = dsp->plugin->process (dsp, chunk->buf, chunk->nframes, chunk->maxframes, &chunk->fmt, &r);
+    chunk->ratio *= r;
+    _stage_cpu_ns[stage] += _thread_cpu_time_ns () - start;
+}
+
+static void
+_worker (void *ctx) {
+    int stage = (int)(intptr_t)ctx;
+    if (_workers_role >= 0) {
+        // the calling thread waits for the workers, so they need the same priority
+        rt_thread_promote ((rt_thread_role_t)_workers_role);
+    }
+    for (;;) {
+        dsp_chunk_t *chunk = _queue_pop (&_queues[stage]);
+        if (!chunk) {
+            break;
+        }
+        rt_thread_update ();
+        _process_stage (stage, chunk);
+        _queue_push (&_queues[stage == _nstages - 1 ? 0 : stage + 1], chunk);
+    }
+}
+
+static void
+_stop_workers (void) {
+    for (int i = 1; i <= _nworkers; i++) {
+        _queue_push (&_queues[i], NULL);
+        thread_join (_workers[i]);
+        _workers[i] = 0;
+    }
+    _nworkers = 0;
+}
+
+static void
+_start_workers (int count) {
+    int role = rt_thread_get_role ();
+    if (role != _workers_role) {
+        _stop_workers ();
+        _workers_role = role;
+    }
+    while (_nworkers < count) {
+        _nworkers++;
+        _workers[_nworkers] = thread_start (_worker, (void *)(intptr_t)_nworkers);
+    }
+}
+
+void
+dsp_pipeline_init (void) {
+    for (int i = 0; i < DSP_PIPELINE_MAX_STAGES; i++) {
+        _queue_init (&_queues[i]);
+    }
+    _stats_mutex = mutex_create ();
+}
+
+void
+dsp_pipeline_free (void) {
+    _stop_workers ();
+    for (int i = 0; i < DSP_PIPELINE_MAX_STAGES; i++) {
+        _queue_free (&_queues[i]);
+    }
+    for (int i = 0; i < DSP_PIPELINE_MAX_CHUNKS; i++) {
+        free (_chunks[i].buf);
+        _chunks[i].buf = NULL;
+        _chunks[i].bufsize = 0;
+    }
+    mutex_free (_stats_mutex);
+    _stats_mutex = 0;
+}
+
+void
+dsp_pipeline_set_threaded (int threaded) {
+    // only called from the streamer thread, or with the streamer locked, so no processing is running
+    _threaded = threaded;
+    if (!threaded) {
+        _stop_workers ();
+    }
+}
+
+static void
+_update_stats (void) {
+    mutex_lock (_stats_mutex);
+    for (int i = 0; i < _nstages; i++) {
+        dsp_stage_stats_t *s = &_stats[i];
+        const char *id = _stages[i]->plugin->plugin.id;
+        if (strcmp (s->id, id)) {
+            // the chain has changed
+            memset (s, 0, sizeof (dsp_stage_stats_t));
+            strncpy (s->id, id, sizeof (s->id) - 1);
+        }
+        s->calls++;
+        s->frames += _stage_frames[i];
+        s->cpu_ns += _stage_cpu_ns[i];
+        s->audio_ns += _stage_audio_ns[i];
+    }
+    for (int i = _nstages; i < DSP_PIPELINE_MAX_STAGES; i++) {
+        memset (&_stats[i], 0, sizeof (dsp_stage_stats_t));
+    }
+    mutex_unlock (_stats_mutex);
+}
+
+static int
+_process_sequential (float *buffer, int nframes, int maxframes, ddb_waveformat_t *fmt, float *out_ratio) {
+    dsp_chunk_t chunk = {
+        .buf = buffer,
+        .nframes = nframes,
+        .maxframes = maxframes,
+        .ratio = 1,
+        .fmt = *fmt,
+    };
+    for (int i = 0; i < _nstages; i++) {
+        _process_stage (i, &chunk);
+    }
+    *fmt = chunk.fmt;
+    *out_ratio = chunk.ratio;
+    return chunk.nframes;
+}
+
+static int
+_process_threaded (float *buffer, int nframes, int maxframes, ddb_waveformat_t *fmt, float *out_ratio) {
+    int nchunks = (nframes + DSP_PIPELINE_CHUNK_FRAMES - 1) / DSP_PIPELINE_CHUNK_FRAMES;
+    if (nchunks > DSP_PIPELINE_MAX_CHUNKS) {
+        nchunks = DSP_PIPELINE_MAX_CHUNKS;
+    }
+    int chunk_frames = (nframes + nchunks - 1) / nchunks;
+
+    // Each chunk gets its share of the buffer's headroom for growing (e.g. resampling),
+    // rounded down, so that the output of all chunks always fits into the buffer.
+    int samplesize = fmt->channels * sizeof (float);
+    int chunk_bufsize = (int)((int64_t)chunk_frames * maxframes / nframes) * samplesize;
+
+    _start_workers (_nstages - 1);
+
+    // stage 0 runs on the calling thread, and feeds the workers
+    int pos = 0;
+    for (int i = 0; i < nchunks; i++) {
+        dsp_chunk_t *chunk = &_chunks[i];
+        if (chunk->bufsize < chunk_bufsize) {
+            rt_check_alloc ();
+            free (chunk->buf);
+            chunk->buf = malloc (chunk_bufsize);
+            chunk->bufsize = chunk_bufsize;
+        }
+        int n = nframes - pos < chunk_frames ? nframes - pos : chunk_frames;
+        memcpy (chunk->buf, (char *)buffer + pos * samplesize, n * samplesize);
+        pos += n;
+        chunk->nframes = n;
+        chunk->maxframes = (int)((int64_t)n * maxframes / nframes);
+        chunk->ratio = 1;
+        chunk->fmt = *fmt;
+        _process_stage (0, chunk);
+        _queue_push (&_queues[1], chunk);
+    }
+
+    // the stages are FIFO, so the chunks come out in order
+    char *out = (char *)buffer;
+    char *end = (char *)buffer + maxframes * samplesize;
+    int outframes = 0;
+    int overflow = 0;
+    for (int i = 0; i < nchunks; i++) {
+        // all chunks need to be popped, even after an error, for the next call to start clean
+        dsp_chunk_t *chunk = _queue_pop (&_queues[0]);
+        int size = chunk->nframes * chunk->fmt.channels * (int)sizeof (float);
+        if (overflow || chunk->nframes < 0 || chunk->nframes > chunk->maxframes || out + size > end) {
+            // only possible when a DSP returns more frames than it was allowed to
+            overflow = 1;
+            continue;
+        }
+        memcpy (out, chunk->buf, size);
+        out += size;
+        outframes += chunk->nframes;
+    }
+
+    if (overflow) {
+        return -1;
+    }
+    *out_ratio = _chunks[0].ratio;
+    *fmt = _chunks[nchunks - 1].fmt;
+    return outframes;
+}
+
+int
+dsp_pipeline_process (ddb_dsp_context_t *chain, float *buffer, int nframes, int maxframes, ddb_waveformat_t *fmt, float *out_ratio) {
+    _nstages = 0;
+    for (ddb_dsp_context_t *dsp = chain; dsp && _nstages < DSP_PIPELINE_MAX_STAGES; dsp = dsp->next) {
+        if (dsp->enabled) {
+            _stage_cpu_ns[_nstages] = 0;
+            _stage_frames[_nstages] = 0;
+            _stage_audio_ns[_nstages] = 0;
+            _stages[_nstages++] = dsp;
+        }
+    }
+
+    int res;
+    if (_threaded && _nstages > 1 && nframes >= DSP_PIPELINE_CHUNK_FRAMES * 2) {
+        res = _process_threaded (buffer, nframes, maxframes, fmt, out_ratio);
+    }
+    else {
+        res = _process_sequential (buffer, nframes, maxframes, fmt, out_ratio);
+    }
+
+    _update_stats ();
+    return res;
+}
+
+void
+dsp_pipeline_format_report (char *buffer, size_t size) {
+    *buffer = 0;
+    if (!_stats_mutex) {
+        return;
+    }
+    mutex_lock (_stats_mutex);
+    int n = snprintf (buffer, size, "DSP stages (%s): calls, frames, cpu msec, cpu load %% of realtime\n", _threaded ? "threaded" : "sequential");
+    for (int i = 0; i < DSP_PIPELINE_MAX_STAGES && _stats[i].id[0] && n >= 0 && n < size; i++) {
+        dsp_stage_stats_t *s = &_stats[i];
+        double load = s->audio_ns ? s->cpu_ns * 100.0 / s->audio_ns : 0;
+        n += snprintf (buffer + n, size - n, "%d %s: %" PRIu64 ", %" PRIu64 ", %.1f, %.2f%%\n", i, s->id, s->calls, s->frames, s->cpu_ns / 1000000.0, load);
+    }
+    mutex_unlock (_stats_mutex);
+}
@@ -0,0 +1,59 @@
+/*
+    DeaDBeeF -- the music player
+    Copyright (C) 2009-2023 Oleksiy Yakovenko and other contributors
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef dsppipeline_h
+#define dsppipeline_h
+
+#include <deadbeef/deadbeef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void
+dsp_pipeline_init (void);
+
+void
+dsp_pipeline_free (void);
+
+// When enabled, the enabled DSPs of the chain run on separate threads, one per stage,
+// processing consecutive chunks of each buffer in parallel.
+void
+dsp_pipeline_set_threaded (int threaded);
+
+// Runs the enabled DSPs of the chain over the float samples in `buffer`,
+// which can hold up to `maxframes` frames in the input format.
+// The output is always complete when the function returns, so no latency is added.
+// @returns number of output frames, or -1 if the output didn't fit into the buffer
+int
+dsp_pipeline_process (ddb_dsp_context_t *chain, float *buffer, int nframes, int maxframes, ddb_waveformat_t *fmt, float *out_ratio);
+
+// Formats the per-stage CPU time statistics
+void
+dsp_pipeline_format_report (char *buffer, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* dsppipeline_h */
@@ -79,6 +79,9 @@
 #include "conf.h"
 #include "volume.h"
 #include "plugins.h"
+#include "dsppipeline.h"
+#include "realtime.h"
+#include "viz.h"
 #include <deadbeef/common.h>
 #include "junklib.h"
 #ifdef OSX_APPBUNDLE
@@ -159,6 +162,10 @@ print_help (void) {
     fprintf (stdout, _("   --plugin=[PLUG]    Send commands to a specific plugin. Use PLUG=main to send commands to deadbeef itself.\n"));
     fprintf (stdout, _("                      To get plugin specific commands use --plugin=[PLUG] --help\n"));
     fprintf (stdout, _("   --plugin-list      List all available plugins including indication for plugins that support commands.\n"));
+    fprintf (stdout, _("   --memory-report    Print the playlist memory usage.\n"));
+    fprintf (stdout, _("   --lock-report      Print the playlist lock contention statistics (requires playlist.lock_stats=1).\n"));
+    fprintf (stdout, _("   --dsp-report       Print the CPU time used by each DSP stage.\n"));
+    fprintf (stdout, _("   --rt-report        Print the real-time audio state, and the allocations and lock waits on the audio thread.\n"));
 #ifdef ENABLE_NLS
     bind_textdomain_codeset (PACKAGE, "UTF-8");
 #endif
@@ -237,6 +244,50 @@ _append_response(ddb_response_t *response, char *buffer, size_t size) {
     return 0;
 }
 
+static void
+_format_lock_report (char *buffer, size_t size, int remote) {
+    pl_format_lock_report (buffer, size, remote ? 5 : 30); // the reply buffer is small
+}
+
+static void
+_format_memory_report (char *buffer, size_t size, int remote) {
+    pl_format_memory_report (buffer, size);
+}
+
+static void
+_format_dsp_report (char *buffer, size_t size, int remote) {
+    dsp_pipeline_format_report (buffer, size);
+}
+
+static void
+_format_rt_report (char *buffer, size_t size, int remote) {
+    rt_format_report (buffer, size);
+}
+
+typedef void (*report_format_fn_t) (char *buffer, size_t size, int remote);
+
+// diagnostic reports, printed by the --*-report commands
+static const struct {
+    const char *arg;
+    report_format_fn_t format;
+} _reports[] = {
+    { "--memory-report", _format_memory_report },
+    { "--lock-report", _format_lock_report },
+    { "--dsp-report", _format_dsp_report },
+    { "--rt-report", _format_rt_report },
+    { NULL, NULL }
+};
+
+static report_format_fn_t
+_find_report (const char *arg) {
+    for (int i = 0; _reports[i].arg; i++) {
+        if (!strcmp (arg, _reports[i].arg)) {
+            return _reports[i].format;
+        }
+    }
+    return NULL;
+}
+
 // this function executes server-side commands only
 // must be called only from within server
 // -1 error, program must exit with error code -1
@@ -252,6 +303,7 @@ server_exec_command_line (const char *cmdline, int len, char *sendback, int sbsi
     const char *parg = cmdline;
     const char *pend = cmdline + len;
     int queue = 0;
+    report_format_fn_t report;
     while (parg < pend) {
         if (strlen (parg) >= 2 && parg[0] == '-' && parg[1] != '-') {
             parg += strlen (parg);
@@ -452,6 +504,17 @@ server_exec_command_line (const char *cmdline, int len, char *sendback, int sbsi
             parg += parg_len + 1;
             continue;
         }
+        else if ((report = _find_report (parg)) != NULL) {
+            char out[8192];
+            report (out, sizeof (out), sendback != NULL);
+            if (sendback) {
+                snprintf (sendback, sbsize, "\1%s", out);
+            }
+            else {
+                fwrite (out, 1, strlen (out), stdout);
+                return 1; // exit
+            }
+        }
         else if (!strcmp(parg, "--plugin-list")) {
             char out[2048];
             int out_pos = 0;
@@ -821,6 +884,19 @@ save_resume_state (void) {
     conf_set_int ("resume.paused", paused);
 }
 
+// Plugins built before the batched event existed get the tracks one by one
+static void
+_send_tracksinfochanged_per_track (DB_plugin_t *plug, ddb_event_tracks_t *ev) {
+    for (int i = 0; i < ev->count; i++) {
+        ddb_event_track_t track_ev = {
+            .ev.event = DB_EV_TRACKINFOCHANGED,
+            .ev.size = sizeof (ddb_event_track_t),
+            .track = ev->tracks[i],
+        };
+        plug->message (DB_EV_TRACKINFOCHANGED, (uintptr_t)&track_ev, 0, 0);
+    }
+}
+
 void
 player_mainloop (void) {
     for (;;) {
@@ -834,6 +910,10 @@ player_mainloop (void) {
             DB_plugin_t **plugs = plug_get_list ();
             for (int n = 0; plugs[n]; n++) {
                 if (plugs[n]->message) {
+                    if (msg == DB_EV_TRACKSINFOCHANGED && plugs[n]->api_vmajor == 1 && plugs[n]->api_vminor < 17) {
+                        _send_tracksinfochanged_per_track (plugs[n], (ddb_event_tracks_t *)ctx);
+                        continue;
+                    }
                     plugs[n]->message (msg, ctx, p1, p2);
                 }
             }
@@ -889,7 +969,9 @@ player_mainloop (void) {
                     break;
                 case DB_EV_CONFIGCHANGED:
                     conf_save ();
+                    rt_configchanged ();
                     streamer_configchanged ();
+                    viz_configchanged ();
                     pl_configchanged ();
                     junk_configchanged ();
                     break;
@@ -1469,6 +1551,9 @@ main (int argc, char *argv[]) {
     pl_init ();
     conf_init ();
     conf_load (); // required by some plugins at startup
+    pl_set_compact_storage (conf_get_int ("playlist.compact_storage", 1));
+    pl_set_lock_stats_enabled (conf_get_int ("playlist.lock_stats", 0));
+    rt_configchanged ();
 
     if (use_gui_plugin[0]) {
         conf_set_str ("gui_plugin", use_gui_plugin);
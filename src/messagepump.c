@@ -49,9 +49,25 @@ static message_t *mqtail;
 static uintptr_t mutex;
 static uintptr_t cond;
 
+// DB_EV_TRACKINFOCHANGED events are coalesced: the first changed track queues a DB_EV_TRACKSINFOCHANGED event,
+// and the tracks changed while that message is the last one in the queue are added to it.
+// Once another message is queued after it, the next changed track starts a new batch,
+// so that the changes are not delivered before the messages which preceded them.
+static ddb_event_tracks_t *changed_event; // the batch which is open for adding, each track holds a reference
+static message_t *changed_msg; // the message delivering changed_event, NULL if the queue was full
+static int changed_reserved;
+static uint32_t *changed_hash; // open addressing, index+1 into changed_event->tracks, 0 for empty slots
+static uint32_t changed_hash_size;
+
 static void
 messagepump_reset (void);
 
+static void
+_changed_tracks_close (void);
+
+static void
+_changed_tracks_release (playItem_t **tracks, int count);
+
 int
 messagepump_init (void) {
     messagepump_reset ();
@@ -71,6 +87,7 @@ messagepump_free (void) {
         case DB_EV_SONGSTARTED:
         case DB_EV_SONGFINISHED:
         case DB_EV_TRACKINFOCHANGED:
+        case DB_EV_TRACKSINFOCHANGED:
         case DB_EV_CURSOR_MOVED:
         case DB_EV_SEEKED:
             assert (0);
@@ -78,7 +95,12 @@ messagepump_free (void) {
     }
 
     messagepump_reset ();
+    ddb_event_t *ev = (ddb_event_t *)changed_event;
+    _changed_tracks_close ();
     mutex_unlock (mutex);
+    if (ev) {
+        messagepump_event_free (ev);
+    }
     mutex_free (mutex);
     cond_free (cond);
     mutex = 0;
@@ -96,15 +118,10 @@ messagepump_reset (void) {
     }
 }
 
-int
-messagepump_push (uint32_t id, uintptr_t ctx, uint32_t p1, uint32_t p2) {
-    mutex_lock (mutex);
+// called with the mutex locked
+static int
+_messagepump_push_locked (uint32_t id, uintptr_t ctx, uint32_t p1, uint32_t p2) {
     if (!mfree) {
-        mutex_unlock (mutex);
-        //fprintf (stderr, "WARNING: message queue is full! message ignored (%d %p %d %d)\n", id, (void*)ctx, p1, p2);
-        if (id >= DB_EV_FIRST && ctx) {
-            messagepump_event_free ((ddb_event_t *)ctx);
-        }
         return -1;
     }
     message_t *msg = mfree;
@@ -122,7 +139,112 @@ messagepump_push (uint32_t id, uintptr_t ctx, uint32_t p1, uint32_t p2) {
     msg->ctx = ctx;
     msg->p1 = p1;
     msg->p2 = p2;
+    return 0;
+}
+
+int
+messagepump_push (uint32_t id, uintptr_t ctx, uint32_t p1, uint32_t p2) {
+    mutex_lock (mutex);
+    // the changed tracks which didn't fit into the queue go before this message, if both fit now
+    if (changed_event && !changed_msg && mfree && mfree->next) {
+        _messagepump_push_locked (DB_EV_TRACKSINFOCHANGED, (uintptr_t)changed_event, 0, 0);
+        changed_msg = mqtail;
+    }
+    if (_messagepump_push_locked (id, ctx, p1, p2) < 0) {
+        mutex_unlock (mutex);
+        //fprintf (stderr, "WARNING: message queue is full! message ignored (%d %p %d %d)\n", id, (void*)ctx, p1, p2);
+        if (id >= DB_EV_FIRST && ctx) {
+            messagepump_event_free ((ddb_event_t *)ctx);
+        }
+        return -1;
+    }
+    mutex_unlock (mutex);
+    cond_signal (cond);
+    return 0;
+}
+
+static uint32_t
+_changed_hash_slot (playItem_t *track) {
+    uintptr_t p = (uintptr_t)track;
+    uint32_t mask = changed_hash_size - 1;
+    uint32_t h = ((uint32_t)(p >> 4) * 2654435761u) & mask;
+    while (changed_hash[h] && (playItem_t *)changed_event->tracks[changed_hash[h] - 1] != track) {
+        h = (h + 1) & mask;
+    }
+    return h;
+}
+
+// called with the mutex locked
+// returns 0 if the track was added, and the reference was taken over, or 1 if it was already there
+static int
+_changed_tracks_add (playItem_t *track) {
+    int count = changed_event->count;
+    if (count == changed_reserved) {
+        changed_reserved = changed_reserved ? changed_reserved * 2 : 64;
+        changed_event->tracks = realloc (changed_event->tracks, changed_reserved * sizeof (DB_playItem_t *));
+        free (changed_hash);
+        changed_hash_size = changed_reserved * 2;
+        changed_hash = calloc (changed_hash_size, sizeof (uint32_t));
+        for (int i = 0; i < count; i++) {
+            changed_hash[_changed_hash_slot ((playItem_t *)changed_event->tracks[i])] = i + 1;
+        }
+    }
+
+    uint32_t h = _changed_hash_slot (track);
+    if (changed_hash[h]) {
+        return 1;
+    }
+    changed_event->tracks[count] = DB_PLAYITEM (track);
+    changed_event->count = count + 1;
+    changed_hash[h] = count + 1;
+    return 0;
+}
+
+// called with the mutex locked
+// Stops adding to the current batch, which stays owned by its message, or by the caller if it wasn't queued
+static void
+_changed_tracks_close (void) {
+    free (changed_hash);
+    changed_hash = NULL;
+    changed_hash_size = 0;
+    changed_reserved = 0;
+    changed_event = NULL;
+    changed_msg = NULL;
+}
+
+static void
+_changed_tracks_release (playItem_t **tracks, int count) {
+    for (int i = 0; i < count; i++) {
+        pl_item_unref (tracks[i]);
+    }
+    free (tracks);
+}
+
+static int
+_messagepump_push_trackinfochanged (ddb_event_track_t *ev) {
+    playItem_t *track = (playItem_t *)ev->track;
+    ev->track = NULL;
+    messagepump_event_free ((ddb_event_t *)ev);
+
+    mutex_lock (mutex);
+    if (changed_msg && changed_msg != mqtail) {
+        // other messages were queued after the batch
+        _changed_tracks_close ();
+    }
+    if (!changed_event) {
+        changed_event = (ddb_event_tracks_t *)messagepump_event_alloc (DB_EV_TRACKSINFOCHANGED);
+        // if the queue is full, the batch is queued with the next message, or delivered when the queue drains
+        if (!_messagepump_push_locked (DB_EV_TRACKSINFOCHANGED, (uintptr_t)changed_event, 0, 0)) {
+            changed_msg = mqtail;
+        }
+    }
+    int duplicate = _changed_tracks_add (track);
     mutex_unlock (mutex);
+
+    // the unref may need pl_lock, which must not be taken inside the messagepump lock
+    if (duplicate) {
+        pl_item_unref (track);
+    }
     cond_signal (cond);
     return 0;
 }
@@ -133,17 +255,46 @@ messagepump_wait (void) {
     mutex_unlock (mutex);
 }
 
+// A batch of a single track is delivered as DB_EV_TRACKINFOCHANGED, like before the coalescing
+static void
+_changed_tracks_deliver (uint32_t *id, uintptr_t *ctx) {
+    ddb_event_tracks_t *batch = (ddb_event_tracks_t *)*ctx;
+    if (batch->count != 1) {
+        return;
+    }
+    ddb_event_track_t *ev = (ddb_event_track_t *)messagepump_event_alloc (DB_EV_TRACKINFOCHANGED);
+    ev->track = batch->tracks[0];
+    batch->count = 0; // the reference moves to the new event
+    messagepump_event_free ((ddb_event_t *)batch);
+    *id = DB_EV_TRACKINFOCHANGED;
+    *ctx = (uintptr_t)ev;
+}
+
 int
 messagepump_pop (uint32_t *id, uintptr_t *ctx, uint32_t *p1, uint32_t *p2) {
     mutex_lock (mutex);
     if (!mqueue) {
+        if (!changed_event) {
+            mutex_unlock (mutex);
+            return -1;
+        }
+        // the batch couldn't be queued earlier
+        *id = DB_EV_TRACKSINFOCHANGED;
+        *ctx = (uintptr_t)changed_event;
+        *p1 = 0;
+        *p2 = 0;
+        _changed_tracks_close ();
         mutex_unlock (mutex);
-        return -1;
+        _changed_tracks_deliver (id, ctx);
+        return 0;
     }
     *id = mqueue->id;
     *ctx = mqueue->ctx;
     *p1 = mqueue->p1;
     *p2 = mqueue->p2;
+    if (mqueue == changed_msg) {
+        _changed_tracks_close ();
+    }
     message_t *next = mqueue->next;
     mqueue->next = mfree;
     mfree = mqueue;
@@ -152,12 +303,15 @@ messagepump_pop (uint32_t *id, uintptr_t *ctx, uint32_t *p1, uint32_t *p2) {
         mqtail = NULL;
     }
     mutex_unlock (mutex);
+    if (*id == DB_EV_TRACKSINFOCHANGED && *ctx) {
+        _changed_tracks_deliver (id, ctx);
+    }
     return 0;
 }
 
 int
 messagepump_hasmessages (void) {
-    return mqueue ? 1 : 0;
+    return mqueue || changed_event ? 1 : 0;
 }
 
 ddb_event_t *
@@ -177,6 +331,9 @@ messagepump_event_alloc (uint32_t id) {
     case DB_EV_SEEKED:
         sz = sizeof (ddb_event_playpos_t);
         break;
+    case DB_EV_TRACKSINFOCHANGED:
+        sz = sizeof (ddb_event_tracks_t);
+        break;
     default:
         trace ("Invalid event %d to use with messagepump_event_alloc, use sendmessage instead\n", id);
         return NULL;
@@ -221,12 +378,22 @@ messagepump_event_free (ddb_event_t *ev) {
             }
         }
         break;
+    case DB_EV_TRACKSINFOCHANGED:
+        {
+            ddb_event_tracks_t *tc = (ddb_event_tracks_t*)ev;
+            _changed_tracks_release ((playItem_t **)tc->tracks, tc->count);
+        }
+        break;
     }
     free (ev);
 }
 
 int
 messagepump_push_event (ddb_event_t *ev, uint32_t p1, uint32_t p2) {
+    // only the generic content changes are coalesced, e.g. not the playqueue or selection changes
+    if (ev->event == DB_EV_TRACKINFOCHANGED && p1 == 0 && p2 == 0 && ((ddb_event_track_t *)ev)->track != NULL) {
+        return _messagepump_push_trackinfochanged ((ddb_event_track_t *)ev);
+    }
     return messagepump_push (ev->event, (uintptr_t)ev, p1, p2);
 }
 
@@ -78,6 +78,7 @@ metacache_find_in_bucket (uint32_t h, const char *value, size_t len) {
 static int n_strings = 0;
 static int n_inserts = 0;
 static int n_buckets = 0;
+static size_t n_bytes = 0;
 
 const char *
 metacache_add_value (const char *value, size_t len) {
@@ -101,6 +102,7 @@ metacache_add_value (const char *value, size_t len) {
     data->next = bucket->chain;
     bucket->chain = data;
     n_strings++;
+    n_bytes += sizeof (metacache_str_t) + len;
     return data->str;
 }
 
@@ -125,6 +127,8 @@ metacache_remove_value (const char *value, size_t valuesize) {
                 else {
                     bucket->chain = chain->next;
                 }
+                n_strings--;
+                n_bytes -= sizeof (metacache_str_t) + chain->value_length;
                 free (chain);
             }
             break;
@@ -170,3 +174,9 @@ metacache_get_value (const char *value, size_t len) {
 
     return NULL;
 }
+
+void
+metacache_get_stats (size_t *count, size_t *bytes) {
+    *count = n_strings;
+    *bytes = n_bytes;
+}
@@ -59,4 +59,8 @@ metacache_ref (const char *str);
 void
 metacache_unref (const char *str);
 
+// Returns the number of unique strings, and the memory used by them
+void
+metacache_get_stats (size_t *count, size_t *bytes);
+
 #endif
@@ -48,6 +48,7 @@
 #include <limits.h>
 #include <errno.h>
 #include <math.h>
+#include <inttypes.h>
 #include "buffered_file_writer.h"
 #include "gettext.h"
 #include "playlist.h"
@@ -70,7 +71,9 @@
 #include "playqueue.h"
 #include "sort.h"
 #include "cueutil.h"
+#include "decoderdispatch.h"
 #include "playmodes.h"
+#include "slaballoc.h"
 
 // disable custom title function, until we have new title formatting (0.7)
 #define DISABLE_CUSTOM_TITLE
@@ -82,6 +85,9 @@
 #if DETECT_PL_LOCK_RC
 #include <pthread.h>
 #endif
+#ifndef _WIN32
+#include <dlfcn.h>
+#endif
 
 // file format revision history
 // 1.1->1.2 changelog:
@@ -109,11 +115,14 @@ static playlist_t *_current_playlist = NULL; // current playlist
 static int _plt_loading = 0; // disable sending event about playlist switch, config regen, etc
 
 #if !DISABLE_LOCKING
-static uintptr_t _playlist_mutex;
+// pl_lock takes the write side, pl_read_lock the read side
+static uintptr_t _playlist_rwlock;
 #endif
 
 #define LOCK {pl_lock();}
 #define UNLOCK {pl_unlock();}
+#define READ_LOCK {pl_read_lock();}
+#define READ_UNLOCK {pl_read_unlock();}
 
 // used at startup to prevent crashes
 static playlist_t _dummy_playlist = {
@@ -170,7 +179,7 @@ pl_init (void) {
     }
     _current_playlist = &_dummy_playlist;
 #if !DISABLE_LOCKING
-    _playlist_mutex = mutex_create ();
+    _playlist_rwlock = rwlock_create ();
 #endif
     return 0;
 }
@@ -198,15 +207,196 @@ pl_free (void) {
     }
     _plt_loading = 0;
     UNLOCK;
+    cue_cache_free ();
 #if !DISABLE_LOCKING
-    if (_playlist_mutex) {
-        mutex_free (_playlist_mutex);
-        _playlist_mutex = 0;
+    if (_playlist_rwlock) {
+        rwlock_free (_playlist_rwlock);
+        _playlist_rwlock = 0;
     }
 #endif
     _current_playlist = NULL;
 }
 
+#pragma mark - Lock contention statistics
+
+// Per call site wait and hold time histograms of pl_lock.
+// The call sites are identified by the return addresses of pl_lock,
+// and the hold time is attributed to the site which took the lock first.
+// Only the write side is measured.
+// Everything except _lock_stats_enabled is protected by the write lock.
+#define LOCK_STATS_SITES 512
+#define LOCK_STATS_BUCKETS 16 // <1us, <2us, <4us, ... >=16ms
+
+typedef struct {
+    void *site;
+    uint64_t count;
+    uint64_t wait_total;
+    uint64_t hold_total;
+    uint32_t wait_hist[LOCK_STATS_BUCKETS];
+    uint32_t hold_hist[LOCK_STATS_BUCKETS];
+} pl_lock_site_stats_t;
+
+static int _lock_stats_enabled;
+static pl_lock_site_stats_t *_lock_stats;
+static pl_lock_site_stats_t *_lock_holder;
+static uint64_t _lock_acquire_time;
+
+// monotonic, so that wall clock adjustments don't end up in the histograms
+static uint64_t
+_lock_stats_time_usec (void) {
+#ifdef CLOCK_MONOTONIC
+    struct timespec ts;
+    if (!clock_gettime (CLOCK_MONOTONIC, &ts)) {
+        return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    }
+#endif
+    struct timeval tm;
+    gettimeofday (&tm, NULL);
+    return (uint64_t)tm.tv_sec * 1000000 + tm.tv_usec;
+}
+
+static int
+_lock_stats_bucket (uint64_t usec) {
+    int bucket = 0;
+    while (usec && bucket < LOCK_STATS_BUCKETS - 1) {
+        usec >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+static pl_lock_site_stats_t *
+_lock_stats_site (void *site) {
+    uintptr_t h = ((uintptr_t)site >> 2) * 2654435761u;
+    for (int i = 0; i < LOCK_STATS_SITES; i++) {
+        pl_lock_site_stats_t *s = &_lock_stats[(h + i) & (LOCK_STATS_SITES - 1)];
+        if (s->site == site) {
+            return s;
+        }
+        if (!s->site) {
+            s->site = site;
+            return s;
+        }
+    }
+    return NULL;
+}
+
+// called with the write lock taken, not for the recursive calls
+static void
+_lock_stats_acquired (void *site, uint64_t start) {
+    uint64_t now = _lock_stats_time_usec ();
+    _lock_holder = _lock_stats_site (site);
+    _lock_acquire_time = now;
+    if (_lock_holder) {
+        _lock_holder->count++;
+        _lock_holder->wait_total += now - start;
+        _lock_holder->wait_hist[_lock_stats_bucket (now - start)]++;
+    }
+}
+
+// called with the write lock taken, before the last unlock
+static void
+_lock_stats_released (void) {
+    if (!_lock_holder) {
+        return;
+    }
+    uint64_t hold = _lock_stats_time_usec () - _lock_acquire_time;
+    _lock_holder->hold_total += hold;
+    _lock_holder->hold_hist[_lock_stats_bucket (hold)]++;
+    _lock_holder = NULL;
+}
+
+void
+pl_set_lock_stats_enabled (int enable) {
+    pl_lock ();
+    if (enable && !_lock_stats) {
+        _lock_stats = calloc (LOCK_STATS_SITES, sizeof (pl_lock_site_stats_t));
+    }
+    _lock_stats_enabled = enable;
+    pl_unlock ();
+}
+
+static int
+_lock_stats_cmp (const void *a, const void *b) {
+    const pl_lock_site_stats_t *sa = a;
+    const pl_lock_site_stats_t *sb = b;
+    uint64_t ta = sa->wait_total + sa->hold_total;
+    uint64_t tb = sb->wait_total + sb->hold_total;
+    if (ta != tb) {
+        return ta < tb ? 1 : -1;
+    }
+    // the unused slots go last
+    return (sa->site == NULL) - (sb->site == NULL);
+}
+
+static int
+_lock_stats_format_hist (char *buffer, size_t size, const uint32_t *hist) {
+    int n = 0;
+    for (int i = 0; i < LOCK_STATS_BUCKETS && n >= 0 && n < size; i++) {
+        n += snprintf (buffer + n, size - n, "%s%u", i ? " " : "", hist[i]);
+    }
+    return n;
+}
+
+void
+pl_format_lock_report (char *buffer, size_t size, int max_sites) {
+    *buffer = 0;
+    pl_lock ();
+    if (!_lock_stats) {
+        pl_unlock ();
+        snprintf (buffer, size, "lock statistics are disabled, set playlist.lock_stats=1 to enable\n");
+        return;
+    }
+    pl_lock_site_stats_t *sorted = malloc (LOCK_STATS_SITES * sizeof (pl_lock_site_stats_t));
+    memcpy (sorted, _lock_stats, LOCK_STATS_SITES * sizeof (pl_lock_site_stats_t));
+    pl_unlock ();
+
+    qsort (sorted, LOCK_STATS_SITES, sizeof (pl_lock_site_stats_t), _lock_stats_cmp);
+
+    int n = snprintf (buffer, size, "pl_lock call sites: count, wait usec, hold usec, wait/hold histograms (log2 usec buckets)\n");
+    for (int i = 0; i < LOCK_STATS_SITES && i < max_sites && sorted[i].site && n >= 0 && n < size; i++) {
+        pl_lock_site_stats_t *s = &sorted[i];
+        char name[200];
+#ifndef _WIN32
+        Dl_info info;
+        if (dladdr (s->site, &info) && info.dli_sname) {
+            snprintf (name, sizeof (name), "%s+0x%lx", info.dli_sname, (unsigned long)((char *)s->site - (char *)info.dli_saddr));
+        }
+        else
+#endif
+        {
+            snprintf (name, sizeof (name), "%p", s->site);
+        }
+        n += snprintf (buffer + n, size - n, "%s: %" PRIu64 ", %" PRIu64 ", %" PRIu64 "\n  wait: ", name, s->count, s->wait_total, s->hold_total);
+        if (n < 0 || n >= size) {
+            break;
+        }
+        n += _lock_stats_format_hist (buffer + n, size - n, s->wait_hist);
+        if (n < 0 || n >= size) {
+            break;
+        }
+        n += snprintf (buffer + n, size - n, "\n  hold: ");
+        if (n < 0 || n >= size) {
+            break;
+        }
+        n += _lock_stats_format_hist (buffer + n, size - n, s->hold_hist);
+        if (n < 0 || n >= size) {
+            break;
+        }
+        n += snprintf (buffer + n, size - n, "\n");
+    }
+    free (sorted);
+}
+
+#pragma mark -
+
+// The rwlock itself is not recursive, so the nesting is counted per thread,
+// and only the outermost pl_lock / pl_read_lock takes it.
+// pl_read_lock under pl_lock does nothing, since the thread already has exclusive access.
+// pl_lock must not be called under pl_read_lock: the write lock would wait for the thread's own read lock.
+static __thread int _lock_depth;
+static __thread int _lock_read_depth;
+
 #if DEBUG_LOCKING
 volatile int pl_lock_cnt = 0;
 #endif
@@ -218,7 +408,17 @@ pthread_t pl_lock_tid = 0;
 void
 pl_lock (void) {
 #if !DISABLE_LOCKING
-    mutex_lock (_playlist_mutex);
+    assert (!_lock_read_depth);
+    if (_lock_depth++ == 0) {
+        if (_lock_stats_enabled) {
+            uint64_t start = _lock_stats_time_usec ();
+            rwlock_wrlock (_playlist_rwlock);
+            _lock_stats_acquired (__builtin_return_address (0), start);
+        }
+        else {
+            rwlock_wrlock (_playlist_rwlock);
+        }
+    }
 #if DETECT_PL_LOCK_RC
     pl_lock_tid = pthread_self ();
     tids[ntids++] = pl_lock_tid;
@@ -245,7 +445,12 @@ pl_unlock (void) {
         pl_lock_tid = 0;
     }
 #endif
-    mutex_unlock (_playlist_mutex);
+    if (_lock_depth == 1 && _lock_stats_enabled) {
+        _lock_stats_released ();
+    }
+    if (--_lock_depth == 0) {
+        rwlock_unlock (_playlist_rwlock);
+    }
 #if DEBUG_LOCKING
     pl_lock_cnt--;
     printf ("pcnt: %d\n", pl_lock_cnt);
@@ -253,6 +458,30 @@ pl_unlock (void) {
 #endif
 }
 
+void
+pl_read_lock (void) {
+#if !DISABLE_LOCKING
+    if (_lock_depth > 0) {
+        return;
+    }
+    if (_lock_read_depth++ == 0) {
+        rwlock_rdlock (_playlist_rwlock);
+    }
+#endif
+}
+
+void
+pl_read_unlock (void) {
+#if !DISABLE_LOCKING
+    if (_lock_depth > 0) {
+        return;
+    }
+    if (--_lock_read_depth == 0) {
+        rwlock_unlock (_playlist_rwlock);
+    }
+#endif
+}
+
 static void
 pl_item_free (playItem_t *it);
 
@@ -662,15 +891,15 @@ plt_get_idx_of (playlist_t *plt) {
 
 int
 plt_get_title (playlist_t *p, char *buffer, int bufsize) {
-    LOCK;
+    READ_LOCK;
     if (!buffer) {
         int l = (int)strlen (p->title);
-        UNLOCK;
+        READ_UNLOCK;
         return l;
     }
     strncpy (buffer, p->title, bufsize);
     buffer[bufsize-1] = 0;
-    UNLOCK;
+    READ_UNLOCK;
     return 0;
 }
 
@@ -1089,103 +1318,62 @@ plt_insert_file_int (
 
     // handle cue files
     if (!strcasecmp (eol, "cue")) {
-        playItem_t *inserted = plt_load_cue_file(plt, after, fname, NULL, NULL, 0);
+        playItem_t *inserted = plt_load_cue_file(plt, after, fname, NULL, NULL);
         if (callback_with_result) {
             callback_with_result(inserted ? DDB_INSERT_FILE_RESULT_SUCCESS : DDB_INSERT_FILE_RESULT_CUESHEET_ERROR, fname, user_data);
         }
         return inserted;
     }
 
-    int filter_done = 0;
-    int file_recognized = 0;
-
-    DB_decoder_t **decoders = plug_get_decoder_list ();
-    // match by decoder
-    for (int i = 0; decoders[i]; i++) {
-        if (decoders[i]->exts && decoders[i]->insert) {
-            const char **exts = decoders[i]->exts;
-            for (int e = 0; exts[e]; e++) {
-                if (!strcasecmp (exts[e], eol) || !strcmp (exts[e], "*")) {
-                    if (!filter_done) {
-                        ddb_file_found_data_t dt;
-                        dt.filename = fname;
-                        dt.plt = (ddb_playlist_t *)plt;
-                        dt.is_dir = 0;
-                        if (fileadd_filter_test (&dt) < 0) {
-                            return NULL;
-                        }
-                        filter_done = 1;
-                    }
-
-                    file_recognized = 1;
+    DB_decoder_t *decoders[DECODER_DISPATCH_MAX];
+    int ambiguous = 0;
+    int num_decoders = decoder_dispatch_find (fn, eol, decoders, &ambiguous);
+    int file_recognized = num_decoders > 0;
 
-                    playItem_t *inserted = (playItem_t *)decoders[i]->insert ((ddb_playlist_t *)plt, DB_PLAYITEM (after), fname);
-                    if (inserted != NULL) {
-                        if (callback && callback (inserted, user_data) < 0) {
-                            *pabort = 1;
-                        }
-                        else if (callback_with_result && callback_with_result(DDB_INSERT_FILE_RESULT_SUCCESS, fname, user_data) < 0) {
-                            *pabort = 1;
-                        }
-                        if (file_add_listeners) {
-                            ddb_fileadd_data_t d;
-                            memset (&d, 0, sizeof (d));
-                            d.visibility = visibility;
-                            d.plt = (ddb_playlist_t *)plt;
-                            d.track = (ddb_playItem_t *)inserted;
-                            for (ddb_fileadd_listener_t *l = file_add_listeners; l; l = l->next) {
-                                if (pabort && l->callback (&d, l->user_data) < 0) {
-                                    *pabort = 1;
-                                    break;
-                                }
-                            }
-                        }
-                        return inserted;
-                    }
-                }
-            }
+    if (file_recognized) {
+        ddb_file_found_data_t dt;
+        dt.filename = fname;
+        dt.plt = (ddb_playlist_t *)plt;
+        dt.is_dir = 0;
+        if (fileadd_filter_test (&dt) < 0) {
+            return NULL;
         }
-        if (decoders[i]->prefixes && decoders[i]->insert) {
-            const char **prefixes = decoders[i]->prefixes;
-            for (int e = 0; prefixes[e]; e++) {
-                if (!strncasecmp (prefixes[e], fn, strlen(prefixes[e])) && *(fn + strlen (prefixes[e])) == '.') {
-                    if (!filter_done) {
-                        ddb_file_found_data_t dt;
-                        dt.filename = fname;
-                        dt.plt = (ddb_playlist_t *)plt;
-                        dt.is_dir = 0;
-                        if (fileadd_filter_test (&dt) < 0) {
-                            return NULL;
-                        }
-                        filter_done = 1;
-                    }
+        // only read the file when the extension doesn't tell which decoder to use
+        if (ambiguous) {
+            num_decoders = decoder_dispatch_sniff (fname, decoders, num_decoders, 0);
+        }
+    }
 
-                    file_recognized = 1;
-                    playItem_t *inserted = (playItem_t *)decoders[i]->insert ((ddb_playlist_t *)plt, DB_PLAYITEM (after), fname);
-                    if (inserted != NULL) {
-                        if (callback && callback (inserted, user_data) < 0) {
-                            *pabort = 1;
-                        }
-                        else if (callback_with_result && callback_with_result(DDB_INSERT_FILE_RESULT_SUCCESS, fname, user_data) < 0) {
-                            *pabort = 1;
-                        }
-                        if (file_add_listeners) {
-                            ddb_fileadd_data_t d;
-                            memset (&d, 0, sizeof (d));
-                            d.visibility = visibility;
-                            d.plt = (ddb_playlist_t *)plt;
-                            d.track = (ddb_playItem_t *)inserted;
-                            for (ddb_fileadd_listener_t *l = file_add_listeners; l; l = l->next) {
-                                if (l->callback (&d, l->user_data) < 0) {
-                                    *pabort = 1;
-                                    break;
-                                }
-                            }
-                        }
-                        return inserted;
+    int sniffed = ambiguous;
+    for (int i = 0; i < num_decoders; i++) {
+        playItem_t *inserted = (playItem_t *)decoders[i]->insert ((ddb_playlist_t *)plt, DB_PLAYITEM (after), fname);
+        if (inserted == NULL && !sniffed) {
+            // the decoder matching the extension failed, the file might be misnamed:
+            // try the decoder matching the content next, before the wildcard decoders
+            sniffed = 1;
+            num_decoders = decoder_dispatch_sniff (fname, decoders, num_decoders, i + 1);
+        }
+        if (inserted != NULL) {
+            if (callback && callback (inserted, user_data) < 0) {
+                *pabort = 1;
+            }
+            else if (callback_with_result && callback_with_result(DDB_INSERT_FILE_RESULT_SUCCESS, fname, user_data) < 0) {
+                *pabort = 1;
+            }
+            if (file_add_listeners) {
+                ddb_fileadd_data_t d;
+                memset (&d, 0, sizeof (d));
+                d.visibility = visibility;
+                d.plt = (ddb_playlist_t *)plt;
+                d.track = (ddb_playItem_t *)inserted;
+                for (ddb_fileadd_listener_t *l = file_add_listeners; l; l = l->next) {
+                    if (pabort && l->callback (&d, l->user_data) < 0) {
+                        *pabort = 1;
+                        break;
                     }
                 }
             }
+            return inserted;
         }
     }
     if (file_recognized) {
@@ -1395,12 +1583,14 @@ plt_insert_dir_int (
     char fullname[PATH_MAX];
     char fulldir[PATH_MAX];
 
+    cue_dir_index_t *dir = ncuefiles ? cue_dir_index_alloc (namelist, n) : NULL;
+
     // try loading cuesheets first
     for (int c = 0; c < ncuefiles; c++) {
         int i = cuefiles[c];
         _get_fullname_and_dir (fullname, sizeof (fullname), fulldir, sizeof(fulldir), vfs, dirname, namelist[i]->d_name);
 
-        playItem_t *inserted = plt_load_cue_file (plt, after, fullname, fulldir, namelist, n);
+        playItem_t *inserted = plt_load_cue_file (plt, after, fullname, fulldir, dir);
         namelist[i]->d_name[0] = 0;
 
         if (inserted) {
@@ -1411,6 +1601,10 @@ plt_insert_dir_int (
         }
     }
 
+    if (dir) {
+        cue_dir_index_free (dir);
+    }
+
     // load the rest of the files
     if (!pabort || !*pabort) {
         for (int i = 0; i < n; i++) {
@@ -1558,35 +1752,35 @@ plt_get_item_count (playlist_t *plt, int iter) {
 
 int
 pl_getcount (int iter) {
-    LOCK;
+    READ_LOCK;
     if (!_current_playlist) {
-        UNLOCK;
+        READ_UNLOCK;
         return 0;
     }
 
     int cnt = _current_playlist->count[iter];
-    UNLOCK;
+    READ_UNLOCK;
     return cnt;
 }
 
 int
 plt_getselcount (playlist_t *playlist) {
-    LOCK;
+    READ_LOCK;
     int cnt = 0;
     for (playItem_t *it = playlist->head[PL_MAIN]; it; it = it->next[PL_MAIN]) {
         if (it->selected) {
             cnt++;
         }
     }
-    UNLOCK;
+    READ_UNLOCK;
     return cnt;
 }
 
 int
 pl_getselcount (void) {
-    LOCK;
+    READ_LOCK;
     int cnt = plt_getselcount (_current_playlist);
-    UNLOCK;
+    READ_UNLOCK;
     return cnt;
 }
 
@@ -1623,7 +1817,7 @@ pl_get_for_idx (int idx) {
 
 int
 plt_get_item_idx (playlist_t *playlist, playItem_t *it, int iter) {
-    LOCK;
+    READ_LOCK;
     playItem_t *c = playlist->head[iter];
     int idx = 0;
     while (c && c != it) {
@@ -1631,10 +1825,10 @@ plt_get_item_idx (playlist_t *playlist, playItem_t *it, int iter) {
         idx++;
     }
     if (!c) {
-        UNLOCK;
+        READ_UNLOCK;
         return -1;
     }
-    UNLOCK;
+    READ_UNLOCK;
     return idx;
 }
 
@@ -1645,9 +1839,9 @@ pl_get_idx_of (playItem_t *it) {
 
 int
 pl_get_idx_of_iter (playItem_t *it, int iter) {
-    LOCK;
+    READ_LOCK;
     int idx = plt_get_item_idx (_current_playlist, it, iter);
-    UNLOCK;
+    READ_UNLOCK;
     return idx;
 }
 
@@ -1745,15 +1939,83 @@ pl_item_copy (playItem_t *out, playItem_t *it) {
     UNLOCK;
 }
 
+#define ITEMS_PER_SLAB 1024
+
+// compact storage of items, protected by pl_lock
+static int _compact_storage;
+static slab_allocator_t *_item_allocator;
+
+void
+pl_set_compact_storage (int enable) {
+    LOCK;
+    _compact_storage = enable;
+    if (enable && !_item_allocator) {
+        _item_allocator = slab_allocator_create (sizeof (playItem_t), ITEMS_PER_SLAB);
+    }
+    UNLOCK;
+}
+
 playItem_t *
 pl_item_alloc (void) {
-    playItem_t *it = malloc (sizeof (playItem_t));
-    memset (it, 0, sizeof (playItem_t));
+    playItem_t *it;
+    LOCK;
+    it = _compact_storage ? slab_alloc (_item_allocator) : NULL;
+    if (it) {
+        it->slab_allocated = 1;
+    }
+    else {
+        it = calloc (1, sizeof (playItem_t));
+        if (!it) {
+            UNLOCK;
+            return NULL;
+        }
+    }
     it->_duration = -1;
     it->_refc = 1;
+    pl_item_set_modified (it);
+    UNLOCK;
     return it;
 }
 
+void
+pl_format_memory_report (char *buffer, size_t size) {
+    LOCK;
+    int playlists = 0;
+    int items = 0;
+    int meta_nodes = 0;
+    for (playlist_t *plt = _playlists_head; plt; plt = plt->next) {
+        playlists++;
+        for (playItem_t *it = plt->head[PL_MAIN]; it; it = it->next[PL_MAIN]) {
+            items++;
+            for (DB_metaInfo_t *m = it->meta; m; m = m->next) {
+                meta_nodes++;
+            }
+        }
+    }
+
+    size_t strings_count, strings_bytes;
+    metacache_get_stats (&strings_count, &strings_bytes);
+
+    int n = snprintf (buffer, size,
+        "playlists: %d\n"
+        "items in playlists: %d (%d bytes each)\n"
+        "metadata fields: %d (%d bytes each)\n"
+        "unique metadata strings: %zu (%zu bytes)\n"
+        "compact storage: %s\n",
+        playlists, items, (int)sizeof (playItem_t), meta_nodes, (int)sizeof (DB_metaInfo_t), strings_count, strings_bytes,
+        _compact_storage ? "enabled" : "disabled");
+
+    slab_allocator_stats_t stats;
+    if (_item_allocator && n >= 0 && n < size) {
+        slab_allocator_get_stats (_item_allocator, &stats);
+        n += snprintf (buffer + n, size - n, "item slabs: %zu used, %zu free, %zu bytes\n", stats.objects_used, stats.objects_free, stats.bytes_allocated);
+    }
+    if (n >= 0 && n < size && !pl_meta_get_allocator_stats (&stats)) {
+        snprintf (buffer + n, size - n, "metadata slabs: %zu used, %zu free, %zu bytes\n", stats.objects_used, stats.objects_free, stats.bytes_allocated);
+    }
+    UNLOCK;
+}
+
 playItem_t *
 pl_item_alloc_init (const char *fname, const char *decoder_id) {
     playItem_t *it = pl_item_alloc ();
@@ -1778,10 +2040,16 @@ pl_item_free (playItem_t *it) {
             pl_meta_free_values (it->meta);
             DB_metaInfo_t *m = it->meta;
             it->meta = m->next;
-            free (m);
+            pl_meta_node_free (it, m);
         }
+        pl_meta_index_free (it);
 
-        free (it);
+        if (it->slab_allocated) {
+            slab_free (_item_allocator, it);
+        }
+        else {
+            free (it);
+        }
     }
     UNLOCK;
 }
@@ -2682,9 +2950,9 @@ plt_set_item_duration (playlist_t *playlist, playItem_t *it, float duration) {
 
 float
 pl_get_item_duration (playItem_t *it) {
-    LOCK;
+    READ_LOCK;
     float res = it->_duration;
-    UNLOCK;
+    READ_UNLOCK;
     return res;
 }
 
@@ -3737,9 +4005,9 @@ pl_items_copy_junk (playItem_t *from, playItem_t *first, playItem_t *last) {
 
 uint32_t
 pl_get_item_flags (playItem_t *it) {
-    LOCK;
+    READ_LOCK;
     uint32_t flags = it->_flags;
-    UNLOCK;
+    READ_UNLOCK;
     return flags;
 }
 
@@ -3785,6 +4053,9 @@ plt_is_fast_mode (playlist_t *plt) {
 void
 pl_ensure_lock (void) {
 #if DETECT_PL_LOCK_RC
+    if (_lock_read_depth) {
+        return;
+    }
     pthread_t tid = pthread_self ();
     for (int i = 0; i < ntids; i++) {
         if (tids[i] == tid) {
@@ -4076,7 +4347,7 @@ plt_process_embedded_cue (playlist_t *plt, playItem_t *after, playItem_t *it, in
     const char *cuesheet = pl_find_meta (it, "cuesheet");
     if (cuesheet) {
         const char *fname = pl_find_meta (it, ":URI");
-        cue = plt_load_cuesheet_from_buffer (plt, after, fname, it, totalsamples, samplerate, (const uint8_t *)cuesheet, (int)strlen (cuesheet), NULL, 0, 0);
+        cue = plt_load_cuesheet_from_buffer (plt, after, fname, it, totalsamples, samplerate, (const uint8_t *)cuesheet, (int)strlen (cuesheet), NULL, NULL);
     }
     pl_unlock();
     return cue;
@@ -4096,6 +4367,7 @@ plt_process_cue (playlist_t *plt, playItem_t *after, playItem_t *it, uint64_t to
 void
 pl_configchanged (void) {
     conf_cue_prefer_embedded = conf_get_int ("cue.prefer_embedded", 0);
+    decoder_dispatch_configchanged ();
 }
 
 int64_t
@@ -45,24 +45,31 @@ extern "C" {
 // :DURATION - length in seconds
 
 typedef struct playItem_s {
+    // the public part (ddb_playItem_t), which plugins may access directly,
+    // so the 32 bit sample fields must stay here, in addition to the 64 bit ones
     int32_t startsample;
     int32_t endsample;
     int32_t shufflerating; // sort order for shuffle mode
 
+    // private area, must not be visible to plugins
+    // the flags are placed in the padding before the 64 bit fields
+    unsigned selected : 1;
+    unsigned played : 1; // mark as played in shuffle mode
+    unsigned in_playlist : 1; // 1 if item is in playlist
+    unsigned has_startsample64 : 1;
+    unsigned has_endsample64 : 1;
+    unsigned slab_allocated : 1; // the item and its metadata nodes come from the compact storage slabs
+
     int64_t startsample64;
     int64_t endsample64;
-    // private area, must not be visible to plugins
     float _duration;
     uint32_t _flags;
     int _refc;
+    uint32_t _modification_stamp; // unique value, which changes each time the metadata changes
     struct playItem_s *next[PL_MAX_ITERATORS]; // next item in linked list
     struct playItem_s *prev[PL_MAX_ITERATORS]; // prev item in linked list
     struct DB_metaInfo_s *meta; // linked list storing metainfo
-    unsigned selected : 1;
-    unsigned played : 1; // mark as played in shuffle mode
-    unsigned in_playlist : 1; // 1 if item is in playlist
-    unsigned has_startsample64 : 1;
-    unsigned has_endsample64 : 1;
+    struct pl_meta_index_s *_meta_index; // index of the meta list, built on demand
 } playItem_t;
 
 typedef struct playlist_s {
@@ -101,12 +108,32 @@ pl_init (void);
 void
 pl_free (void);
 
+// The exclusive (write) side of the lock for all playlists, items and their metadata.
+// It's recursive, and plugins take it through the API around arbitrary sequences of calls.
+// Use playlist.lock_stats=1 and --lock-report to find the call sites which hold it for long.
 void
 pl_lock (void);
 
 void
 pl_unlock (void);
 
+// Shared lock for the functions which only read the playlists and the items,
+// e.g. the metadata lookups. May be nested, and may be taken under pl_lock,
+// but pl_lock must not be taken under it.
+void
+pl_read_lock (void);
+
+void
+pl_read_unlock (void);
+
+// Enable collecting the pl_lock wait and hold times per call site
+void
+pl_set_lock_stats_enabled (int enable);
+
+// Write the lock statistics of the busiest call sites
+void
+pl_format_lock_report (char *buffer, size_t size, int max_sites);
+
 //void
 //plt_lock (void);
 //
@@ -229,6 +256,16 @@ plt_remove_item (playlist_t *playlist, playItem_t *it);
 playItem_t *
 pl_item_alloc (void);
 
+// Allocate the new items and their metadata from slabs, instead of individual mallocs.
+// Affects only the items allocated after the call.
+// Enabled at startup unless playlist.compact_storage=0.
+void
+pl_set_compact_storage (int enable);
+
+// Write a human readable summary of the playlist memory usage
+void
+pl_format_memory_report (char *buffer, size_t size);
+
 playItem_t *
 pl_item_alloc_init (const char *fname, const char *decoder_id);
 
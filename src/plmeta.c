@@ -30,44 +30,491 @@
 #include "plmeta.h"
 #include <deadbeef/deadbeef.h>
 #include "metacache.h"
+#include "slaballoc.h"
 
 #define LOCK {pl_lock();}
 #define UNLOCK {pl_unlock();}
 
-DB_metaInfo_t *
-pl_meta_for_key_with_override (playItem_t *it, const char *key) {
-    pl_ensure_lock ();
-    DB_metaInfo_t *m = it->meta;
+#define META_NODES_PER_SLAB 4096
 
-    // try to find an override
-    while (m) {
-        if (m->key[0] == '!' && !strcasecmp (key, m->key+1)) {
+static uint32_t _modification_stamp;
+
+// metadata nodes of the slab allocated items, protected by pl_lock
+static slab_allocator_t *_meta_allocator;
+
+static DB_metaInfo_t *
+_meta_node_alloc (playItem_t *it) {
+    if (!it->slab_allocated) {
+        return calloc (1, sizeof (DB_metaInfo_t));
+    }
+    LOCK;
+    if (!_meta_allocator) {
+        _meta_allocator = slab_allocator_create (sizeof (DB_metaInfo_t), META_NODES_PER_SLAB);
+    }
+    DB_metaInfo_t *m = slab_alloc (_meta_allocator);
+    UNLOCK;
+    return m;
+}
+
+void
+pl_meta_node_free (playItem_t *it, DB_metaInfo_t *m) {
+    if (!it->slab_allocated) {
+        free (m);
+        return;
+    }
+    LOCK;
+    slab_free (_meta_allocator, m);
+    UNLOCK;
+}
+
+int
+pl_meta_get_allocator_stats (slab_allocator_stats_t *stats) {
+    int res = -1;
+    LOCK;
+    if (_meta_allocator) {
+        slab_allocator_get_stats (_meta_allocator, stats);
+        res = 0;
+    }
+    UNLOCK;
+    return res;
+}
+
+void
+pl_item_set_modified (playItem_t *it) {
+    it->_modification_stamp = ++_modification_stamp;
+}
+
+#pragma mark - Keys
+
+// Each distinct metadata key gets a small id, keys differing only in case share the id.
+// The interned key strings of the metadata nodes are mapped to the ids by pointer,
+// so the lookups with interned keys (e.g. from compiled title formatting scripts) don't hash the key,
+// only the other keys are hashed, to find them by name.
+// The tables are only modified under pl_lock, but may be read without it,
+// since the callers passing DDB_TF_CONTEXT_NO_MUTEX_LOCK don't necessarily hold pl_lock.
+// So the slots are published with release stores, and the replaced tables are never freed.
+// Like the interned strings they reference, the keys are kept for the lifetime of the process.
+
+#define META_KEY_MAX 0xffff
+#define META_KEYS_PER_CHUNK 256
+
+typedef struct {
+    const char *name; // interned, the first spelling seen
+    uint16_t override_id; // id of the "!" override of this key, or 0
+} meta_key_t;
+
+typedef struct {
+    const char *key;
+    uint32_t hash;
+    uint16_t id;
+} meta_key_slot_t;
+
+typedef struct meta_key_table_s {
+    uint32_t mask;
+    uint32_t count;
+    struct meta_key_table_s *prev; // replaced table, which may still be read
+    meta_key_slot_t slots[];
+} meta_key_table_t;
+
+static meta_key_t *_keys[META_KEY_MAX / META_KEYS_PER_CHUNK + 1];
+static uint32_t _keys_count;
+static meta_key_table_t *_keys_by_ptr;
+static meta_key_table_t *_keys_by_name;
+
+static inline uint32_t
+_meta_hash_update (uint32_t hash, const char *key) {
+    for (const uint8_t *p = (const uint8_t *)key; *p; p++) {
+        uint8_t c = *p;
+        if (c >= 'A' && c <= 'Z') {
+            c += 'a' - 'A';
+        }
+        hash = (hash ^ c) * 16777619u;
+    }
+    return hash;
+}
+
+static inline uint32_t
+_meta_hash (const char *key) {
+    return _meta_hash_update (2166136261u, key);
+}
+
+static inline uint32_t
+_meta_ptr_hash (const char *key) {
+    return (uint32_t)((uintptr_t)key >> 3) * 2654435761u;
+}
+
+static inline meta_key_t *
+_meta_key (uint16_t id) {
+    return &_keys[id / META_KEYS_PER_CHUNK][id % META_KEYS_PER_CHUNK];
+}
+
+// Returns the id of the interned key, or 0
+static uint16_t
+_meta_key_find_ptr (const char *key) {
+    meta_key_table_t *t = __atomic_load_n (&_keys_by_ptr, __ATOMIC_ACQUIRE);
+    if (!t) {
+        return 0;
+    }
+    for (uint32_t i = _meta_ptr_hash (key) & t->mask; ; i = (i + 1) & t->mask) {
+        const char *k = __atomic_load_n (&t->slots[i].key, __ATOMIC_ACQUIRE);
+        if (!k) {
+            return 0;
+        }
+        if (k == key) {
+            return t->slots[i].id;
+        }
+    }
+}
+
+// Returns the id of the key with the given hash, compared case-insensitively after skipping `skip` chars, or 0
+static uint16_t
+_meta_key_find_name (const char *key, uint32_t hash) {
+    meta_key_table_t *t = __atomic_load_n (&_keys_by_name, __ATOMIC_ACQUIRE);
+    if (!t) {
+        return 0;
+    }
+    for (uint32_t i = hash & t->mask; ; i = (i + 1) & t->mask) {
+        const char *k = __atomic_load_n (&t->slots[i].key, __ATOMIC_ACQUIRE);
+        if (!k) {
+            return 0;
+        }
+        if (t->slots[i].hash == hash && !strcasecmp (k, key)) {
+            return t->slots[i].id;
+        }
+    }
+}
+
+// Returns the id of any key, or 0 if no track ever had it
+static uint16_t
+_meta_key_id (const char *key) {
+    uint16_t id = _meta_key_find_ptr (key);
+    if (!id) {
+        id = _meta_key_find_name (key, _meta_hash (key));
+    }
+    return id;
+}
+
+static void
+_meta_key_table_insert (meta_key_table_t *t, const char *key, uint32_t hash, uint16_t id) {
+    uint32_t i = hash & t->mask;
+    while (t->slots[i].key) {
+        i = (i + 1) & t->mask;
+    }
+    t->slots[i].hash = hash;
+    t->slots[i].id = id;
+    __atomic_store_n (&t->slots[i].key, key, __ATOMIC_RELEASE);
+    t->count++;
+}
+
+// must be called under pl_lock
+static void
+_meta_key_table_add (meta_key_table_t **ptable, const char *key, uint32_t hash, uint16_t id, int by_ptr) {
+    meta_key_table_t *t = *ptable;
+    if (!t || (t->count + 1) * 2 > t->mask + 1) {
+        uint32_t size = t ? (t->mask + 1) * 2 : 256;
+        meta_key_table_t *nt = calloc (1, sizeof (meta_key_table_t) + size * sizeof (meta_key_slot_t));
+        nt->mask = size - 1;
+        nt->prev = t;
+        if (t) {
+            for (uint32_t i = 0; i <= t->mask; i++) {
+                if (t->slots[i].key) {
+                    uint32_t h = by_ptr ? _meta_ptr_hash (t->slots[i].key) : t->slots[i].hash;
+                    _meta_key_table_insert (nt, t->slots[i].key, h, t->slots[i].id);
+                }
+            }
+        }
+        __atomic_store_n (ptable, nt, __ATOMIC_RELEASE);
+        t = nt;
+    }
+    _meta_key_table_insert (t, key, hash, id);
+}
+
+// Finds or adds the key by name, must be called under pl_lock.
+// Returns 0 if there are too many keys.
+static uint16_t
+_meta_key_add_name (const char *key) {
+    uint32_t hash = _meta_hash (key);
+    uint16_t id = _meta_key_find_name (key, hash);
+    if (id || _keys_count >= META_KEY_MAX) {
+        return id;
+    }
+    id = ++_keys_count;
+    if (!_keys[id / META_KEYS_PER_CHUNK]) {
+        _keys[id / META_KEYS_PER_CHUNK] = calloc (META_KEYS_PER_CHUNK, sizeof (meta_key_t));
+    }
+    meta_key_t *k = _meta_key (id);
+    // the table keeps a reference, so the pointer stays valid
+    k->name = metacache_add_string (key);
+    if (key[0] == '!') {
+        uint16_t base = _meta_key_add_name (key + 1);
+        if (base) {
+            _meta_key (base)->override_id = id;
+        }
+    }
+    else {
+        char override[strlen (key) + 2];
+        override[0] = '!';
+        strcpy (override + 1, key);
+        k->override_id = _meta_key_find_name (override, _meta_hash (override));
+    }
+    _meta_key_table_add (&_keys_by_name, k->name, hash, id, 0);
+    return id;
+}
+
+// Registers the interned key of a metadata node, and returns its id, or 0 if there are too many keys.
+static uint16_t
+_meta_key_register (const char *key) {
+    uint16_t id = _meta_key_find_ptr (key);
+    if (id) {
+        return id;
+    }
+    LOCK;
+    id = _meta_key_find_ptr (key);
+    if (!id) {
+        id = _meta_key_add_name (key);
+        if (id) {
+            metacache_add_string (key);
+            _meta_key_table_add (&_keys_by_ptr, key, _meta_ptr_hash (key), id, 1);
+        }
+    }
+    UNLOCK;
+    return id;
+}
+
+#pragma mark - Index
+
+// The meta list remains the storage, and defines the iteration order.
+// Tracks with many fields get an index: the nodes in the list order, and their key ids, in two arrays.
+// A lookup scans the ids, instead of walking the list and comparing the strings.
+// It takes 10 bytes per field, plus a 16 byte header, with the arrays grown in steps of 8 fields.
+#define PL_META_INDEX_MIN_COUNT 8
+#define PL_META_INDEX_STEP 8
+
+struct pl_meta_index_s {
+    uint32_t count;
+    uint32_t size;
+    // the number of the normal fields, which come before the properties (":", "_", "!") in the list
+    uint32_t normal_count;
+    uint32_t _reserved;
+    // followed by DB_metaInfo_t *nodes[size] and uint16_t ids[size]
+};
+
+#define INDEX_NODES(index) ((DB_metaInfo_t **)((index) + 1))
+#define INDEX_IDS(index) ((uint16_t *)(INDEX_NODES(index) + (index)->size))
+
+static inline int
+_meta_key_is_property (const char *key) {
+    return key[0] == ':' || key[0] == '_' || key[0] == '!';
+}
+
+void
+pl_meta_index_free (playItem_t *it) {
+    free (it->_meta_index);
+    it->_meta_index = NULL;
+}
+
+static struct pl_meta_index_s *
+_meta_index_alloc (uint32_t size) {
+    struct pl_meta_index_s *index = calloc (1, sizeof (struct pl_meta_index_s) + size * (sizeof (DB_metaInfo_t *) + sizeof (uint16_t)));
+    index->size = size;
+    return index;
+}
+
+// Returns the index, building it if the track has enough fields, or NULL.
+// The lookups only hold pl_read_lock, so several threads may build the index at once:
+// it's published with a compare-and-swap, and the losers free their copies.
+static struct pl_meta_index_s *
+_meta_index_get (playItem_t *it) {
+    struct pl_meta_index_s *current = __atomic_load_n (&it->_meta_index, __ATOMIC_ACQUIRE);
+    if (current) {
+        return current;
+    }
+    uint32_t count = 0;
+    for (DB_metaInfo_t *m = it->meta; m; m = m->next) {
+        count++;
+    }
+    if (count < PL_META_INDEX_MIN_COUNT) {
+        return NULL;
+    }
+    struct pl_meta_index_s *index = _meta_index_alloc ((count + PL_META_INDEX_STEP - 1) & ~(PL_META_INDEX_STEP - 1));
+    DB_metaInfo_t **nodes = INDEX_NODES (index);
+    uint16_t *ids = INDEX_IDS (index);
+    for (DB_metaInfo_t *m = it->meta; m; m = m->next) {
+        uint16_t id = _meta_key_find_ptr (m->key);
+        if (!id) {
+            // the key wasn't registered, e.g. there are too many keys
+            free (index);
+            return NULL;
+        }
+        if (!_meta_key_is_property (m->key)) {
+            index->normal_count = index->count + 1;
+        }
+        nodes[index->count] = m;
+        ids[index->count] = id;
+        index->count++;
+    }
+    if (!__atomic_compare_exchange_n (&it->_meta_index, &current, index, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        free (index);
+        return current;
+    }
+    return index;
+}
+
+static int
+_meta_index_find (struct pl_meta_index_s *index, uint16_t id) {
+    if (!id) {
+        return -1;
+    }
+    uint16_t *ids = INDEX_IDS (index);
+    for (uint32_t i = 0; i < index->count; i++) {
+        if (ids[i] == id) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int
+_meta_index_find_node (struct pl_meta_index_s *index, DB_metaInfo_t *meta) {
+    DB_metaInfo_t **nodes = INDEX_NODES (index);
+    for (uint32_t i = 0; i < index->count; i++) {
+        if (nodes[i] == meta) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Inserts the node into the index at the given list position
+static void
+_meta_index_insert (playItem_t *it, uint32_t pos, DB_metaInfo_t *meta, uint16_t id) {
+    struct pl_meta_index_s *index = it->_meta_index;
+    if (index->count == index->size) {
+        struct pl_meta_index_s *grown = _meta_index_alloc (index->size + PL_META_INDEX_STEP);
+        grown->count = index->count;
+        grown->normal_count = index->normal_count;
+        memcpy (INDEX_NODES (grown), INDEX_NODES (index), index->count * sizeof (DB_metaInfo_t *));
+        memcpy (INDEX_IDS (grown), INDEX_IDS (index), index->count * sizeof (uint16_t));
+        free (index);
+        it->_meta_index = index = grown;
+    }
+    DB_metaInfo_t **nodes = INDEX_NODES (index);
+    uint16_t *ids = INDEX_IDS (index);
+    memmove (&nodes[pos + 1], &nodes[pos], (index->count - pos) * sizeof (DB_metaInfo_t *));
+    memmove (&ids[pos + 1], &ids[pos], (index->count - pos) * sizeof (uint16_t));
+    nodes[pos] = meta;
+    ids[pos] = id;
+    index->count++;
+    if (!_meta_key_is_property (meta->key)) {
+        index->normal_count++;
+    }
+}
+
+// Removes the node at the given position from the index
+static void
+_meta_index_remove_at (struct pl_meta_index_s *index, uint32_t pos) {
+    DB_metaInfo_t **nodes = INDEX_NODES (index);
+    uint16_t *ids = INDEX_IDS (index);
+    if (!_meta_key_is_property (nodes[pos]->key)) {
+        index->normal_count--;
+    }
+    index->count--;
+    memmove (&nodes[pos], &nodes[pos + 1], (index->count - pos) * sizeof (DB_metaInfo_t *));
+    memmove (&ids[pos], &ids[pos + 1], (index->count - pos) * sizeof (uint16_t));
+}
+
+static DB_metaInfo_t *
+_meta_find_id (playItem_t *it, uint16_t id) {
+    if (!id) {
+        return NULL;
+    }
+    struct pl_meta_index_s *index = _meta_index_get (it);
+    if (index) {
+        int pos = _meta_index_find (index, id);
+        return pos >= 0 ? INDEX_NODES (index)[pos] : NULL;
+    }
+    const char *name = _meta_key (id)->name;
+    for (DB_metaInfo_t *m = it->meta; m; m = m->next) {
+        if (name == m->key || !strcasecmp (name, m->key)) {
             return m;
         }
-        m = m->next;
     }
+    return NULL;
+}
 
-    m = it->meta;
-    while (m) {
-        if (key && !strcasecmp (key, m->key)) {
+// Only used when the keys ran out of ids
+static DB_metaInfo_t *
+_meta_find_slow (playItem_t *it, const char *key, int override) {
+    for (DB_metaInfo_t *m = it->meta; m; m = m->next) {
+        if (override ? (m->key[0] == '!' && !strcasecmp (key, m->key + 1)) : !strcasecmp (key, m->key)) {
             return m;
         }
-        m = m->next;
     }
-    return NULL;}
+    return NULL;
+}
+
+static DB_metaInfo_t *
+_meta_find_override (playItem_t *it, const char *key) {
+    uint16_t id = _meta_key_id (key);
+    if (!id && _keys_count >= META_KEY_MAX) {
+        return _meta_find_slow (it, key, 1);
+    }
+    return id ? _meta_find_id (it, _meta_key (id)->override_id) : NULL;
+}
 
+static DB_metaInfo_t *
+_meta_find (playItem_t *it, const char *key) {
+    uint16_t id = _meta_key_id (key);
+    if (!id && _keys_count >= META_KEY_MAX) {
+        return _meta_find_slow (it, key, 0);
+    }
+    return _meta_find_id (it, id);
+}
+
+// Unlinks the node from the list and the index, prev is the previous node in the list
+static void
+_meta_unlink (playItem_t *it, DB_metaInfo_t *prev, DB_metaInfo_t *m) {
+    if (it->_meta_index) {
+        int pos = _meta_index_find_node (it->_meta_index, m);
+        if (pos >= 0) {
+            _meta_index_remove_at (it->_meta_index, pos);
+        }
+    }
+    if (prev) {
+        prev->next = m->next;
+    }
+    else {
+        it->meta = m->next;
+    }
+    metacache_remove_string (m->key);
+    pl_meta_free_values (m);
+    pl_meta_node_free (it, m);
+    pl_item_set_modified (it);
+}
+
+#pragma mark -
 
 DB_metaInfo_t *
-pl_meta_for_key (playItem_t *it, const char *key) {
+pl_meta_for_key_with_override (playItem_t *it, const char *key) {
     pl_ensure_lock ();
-    DB_metaInfo_t *m = it->meta;
-    while (m) {
-        if (!strcasecmp (key, m->key)) {
-            return m;
-        }
-        m = m->next;
+    if (!key) {
+        return NULL;
     }
-    return NULL;
+
+    // try to find an override
+    DB_metaInfo_t *m = _meta_find_override (it, key);
+    if (m) {
+        return m;
+    }
+
+    return _meta_find (it, key);
+}
+
+
+DB_metaInfo_t *
+pl_meta_for_key (playItem_t *it, const char *key) {
+    pl_ensure_lock ();
+    return _meta_find (it, key);
 }
 
 void
@@ -79,14 +526,52 @@ pl_meta_free_values (DB_metaInfo_t *meta) {
 
 DB_metaInfo_t *
 pl_add_empty_meta_for_key (playItem_t *it, const char *key) {
-    // check if it's already set
+    const char *ikey = metacache_add_string (key);
+    uint16_t id = _meta_key_register (ikey);
+
+    struct pl_meta_index_s *index = it->_meta_index;
+    if (index && id) {
+        // check if it's already set
+        if (_meta_index_find (index, id) >= 0) {
+            metacache_remove_string (ikey);
+            return NULL;
+        }
+        // the same position as found by walking the list below:
+        // the properties are appended, the normal fields go before the properties, or before the last field if there are no properties
+        uint32_t pos;
+        if (_meta_key_is_property (key)) {
+            pos = index->count;
+        }
+        else if (index->normal_count == index->count && index->count > 0) {
+            pos = index->count - 1;
+        }
+        else {
+            pos = index->normal_count;
+        }
+        DB_metaInfo_t *prev = pos > 0 ? INDEX_NODES (index)[pos - 1] : NULL;
+        DB_metaInfo_t *m = _meta_node_alloc (it);
+        m->key = ikey;
+        if (prev) {
+            m->next = prev->next;
+            prev->next = m;
+        }
+        else {
+            m->next = it->meta;
+            it->meta = m;
+        }
+        _meta_index_insert (it, pos, m, id);
+        pl_item_set_modified (it);
+        return m;
+    }
+
     DB_metaInfo_t *normaltail = NULL;
     DB_metaInfo_t *propstart = NULL;
     DB_metaInfo_t *tail = NULL;
     DB_metaInfo_t *m = it->meta;
     while (m) {
-        if (!strcasecmp (key, m->key)) {
+        if (ikey == m->key || !strcasecmp (key, m->key)) {
             // duplicate key
+            metacache_remove_string (ikey);
             return NULL;
         }
         // find end of normal metadata
@@ -102,8 +587,9 @@ pl_add_empty_meta_for_key (playItem_t *it, const char *key) {
         m = m->next;
     }
     // add
-    m = calloc (1, sizeof (DB_metaInfo_t));
-    m->key = metacache_add_string (key);
+    m = _meta_node_alloc (it);
+    m->key = ikey;
+    pl_item_set_modified (it);
 
     if (key[0] == ':' || key[0] == '_' || key[0] == '!') {
         if (tail) {
@@ -122,6 +608,8 @@ pl_add_empty_meta_for_key (playItem_t *it, const char *key) {
             it->meta = m;
         }
     }
+    // the index, if any, is missing the node, e.g. when the key couldn't get an id
+    pl_meta_index_free (it);
 
     return m;
 }
@@ -184,6 +672,7 @@ pl_add_meta_full (playItem_t *it, const char *key, const char *value, int values
     }
 
     _meta_set_value (meta, value, valuesize);
+    pl_item_set_modified (it);
 }
 
 void
@@ -250,6 +739,7 @@ pl_append_meta_full (playItem_t *it, const char *key, const char *value, int siz
 
     if (!m->value) {
         _meta_set_value (m, value, size);
+        pl_item_set_modified (it);
         pl_unlock ();
         return;
     }
@@ -266,6 +756,7 @@ pl_append_meta_full (playItem_t *it, const char *key, const char *value, int siz
     m->value = metacache_add_value (buf, buflen);
     m->valuesize = (int)buflen;
     free (buf);
+    pl_item_set_modified (it);
     pl_unlock ();
 }
 
@@ -285,6 +776,7 @@ pl_replace_meta (playItem_t *it, const char *key, const char *value) {
         int l = (int)strlen (value) + 1;
         m->value = metacache_add_value(value, l);
         m->valuesize = l;
+        pl_item_set_modified (it);
         UNLOCK;
         return;
     }
@@ -315,26 +807,37 @@ pl_set_meta_float (playItem_t *it, const char *key, float value) {
     pl_replace_meta (it, key, s);
 }
 
+// Deletes the node, if it belongs to the item
+static void
+_meta_delete_node (playItem_t *it, DB_metaInfo_t *meta) {
+    DB_metaInfo_t *prev = NULL;
+    struct pl_meta_index_s *index = it->_meta_index;
+    if (index) {
+        int pos = _meta_index_find_node (index, meta);
+        if (pos < 0) {
+            return;
+        }
+        prev = pos > 0 ? INDEX_NODES (index)[pos - 1] : NULL;
+    }
+    else {
+        DB_metaInfo_t *m = it->meta;
+        while (m && m != meta) {
+            prev = m;
+            m = m->next;
+        }
+        if (!m) {
+            return;
+        }
+    }
+    _meta_unlink (it, prev, meta);
+}
+
 void
 pl_delete_meta (playItem_t *it, const char *key) {
     pl_lock ();
-    DB_metaInfo_t *prev = NULL;
-    DB_metaInfo_t *m = it->meta;
-    while (m) {
-        if (!strcasecmp (key, m->key)) {
-            if (prev) {
-                prev->next = m->next;
-            }
-            else {
-                it->meta = m->next;
-            }
-            metacache_remove_string (m->key);
-            pl_meta_free_values(m);
-            free (m);
-            break;
-        }
-        prev = m;
-        m = m->next;
+    DB_metaInfo_t *m = _meta_find (it, key);
+    if (m) {
+        _meta_delete_node (it, m);
     }
     pl_unlock ();
 }
@@ -342,26 +845,21 @@ pl_delete_meta (playItem_t *it, const char *key) {
 const char *
 pl_find_meta (playItem_t *it, const char *key) {
     pl_ensure_lock ();
-    DB_metaInfo_t *m = it->meta;
-
-    if (key && key[0] == ':') {
-        // try to find an override
-        while (m) {
-            if (m->key[0] == '!' && !strcasecmp (key+1, m->key+1)) {
-                return m->value;
-            }
-            m = m->next;
-        }
+    if (!key) {
+        return NULL;
     }
 
-    m = it->meta;
-    while (m) {
-        if (key && !strcasecmp (key, m->key)) {
+    DB_metaInfo_t *m = NULL;
+    if (key[0] == ':') {
+        // try to find an override
+        m = _meta_find_override (it, key+1);
+        if (m) {
             return m->value;
         }
-        m = m->next;
     }
-    return NULL;
+
+    m = _meta_find (it, key);
+    return m ? m->value : NULL;
 }
 
 const char *
@@ -382,28 +880,28 @@ pl_find_meta_raw (playItem_t *it, const char *key) {
 
 int
 pl_find_meta_int (playItem_t *it, const char *key, int def) {
-    pl_lock ();
+    pl_read_lock ();
     const char *val = pl_find_meta (it, key);
     int res = val ? atoi (val) : def;
-    pl_unlock ();
+    pl_read_unlock ();
     return res;
 }
 
 int64_t
 pl_find_meta_int64 (playItem_t *it, const char *key, int64_t def) {
-    pl_lock ();
+    pl_read_lock ();
     const char *val = pl_find_meta (it, key);
     int64_t res = val ? atoll (val) : def;
-    pl_unlock ();
+    pl_read_unlock ();
     return res;
 }
 
 float
 pl_find_meta_float (playItem_t *it, const char *key, float def) {
-    pl_lock ();
+    pl_read_lock ();
     const char *val = pl_find_meta (it, key);
     float res = val ? (float)atof (val) : def;
-    pl_unlock ();
+    pl_read_unlock ();
     return res;
 }
 
@@ -415,24 +913,7 @@ pl_get_metadata_head (playItem_t *it) {
 void
 pl_delete_metadata (playItem_t *it, DB_metaInfo_t *meta) {
     pl_lock ();
-    DB_metaInfo_t *prev = NULL;
-    DB_metaInfo_t *m = it->meta;
-    while (m) {
-        if (m == meta) {
-            if (prev) {
-                prev->next = m->next;
-            }
-            else {
-                it->meta = m->next;
-            }
-            metacache_remove_string (m->key);
-            pl_meta_free_values(m);
-            free (m);
-            break;
-        }
-        prev = m;
-        m = m->next;
-    }
+    _meta_delete_node (it, meta);
     pl_unlock ();
 }
 
@@ -447,15 +928,7 @@ pl_delete_all_meta (playItem_t *it) {
             prev = m;
         }
         else {
-            if (prev) {
-                prev->next = next;
-            }
-            else {
-                it->meta = next;
-            }
-            metacache_remove_string (m->key);
-            pl_meta_free_values (m);
-            free (m);
+            _meta_unlink (it, prev, m);
         }
         m = next;
     }
@@ -476,58 +949,58 @@ pl_delete_all_meta (playItem_t *it) {
 int
 pl_get_meta (playItem_t *it, const char *key, char *val, int size) {
     *val = 0;
-    pl_lock ();
+    pl_read_lock ();
     const char *v = pl_find_meta (it, key);
     if (!v) {
-        pl_unlock ();
+        pl_read_unlock ();
         return 0;
     }
     strncpy (val, v, size);
-    pl_unlock ();
+    pl_read_unlock ();
     return 1;
 }
 
 int
 pl_get_meta_with_override (playItem_t *it, const char *key, char *val, size_t size) {
     *val = 0;
-    pl_lock ();
+    pl_read_lock ();
     DB_metaInfo_t *meta = pl_meta_for_key_with_override (it, key);
     if (!meta) {
-        pl_unlock ();
+        pl_read_unlock ();
         return 0;
     }
     strncpy (val, meta->value, size);
-    pl_unlock ();
+    pl_read_unlock ();
     return 1;
 }
 
 int
 pl_get_meta_raw (playItem_t *it, const char *key, char *val, int size) {
     *val = 0;
-    pl_lock ();
+    pl_read_lock ();
     const char *v = pl_find_meta_raw (it, key);
     if (!v) {
-        pl_unlock ();
+        pl_read_unlock ();
         return 0;
     }
     strncpy (val, v, size);
-    pl_unlock ();
+    pl_read_unlock ();
     return 1;
 }
 
 int
 pl_meta_exists (playItem_t *it, const char *key) {
-    pl_lock ();
+    pl_read_lock ();
     const char *v = pl_find_meta (it, key);
-    pl_unlock ();
+    pl_read_unlock ();
     return v ? 1 : 0;
 }
 
 int
 pl_meta_exists_with_override (playItem_t *it, const char *key) {
-    pl_lock ();
+    pl_read_lock ();
     const char *v = pl_find_meta_with_override (it, key);
-    pl_unlock ();
+    pl_read_unlock ();
     return v ? 1 : 0;
 }
 
@@ -540,4 +1013,5 @@ pl_add_meta_copy (playItem_t *it, DB_metaInfo_t *meta) {
 
     m->value = metacache_add_value (meta->value, meta->valuesize);
     m->valuesize = meta->valuesize;
+    pl_item_set_modified (it);
 }
@@ -2,6 +2,7 @@
 #define plmeta_h
 
 #include "playlist.h"
+#include "slaballoc.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -78,6 +79,24 @@ pl_get_meta_with_override (playItem_t *it, const char *key, char *val, size_t si
 const char *
 pl_find_meta_with_override (playItem_t *it, const char *key);
 
+// Assign a new modification stamp to the item, must be called under pl_lock.
+// Used to invalidate the data derived from the item metadata, e.g. title formatting results.
+void
+pl_item_set_modified (playItem_t *it);
+
+// Free the metadata lookup index of the item, it will be rebuilt on demand
+void
+pl_meta_index_free (playItem_t *it);
+
+// Free a metadata node, which was unlinked from the item
+void
+pl_meta_node_free (playItem_t *it, DB_metaInfo_t *m);
+
+// Get the memory usage of the metadata nodes of the slab allocated items.
+// Returns -1 if no such nodes were allocated.
+int
+pl_meta_get_allocator_stats (slab_allocator_stats_t *stats);
+
 void
 pl_meta_free_values (DB_metaInfo_t *meta);
 
@@ -0,0 +1,466 @@
+/*
+    DeaDBeeF -- the music player
+    Copyright (C) 2009-2023 Oleksiy Yakovenko and other contributors
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <deadbeef/common.h>
+#include "escape.h"
+#include "pluginmanifest.h"
+
+// 2: the plugins handling messages are not deferrable
+#define MANIFEST_VERSION 2
+
+extern char dbcachedir[PATH_MAX];
+
+static pluginmanifest_entry_t *entries;
+static int changed;
+
+static void
+_free_list (char **list) {
+    if (!list) {
+        return;
+    }
+    for (int i = 0; list[i]; i++) {
+        free (list[i]);
+    }
+    free (list);
+}
+
+static void
+_entry_free (pluginmanifest_entry_t *e) {
+    free (e->path);
+    free (e->id);
+    free (e->name);
+    free (e->descr);
+    free (e->copyright);
+    free (e->website);
+    free (e->configdialog);
+    _free_list (e->exts);
+    _free_list (e->prefixes);
+    _free_list (e->schemes);
+    free (e);
+}
+
+static char **
+_list_append (char **list, char *value) {
+    int n = 0;
+    if (list) {
+        while (list[n]) {
+            n++;
+        }
+    }
+    list = realloc (list, (n + 2) * sizeof (char *));
+    list[n] = value;
+    list[n+1] = NULL;
+    return list;
+}
+
+static char **
+_list_copy (const char **list) {
+    if (!list) {
+        return NULL;
+    }
+    char **res = calloc (1, sizeof (char *));
+    for (int i = 0; list[i]; i++) {
+        res = _list_append (res, strdup (list[i]));
+    }
+    return res;
+}
+
+static void
+_get_manifest_path (char *path, size_t size, const char *suffix) {
+    snprintf (path, size, "%s/plugins.manifest%s", dbcachedir, suffix);
+}
+
+static void
+_unlink_entry (pluginmanifest_entry_t *entry) {
+    pluginmanifest_entry_t *prev = NULL;
+    for (pluginmanifest_entry_t *e = entries; e; prev = e, e = e->next) {
+        if (e == entry) {
+            if (prev) {
+                prev->next = e->next;
+            }
+            else {
+                entries = e->next;
+            }
+            break;
+        }
+    }
+}
+
+void
+pluginmanifest_load (void) {
+    char fname[PATH_MAX];
+    _get_manifest_path (fname, sizeof (fname), "");
+    FILE *fp = fopen (fname, "rb");
+    if (!fp) {
+        // first run, or the cache was cleaned
+        return;
+    }
+
+    fseek (fp, 0, SEEK_END);
+    long l = ftell (fp);
+    rewind (fp);
+    if (l <= 0) {
+        fclose (fp);
+        return;
+    }
+
+    char *buffer = malloc (l+1);
+    if (l != fread (buffer, 1, l, fp)) {
+        trace_err ("failed to read plugin manifest %s\n", fname);
+        free (buffer);
+        fclose (fp);
+        return;
+    }
+    buffer[l] = 0;
+    fclose (fp);
+
+    pluginmanifest_entry_t *tail = NULL;
+    pluginmanifest_entry_t *e = NULL;
+    int version = 0;
+
+    char *str = buffer;
+    while (*str) {
+        char *estr = str;
+        while (*estr && *estr != '\n') {
+            estr++;
+        }
+        char *next = *estr ? estr + 1 : estr;
+        *estr = 0;
+
+        if (str[0] == '#' || str[0] == 0) {
+            str = next;
+            continue;
+        }
+
+        char *value = strchr (str, ' ');
+        if (value) {
+            *value++ = 0;
+        }
+        else {
+            value = estr;
+        }
+
+        if (!strcmp (str, "version")) {
+            version = atoi (value);
+            if (version != MANIFEST_VERSION) {
+                // written by a different version: rebuild from scratch
+                break;
+            }
+        }
+        else if (!strcmp (str, "plugin")) {
+            char *path_end = strchr (value, ' ');
+            long long mtime, size;
+            if (e || !path_end || 2 != sscanf (path_end, "%lld %lld", &mtime, &size)) {
+                trace_err ("plugin manifest is corrupt, ignored\n");
+                break;
+            }
+            *path_end = 0;
+            e = calloc (1, sizeof (pluginmanifest_entry_t));
+            e->path = uri_unescape (value, 0);
+            e->mtime = mtime;
+            e->size = size;
+        }
+        else if (!e) {
+            trace_err ("plugin manifest is corrupt, ignored\n");
+            break;
+        }
+        else if (!strcmp (str, "end")) {
+            if (tail) {
+                tail->next = e;
+            }
+            else {
+                entries = e;
+            }
+            tail = e;
+            e = NULL;
+        }
+        else if (!strcmp (str, "type")) {
+            e->type = atoi (value);
+        }
+        else if (!strcmp (str, "api")) {
+            int vmajor = 0, vminor = 0;
+            sscanf (value, "%d.%d", &vmajor, &vminor);
+            e->api_vmajor = vmajor;
+            e->api_vminor = vminor;
+        }
+        else if (!strcmp (str, "plugin_version")) {
+            int vmajor = 0, vminor = 0;
+            sscanf (value, "%d.%d", &vmajor, &vminor);
+            e->version_major = vmajor;
+            e->version_minor = vminor;
+        }
+        else if (!strcmp (str, "flags")) {
+            e->flags = (uint32_t)strtoul (value, NULL, 10);
+        }
+        else if (!strcmp (str, "caps")) {
+            e->caps = (uint32_t)strtoul (value, NULL, 10);
+        }
+        else if (!strcmp (str, "deferrable")) {
+            e->deferrable = atoi (value);
+        }
+        else if (!strcmp (str, "id")) {
+            e->id = uri_unescape (value, 0);
+        }
+        else if (!strcmp (str, "name")) {
+            e->name = uri_unescape (value, 0);
+        }
+        else if (!strcmp (str, "descr")) {
+            e->descr = uri_unescape (value, 0);
+        }
+        else if (!strcmp (str, "copyright")) {
+            e->copyright = uri_unescape (value, 0);
+        }
+        else if (!strcmp (str, "website")) {
+            e->website = uri_unescape (value, 0);
+        }
+        else if (!strcmp (str, "configdialog")) {
+            e->configdialog = uri_unescape (value, 0);
+        }
+        else if (!strcmp (str, "ext")) {
+            e->exts = _list_append (e->exts, uri_unescape (value, 0));
+        }
+        else if (!strcmp (str, "prefix")) {
+            e->prefixes = _list_append (e->prefixes, uri_unescape (value, 0));
+        }
+        else if (!strcmp (str, "scheme")) {
+            e->schemes = _list_append (e->schemes, uri_unescape (value, 0));
+        }
+        str = next;
+    }
+
+    if (e) {
+        // incomplete last entry
+        _entry_free (e);
+    }
+
+    if (version != MANIFEST_VERSION) {
+        pluginmanifest_free ();
+    }
+
+    free (buffer);
+    changed = 0;
+}
+
+static int
+_write_str (FILE *fp, const char *key, const char *value) {
+    if (!value) {
+        return 0;
+    }
+    // escaped empty string is written as empty value
+    char *escaped = *value ? uri_escape (value, 0) : strdup ("");
+    if (!escaped) {
+        return -1;
+    }
+    int res = fprintf (fp, "%s %s\n", key, escaped);
+    free (escaped);
+    return res < 0 ? -1 : 0;
+}
+
+static int
+_write_list (FILE *fp, const char *key, char **list) {
+    if (!list) {
+        return 0;
+    }
+    for (int i = 0; list[i]; i++) {
+        if (_write_str (fp, key, list[i]) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int
+_write_entry (FILE *fp, pluginmanifest_entry_t *e) {
+    char *path = uri_escape (e->path, 0);
+    int res = fprintf (fp, "plugin %s %lld %lld\n", path, (long long)e->mtime, (long long)e->size);
+    free (path);
+    if (res < 0) {
+        return -1;
+    }
+    if (fprintf (fp, "type %d\napi %d.%d\nplugin_version %d.%d\nflags %u\ncaps %u\ndeferrable %d\n", e->type, e->api_vmajor, e->api_vminor, e->version_major, e->version_minor, e->flags, e->caps, e->deferrable) < 0) {
+        return -1;
+    }
+    if (_write_str (fp, "id", e->id) < 0
+        || _write_str (fp, "name", e->name) < 0
+        || _write_str (fp, "descr", e->descr) < 0
+        || _write_str (fp, "copyright", e->copyright) < 0
+        || _write_str (fp, "website", e->website) < 0
+        || _write_str (fp, "configdialog", e->configdialog) < 0
+        || _write_list (fp, "ext", e->exts) < 0
+        || _write_list (fp, "prefix", e->prefixes) < 0
+        || _write_list (fp, "scheme", e->schemes) < 0) {
+        return -1;
+    }
+    return fprintf (fp, "end\n") < 0 ? -1 : 0;
+}
+
+int
+pluginmanifest_save (void) {
+    if (!changed) {
+        return 0;
+    }
+
+    char tempfile[PATH_MAX];
+    char fname[PATH_MAX];
+    _get_manifest_path (tempfile, sizeof (tempfile), ".tmp");
+    _get_manifest_path (fname, sizeof (fname), "");
+
+    mkdir (dbcachedir, 0755);
+    FILE *fp = fopen (tempfile, "w+b");
+    if (!fp) {
+        trace ("failed to open plugin manifest %s for writing\n", tempfile);
+        return -1;
+    }
+
+    int err = 0;
+    if (fprintf (fp, "# DeaDBeeF plugin manifest, generated automatically\nversion %d\n", MANIFEST_VERSION) < 0) {
+        err = 1;
+    }
+    for (pluginmanifest_entry_t *e = entries; e && !err; e = e->next) {
+        if (!e->seen) {
+            // the plugin was removed from disk
+            continue;
+        }
+        if (_write_entry (fp, e) < 0) {
+            err = 1;
+        }
+    }
+    if (EOF == fclose (fp)) {
+        err = 1;
+    }
+    if (err || rename (tempfile, fname)) {
+        trace_err ("failed to write plugin manifest %s: %s\n", fname, strerror (errno));
+        unlink (tempfile);
+        return -1;
+    }
+    changed = 0;
+    return 0;
+}
+
+void
+pluginmanifest_free (void) {
+    while (entries) {
+        pluginmanifest_entry_t *next = entries->next;
+        _entry_free (entries);
+        entries = next;
+    }
+    changed = 0;
+}
+
+pluginmanifest_entry_t *
+pluginmanifest_find (const char *path, const struct stat *st) {
+    for (pluginmanifest_entry_t *e = entries; e; e = e->next) {
+        if (!strcmp (e->path, path)) {
+            if (e->mtime != (int64_t)st->st_mtime || e->size != (int64_t)st->st_size) {
+                return NULL;
+            }
+            e->seen = 1;
+            return e;
+        }
+    }
+    return NULL;
+}
+
+static uint32_t
+_decoder_caps (DB_decoder_t *dec) {
+    uint32_t caps = 0;
+    if (dec->open2) {
+        caps |= PLUGINMANIFEST_CAP_OPEN2;
+    }
+    if (dec->insert) {
+        caps |= PLUGINMANIFEST_CAP_INSERT;
+    }
+    if (dec->read_metadata) {
+        caps |= PLUGINMANIFEST_CAP_READ_METADATA;
+    }
+    if (dec->write_metadata) {
+        caps |= PLUGINMANIFEST_CAP_WRITE_METADATA;
+    }
+    if (dec->numvoices) {
+        caps |= PLUGINMANIFEST_CAP_NUMVOICES;
+    }
+    if ((dec->plugin.flags & DDB_PLUGIN_FLAG_IMPLEMENTS_DECODER2) && ((ddb_decoder2_t *)dec)->seek_sample64) {
+        caps |= PLUGINMANIFEST_CAP_SEEK_SAMPLE64;
+    }
+    return caps;
+}
+
+void
+pluginmanifest_update (const char *path, const struct stat *st, DB_plugin_t *plugin, int deferrable) {
+    for (pluginmanifest_entry_t *e = entries; e; e = e->next) {
+        if (!strcmp (e->path, path)) {
+            _unlink_entry (e);
+            _entry_free (e);
+            break;
+        }
+    }
+
+    pluginmanifest_entry_t *e = calloc (1, sizeof (pluginmanifest_entry_t));
+    e->path = strdup (path);
+    e->mtime = st->st_mtime;
+    e->size = st->st_size;
+    e->type = plugin->type;
+    e->api_vmajor = plugin->api_vmajor;
+    e->api_vminor = plugin->api_vminor;
+    e->version_major = plugin->version_major;
+    e->version_minor = plugin->version_minor;
+    e->flags = plugin->flags;
+    e->id = plugin->id ? strdup (plugin->id) : NULL;
+    e->name = plugin->name ? strdup (plugin->name) : NULL;
+    e->descr = plugin->descr ? strdup (plugin->descr) : NULL;
+    e->copyright = plugin->copyright ? strdup (plugin->copyright) : NULL;
+    e->website = plugin->website ? strdup (plugin->website) : NULL;
+    e->configdialog = plugin->configdialog ? strdup (plugin->configdialog) : NULL;
+    e->deferrable = deferrable;
+    e->seen = 1;
+
+    if (plugin->type == DB_PLUGIN_DECODER) {
+        DB_decoder_t *dec = (DB_decoder_t *)plugin;
+        e->caps = _decoder_caps (dec);
+        e->exts = _list_copy (dec->exts);
+        e->prefixes = _list_copy (dec->prefixes);
+    }
+    else if (plugin->type == DB_PLUGIN_VFS) {
+        DB_vfs_t *vfs = (DB_vfs_t *)plugin;
+        if (vfs->get_schemes) {
+            e->schemes = _list_copy (vfs->get_schemes ());
+        }
+    }
+
+    e->next = entries;
+    entries = e;
+    changed = 1;
+}
+
+void
+pluginmanifest_invalidate (pluginmanifest_entry_t *entry) {
+    entry->seen = 0;
+    changed = 1;
+}
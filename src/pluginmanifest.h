@@ -0,0 +1,108 @@
+/*
+    DeaDBeeF -- the music player
+    Copyright (C) 2009-2023 Oleksiy Yakovenko and other contributors
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef pluginmanifest_h
+#define pluginmanifest_h
+
+#include <stdint.h>
+#include <sys/stat.h>
+#include <deadbeef/deadbeef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Optional decoder entry points, which are present in the plugin.
+// The lazy loader needs to know these without loading the plugin,
+// since the callers check the function pointers for NULL.
+enum {
+    PLUGINMANIFEST_CAP_OPEN2 = 1<<0,
+    PLUGINMANIFEST_CAP_INSERT = 1<<1,
+    PLUGINMANIFEST_CAP_READ_METADATA = 1<<2,
+    PLUGINMANIFEST_CAP_WRITE_METADATA = 1<<3,
+    PLUGINMANIFEST_CAP_NUMVOICES = 1<<4,
+    PLUGINMANIFEST_CAP_SEEK_SAMPLE64 = 1<<5,
+};
+
+// Everything known about a plugin binary after it was loaded once,
+// keyed by the file path, and valid as long as mtime and size match.
+typedef struct pluginmanifest_entry_s {
+    char *path;
+    int64_t mtime;
+    int64_t size;
+
+    int32_t type;
+    int16_t api_vmajor;
+    int16_t api_vminor;
+    int16_t version_major;
+    int16_t version_minor;
+    uint32_t flags;
+    uint32_t caps;
+
+    char *id;
+    char *name;
+    char *descr;
+    char *copyright;
+    char *website;
+    char *configdialog;
+
+    // NULL-terminated lists
+    char **exts;
+    char **prefixes;
+    char **schemes;
+
+    // the plugin can be loaded on first use
+    int deferrable;
+
+    // found on disk during current session, the stale entries are dropped on save
+    int seen;
+
+    struct pluginmanifest_entry_s *next;
+} pluginmanifest_entry_t;
+
+void
+pluginmanifest_load (void);
+
+int
+pluginmanifest_save (void);
+
+void
+pluginmanifest_free (void);
+
+// Returns the entry for the path, if it's up to date with the file stat
+pluginmanifest_entry_t *
+pluginmanifest_find (const char *path, const struct stat *st);
+
+// Record the loaded and started plugin, replacing the previous entry
+void
+pluginmanifest_update (const char *path, const struct stat *st, DB_plugin_t *plugin, int deferrable);
+
+// Drop the entry, e.g. when the deferred load failed
+void
+pluginmanifest_invalidate (pluginmanifest_entry_t *entry);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* pluginmanifest_h */
@@ -69,6 +69,9 @@
 #include "cocoautil.h"
 #endif
 #include "viz.h"
+#include "pluginmanifest.h"
+#include "realtime.h"
+#include "decoderdispatch.h"
 
 DB_plugin_t main_plugin = {
     .type = DB_PLUGIN_MISC,
@@ -94,11 +97,15 @@ const char *lowprio_plugin_ids[] = {
     NULL
 };
 
+struct lazy_decoder_s;
+
 // internal plugin list
 typedef struct plugin_s {
     void *handle;
     char *filepath;
     DB_plugin_t *plugin;
+    // non-NULL for the decoders registered from the manifest, which are dlopened on first use
+    struct lazy_decoder_s *lazy;
     struct plugin_s *next;
 } plugin_t;
 
@@ -137,10 +144,35 @@ static DB_playlist_t *g_playlist_plugins[MAX_PLAYLIST_PLUGINS+1];
 static uintptr_t background_jobs_mutex;
 static int num_background_jobs;
 
+// Decoders known from the plugin manifest are registered as proxies,
+// which carry the cached plugin info (id, name, exts, etc), and a set of entry points
+// loading the real plugin on first call.
+// After loading, the plugin lists are switched to the real plugin pointer,
+// while the callers still holding the proxy keep calling the real plugin through the proxy entry points.
+typedef struct lazy_decoder_s {
+    ddb_decoder2_t decoder;
+    int slot;
+    char *filepath;
+    char *loadsym;
+    pluginmanifest_entry_t *manifest;
+    plugin_t *owner;
+    DB_decoder_t *real;
+    int failed;
+} lazy_decoder_t;
+
+static int lazy_load_enabled;
+static uintptr_t lazy_mutex;
+static lazy_decoder_t *lazy_decoders[MAX_DECODER_PLUGINS];
+
 static void
 _viz_spectrum_listen_stub (void *ctx, void (*callback)(void *ctx, const ddb_audio_data_t *data)) {
 }
 
+static int
+_thread_promote_realtime (void) {
+    return rt_thread_promote (RT_THREAD_OUTPUT);
+}
+
 // deadbeef api
 static DB_functions_t deadbeef_api = {
     .vmajor = DB_API_VERSION_MAJOR,
@@ -533,6 +565,10 @@ static DB_functions_t deadbeef_api = {
     .plt_insert_dir3 = (ddb_playItem_t *(*) (int visibility, uint32_t flags, ddb_playlist_t *plt, ddb_playItem_t *after, const char *dirname, int *pabort, int (*callback)(ddb_insert_file_result_t result, const char *fname, void *user_data), void *user_data))plt_insert_dir3,
 
     .streamer_get_playing_track_safe = (DB_playItem_t *(*) (void))streamer_get_playing_track,
+
+    .streamer_read_acquire = streamer_read_acquire,
+    .streamer_read_commit = streamer_read_commit,
+    .thread_promote_realtime = _thread_promote_realtime,
 };
 
 DB_functions_t *deadbeef = &deadbeef_api;
@@ -647,13 +683,11 @@ plug_playback_set_pos (float pos) {
     streamer_set_seek (t);
 }
 
-int
-plug_init_plugin (DB_plugin_t* (*loadfunc)(DB_functions_t *), void *handle) {
-    DB_plugin_t *plugin_api = loadfunc (&deadbeef_api);
-    if (!plugin_api) {
-        return -1;
-    }
+static void
+_lazy_decoder_free (lazy_decoder_t *lazy);
 
+static plugin_t *
+_plug_register_plugin (DB_plugin_t *plugin_api, void *handle) {
     // check if same plugin with the same or bigger version is loaded already
     plugin_t *prev = NULL;
     for (plugin_t *p = plugins; p; prev = p, p = p->next) {
@@ -673,12 +707,16 @@ plug_init_plugin (DB_plugin_t* (*loadfunc)(DB_functions_t *), void *handle) {
                 if (p->handle) {
                     dlclose (p->handle);
                 }
+                if (p->lazy) {
+                    _lazy_decoder_free (p->lazy);
+                }
+                free (p->filepath);
                 free (p);
                 break;
             }
             else {
                 trace_err ("found copy of plugin \"%s\" (%s), but newer version is already loaded\n", plugin_api->id, plugin_api->name)
-                return -1;
+                return NULL;
             }
         }
     }
@@ -689,7 +727,7 @@ plug_init_plugin (DB_plugin_t* (*loadfunc)(DB_functions_t *), void *handle) {
         if (DB_API_VERSION_MAJOR != 9 || DB_API_VERSION_MINOR != 9) {
             if (plugin_api->api_vmajor != DB_API_VERSION_MAJOR || plugin_api->api_vminor > DB_API_VERSION_MINOR) {
                 trace_err ("WARNING: plugin \"%s\" wants API v%d.%d (got %d.%d), will not be loaded\n", plugin_api->name, plugin_api->api_vmajor, plugin_api->api_vminor, DB_API_VERSION_MAJOR, DB_API_VERSION_MINOR);
-                return -1;
+                return NULL;
             }
         }
     }
@@ -730,9 +768,307 @@ plug_init_plugin (DB_plugin_t* (*loadfunc)(DB_functions_t *), void *handle) {
         }
     }
 
+    return plug;
+}
+
+int
+plug_init_plugin (DB_plugin_t* (*loadfunc)(DB_functions_t *), void *handle) {
+    DB_plugin_t *plugin_api = loadfunc (&deadbeef_api);
+    if (!plugin_api) {
+        return -1;
+    }
+    return _plug_register_plugin (plugin_api, handle) ? 0 : -1;
+}
+
+#pragma mark - Lazy decoders
+
+static DB_decoder_t *
+_lazy_decoder_resolve (int slot) {
+    lazy_decoder_t *lazy = lazy_decoders[slot];
+    mutex_lock (lazy_mutex);
+    if (lazy->real || lazy->failed) {
+        mutex_unlock (lazy_mutex);
+        return lazy->real;
+    }
+
+    trace ("loading deferred plugin %s\n", lazy->filepath);
+    DB_plugin_t *plugin_api = NULL;
+    void *handle = dlopen (lazy->filepath, RTLD_NOW);
+    if (!handle) {
+        trace_err ("dlopen error: %s\n", dlerror ());
+        goto error;
+    }
+    DB_plugin_t *(*plug_load)(DB_functions_t *api) = dlsym (handle, lazy->loadsym);
+    if (!plug_load) {
+        trace_err ("dlsym error: %s (%s)\n", dlerror (), lazy->loadsym);
+        goto error;
+    }
+    plugin_api = plug_load (&deadbeef_api);
+    if (!plugin_api
+        || plugin_api->type != DB_PLUGIN_DECODER
+        || !plugin_api->id
+        || strcmp (plugin_api->id, lazy->manifest->id)) {
+        trace_err ("deferred plugin %s doesn't match the manifest\n", lazy->filepath);
+        plugin_api = NULL;
+        goto error;
+    }
+    if (plugin_api->start && plugin_api->start () < 0) {
+        trace_err ("plugin %s failed to start, deactivated.\n", plugin_api->name);
+        if (plugin_api->stop) {
+            plugin_api->stop ();
+        }
+        plugin_api = NULL;
+        goto error;
+    }
+
+    lazy->owner->handle = handle;
+    lazy->real = (DB_decoder_t *)plugin_api;
+
+    // the proxy is never modified, since other threads may be reading it
+    DB_plugin_t *proxy = &lazy->decoder.decoder.plugin;
+    __atomic_store_n (&lazy->owner->plugin, plugin_api, __ATOMIC_RELEASE);
+    for (int i = 0; g_plugins[i]; i++) {
+        if (g_plugins[i] == proxy) {
+            __atomic_store_n (&g_plugins[i], plugin_api, __ATOMIC_RELEASE);
+        }
+    }
+    for (int i = 0; g_decoder_plugins[i]; i++) {
+        if (&g_decoder_plugins[i]->plugin == proxy) {
+            __atomic_store_n (&g_decoder_plugins[i], lazy->real, __ATOMIC_RELEASE);
+        }
+    }
+    mutex_unlock (lazy_mutex);
+    return lazy->real;
+
+error:
+    if (handle) {
+        dlclose (handle);
+    }
+    lazy->failed = 1;
+    // load normally next time, to report the errors, and to refresh the manifest
+    pluginmanifest_invalidate (lazy->manifest);
+    pluginmanifest_save ();
+    mutex_unlock (lazy_mutex);
+    return NULL;
+}
+
+// The entry points, which may be called before the plugin is loaded.
+// Since the decoder API doesn't pass the plugin pointer to these,
+// each proxy gets its own set, bound to the slot index.
+#define LAZY_DECODER_SLOT(n)\
+static DB_fileinfo_t *_lazy_open_##n (uint32_t hints) {\
+    DB_decoder_t *dec = _lazy_decoder_resolve (n);\
+    return dec ? dec->open (hints) : NULL;\
+}\
+static DB_fileinfo_t *_lazy_open2_##n (uint32_t hints, DB_playItem_t *it) {\
+    DB_decoder_t *dec = _lazy_decoder_resolve (n);\
+    return dec ? dec->open2 (hints, it) : NULL;\
+}\
+static DB_playItem_t *_lazy_insert_##n (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname) {\
+    DB_decoder_t *dec = _lazy_decoder_resolve (n);\
+    return dec ? dec->insert (plt, after, fname) : NULL;\
+}\
+static int _lazy_read_metadata_##n (DB_playItem_t *it) {\
+    DB_decoder_t *dec = _lazy_decoder_resolve (n);\
+    return dec ? dec->read_metadata (it) : -1;\
+}\
+static int _lazy_write_metadata_##n (DB_playItem_t *it) {\
+    DB_decoder_t *dec = _lazy_decoder_resolve (n);\
+    return dec ? dec->write_metadata (it) : -1;\
+}
+
+LAZY_DECODER_SLOT(0) LAZY_DECODER_SLOT(1) LAZY_DECODER_SLOT(2) LAZY_DECODER_SLOT(3) LAZY_DECODER_SLOT(4)
+LAZY_DECODER_SLOT(5) LAZY_DECODER_SLOT(6) LAZY_DECODER_SLOT(7) LAZY_DECODER_SLOT(8) LAZY_DECODER_SLOT(9)
+LAZY_DECODER_SLOT(10) LAZY_DECODER_SLOT(11) LAZY_DECODER_SLOT(12) LAZY_DECODER_SLOT(13) LAZY_DECODER_SLOT(14)
+LAZY_DECODER_SLOT(15) LAZY_DECODER_SLOT(16) LAZY_DECODER_SLOT(17) LAZY_DECODER_SLOT(18) LAZY_DECODER_SLOT(19)
+LAZY_DECODER_SLOT(20) LAZY_DECODER_SLOT(21) LAZY_DECODER_SLOT(22) LAZY_DECODER_SLOT(23) LAZY_DECODER_SLOT(24)
+LAZY_DECODER_SLOT(25) LAZY_DECODER_SLOT(26) LAZY_DECODER_SLOT(27) LAZY_DECODER_SLOT(28) LAZY_DECODER_SLOT(29)
+LAZY_DECODER_SLOT(30) LAZY_DECODER_SLOT(31) LAZY_DECODER_SLOT(32) LAZY_DECODER_SLOT(33) LAZY_DECODER_SLOT(34)
+LAZY_DECODER_SLOT(35) LAZY_DECODER_SLOT(36) LAZY_DECODER_SLOT(37) LAZY_DECODER_SLOT(38) LAZY_DECODER_SLOT(39)
+LAZY_DECODER_SLOT(40) LAZY_DECODER_SLOT(41) LAZY_DECODER_SLOT(42) LAZY_DECODER_SLOT(43) LAZY_DECODER_SLOT(44)
+LAZY_DECODER_SLOT(45) LAZY_DECODER_SLOT(46) LAZY_DECODER_SLOT(47) LAZY_DECODER_SLOT(48) LAZY_DECODER_SLOT(49)
+
+#undef LAZY_DECODER_SLOT
+
+#define LAZY_DECODER_SLOT(n) { _lazy_open_##n, _lazy_open2_##n, _lazy_insert_##n, _lazy_read_metadata_##n, _lazy_write_metadata_##n },
+
+static const struct {
+    DB_fileinfo_t *(*open) (uint32_t hints);
+    DB_fileinfo_t *(*open2) (uint32_t hints, DB_playItem_t *it);
+    DB_playItem_t *(*insert) (ddb_playlist_t *plt, DB_playItem_t *after, const char *fname);
+    int (*read_metadata) (DB_playItem_t *it);
+    int (*write_metadata) (DB_playItem_t *it);
+} lazy_decoder_slots[MAX_DECODER_PLUGINS] = {
+    LAZY_DECODER_SLOT(0) LAZY_DECODER_SLOT(1) LAZY_DECODER_SLOT(2) LAZY_DECODER_SLOT(3) LAZY_DECODER_SLOT(4)
+    LAZY_DECODER_SLOT(5) LAZY_DECODER_SLOT(6) LAZY_DECODER_SLOT(7) LAZY_DECODER_SLOT(8) LAZY_DECODER_SLOT(9)
+    LAZY_DECODER_SLOT(10) LAZY_DECODER_SLOT(11) LAZY_DECODER_SLOT(12) LAZY_DECODER_SLOT(13) LAZY_DECODER_SLOT(14)
+    LAZY_DECODER_SLOT(15) LAZY_DECODER_SLOT(16) LAZY_DECODER_SLOT(17) LAZY_DECODER_SLOT(18) LAZY_DECODER_SLOT(19)
+    LAZY_DECODER_SLOT(20) LAZY_DECODER_SLOT(21) LAZY_DECODER_SLOT(22) LAZY_DECODER_SLOT(23) LAZY_DECODER_SLOT(24)
+    LAZY_DECODER_SLOT(25) LAZY_DECODER_SLOT(26) LAZY_DECODER_SLOT(27) LAZY_DECODER_SLOT(28) LAZY_DECODER_SLOT(29)
+    LAZY_DECODER_SLOT(30) LAZY_DECODER_SLOT(31) LAZY_DECODER_SLOT(32) LAZY_DECODER_SLOT(33) LAZY_DECODER_SLOT(34)
+    LAZY_DECODER_SLOT(35) LAZY_DECODER_SLOT(36) LAZY_DECODER_SLOT(37) LAZY_DECODER_SLOT(38) LAZY_DECODER_SLOT(39)
+    LAZY_DECODER_SLOT(40) LAZY_DECODER_SLOT(41) LAZY_DECODER_SLOT(42) LAZY_DECODER_SLOT(43) LAZY_DECODER_SLOT(44)
+    LAZY_DECODER_SLOT(45) LAZY_DECODER_SLOT(46) LAZY_DECODER_SLOT(47) LAZY_DECODER_SLOT(48) LAZY_DECODER_SLOT(49)
+};
+
+#undef LAZY_DECODER_SLOT
+
+// The functions taking DB_fileinfo_t can only be called after open,
+// which means the plugin is loaded, and fileinfo->plugin points to the real plugin.
+static int
+_lazy_init (DB_fileinfo_t *info, DB_playItem_t *it) {
+    return info->plugin->init (info, it);
+}
+
+static void
+_lazy_free (DB_fileinfo_t *info) {
+    info->plugin->free (info);
+}
+
+static int
+_lazy_read (DB_fileinfo_t *info, char *buffer, int nbytes) {
+    return info->plugin->read (info, buffer, nbytes);
+}
+
+static int
+_lazy_seek (DB_fileinfo_t *info, float seconds) {
+    return info->plugin->seek (info, seconds);
+}
+
+static int
+_lazy_seek_sample (DB_fileinfo_t *info, int sample) {
+    return info->plugin->seek_sample (info, sample);
+}
+
+static int
+_lazy_seek_sample64 (DB_fileinfo_t *info, int64_t sample) {
+    return ((ddb_decoder2_t *)info->plugin)->seek_sample64 (info, sample);
+}
+
+static int
+_lazy_numvoices (DB_fileinfo_t *info) {
+    return info->plugin->numvoices (info);
+}
+
+static void
+_lazy_mutevoice (DB_fileinfo_t *info, int voice, int mute) {
+    info->plugin->mutevoice (info, voice, mute);
+}
+
+static int
+_lazy_decoder_register (const char *fullname, const char *loadsym, pluginmanifest_entry_t *entry) {
+    int slot;
+    for (slot = 0; slot < MAX_DECODER_PLUGINS && lazy_decoders[slot]; slot++);
+    if (slot == MAX_DECODER_PLUGINS) {
+        return -1;
+    }
+
+    lazy_decoder_t *lazy = calloc (1, sizeof (lazy_decoder_t));
+    lazy->slot = slot;
+    lazy->filepath = strdup (fullname);
+    lazy->loadsym = strdup (loadsym);
+    lazy->manifest = entry;
+
+    DB_decoder_t *dec = &lazy->decoder.decoder;
+    dec->plugin.type = entry->type;
+    dec->plugin.api_vmajor = entry->api_vmajor;
+    dec->plugin.api_vminor = entry->api_vminor;
+    dec->plugin.version_major = entry->version_major;
+    dec->plugin.version_minor = entry->version_minor;
+    dec->plugin.flags = entry->flags;
+    dec->plugin.id = entry->id;
+    dec->plugin.name = entry->name;
+    dec->plugin.descr = entry->descr;
+    dec->plugin.copyright = entry->copyright;
+    dec->plugin.website = entry->website;
+    dec->plugin.configdialog = entry->configdialog;
+
+    dec->open = lazy_decoder_slots[slot].open;
+    dec->init = _lazy_init;
+    dec->free = _lazy_free;
+    dec->read = _lazy_read;
+    dec->seek = _lazy_seek;
+    dec->seek_sample = _lazy_seek_sample;
+    dec->exts = (const char **)entry->exts;
+    dec->prefixes = (const char **)entry->prefixes;
+    if (entry->caps & PLUGINMANIFEST_CAP_OPEN2) {
+        dec->open2 = lazy_decoder_slots[slot].open2;
+    }
+    if (entry->caps & PLUGINMANIFEST_CAP_INSERT) {
+        dec->insert = lazy_decoder_slots[slot].insert;
+    }
+    if (entry->caps & PLUGINMANIFEST_CAP_READ_METADATA) {
+        dec->read_metadata = lazy_decoder_slots[slot].read_metadata;
+    }
+    if (entry->caps & PLUGINMANIFEST_CAP_WRITE_METADATA) {
+        dec->write_metadata = lazy_decoder_slots[slot].write_metadata;
+    }
+    if (entry->caps & PLUGINMANIFEST_CAP_NUMVOICES) {
+        dec->numvoices = _lazy_numvoices;
+        dec->mutevoice = _lazy_mutevoice;
+    }
+    if (entry->caps & PLUGINMANIFEST_CAP_SEEK_SAMPLE64) {
+        lazy->decoder.seek_sample64 = _lazy_seek_sample64;
+    }
+
+    plugin_t *plug = _plug_register_plugin (&dec->plugin, NULL);
+    if (!plug) {
+        free (lazy->filepath);
+        free (lazy->loadsym);
+        free (lazy);
+        return -1;
+    }
+    plug->filepath = strdup (fullname);
+    plug->lazy = lazy;
+    lazy->owner = plug;
+    lazy_decoders[slot] = lazy;
+    trace ("deferred loading plugin %s\n", fullname);
     return 0;
 }
 
+static void
+_lazy_decoder_free (lazy_decoder_t *lazy) {
+    lazy_decoders[lazy->slot] = NULL;
+    free (lazy->filepath);
+    free (lazy->loadsym);
+    free (lazy);
+}
+
+// Decoders which don't hook into the UI or other plugins can be loaded on first use.
+// The plugins handling messages are loaded immediately, since the proxy can't receive them,
+// and they may update their state (e.g. sndfile rebuilds the extension list on config changes).
+static int
+_plugin_is_deferrable (DB_plugin_t *plugin) {
+    if (plugin->type != DB_PLUGIN_DECODER || !plugin->id) {
+        return 0;
+    }
+    if (plugin->connect || plugin->get_actions || plugin->exec_cmdline || plugin->command || plugin->message) {
+        return 0;
+    }
+    // low priority plugins compute their extension lists from config
+    for (int n = 0; lowprio_plugin_ids[n]; n++) {
+        if (!strcmp (lowprio_plugin_ids[n], plugin->id)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void
+_update_manifest (plugin_t *head) {
+    for (plugin_t *p = head; p; p = p->next) {
+        if (!p->handle || !p->filepath || p->lazy) {
+            continue;
+        }
+        struct stat s;
+        if (0 != stat (p->filepath, &s)) {
+            continue;
+        }
+        pluginmanifest_update (p->filepath, &s, p->plugin, _plugin_is_deferrable (p->plugin));
+    }
+    pluginmanifest_save ();
+}
+
 static int dirent_alphasort (const struct dirent **a, const struct dirent **b) {
     return strcmp ((*a)->d_name, (*b)->d_name);
 }
@@ -748,6 +1084,7 @@ plug_remove_plugin (void *p) {
     for (i = 0; g_decoder_plugins[i]; i++) {
         if (g_decoder_plugins[i] == p) {
             memmove (&g_decoder_plugins[i], &g_decoder_plugins[i+1], (MAX_DECODER_PLUGINS+1-i-1) * sizeof (void*));
+            decoder_dispatch_invalidate ();
             break;
         }
     }
@@ -795,6 +1132,25 @@ load_plugin (const char *plugdir, char *d_name, int l) {
         return -1;
     }
 
+    if (lazy_load_enabled) {
+        pluginmanifest_entry_t *entry = pluginmanifest_find (fullname, &s);
+        if (entry && entry->deferrable) {
+            d_name[l-sizeof (PLUGINEXT)+1] = 0;
+            strcat (d_name, "_load");
+#ifndef ANDROID
+            const char *loadsym = d_name;
+#else
+            const char *loadsym = d_name+3;
+#endif
+            if (!_lazy_decoder_register (fullname, loadsym, entry)) {
+                return 0;
+            }
+            // restore the name, and load normally
+            d_name[l-sizeof (PLUGINEXT)+1] = 0;
+            strcat (d_name, PLUGINEXT);
+        }
+    }
+
     trace ("loading plugin %s/%s\n", plugdir, d_name);
     void *handle = dlopen (fullname, RTLD_NOW);
     if (!handle) {
@@ -836,12 +1192,14 @@ load_plugin (const char *plugdir, char *d_name, int l) {
         }
         return 0;
     }
-    if (plug_init_plugin (plug_load, handle) < 0) {
+    DB_plugin_t *plugin_api = plug_load (&deadbeef_api);
+    plugin_t *plug = plugin_api ? _plug_register_plugin (plugin_api, handle) : NULL;
+    if (!plug) {
         d_name[l-sizeof (PLUGINEXT)+1] = 0;
         dlclose (handle);
         return -1;
     }
-    plugins_tail->filepath = strdup (fullname);
+    plug->filepath = strdup (fullname);
     return 0;
 }
 
@@ -1012,6 +1370,12 @@ plug_load_all (void) {
 
     background_jobs_mutex = mutex_create ();
 
+    lazy_load_enabled = conf_get_int ("plugins.lazy_load", 1);
+    if (lazy_load_enabled) {
+        lazy_mutex = mutex_create ();
+        pluginmanifest_load ();
+    }
+
     const char *dirname = plug_get_system_dir (DDB_SYS_DIR_PLUGIN);
 
     // remember how many plugins to skip if called Nth time
@@ -1228,10 +1592,16 @@ plug_load_all (void) {
         prev = plug;
         plug = plug->next;
     }
+
+    if (lazy_load_enabled) {
+        _update_manifest (prev_plugins_tail ? prev_plugins_tail->next : plugins);
+    }
+
 //    trace ("numplugins: %d, numdecoders: %d, numvfs: %d\n", numplugins, numdecoders, numvfs);
     g_plugins[numplugins] = NULL;
     g_decoder_plugins[numdecoders] = NULL;
     g_vfs_plugins[numvfs] = NULL;
+    decoder_dispatch_invalidate ();
     g_output_plugins[numoutput] = NULL;
     g_dsp_plugins[numdsp] = NULL;
     g_playlist_plugins[numplaylist] = NULL;
@@ -1335,10 +1705,18 @@ _plug_unload_stop_complete (void) {
         if (plugins->handle) {
             dlclose (plugins->handle);
         }
+        if (plugins->lazy) {
+            _lazy_decoder_free (plugins->lazy);
+        }
         free (plugins->filepath);
         free (plugins);
         plugins = next;
     }
+    pluginmanifest_free ();
+    if (lazy_mutex) {
+        mutex_free (lazy_mutex);
+        lazy_mutex = 0;
+    }
     for (int i = 0; g_gui_names[i]; i++) {
         free (g_gui_names[i]);
         g_gui_names[i] = NULL;
@@ -1349,6 +1727,7 @@ _plug_unload_stop_complete (void) {
     memset (g_gui_names, 0, sizeof (g_gui_names));
     g_num_gui_names = 0;
     memset (g_decoder_plugins, 0, sizeof (g_decoder_plugins));
+    decoder_dispatch_invalidate ();
     memset (g_vfs_plugins, 0, sizeof (g_vfs_plugins));
     memset (g_dsp_plugins, 0, sizeof (g_dsp_plugins));
     memset (g_output_plugins, 0, sizeof (g_output_plugins));
@@ -1396,6 +1775,7 @@ plug_set_output (DB_output_t *out) {
 void
 plug_cleanup (void) {
     plug_free_decoder_ids ();
+    decoder_dispatch_free ();
 }
 
 struct DB_decoder_s **
@@ -1701,6 +2081,7 @@ plug_register_in (DB_plugin_t *inplug) {
     for (i = 0; g_decoder_plugins[i]; i++);
     g_decoder_plugins[i++] = (DB_decoder_t *)inplug;
     g_decoder_plugins[i] = NULL;
+    decoder_dispatch_invalidate ();
 }
 
 // for tests
@@ -173,6 +173,9 @@ plug_register_in (DB_plugin_t *inplug);
 void
 plug_register_out (DB_plugin_t *outplug);
 
+void
+plug_remove_plugin (void *p);
+
 DB_functions_t *
 plug_get_api (void);
 
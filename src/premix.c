@@ -28,6 +28,7 @@
 #include <assert.h>
 #include <string.h>
 #include <stdlib.h>
+#include <math.h>
 #include <deadbeef/deadbeef.h>
 #include <deadbeef/fastftoi.h>
 #include "premix.h"
@@ -592,3 +593,236 @@ pcm_convert (const ddb_waveformat_t * restrict inputfmt, const char * restrict i
     return nsamples * outputsamplesize;
 }
 
+
+// Fused gain + format conversion.
+// Samples are processed in chunks through a small float buffer, which stays in L1,
+// so that the data is only read and written once.
+
+#if defined(__SSE2__) || defined(__x86_64__) || (defined(_MSC_VER) && defined(_WIN64))
+#define PCM_GAIN_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#define PCM_GAIN_CHUNK 1024
+
+// Round to nearest, same as _mm_cvtps_epi32 in the vectorized paths.
+// ftoi truncates on some platforms, which would bias the output by half a step.
+static inline int32_t
+pcm_round (float f) {
+#if PCM_GAIN_SSE2
+    return _mm_cvtss_si32 (_mm_set_ss (f));
+#else
+    return (int32_t)lrintf (f);
+#endif
+}
+
+static void
+pcm_load_float (const ddb_waveformat_t * restrict fmt, const char * restrict input, float * restrict out, int n) {
+    int i = 0;
+    if (fmt->is_float) {
+        memcpy (out, input, n * sizeof (float));
+        return;
+    }
+    switch (fmt->bps) {
+    case 8: {
+        const int8_t *in = (const int8_t *)input;
+        for (; i < n; i++) {
+            out[i] = in[i] / (float)0x80;
+        }
+        break;
+    }
+    case 16: {
+        const int16_t *in = (const int16_t *)input;
+#if PCM_GAIN_SSE2
+        const __m128 scale = _mm_set1_ps (1.f / 0x8000);
+        for (; i + 8 <= n; i += 8) {
+            __m128i s = _mm_loadu_si128 ((const __m128i *)(in + i));
+            // sign-extend to 32 bit by unpacking into the high halves and shifting back
+            __m128i lo = _mm_srai_epi32 (_mm_unpacklo_epi16 (s, s), 16);
+            __m128i hi = _mm_srai_epi32 (_mm_unpackhi_epi16 (s, s), 16);
+            _mm_storeu_ps (out + i, _mm_mul_ps (_mm_cvtepi32_ps (lo), scale));
+            _mm_storeu_ps (out + i + 4, _mm_mul_ps (_mm_cvtepi32_ps (hi), scale));
+        }
+#endif
+        for (; i < n; i++) {
+            out[i] = in[i] / (float)0x8000;
+        }
+        break;
+    }
+    case 24: {
+        const uint8_t *in = (const uint8_t *)input;
+        for (; i < n; i++, in += 3) {
+            int32_t sample = in[0] | (in[1]<<8) | ((int8_t)in[2]<<16);
+            out[i] = sample / (float)0x800000;
+        }
+        break;
+    }
+    case 32: {
+        const int32_t *in = (const int32_t *)input;
+        for (; i < n; i++) {
+            out[i] = in[i] / (float)0x80000000;
+        }
+        break;
+    }
+    }
+}
+
+static void
+pcm_store_float (const ddb_waveformat_t * restrict fmt, const float * restrict in, char * restrict output, int n, float gain) {
+    int i = 0;
+    if (fmt->is_float) {
+        // float output is not clipped, the DSP plugins and the output handle the headroom
+        float *out = (float *)output;
+        for (; i < n; i++) {
+            out[i] = in[i] * gain;
+        }
+        return;
+    }
+    switch (fmt->bps) {
+    case 8: {
+        int8_t *out = (int8_t *)output;
+        for (; i < n; i++) {
+            int sample = pcm_round (in[i] * gain * 0x80);
+            out[i] = (int8_t)(sample > 0x7f ? 0x7f : (sample < -0x80 ? -0x80 : sample));
+        }
+        break;
+    }
+    case 16: {
+        int16_t *out = (int16_t *)output;
+#if PCM_GAIN_SSE2
+        const __m128 scale = _mm_set1_ps (gain * 0x8000);
+        for (; i + 8 <= n; i += 8) {
+            __m128i lo = _mm_cvtps_epi32 (_mm_mul_ps (_mm_loadu_ps (in + i), scale));
+            __m128i hi = _mm_cvtps_epi32 (_mm_mul_ps (_mm_loadu_ps (in + i + 4), scale));
+            // packs saturates to the int16 range
+            _mm_storeu_si128 ((__m128i *)(out + i), _mm_packs_epi32 (lo, hi));
+        }
+#endif
+        for (; i < n; i++) {
+            int sample = pcm_round (in[i] * gain * 0x8000);
+            out[i] = (int16_t)(sample > 0x7fff ? 0x7fff : (sample < -0x8000 ? -0x8000 : sample));
+        }
+        break;
+    }
+    case 24: {
+        uint8_t *out = (uint8_t *)output;
+        for (; i < n; i++, out += 3) {
+            int32_t sample = pcm_round (in[i] * gain * 0x800000);
+            sample = sample > 0x7fffff ? 0x7fffff : (sample < -0x800000 ? -0x800000 : sample);
+            out[0] = (sample&0x0000ff);
+            out[1] = (sample&0x00ff00)>>8;
+            out[2] = (sample&0xff0000)>>16;
+        }
+        break;
+    }
+    case 32: {
+        int32_t *out = (int32_t *)output;
+        for (; i < n; i++) {
+            // 0x7fffffff is not representable in float, so clip at 1.0 before scaling
+            float sample = in[i] * gain;
+            if (sample >= 1.f) {
+                out[i] = INT32_MAX;
+            }
+            else if (sample <= -1.f) {
+                out[i] = INT32_MIN;
+            }
+            else {
+                out[i] = pcm_round (sample * (float)0x80000000);
+            }
+        }
+        break;
+    }
+    }
+}
+
+// 32 bit integer samples would lose precision in float, so these are scaled in fixed point
+static void
+pcm_gain_int32 (const int32_t *in, int32_t *out, int n, float gain) {
+    int64_t vol = (int64_t)(gain * 0x10000);
+    for (int i = 0; i < n; i++) {
+        int64_t sample = ((int64_t)in[i] * vol) >> 16;
+        out[i] = (int32_t)(sample > INT32_MAX ? INT32_MAX : (sample < INT32_MIN ? INT32_MIN : sample));
+    }
+}
+
+static int
+pcm_is_int32 (const ddb_waveformat_t *fmt) {
+    return fmt->bps == 32 && !fmt->is_float;
+}
+
+void
+pcm_apply_gain (const ddb_waveformat_t *fmt, char *bytes, int size, float gain) {
+    if (gain == 1.f) {
+        return;
+    }
+    int samplesize = fmt->bps >> 3;
+    int n = size / samplesize;
+    if (pcm_is_int32 (fmt)) {
+        pcm_gain_int32 ((const int32_t *)bytes, (int32_t *)bytes, n, gain);
+        return;
+    }
+
+    fpu_control ctl = 0;
+    (void)ctl;
+    fpu_setround (&ctl);
+    float temp[PCM_GAIN_CHUNK];
+    while (n > 0) {
+        int chunk = n < PCM_GAIN_CHUNK ? n : PCM_GAIN_CHUNK;
+        pcm_load_float (fmt, bytes, temp, chunk);
+        pcm_store_float (fmt, temp, bytes, chunk, gain);
+        bytes += chunk * samplesize;
+        n -= chunk;
+    }
+    fpu_restore (ctl);
+}
+
+int
+pcm_convert_with_gain (const ddb_waveformat_t * restrict inputfmt, const char * restrict input, const ddb_waveformat_t * restrict outputfmt, char * restrict output, int inputsize, float gain) {
+    // channel remapping is left to pcm_convert, the gain goes on top of that
+    if (inputfmt->channels != outputfmt->channels || inputfmt->channelmask != outputfmt->channelmask) {
+        int outputsize = pcm_convert (inputfmt, input, outputfmt, output, inputsize);
+        pcm_apply_gain (outputfmt, output, outputsize, gain);
+        return outputsize;
+    }
+
+    int inputsamplesize = (inputfmt->bps >> 3) * inputfmt->channels;
+    int outputsamplesize = (outputfmt->bps >> 3) * outputfmt->channels;
+    int nsamples = inputsize / inputsamplesize;
+    int n = nsamples * inputfmt->channels;
+
+    if (inputfmt->bps == outputfmt->bps && inputfmt->is_float == outputfmt->is_float) {
+        if (gain == 1.f) {
+            memcpy (output, input, nsamples * outputsamplesize);
+            return nsamples * outputsamplesize;
+        }
+        if (pcm_is_int32 (inputfmt)) {
+            pcm_gain_int32 ((const int32_t *)input, (int32_t *)output, n, gain);
+            return nsamples * outputsamplesize;
+        }
+    }
+
+    int in_ss = inputfmt->bps >> 3;
+    int out_ss = outputfmt->bps >> 3;
+
+    fpu_control ctl = 0;
+    (void)ctl;
+    fpu_setround (&ctl);
+    float temp[PCM_GAIN_CHUNK];
+    while (n > 0) {
+        int chunk = n < PCM_GAIN_CHUNK ? n : PCM_GAIN_CHUNK;
+        if (inputfmt->is_float) {
+            // no need to copy float input through the temp buffer
+            pcm_store_float (outputfmt, (const float *)input, output, chunk, gain);
+        }
+        else {
+            pcm_load_float (inputfmt, input, temp, chunk);
+            pcm_store_float (outputfmt, temp, output, chunk, gain);
+        }
+        input += chunk * in_ss;
+        output += chunk * out_ss;
+        n -= chunk;
+    }
+    fpu_restore (ctl);
+
+    return nsamples * outputsamplesize;
+}
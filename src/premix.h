@@ -39,6 +39,17 @@ extern "C" {
 int
 pcm_convert (const ddb_waveformat_t * restrict inputfmt, const char * restrict input, const ddb_waveformat_t * restrict outputfmt, char * restrict output, int inputsize);
 
+// Same as pcm_convert, but also scales the samples by `gain`, clipping integer output to its range.
+// Float output is not clipped. Matching channel layouts are converted in a single pass,
+// rounding to nearest.
+// @returns number of output bytes
+int
+pcm_convert_with_gain (const ddb_waveformat_t * restrict inputfmt, const char * restrict input, const ddb_waveformat_t * restrict outputfmt, char * restrict output, int inputsize, float gain);
+
+// Scales the samples in place by `gain`, clipping integer samples to the format range.
+void
+pcm_apply_gain (const ddb_waveformat_t *fmt, char *bytes, int size, float gain);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,336 @@
+/*
+    DeaDBeeF -- the music player
+    Copyright (C) 2009-2023 Oleksiy Yakovenko and other contributors
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <errno.h>
+#include <pthread.h>
+#ifndef _WIN32
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <dlfcn.h>
+#endif
+#include "realtime.h"
+#include "conf.h"
+
+#define RT_CHECK_SITES 64
+
+typedef struct {
+    const char *file; // allocation site
+    int line;
+    void *site; // lock wait site
+    unsigned count;
+} rt_check_site_t;
+
+// A buffer locked by rt_mem_lock
+typedef struct {
+    char *ptr;
+    size_t size;
+} rt_locked_range_t;
+
+__thread int rt_thread_checked;
+
+// The role passed to rt_thread_promote, or -1 if the thread was not promoted,
+// and the settings generation which was last applied to the thread
+static __thread int _rt_thread_role = -1;
+static __thread int _rt_thread_generation;
+static __thread int _rt_thread_promoted;
+
+static int _rt_enabled;
+static int _rt_priority;
+static int _rt_check_enabled;
+
+static pthread_mutex_t _rt_check_mutex = PTHREAD_MUTEX_INITIALIZER;
+static rt_check_site_t _rt_alloc_sites[RT_CHECK_SITES];
+static rt_check_site_t _rt_lock_sites[RT_CHECK_SITES];
+static size_t _rt_locked_bytes;
+static rt_locked_range_t *_rt_locked_ranges;
+static int _rt_locked_count;
+static int _rt_locked_reserved;
+static int _rt_promoted_threads;
+static int _rt_failed_threads;
+static int _rt_generation;
+
+void
+rt_configchanged (void) {
+    int enabled = conf_get_int ("streamer.realtime", 0);
+    int priority = conf_get_int ("streamer.realtime_priority", 50);
+    int check_enabled = conf_get_int ("streamer.realtime_check", 0);
+    if (enabled == _rt_enabled && priority == _rt_priority && check_enabled == _rt_check_enabled) {
+        return;
+    }
+    _rt_enabled = enabled;
+    _rt_priority = priority;
+    _rt_check_enabled = check_enabled;
+    // the promoted threads pick up the change in rt_thread_update
+    __atomic_add_fetch (&_rt_generation, 1, __ATOMIC_RELEASE);
+}
+
+static int
+_rt_thread_apply (void) {
+    rt_thread_role_t role = (rt_thread_role_t)_rt_thread_role;
+    _rt_thread_generation = __atomic_load_n (&_rt_generation, __ATOMIC_ACQUIRE);
+    rt_thread_checked = role == RT_THREAD_OUTPUT && _rt_check_enabled;
+#ifndef _WIN32
+    if (!_rt_enabled) {
+        if (_rt_thread_promoted) {
+            struct sched_param param = { .sched_priority = 0 };
+            pthread_setschedparam (pthread_self (), SCHED_OTHER, &param);
+            _rt_thread_promoted = 0;
+            pthread_mutex_lock (&_rt_check_mutex);
+            _rt_promoted_threads--;
+            pthread_mutex_unlock (&_rt_check_mutex);
+        }
+        return -1;
+    }
+
+    int min = sched_get_priority_min (SCHED_FIFO);
+    int max = sched_get_priority_max (SCHED_FIFO);
+
+    // the output thread drains the buffer which the streamer fills, so it goes first
+    int prio = _rt_priority - (role == RT_THREAD_STREAMER ? 5 : 0);
+    if (prio < min) {
+        prio = min;
+    }
+    if (prio > max) {
+        prio = max;
+    }
+
+    struct sched_param param = { .sched_priority = prio };
+    int err = pthread_setschedparam (pthread_self (), SCHED_FIFO, &param);
+    pthread_mutex_lock (&_rt_check_mutex);
+    if (err == 0) {
+        if (!_rt_thread_promoted) {
+            _rt_promoted_threads++;
+        }
+    }
+    else {
+        _rt_failed_threads++;
+    }
+    pthread_mutex_unlock (&_rt_check_mutex);
+    if (err != 0) {
+        fprintf (stderr, "realtime: failed to set SCHED_FIFO priority %d: %s%s\n", prio, strerror (err), err == EPERM ? " (RLIMIT_RTPRIO needs to allow it, e.g. via limits.conf)" : "");
+        return -1;
+    }
+    _rt_thread_promoted = 1;
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+int
+rt_thread_promote (rt_thread_role_t role) {
+    _rt_thread_role = role;
+    return _rt_thread_apply ();
+}
+
+int
+rt_thread_get_role (void) {
+    return _rt_thread_role;
+}
+
+void
+rt_thread_update (void) {
+    if (_rt_thread_role < 0 || _rt_thread_generation == __atomic_load_n (&_rt_generation, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+    _rt_thread_apply ();
+}
+
+void
+rt_mem_lock (void *ptr, size_t size) {
+    if (!_rt_enabled || !ptr || !size) {
+        return;
+    }
+#ifndef _WIN32
+    pthread_mutex_lock (&_rt_check_mutex);
+    if (_rt_locked_count == _rt_locked_reserved) {
+        int reserved = _rt_locked_reserved ? _rt_locked_reserved * 2 : 32;
+        rt_locked_range_t *ranges = realloc (_rt_locked_ranges, reserved * sizeof (rt_locked_range_t));
+        if (!ranges) {
+            pthread_mutex_unlock (&_rt_check_mutex);
+            return;
+        }
+        _rt_locked_ranges = ranges;
+        _rt_locked_reserved = reserved;
+    }
+    // mlock faults the pages in, so there are no page faults on first access either
+    if (mlock (ptr, size) != 0) {
+        pthread_mutex_unlock (&_rt_check_mutex);
+        fprintf (stderr, "realtime: failed to lock %zu bytes: %s\n", size, strerror (errno));
+        return;
+    }
+    _rt_locked_ranges[_rt_locked_count].ptr = ptr;
+    _rt_locked_ranges[_rt_locked_count].size = size;
+    _rt_locked_count++;
+    _rt_locked_bytes += size;
+    pthread_mutex_unlock (&_rt_check_mutex);
+#endif
+}
+
+#ifndef _WIN32
+// called with _rt_check_mutex locked
+static int
+_rt_page_is_locked (uintptr_t page, size_t pagesize) {
+    for (int i = 0; i < _rt_locked_count; i++) {
+        uintptr_t start = (uintptr_t)_rt_locked_ranges[i].ptr;
+        if (start < page + pagesize && start + _rt_locked_ranges[i].size > page) {
+            return 1;
+        }
+    }
+    return 0;
+}
+#endif
+
+void
+rt_mem_unlock (void *ptr, size_t size) {
+    if (!ptr || !size) {
+        return;
+    }
+#ifndef _WIN32
+    pthread_mutex_lock (&_rt_check_mutex);
+    int i;
+    for (i = 0; i < _rt_locked_count; i++) {
+        if (_rt_locked_ranges[i].ptr == ptr && _rt_locked_ranges[i].size == size) {
+            break;
+        }
+    }
+    if (i == _rt_locked_count) {
+        // not locked by rt_mem_lock, e.g. allocated before the real-time mode was enabled
+        pthread_mutex_unlock (&_rt_check_mutex);
+        return;
+    }
+    _rt_locked_ranges[i] = _rt_locked_ranges[--_rt_locked_count];
+    _rt_locked_bytes -= size;
+
+    // Locks don't stack: munlock unlocks the whole pages, even if another buffer still needs them.
+    // The buffers don't overlap, so only the first and the last page can be shared.
+    size_t pagesize = (size_t)sysconf (_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t)ptr & ~(pagesize - 1);
+    uintptr_t end = ((uintptr_t)ptr + size + pagesize - 1) & ~(pagesize - 1);
+    if (_rt_page_is_locked (start, pagesize)) {
+        start += pagesize;
+    }
+    if (end > start && _rt_page_is_locked (end - pagesize, pagesize)) {
+        end -= pagesize;
+    }
+    if (end > start) {
+        munlock ((void *)start, end - start);
+    }
+    pthread_mutex_unlock (&_rt_check_mutex);
+#endif
+}
+
+// called with _rt_check_mutex locked
+static rt_check_site_t *
+_rt_check_site (rt_check_site_t *sites, const char *file, int line, void *site) {
+    for (int i = 0; i < RT_CHECK_SITES; i++) {
+        rt_check_site_t *s = &sites[i];
+        if (s->file == file && s->line == line && s->site == site && s->count) {
+            return s;
+        }
+        if (!s->count) {
+            s->file = file;
+            s->line = line;
+            s->site = site;
+            return s;
+        }
+    }
+    return NULL;
+}
+
+void
+rt_report_alloc (const char *file, int line) {
+    pthread_mutex_lock (&_rt_check_mutex);
+    rt_check_site_t *s = _rt_check_site (_rt_alloc_sites, file, line, NULL);
+    int first = s && !s->count;
+    if (s) {
+        s->count++;
+    }
+    pthread_mutex_unlock (&_rt_check_mutex);
+    if (first) {
+        fprintf (stderr, "realtime: allocation on the audio thread at %s:%d\n", file, line);
+    }
+}
+
+void
+rt_report_lock_wait (void *site) {
+    // the mutex is taken directly, since mutex_lock reports to here
+    pthread_mutex_lock (&_rt_check_mutex);
+    rt_check_site_t *s = _rt_check_site (_rt_lock_sites, NULL, 0, site);
+    int first = s && !s->count;
+    if (s) {
+        s->count++;
+    }
+    pthread_mutex_unlock (&_rt_check_mutex);
+    if (first) {
+        fprintf (stderr, "realtime: lock wait on the audio thread at %p\n", site);
+    }
+}
+
+static int
+_rt_format_site (char *buffer, size_t size, const rt_check_site_t *s) {
+    if (s->file) {
+        return snprintf (buffer, size, "  %s:%d: %u\n", s->file, s->line, s->count);
+    }
+#ifndef _WIN32
+    Dl_info info;
+    if (dladdr (s->site, &info) && info.dli_sname) {
+        return snprintf (buffer, size, "  %s+0x%lx: %u\n", info.dli_sname, (unsigned long)((char *)s->site - (char *)info.dli_saddr), s->count);
+    }
+#endif
+    return snprintf (buffer, size, "  %p: %u\n", s->site, s->count);
+}
+
+void
+rt_format_report (char *buffer, size_t size) {
+    *buffer = 0;
+    pthread_mutex_lock (&_rt_check_mutex);
+    int n = snprintf (buffer, size, "realtime: %s, priority %d, threads promoted: %d, failed: %d, locked memory: %zu bytes\n",
+                      _rt_enabled ? "enabled" : "disabled", _rt_priority, _rt_promoted_threads, _rt_failed_threads, _rt_locked_bytes);
+    if (!_rt_check_enabled) {
+        if (n >= 0 && n < size) {
+            snprintf (buffer + n, size - n, "audio thread checks are disabled, set streamer.realtime_check=1 to enable\n");
+        }
+        pthread_mutex_unlock (&_rt_check_mutex);
+        return;
+    }
+    const struct {
+        const char *title;
+        rt_check_site_t *sites;
+    } lists[] = {
+        { "allocations on the audio thread:\n", _rt_alloc_sites },
+        { "lock waits on the audio thread:\n", _rt_lock_sites },
+    };
+    for (int l = 0; l < 2 && n >= 0 && n < size; l++) {
+        n += snprintf (buffer + n, size - n, "%s", lists[l].title);
+        for (int i = 0; i < RT_CHECK_SITES && lists[l].sites[i].count && n >= 0 && n < size; i++) {
+            n += _rt_format_site (buffer + n, size - n, &lists[l].sites[i]);
+        }
+    }
+    pthread_mutex_unlock (&_rt_check_mutex);
+}
@@ -0,0 +1,85 @@
+/*
+    DeaDBeeF -- the music player
+    Copyright (C) 2009-2023 Oleksiy Yakovenko and other contributors
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef realtime_h
+#define realtime_h
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    RT_THREAD_STREAMER,
+    RT_THREAD_OUTPUT,
+} rt_thread_role_t;
+
+// Set on the threads which are checked for allocations and lock waits
+extern __thread int rt_thread_checked;
+
+// Reads the streamer.realtime* settings, called on startup and on every config change
+void
+rt_configchanged (void);
+
+// When streamer.realtime is enabled, switches the calling thread to real-time scheduling.
+// When streamer.realtime_check is enabled, output threads are also marked for checking.
+// @return 0 if the thread is running with real-time priority
+int
+rt_thread_promote (rt_thread_role_t role);
+
+// @return the role which the calling thread passed to rt_thread_promote, or -1
+int
+rt_thread_get_role (void);
+
+// Re-applies the settings to a thread which called rt_thread_promote, if they changed since then.
+// Cheap enough to be called on every iteration of the audio threads.
+void
+rt_thread_update (void);
+
+// Pre-fault and lock the memory in RAM when streamer.realtime is enabled, no-op otherwise.
+// Only the buffers allocated while the real-time mode is enabled are locked.
+void
+rt_mem_lock (void *ptr, size_t size);
+
+// Unlocks a buffer locked by rt_mem_lock, keeping the pages shared with other locked buffers locked
+void
+rt_mem_unlock (void *ptr, size_t size);
+
+void
+rt_report_alloc (const char *file, int line);
+
+void
+rt_report_lock_wait (void *site);
+
+// Place at allocations which are not expected on the audio thread during playback
+#define rt_check_alloc() { if (rt_thread_checked) { rt_report_alloc (__FILE__, __LINE__); } }
+
+void
+rt_format_report (char *buffer, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* realtime_h */
@@ -256,8 +256,11 @@ apply_replay_gain_int32 (ddb_replaygain_settings_t *settings, char *bytes, int s
     }
 }
 
-void
-apply_replay_gain_float32 (ddb_replaygain_settings_t *settings, char *bytes, int size) {
+float
+replaygain_get_amp (ddb_replaygain_settings_t *settings) {
+    if (settings->processing_flags == 0) {
+        return 1.f;
+    }
     float vol = 1.f;
     int mode = _get_source_mode (settings->source_mode);
     switch (mode) {
@@ -289,6 +292,17 @@ apply_replay_gain_float32 (ddb_replaygain_settings_t *settings, char *bytes, int
         break;
     }
 
+    return vol;
+}
+
+float
+replaygain_get_current_amp (void) {
+    return replaygain_get_amp (&current_settings);
+}
+
+void
+apply_replay_gain_float32 (ddb_replaygain_settings_t *settings, char *bytes, int size) {
+    float vol = replaygain_get_amp (settings);
     if (vol == 1) {
         return;
     }
@@ -41,6 +41,13 @@ replaygain_apply_with_settings (ddb_replaygain_settings_t *settings, ddb_wavefor
 void
 replaygain_set_current (ddb_replaygain_settings_t *settings);
 
+// @returns the linear amplification factor for the settings, 1 if no replaygain should be applied
+float
+replaygain_get_amp (ddb_replaygain_settings_t *settings);
+
+float
+replaygain_get_current_amp (void);
+
 void
 apply_replay_gain_int8 (ddb_replaygain_settings_t *settings, char *bytes, int size);
 
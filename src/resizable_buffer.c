@@ -22,19 +22,24 @@
 */
 
 #include "resizable_buffer.h"
+#include "realtime.h"
 #include <string.h>
 
 void
 resizable_buffer_ensure_size(resizable_buffer_t *buffer, size_t size) {
     if (buffer->size < size) {
+        rt_check_alloc ();
+        rt_mem_unlock (buffer->buffer, buffer->size);
         free (buffer->buffer);
         buffer->buffer = calloc (1, size);
         buffer->size = size;
+        rt_mem_lock (buffer->buffer, buffer->size);
     }
 }
 
 void
 resizable_buffer_deinit (resizable_buffer_t *buffer) {
+    rt_mem_unlock (buffer->buffer, buffer->size);
     free (buffer->buffer);
     memset (buffer, 0, sizeof (resizable_buffer_t));
 }
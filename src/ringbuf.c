@@ -26,8 +26,20 @@
 */
 
 #include <string.h>
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#include <unistd.h>
+#include <stdlib.h>
+#endif
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
 #include "ringbuf.h"
 
+// The positions are plain uint64_t, shared between the producer and the consumer threads
+#define load_acquire(x) __atomic_load_n (&(x), __ATOMIC_ACQUIRE)
+#define store_release(x, v) __atomic_store_n (&(x), (v), __ATOMIC_RELEASE)
+
 void
 ringbuf_init (ringbuf_t *p, char *buffer, size_t size) {
     memset (p, 0, sizeof (ringbuf_t));
@@ -35,74 +47,159 @@ ringbuf_init (ringbuf_t *p, char *buffer, size_t size) {
     p->size = size;
 }
 
+#if !defined(_WIN32) && (defined(__linux__) || defined(__APPLE__))
+static int
+_mirror_open_fd (void) {
+#if defined(__linux__) && defined(SYS_memfd_create)
+    return (int)syscall (SYS_memfd_create, "ddb_ringbuf", 0);
+#else
+    char path[] = "/tmp/ddb_ringbuf.XXXXXX";
+    int fd = mkstemp (path);
+    if (fd >= 0) {
+        unlink (path);
+    }
+    return fd;
+#endif
+}
+
+int
+ringbuf_init_mirrored (ringbuf_t *p, size_t size) {
+    long pagesize = sysconf (_SC_PAGESIZE);
+    if (pagesize <= 0) {
+        return -1;
+    }
+    size = (size + pagesize - 1) / pagesize * pagesize;
+
+    int fd = _mirror_open_fd ();
+    if (fd < 0) {
+        return -1;
+    }
+    if (ftruncate (fd, size) != 0) {
+        close (fd);
+        return -1;
+    }
+
+    // reserve the address range, then map the same file over both halves of it
+    char *addr = mmap (NULL, size * 2, PROT_NONE, MAP_PRIVATE | MAP_ANON, -1, 0);
+    if (addr == MAP_FAILED) {
+        close (fd);
+        return -1;
+    }
+    if (mmap (addr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != addr
+        || mmap (addr + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != addr + size) {
+        munmap (addr, size * 2);
+        close (fd);
+        return -1;
+    }
+    close (fd);
+
+    ringbuf_init (p, addr, size);
+    p->mirrored = 1;
+    return 0;
+}
+#else
+int
+ringbuf_init_mirrored (ringbuf_t *p, size_t size) {
+    return -1;
+}
+#endif
+
 void
 ringbuf_deinit (ringbuf_t *p) {
+#if !defined(_WIN32)
+    if (p->mirrored) {
+        munmap (p->bytes, p->size * 2);
+    }
+#endif
     memset (p, 0, sizeof (ringbuf_t));
 }
 
-
 void
 ringbuf_flush (ringbuf_t *p) {
-    p->cursor = 0;
-    p->remaining = 0;
+    store_release (p->read_pos, load_acquire (p->write_pos));
     memset (p->bytes, 0, p->size);
 }
 
-int
-ringbuf_write (ringbuf_t *p, char *bytes, size_t size) {
-    if (p->size - p->remaining < size) {
-        return -1;
-    }
+size_t
+ringbuf_get_remaining (ringbuf_t *p) {
+    return (size_t)(load_acquire (p->write_pos) - load_acquire (p->read_pos));
+}
 
-    size_t cursor = p->cursor + p->remaining;
-    cursor %= p->size;
+size_t
+ringbuf_get_free (ringbuf_t *p) {
+    return p->size - ringbuf_get_remaining (p);
+}
+
+uint64_t
+ringbuf_get_read_pos (ringbuf_t *p) {
+    return load_acquire (p->read_pos);
+}
 
-    if (p->size - cursor >= size) { // split
+uint64_t
+ringbuf_get_write_pos (ringbuf_t *p) {
+    return load_acquire (p->write_pos);
+}
+
+static void
+_copy_in (ringbuf_t *p, uint64_t pos, const char *bytes, size_t size) {
+    size_t cursor = (size_t)(pos % p->size);
+    size_t n = p->size - cursor;
+    if (p->mirrored || n >= size) {
         memcpy (p->bytes + cursor, bytes, size);
-        p->remaining += size;
     }
     else {
-        size_t n = p->size - cursor;
-        if (n > 0) {
-            memcpy (p->bytes + cursor, bytes, n);
-            p->remaining += n;
-            size -= n;
-            bytes += n;
-        }
-        memcpy (p->bytes, bytes, size);
-        p->remaining += size;
+        memcpy (p->bytes + cursor, bytes, n);
+        memcpy (p->bytes, bytes + n, size - n);
+    }
+}
+
+static void
+_copy_out (ringbuf_t *p, size_t cursor, char *bytes, size_t size) {
+    size_t n = p->size - cursor;
+    if (p->mirrored || n >= size) {
+        memcpy (bytes, p->bytes + cursor, size);
+    }
+    else {
+        memcpy (bytes, p->bytes + cursor, n);
+        memcpy (bytes + n, p->bytes, size - n);
+    }
+}
+
+int
+ringbuf_write (ringbuf_t *p, char *bytes, size_t size) {
+    uint64_t write_pos = p->write_pos;
+    uint64_t read_pos = load_acquire (p->read_pos);
+    if (p->size - (size_t)(write_pos - read_pos) < size) {
+        return -1;
+    }
+
+    if (size != 0) {
+        _copy_in (p, write_pos, bytes, size);
     }
+    store_release (p->write_pos, write_pos + size);
     return 0;
 }
 
 size_t
 ringbuf_read_int (ringbuf_t * restrict p, char *bytes, size_t size, int keep, off_t offset) {
-    if (p->remaining < size) {
-        size = p->remaining;
+    uint64_t read_pos = p->read_pos;
+    size_t remaining = (size_t)(load_acquire (p->write_pos) - read_pos);
+    if (remaining < size) {
+        size = remaining;
+    }
+    if (size == 0) {
+        return 0;
     }
 
-    off_t cursor = p->cursor + offset;
+    off_t cursor = (off_t)(read_pos % p->size) + offset;
     if (cursor < 0) {
         cursor += p->size;
     }
 
-    size_t readsize1 = p->size - cursor;
-    size_t readsize2 = 0;
-    if (readsize1 < size) {
-        readsize2 = size - readsize1;
-    }
-    else {
-        readsize1 = size;
-    }
-    memcpy (bytes, p->bytes + cursor, readsize1);
-    if (readsize2 != 0) {
-        memcpy (bytes + readsize1, p->bytes, readsize2);
-    }
+    _copy_out (p, (size_t)cursor, bytes, size);
 
     if (!keep) {
-        p->remaining -= size;
-        p->cursor += size;
-        p->cursor %= p->size;
+        store_release (p->read_pos, read_pos + size);
     }
     return size;
 }
@@ -121,3 +218,55 @@ size_t
 ringbuf_read_keep_offset (ringbuf_t *p, char *bytes, size_t size, off_t offset) {
     return ringbuf_read_int(p, bytes, size, 1, offset);
 }
+
+char *
+ringbuf_read_acquire (ringbuf_t *p, size_t *avail) {
+    if (p->size == 0) {
+        *avail = 0;
+        return p->bytes;
+    }
+    uint64_t read_pos = p->read_pos;
+    size_t size = (size_t)(load_acquire (p->write_pos) - read_pos);
+    size_t cursor = (size_t)(read_pos % p->size);
+    if (!p->mirrored && size > p->size - cursor) {
+        size = p->size - cursor;
+    }
+    *avail = size;
+    return p->bytes + cursor;
+}
+
+void
+ringbuf_read_commit (ringbuf_t *p, size_t size) {
+    uint64_t read_pos = p->read_pos;
+    size_t remaining = (size_t)(load_acquire (p->write_pos) - read_pos);
+    if (size > remaining) {
+        size = remaining;
+    }
+    store_release (p->read_pos, read_pos + size);
+}
+
+char *
+ringbuf_write_acquire (ringbuf_t *p, size_t *avail) {
+    if (p->size == 0) {
+        *avail = 0;
+        return p->bytes;
+    }
+    uint64_t write_pos = p->write_pos;
+    size_t size = p->size - (size_t)(write_pos - load_acquire (p->read_pos));
+    size_t cursor = (size_t)(write_pos % p->size);
+    if (!p->mirrored && size > p->size - cursor) {
+        size = p->size - cursor;
+    }
+    *avail = size;
+    return p->bytes + cursor;
+}
+
+void
+ringbuf_write_commit (ringbuf_t *p, size_t size) {
+    uint64_t write_pos = p->write_pos;
+    size_t free_size = p->size - (size_t)(write_pos - load_acquire (p->read_pos));
+    if (size > free_size) {
+        size = free_size;
+    }
+    store_release (p->write_pos, write_pos + size);
+}
@@ -28,27 +28,57 @@
 #define __RINGBUF_H
 
 #include <sys/types.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// Single-producer / single-consumer ring buffer.
+// The write position is only advanced by the producer, and the read position only by the consumer,
+// so one thread may write while another one reads, without locking.
+// ringbuf_flush and ringbuf_read_keep_offset into the history are consumer-side operations,
+// and must not run concurrently with the producer.
+// The positions are 64 bit, so that they never wrap, even on 32 bit platforms.
 typedef struct {
     char *bytes;
     size_t size;
-    size_t cursor;
-    size_t remaining;
+    uint64_t read_pos; // monotonic, owned by the consumer
+    uint64_t write_pos; // monotonic, owned by the producer
+    int mirrored; // the second half of the mapping mirrors the first one
 } ringbuf_t;
 
 void
 ringbuf_init (ringbuf_t *p, char *buffer, size_t size);
 
+// Allocate a ring buffer, which is mapped twice back-to-back in memory,
+// so that reads and writes never need to be split at the wrap point.
+// The size is rounded up to the page size.
+// @return 0 on success, -1 if mirrored mappings are not supported.
+int
+ringbuf_init_mirrored (ringbuf_t *p, size_t size);
+
+// Also releases the memory allocated by ringbuf_init_mirrored
 void
 ringbuf_deinit (ringbuf_t *p);
 
 void
 ringbuf_flush (ringbuf_t *p);
 
+size_t
+ringbuf_get_remaining (ringbuf_t *p);
+
+size_t
+ringbuf_get_free (ringbuf_t *p);
+
+// The total number of bytes read from (or written to) the ring since it was initialized.
+// Safe to call from either thread.
+uint64_t
+ringbuf_get_read_pos (ringbuf_t *p);
+
+uint64_t
+ringbuf_get_write_pos (ringbuf_t *p);
+
 int
 ringbuf_write (ringbuf_t *p, char *bytes, size_t size);
 
@@ -61,6 +91,21 @@ ringbuf_read_keep (ringbuf_t *p, char *bytes, size_t size);
 size_t
 ringbuf_read_keep_offset (ringbuf_t *p, char *bytes, size_t size, off_t offset);
 
+// Zero-copy access: the acquire functions return a pointer to the largest contiguous
+// readable (or writable) region, and its size in *avail; the commit functions advance
+// the ring by the number of bytes actually consumed (or produced).
+char *
+ringbuf_read_acquire (ringbuf_t *p, size_t *avail);
+
+void
+ringbuf_read_commit (ringbuf_t *p, size_t size);
+
+char *
+ringbuf_write_acquire (ringbuf_t *p, size_t *avail);
+
+void
+ringbuf_write_commit (ringbuf_t *p, size_t size);
+
 #ifdef __cplusplus
 }
 #endif
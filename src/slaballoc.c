@@ -0,0 +1,125 @@
+/*
+    DeaDBeeF -- the music player
+    Copyright (C) 2009-2023 Oleksiy Yakovenko and other contributors
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "slaballoc.h"
+
+typedef struct slab_s {
+    struct slab_s *next;
+    // objects follow, aligned to 16 bytes
+} slab_t;
+
+typedef struct slab_free_object_s {
+    struct slab_free_object_s *next;
+} slab_free_object_t;
+
+struct slab_allocator_s {
+    size_t object_size;
+    size_t objects_per_slab;
+    slab_t *slabs;
+    slab_free_object_t *free_list;
+
+    // the next never used object in the last slab
+    char *fresh;
+    char *fresh_end;
+
+    size_t objects_used;
+    size_t objects_free;
+    size_t slab_count;
+};
+
+#define SLAB_HEADER_SIZE ((sizeof (slab_t) + 15) & ~15)
+
+slab_allocator_t *
+slab_allocator_create (size_t object_size, size_t objects_per_slab) {
+    slab_allocator_t *allocator = calloc (1, sizeof (slab_allocator_t));
+    if (object_size < sizeof (slab_free_object_t)) {
+        object_size = sizeof (slab_free_object_t);
+    }
+    // keep the objects pointer-aligned
+    allocator->object_size = (object_size + sizeof (void *) - 1) & ~(sizeof (void *) - 1);
+    allocator->objects_per_slab = objects_per_slab;
+    return allocator;
+}
+
+void
+slab_allocator_free (slab_allocator_t *allocator) {
+    slab_t *slab = allocator->slabs;
+    while (slab) {
+        slab_t *next = slab->next;
+        free (slab);
+        slab = next;
+    }
+    free (allocator);
+}
+
+void *
+slab_alloc (slab_allocator_t *allocator) {
+    void *ptr;
+    if (allocator->free_list) {
+        ptr = allocator->free_list;
+        allocator->free_list = allocator->free_list->next;
+        allocator->objects_free--;
+    }
+    else {
+        if (allocator->fresh == allocator->fresh_end) {
+            slab_t *slab = malloc (SLAB_HEADER_SIZE + allocator->object_size * allocator->objects_per_slab);
+            if (!slab) {
+                return NULL;
+            }
+            slab->next = allocator->slabs;
+            allocator->slabs = slab;
+            allocator->slab_count++;
+            allocator->fresh = (char *)slab + SLAB_HEADER_SIZE;
+            allocator->fresh_end = allocator->fresh + allocator->object_size * allocator->objects_per_slab;
+        }
+        ptr = allocator->fresh;
+        allocator->fresh += allocator->object_size;
+    }
+    allocator->objects_used++;
+    memset (ptr, 0, allocator->object_size);
+    return ptr;
+}
+
+void
+slab_free (slab_allocator_t *allocator, void *ptr) {
+    if (!ptr) {
+        return;
+    }
+    slab_free_object_t *obj = ptr;
+    obj->next = allocator->free_list;
+    allocator->free_list = obj;
+    allocator->objects_used--;
+    allocator->objects_free++;
+}
+
+void
+slab_allocator_get_stats (slab_allocator_t *allocator, slab_allocator_stats_t *stats) {
+    stats->object_size = allocator->object_size;
+    stats->objects_used = allocator->objects_used;
+    stats->objects_free = allocator->objects_free;
+    stats->slab_count = allocator->slab_count;
+    stats->bytes_allocated = allocator->slab_count * (SLAB_HEADER_SIZE + allocator->object_size * allocator->objects_per_slab);
+}
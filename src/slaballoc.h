@@ -0,0 +1,68 @@
+/*
+    DeaDBeeF -- the music player
+    Copyright (C) 2009-2023 Oleksiy Yakovenko and other contributors
+
+    This software is provided 'as-is', without any express or implied
+    warranty.  In no event will the authors be held liable for any damages
+    arising from the use of this software.
+
+    Permission is granted to anyone to use this software for any purpose,
+    including commercial applications, and to alter it and redistribute it
+    freely, subject to the following restrictions:
+
+    1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+
+    2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+
+    3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef slaballoc_h
+#define slaballoc_h
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Fixed size object allocator.
+// Objects are carved from large slabs, without per-allocation malloc overhead,
+// and the freed objects are reused via a free list.
+// The slabs are released only by slab_allocator_free.
+// Not thread safe, the callers are responsible for locking.
+typedef struct slab_allocator_s slab_allocator_t;
+
+typedef struct {
+    size_t object_size;
+    size_t objects_used;
+    size_t objects_free;
+    size_t slab_count;
+    size_t bytes_allocated;
+} slab_allocator_stats_t;
+
+slab_allocator_t *
+slab_allocator_create (size_t object_size, size_t objects_per_slab);
+
+void
+slab_allocator_free (slab_allocator_t *allocator);
+
+// Returns a zero-initialized object
+void *
+slab_alloc (slab_allocator_t *allocator);
+
+void
+slab_free (slab_allocator_t *allocator, void *ptr);
+
+void
+slab_allocator_get_stats (slab_allocator_t *allocator, slab_allocator_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* slaballoc_h */
@@ -57,6 +57,7 @@
 #include "dsp.h"
 #include "playmodes.h"
 #include "viz.h"
+#include "realtime.h"
 #include "fft.h"
 #ifdef __APPLE__
 #include "coreaudio.h"
@@ -131,21 +132,39 @@ static DB_fileinfo_t *new_fileinfo;
 static uint64_t new_fileinfo_file_identifier;
 static DB_vfs_t *new_fileinfo_file_vfs;
 
-// This counter is incremented by one for each streamer_read call, which returns -1,
-// which means audio should stop, but we need to wait a bit until buffered data has finished playing,
+// This counter is incremented by the fill thread every 50 ms after the streaming has finished
+// and the output ringbuffer has drained, which means audio should stop,
+// but we need to wait a bit until the data buffered by the output has finished playing,
 // so we wait AUDIO_STALL_WAIT periods
-#define AUDIO_STALL_WAIT 20
+#define AUDIO_STALL_WAIT 6
 static int _audio_stall_count;
 
 // to allow interruption of stall file requests
 static uint64_t streamer_file_identifier;
 static DB_vfs_t *streamer_file_vfs;
 
+// The output ringbuffer is allocated once, since it's written on the fill thread, and read by the output callback.
+// It needs to take a block upsampled from 8000 mono to the output format at once,
+// and to cover the fill thread latency at high sample rates.
+#define OUTPUT_RINGBUF_SIZE (2*1024*1024)
+
 static char *_int_output_buffer;
 static ringbuf_t _output_ringbuf;
+static intptr_t _fill_tid;
+// streamer_reset discards the data written so far by setting this to the write position,
+// the output callback skips up to it.
+static uint64_t _output_ringbuf_discard_pos;
+// The read position up to which the decoded blocks were advanced, protected by streamer_lock
+static uint64_t _output_ringbuf_consumed_pos;
+// Set after requesting an output format change, and cleared by the next streamer_read call,
+// after which the output plugin uses the new format.
+static int _output_format_change_pending;
+// Number of bytes at the read position of the output ringbuffer, which were returned by
+// streamer_read_acquire and already scaled by the soft volume, but not committed yet.
+// Only accessed on the output thread.
+static int _output_ringbuf_prepared;
 
 static resizable_buffer_t _dsp_process_buffer;
-static resizable_buffer_t _viz_read_buffer;
 
 #if defined(HAVE_XGUI) || defined(ANDROID)
 #include "equalizer.h"
@@ -195,6 +214,12 @@ stream_track (playItem_t *track, int startpaused);
 static void
 _handle_playback_stopped (void);
 
+static void
+_output_ringbuf_setup (void);
+
+static void
+_streamer_fill_thread (void *unused);
+
 static void
 _streamer_mark_album_played_up_to (playItem_t *item);
 
@@ -1521,9 +1546,7 @@ _update_buffering_state (void) {
     int buffering = (blocks_ready < 4) && streaming_track;
 
     if (buffering != streamer_is_buffering) {
-        streamer_lock();
-        streamer_is_buffering = buffering;
-        streamer_unlock();
+        __atomic_store_n (&streamer_is_buffering, buffering, __ATOMIC_RELEASE);
 
         // update buffering UI
         if (!buffering) {
@@ -1665,6 +1688,7 @@ streamer_thread (void *unused) {
 #if defined(__linux__) && !defined(ANDROID)
     prctl (PR_SET_NAME, "deadbeef-stream", 0, 0, 0, 0);
 #endif
+    rt_thread_promote (RT_THREAD_STREAMER);
 
     ddb_shuffle_t shuffle = (ddb_shuffle_t)-1;
     ddb_repeat_t repeat = (ddb_repeat_t)-1;
@@ -1680,6 +1704,7 @@ streamer_thread (void *unused) {
         struct timeval tm1;
         DB_output_t *output = plug_get_output ();
         gettimeofday (&tm1, NULL);
+        rt_thread_update ();
 
         while (!handler_pop (handler, &id, &ctx, &p1, &p2)) {
             switch (id) {
@@ -1748,8 +1773,8 @@ streamer_thread (void *unused) {
 
         if (!fileinfo_curr) {
             // HACK: This is to overcome the output plugin API limitation.
-            // We count the number of times the output plugin has starved,
-            // and stop playback after counter reaches the limit.
+            // The fill thread counts the periods after the output plugin has played out the buffered data,
+            // and we stop playback after counter reaches the limit.
             // The correct way to solve this is to add a `drain` API.
             if (_audio_stall_count >= AUDIO_STALL_WAIT) {
                 output->stop ();
@@ -1876,7 +1901,10 @@ streamer_init (void) {
     streamer_ctmap = NULL;
     streamer_ctmap = ddb_ctmap_init_from_string (conf_network_ctmapping);
 
+    _output_ringbuf_setup ();
+
     streamer_tid = thread_start (streamer_thread, NULL);
+    _fill_tid = thread_start (_streamer_fill_thread, NULL);
     return 0;
 }
 
@@ -1889,6 +1917,8 @@ streamer_free (void) {
     streamer_abort_files ();
     streaming_terminate = 1;
     thread_join (streamer_tid);
+    thread_join (_fill_tid);
+    _fill_tid = 0;
 
     streamreader_free ();
     decoded_blocks_free ();
@@ -1926,12 +1956,12 @@ streamer_free (void) {
     playpos = 0;
     playtime = 0;
 
+    rt_mem_unlock (_output_ringbuf.bytes, _output_ringbuf.size);
     ringbuf_deinit(&_output_ringbuf);
     free (_int_output_buffer);
     _int_output_buffer = NULL;
 
     resizable_buffer_deinit(&_dsp_process_buffer);
-    resizable_buffer_deinit(&_viz_read_buffer);
 }
 
 void
@@ -1945,58 +1975,34 @@ streamer_reset (int full) { // must be called when current song changes by exter
     streamreader_reset ();
     decoded_blocks_reset();
     dsp_reset ();
-    ringbuf_flush(&_output_ringbuf);
+    // the fill thread only writes with streamer_lock held, so the write position is stable here
+    uint64_t write_pos = ringbuf_get_write_pos (&_output_ringbuf);
+    __atomic_store_n (&_output_ringbuf_discard_pos, write_pos, __ATOMIC_RELEASE);
+    _output_ringbuf_consumed_pos = write_pos;
     streamer_unlock();
     viz_reset ();
 }
 
-static int
-process_output_block (streamblock_t *block, char *bytes, int bytes_available_size) {
-    DB_output_t *output = plug_get_output ();
-
-    if (block->pos < 0) {
-        return 0;
-    }
-
-    // A block with 0 size is a valid block, and needs to be processed as usual (code above this line).
-    // But here we do early exit, because there's no data to process in it.
-    if (!block->size) {
-        decoded_block_t *decoded_block = decoded_blocks_append();
-        if (decoded_block != NULL) {
-            decoded_block->track = block->track;
-            if (decoded_block->track != NULL) {
-                pl_item_ref (decoded_block->track);
-            }
-            decoded_block->last = block->last;
-            decoded_block->first = block->first;
-        }
-
-        streamreader_next_block ();
-        _update_buffering_state ();
-        return 0;
-    }
-
-    decoded_block_t *decoded_block = decoded_blocks_append();
-    if (decoded_block == NULL) {
-        return 0; // queue is full!
-    }
-
+// Applies replaygain, the DSP chain and the output format conversion to the block data.
+// When no DSP is active, this is done in a single pass.
+int
+streamer_process_block_data (streamblock_t *block, const ddb_waveformat_t *output_fmt, char *bytes, int bytes_available_size, float *out_dspratio) {
     assert (block->size > block->pos);
     int sz = block->size - block->pos;
+    char *input = block->buf + block->pos;
+    float rg_amp = block->replaygain_amp;
 
     ddb_waveformat_t datafmt; // comes either from dsp, or from input plugin
     memcpy (&datafmt, &block->fmt, sizeof (ddb_waveformat_t));
 
     char *dspbytes = NULL;
     int dspsize = 0;
-    float dspratio = 1;
-
+    *out_dspratio = 1;
 
 #if defined(ANDROID) || defined(HAVE_XGUI)
     // android EQ and resampling require 16 bit, so convert here if needed
     int tempsize = sz * 16 / block->fmt.bps;
     int16_t *temp_audio_data = NULL;
-    char *input = block->buf + block->pos;
     if (block->fmt.bps != 16) {
         temp_audio_data = alloca (tempsize);
         ddb_waveformat_t out_fmt = {
@@ -2008,35 +2014,41 @@ process_output_block (streamblock_t *block, char *bytes, int bytes_available_siz
             .is_bigendian = 0
         };
 
-        pcm_convert (&block->fmt, (char *)input, &out_fmt, (char *)temp_audio_data, sz);
+        pcm_convert_with_gain (&block->fmt, input, &out_fmt, (char *)temp_audio_data, sz, rg_amp);
         input = (char *)temp_audio_data;
         memcpy (&datafmt, &out_fmt, sizeof (ddb_waveformat_t));
         sz = tempsize;
     }
+    else {
+        pcm_apply_gain (&block->fmt, input, sz, rg_amp);
+    }
+    rg_amp = 1.f;
 
     extern void android_eq_apply (char *dspbytes, int dspsize);
     android_eq_apply (input, sz);
 
-    dsp_apply_simple_downsampler(datafmt.samplerate, datafmt.channels, input, sz, output->fmt.samplerate, &dspbytes, &dspsize);
-    datafmt.samplerate = output->fmt.samplerate;
+    dsp_apply_simple_downsampler(datafmt.samplerate, datafmt.channels, input, sz, output_fmt->samplerate, &dspbytes, &dspsize);
+    datafmt.samplerate = output_fmt->samplerate;
     sz = dspsize;
 #else
-    int dsp_res = dsp_apply (&block->fmt, block->buf + block->pos, sz,
-                             &datafmt, &dspbytes, &dspsize, &dspratio);
+    int dsp_res = dsp_apply (&block->fmt, input, sz, rg_amp,
+                             &datafmt, &dspbytes, &dspsize, out_dspratio);
     if (dsp_res) {
+        // the gain was applied when converting to the dsp format
         sz = dspsize;
+        rg_amp = 1.f;
     }
     else {
         memcpy (&datafmt, &block->fmt, sizeof (ddb_waveformat_t));
-        dspbytes = block->buf+block->pos;
+        dspbytes = input;
     }
 #endif
 
-    int need_convert = memcmp (&output->fmt, &datafmt, sizeof (ddb_waveformat_t));
+    int need_convert = memcmp (output_fmt, &datafmt, sizeof (ddb_waveformat_t));
     int required_size = 0;
     if (need_convert) {
         int input_ss = datafmt.channels * datafmt.bps/8;
-        int output_ss = output->fmt.channels * output->fmt.bps/8;
+        int output_ss = output_fmt->channels * output_fmt->bps/8;
         required_size = sz / input_ss * output_ss;
     }
     else {
@@ -2046,13 +2058,51 @@ process_output_block (streamblock_t *block, char *bytes, int bytes_available_siz
     // Crash here to catch the buffer issues early, instead of corrupting sound.
     assert(bytes_available_size >= required_size);
 
-    if (need_convert) {
-        sz = pcm_convert (&datafmt, dspbytes, &output->fmt, bytes, sz);
+    if (need_convert || rg_amp != 1.f) {
+        // without active DSP, this is the only pass over the samples
+        sz = pcm_convert_with_gain (&datafmt, dspbytes, output_fmt, bytes, sz, rg_amp);
     }
     else {
         memcpy (bytes, dspbytes, sz);
     }
 
+    return sz;
+}
+
+static int
+process_output_block (streamblock_t *block, char *bytes, int bytes_available_size) {
+    DB_output_t *output = plug_get_output ();
+
+    if (block->pos < 0) {
+        return 0;
+    }
+
+    // A block with 0 size is a valid block, and needs to be processed as usual (code above this line).
+    // But here we do early exit, because there's no data to process in it.
+    if (!block->size) {
+        decoded_block_t *decoded_block = decoded_blocks_append();
+        if (decoded_block != NULL) {
+            decoded_block->track = block->track;
+            if (decoded_block->track != NULL) {
+                pl_item_ref (decoded_block->track);
+            }
+            decoded_block->last = block->last;
+            decoded_block->first = block->first;
+        }
+
+        streamreader_next_block ();
+        _update_buffering_state ();
+        return 0;
+    }
+
+    decoded_block_t *decoded_block = decoded_blocks_append();
+    if (decoded_block == NULL) {
+        return 0; // queue is full!
+    }
+
+    float dspratio = 1;
+    int sz = streamer_process_block_data (block, &output->fmt, bytes, bytes_available_size, &dspratio);
+
     streamer_lock();
     decoded_block->track = block->track;
     if (decoded_block->track != NULL) {
@@ -2102,86 +2152,36 @@ streamer_apply_soft_volume (char *bytes, int sz) {
 
     float vol = volume_get_amp () * mod;
 
-    char *stream = bytes;
-    int bytesread = sz;
-    if (output->fmt.bps == 16) {
-        int16_t ivolume = (int16_t)(vol * 1000);
-        if (ivolume != 1000) {
-            int half = bytesread/2;
-            for (int i = 0; i < half; i++) {
-                int16_t sample = *((int16_t*)stream);
-                *((int16_t*)stream) = (int16_t)(((int32_t)sample) * ivolume / 1000);
-                stream += 2;
-            }
-        }
-    }
-    else if (output->fmt.bps == 8) {
-        int16_t ivolume = (int16_t)(vol * 255);
-        if (ivolume != 255) {
-            for (int i = 0; i < bytesread; i++) {
-                *stream = (int8_t)(((int32_t)(*stream)) * ivolume / 255);
-                stream++;
-            }
-        }
-    }
-    else if (output->fmt.bps == 24) {
-        int16_t ivolume = (int16_t)(vol * 1000);
-        if (ivolume != 1000) {
-            int third = bytesread/3;
-            for (int i = 0; i < third; i++) {
-                int32_t sample = ((unsigned char)stream[0]) | ((unsigned char)stream[1]<<8) | ((signed char)stream[2]<<16);
-                int32_t newsample = (int32_t)((int64_t)sample * ivolume / 1000);
-                stream[0] = (newsample&0x0000ff);
-                stream[1] = (newsample&0x00ff00)>>8;
-                stream[2] = (newsample&0xff0000)>>16;
-                stream += 3;
-            }
-        }
-    }
-    else if (output->fmt.bps == 32 && !output->fmt.is_float) {
-        int16_t ivolume = (int16_t)(vol * 1000);
-        if (ivolume != 1000) {
-            for (int i = 0; i < bytesread/4; i++) {
-                int32_t sample = *((int32_t*)stream);
-                int32_t newsample = (int32_t)((int64_t)sample * ivolume / 1000);
-                *((int32_t*)stream) = newsample;
-                stream += 4;
-            }
-        }
-    }
-    else if (output->fmt.bps == 32 && output->fmt.is_float) {
-        if (vol != 1.f) {
-            for (int i = 0; i < bytesread/4; i++) {
-                *((float*)stream) = (*((float*)stream)) * vol;
-                stream += 4;
-            }
-        }
-    }
+    // Volume is applied at the output side, so that changing it takes effect without the buffering delay
+    pcm_apply_gain (&output->fmt, bytes, sz, vol);
 }
 
+// Skips the data which was written to the output ringbuffer before the last streamer_reset.
+// Called on the output thread.
+// @return 1 if anything was skipped
 static int
-_streamer_get_bytes (char *bytes, int size) {
-    DB_output_t *output = plug_get_output ();
-
-    // consume decoded data
-    int sz = size;
-    if (!sz) {
-        // no data available
-        memset (bytes, 0, size);
-        return size;
+_output_ringbuf_apply_pending_flush (void) {
+    uint64_t discard_pos = __atomic_load_n (&_output_ringbuf_discard_pos, __ATOMIC_ACQUIRE);
+    uint64_t read_pos = ringbuf_get_read_pos (&_output_ringbuf);
+    if (read_pos >= discard_pos) {
+        return 0;
     }
+    ringbuf_read_commit (&_output_ringbuf, (size_t)(discard_pos - read_pos));
+    _output_ringbuf_prepared = 0;
+    return 1;
+}
 
-    // clip to frame size
-    int ss = output->fmt.channels * output->fmt.bps / 8;
-    if ((sz % ss) != 0) {
-        sz -= (sz % ss);
+// Advance the decoded block state by the output data, which was read by the output callback since the last call.
+// Must be called with streamer_lock held.
+static void
+_streamer_consume_output (void) {
+    uint64_t read_pos = ringbuf_get_read_pos (&_output_ringbuf);
+    if (read_pos <= _output_ringbuf_consumed_pos) {
+        return;
     }
+    int rb = (int)(read_pos - _output_ringbuf_consumed_pos);
+    _output_ringbuf_consumed_pos = read_pos;
 
-    int rb = sz;
-    char *writeptr = bytes;
-
-    // streamer_reset may clear all blocks, therefore need a lock
-    streamer_lock();
     while (rb > 0) {
         decoded_block_t *decoded_block = decoded_blocks_current();
         if (decoded_block == NULL) {
@@ -2195,8 +2195,6 @@ _streamer_get_bytes (char *bytes, int size) {
 
         if (decoded_block->remaining_bytes != 0) {
             size_t got_bytes = min (rb, decoded_block->remaining_bytes);
-            got_bytes = ringbuf_read(&_output_ringbuf, writeptr, got_bytes);
-            writeptr += got_bytes;
             rb -= got_bytes;
 
             decoded_block->remaining_bytes -= got_bytes;
@@ -2215,47 +2213,65 @@ _streamer_get_bytes (char *bytes, int size) {
             decoded_blocks_next();
         }
     }
+}
 
-    sz -= rb; // how many bytes we actually got
+static int
+_streamer_get_bytes (char *bytes, int size) {
+    DB_output_t *output = plug_get_output ();
 
-    streamer_unlock();
+    // consume decoded data
+    int sz = size;
+    if (!sz) {
+        // no data available
+        memset (bytes, 0, size);
+        return size;
+    }
+
+    // clip to frame size
+    int ss = output->fmt.channels * output->fmt.bps / 8;
+    if ((sz % ss) != 0) {
+        sz -= (sz % ss);
+    }
 
-    streamer_apply_soft_volume (bytes, sz);
+    _output_ringbuf_apply_pending_flush ();
+    sz = (int)ringbuf_read(&_output_ringbuf, bytes, sz);
 
-    return sz;
-}
+    // skip the data which was already processed by streamer_read_acquire
+    int prepared = min (sz, _output_ringbuf_prepared);
+    _output_ringbuf_prepared -= prepared;
 
-// @return latency buffer size
-static size_t
-_output_ringbuf_setup(const ddb_waveformat_t *fmt) {
-    // Need to be able to upsample from 8000 mono to the current format.
-    // Add some padding to allow multiple blocks to be decoded.
-    // FIXME: this could be improved by walking the current dsp chain, and calculating the real ratio.
-    size_t size = (size_t)(16384 * 1.5 * MAX_DSP_RATIO);
-    size_t latency = 0;
-#ifdef __APPLE__
-    // add 3 seconds of history for airplay latency / visualization compensation
-    latency = 3 * fmt->channels * fmt->samplerate * fmt->bps / 8;
+#ifndef ANDROID
+    viz_tap (&output->fmt, bytes + prepared, sz - prepared);
 #endif
-    size += latency;
 
-    if (size != _output_ringbuf.size) {
-        free (_int_output_buffer);
-        _int_output_buffer = malloc (size);
-        ringbuf_init(&_output_ringbuf, _int_output_buffer, size);
-    }
+    streamer_apply_soft_volume (bytes + prepared, sz - prepared);
 
-    return latency;
+    return sz;
 }
 
-// Decode enough blocks to fill the _output_buffer, and update avg_bitrate
 static void
+_output_ringbuf_setup (void) {
+    // Prefer the mirrored mapping, which lets the output read any amount of data in one piece
+    if (ringbuf_init_mirrored(&_output_ringbuf, OUTPUT_RINGBUF_SIZE) != 0) {
+        _int_output_buffer = malloc (OUTPUT_RINGBUF_SIZE);
+        ringbuf_init(&_output_ringbuf, _int_output_buffer, OUTPUT_RINGBUF_SIZE);
+    }
+    rt_mem_lock (_output_ringbuf.bytes, _output_ringbuf.size);
+}
+
+// Decode enough blocks to fill the output ringbuffer, and update avg_bitrate.
+// Called on the fill thread.
+// @return the time to wait before the next call, in microseconds
+static int
 _streamer_fill_playback_buffer(void) {
     streamer_lock ();
+    _streamer_consume_output ();
+
     streamblock_t *block = streamreader_get_curr_block();
     if (!block) {
         // NULL streaming_track means playback stopped,
         // otherwise just a buffer starvation (e.g. after seeking)
+        int stalled = 0;
         if (!streaming_track) {
             update_stop_after_current ();
             _handle_playback_stopped();
@@ -2263,53 +2279,69 @@ _streamer_fill_playback_buffer(void) {
             playtime = 0;
             avg_bitrate = -1;
             last_seekpos = -1;
-        }
-        else {
-            // this message is printed in more cases, than if output is broken, so disable it
-            // but keep for reference -- this is a good place to set breakpoint
-//            fprintf (stderr, "streamer: streamer_read has starved. The current output plugin might be broken\n");
+            // count only after the output has played everything out of the ringbuffer
+            if (ringbuf_get_remaining (&_output_ringbuf) == 0) {
+                _audio_stall_count++;
+                stalled = 1;
+            }
         }
         streamer_unlock();
 
-        if (streaming_track) {
-            return;
-        }
-        _audio_stall_count++;
-        return;
+        return stalled ? 50000 : 10000;
     }
 
     _audio_stall_count = 0;
 
+    if (__atomic_load_n (&_output_format_change_pending, __ATOMIC_ACQUIRE)) {
+        // the output didn't switch to the new format yet
+        streamer_unlock ();
+        return 5000;
+    }
+
     int block_bitrate = -1;
 
     // only decode until the next format change
     // decode enough blocks to fill the output buffer
     resizable_buffer_ensure_size(&_dsp_process_buffer, block->size * MAX_DSP_RATIO);
 
-    size_t latency = _output_ringbuf_setup(&plug_get_output ()->fmt);
-
     while (block != NULL
            && decoded_blocks_have_free()
            && decoded_blocks_playback_time_total() < conf_playback_buffer_size
-           && (_output_ringbuf.size - _output_ringbuf.remaining - latency) >= block->size * MAX_DSP_RATIO
+           && ringbuf_get_free(&_output_ringbuf) >= block->size * MAX_DSP_RATIO
            && !memcmp (&block->fmt, &last_block_fmt, sizeof (ddb_waveformat_t))) {
-        int rb = process_output_block (block, _dsp_process_buffer.buffer, block->size * MAX_DSP_RATIO);
-        if (rb <= 0) {
-            break;
+        // Process straight into the output ringbuffer when the block fits without wrapping,
+        // otherwise go through the intermediate buffer.
+        int maxsize = (int)(block->size * MAX_DSP_RATIO);
+        size_t contiguous = 0;
+        char *writeptr = ringbuf_write_acquire(&_output_ringbuf, &contiguous);
+        if (contiguous >= (size_t)maxsize) {
+            int rb = process_output_block (block, writeptr, maxsize);
+            if (rb <= 0) {
+                break;
+            }
+            ringbuf_write_commit(&_output_ringbuf, rb);
+        }
+        else {
+            int rb = process_output_block (block, _dsp_process_buffer.buffer, maxsize);
+            if (rb <= 0) {
+                break;
+            }
+            ringbuf_write(&_output_ringbuf, _dsp_process_buffer.buffer, rb);
         }
-        ringbuf_write(&_output_ringbuf, _dsp_process_buffer.buffer, rb);
 
         block_bitrate = block->bitrate;
         block = streamreader_get_curr_block();
     }
     // empty buffer and the next block format differs? request format change!
 
-    if (_output_ringbuf.remaining == 0 && block && memcmp (&block->fmt, &last_block_fmt, sizeof (ddb_waveformat_t))) {
+    if (ringbuf_get_remaining(&_output_ringbuf) == 0 && block && memcmp (&block->fmt, &last_block_fmt, sizeof (ddb_waveformat_t))) {
         streamer_set_output_format (&block->fmt);
         memcpy (&last_block_fmt, &block->fmt, sizeof (ddb_waveformat_t));
+        // set after the request, so that the output callback can't clear it before seeing the request
+        __atomic_store_n (&_output_format_change_pending, 1, __ATOMIC_RELEASE);
 
         streamer_unlock();
-        return;
+        return 5000;
     }
 
     // approximate bitrate
@@ -2334,47 +2366,108 @@ _streamer_fill_playback_buffer(void) {
         //        printf ("apx bitrate: %d (last %d)\n", avg_bitrate, last_bitrate);
     }
     streamer_unlock ();
-}
 
-int
-streamer_read (char *bytes, int size) {
+    // wake up when a quarter of the buffered data has been played
     DB_output_t *output = plug_get_output ();
+    int bytes_per_sec = output->fmt.samplerate * output->fmt.channels * (output->fmt.bps / 8);
+    if (bytes_per_sec <= 0) {
+        return 10000;
+    }
+    int64_t delay = (int64_t)ringbuf_get_remaining (&_output_ringbuf) * 1000000 / bytes_per_sec / 4;
+    return (int)(delay < 2000 ? 2000 : delay > 20000 ? 20000 : delay);
+}
 
-    // Ensure that the buffer has enough data for analysis
-    int ss = output->fmt.channels * output->fmt.bps / 8;
-    int max_bytes = output->fmt.samplerate * ss;
+// Runs the DSP chain, and fills the output ringbuffer, so that the output callback only needs to copy the data out of it,
+// without taking any locks.
+// This is a separate thread from the streamer thread, so that the buffered blocks keep playing while a decoder blocks, e.g. on network i/o.
+static void
+_streamer_fill_thread (void *unused) {
+#if defined(__linux__) && !defined(ANDROID)
+    prctl (PR_SET_NAME, "deadbeef-fill", 0, 0, 0, 0);
+#endif
+    rt_thread_promote (RT_THREAD_STREAMER);
 
-    // Read into the output buffer
-    _streamer_fill_playback_buffer();
+    while (!streaming_terminate) {
+        rt_thread_update ();
+        DB_output_t *output = plug_get_output ();
+        if (!output || output->state () == DDB_PLAYBACK_STATE_STOPPED) {
+            usleep (50000);
+            continue;
+        }
+        usleep (_streamer_fill_playback_buffer ());
+    }
+}
 
-    // Process
-#ifndef ANDROID
-    // Read extra bytes from output buffer
-    size_t viz_bytes = min (_output_ringbuf.size, max_bytes);
-    int wave_size = size / ss;
-    resizable_buffer_ensure_size(&_viz_read_buffer, max_bytes);
-    size_t offset = 0;
+// Called on the output thread. Doesn't take any locks.
+static void
+_streamer_prepare_read (int size) {
+    rt_thread_update ();
+
+    // the output plugin applies a requested format before reading
+    __atomic_store_n (&_output_format_change_pending, 0, __ATOMIC_RELEASE);
 
 #ifdef __APPLE__
+    DB_output_t *output = plug_get_output ();
     const int AIRPLAY_LATENCY = 2;
-    if (output->plugin.flags & DDB_COREAUDIO_FLAG_AIRPLAY) {
-        offset = AIRPLAY_LATENCY * output->fmt.samplerate * output->fmt.channels * output->fmt.bps/8;
-    }
-#endif
-    ringbuf_read_keep_offset(&_output_ringbuf, _viz_read_buffer.buffer, viz_bytes, -offset);
-    viz_process (_viz_read_buffer.buffer, (int)viz_bytes, output, 4096, wave_size); // FIXME: fft size needs to be configurable
+    viz_set_delay ((output->plugin.flags & DDB_COREAUDIO_FLAG_AIRPLAY) ? AIRPLAY_LATENCY * 1000 : 0);
 #endif
+}
+
+int
+streamer_read (char *bytes, int size) {
+    _streamer_prepare_read (size);
 
     // Play
     return _streamer_get_bytes(bytes, size);
 }
 
+int
+streamer_read_acquire (const char **data, int size) {
+    _streamer_prepare_read (size);
+
+    DB_output_t *output = plug_get_output ();
+    int ss = output->fmt.channels * output->fmt.bps / 8;
+
+    _output_ringbuf_apply_pending_flush ();
+    size_t avail = 0;
+    char *ptr = ringbuf_read_acquire(&_output_ringbuf, &avail);
+
+    int sz = avail < (size_t)size ? (int)avail : size;
+    sz -= sz % ss;
+    if (sz <= 0) {
+        *data = NULL;
+        return 0;
+    }
+
+    // The data which was acquired before but not committed is already scaled,
+    // only the rest of the acquired region is processed, the data ahead stays intact
+    if (sz > _output_ringbuf_prepared) {
+#ifndef ANDROID
+        viz_tap (&output->fmt, ptr + _output_ringbuf_prepared, sz - _output_ringbuf_prepared);
+#endif
+        streamer_apply_soft_volume (ptr + _output_ringbuf_prepared, sz - _output_ringbuf_prepared);
+        _output_ringbuf_prepared = sz;
+    }
+
+    *data = ptr;
+    return sz;
+}
+
+void
+streamer_read_commit (int size) {
+    if (_output_ringbuf_apply_pending_flush ()) {
+        // streamer_reset was called after the data was acquired, so it was skipped already
+        return;
+    }
+
+    _output_ringbuf_prepared = size < _output_ringbuf_prepared ? _output_ringbuf_prepared - size : 0;
+    ringbuf_read_commit(&_output_ringbuf, size);
+}
+
 int
 streamer_ok_to_read (int len) {
-    streamer_lock();
-    int res = !streamer_is_buffering;
-    streamer_unlock();
-    return res;
+    // called from the output callback, so avoid taking the streamer lock
+    return !__atomic_load_n (&streamer_is_buffering, __ATOMIC_ACQUIRE);
 }
 
 static int
@@ -2461,6 +2554,7 @@ streamer_configchanged (void) {
     conf_playback_buffer_size = playback_buffer_size / 1000.f;
 
     streamreader_configchanged ();
+    dsp_configchanged ();
 
     streamer_unlock ();
 }
@@ -2471,7 +2565,7 @@ _handle_playback_stopped (void) {
         playItem_t *trk = playing_track;
         pl_item_ref (trk);
         send_songfinished (trk);
-        streamer_is_buffering = 0;
+        __atomic_store_n (&streamer_is_buffering, 0, __ATOMIC_RELEASE);
         streamer_start_playback (playing_track, NULL);
         streamer_set_buffering_track (NULL);
         send_trackchanged (trk, NULL);
@@ -2486,7 +2580,7 @@ _play_track (playItem_t *it, int startpaused) {
     output->stop ();
     streamer_lock();
     streamer_reset(1);
-    streamer_is_buffering = 1;
+    __atomic_store_n (&streamer_is_buffering, 1, __ATOMIC_RELEASE);
     streamer_unlock();
 
     playItem_t *prev = playing_track;
@@ -2582,7 +2676,6 @@ error:
     output->stop ();
     streamer_reset (1);
     viz_reset();
-    viz_process(NULL, 0, output, 0, 0);
 
     streamer_lock();
     _handle_playback_stopped ();
@@ -57,6 +57,12 @@ streamer_free (void);
 int
 streamer_read (char *bytes, int size);
 
+int
+streamer_read_acquire (const char **data, int size);
+
+void
+streamer_read_commit (int size);
+
 void
 streamer_reset (int full);
 
@@ -187,6 +193,13 @@ streamer_set_output (DB_output_t *output);
 void
 streamer_notify_track_deleted (void);
 
+struct streamblock_s;
+
+// Processes the data of a decoded block into the output format, as done by the streamer for playback.
+// @returns number of bytes written to `bytes`
+int
+streamer_process_block_data (struct streamblock_s *block, const ddb_waveformat_t *output_fmt, char *bytes, int bytes_available_size, float *out_dspratio);
+
 #ifdef __cplusplus
 }
 #endif
@@ -27,6 +27,7 @@
 #include "streamreader.h"
 #include "replaygain.h"
 #include "threading.h"
+#include "realtime.h"
 
 // read ahead about 5 sec at 44100/16/2
 #define BLOCK_SIZE 16384
@@ -54,6 +55,7 @@ streamreader_init (void) {
         streamblock_t *b = calloc (1, sizeof (streamblock_t));
         b->pos = -1;
         b->buf = malloc (BLOCK_SIZE);
+        rt_mem_lock (b->buf, BLOCK_SIZE);
         b->next = blocks;
         blocks = b;
     }
@@ -67,6 +69,7 @@ streamreader_free (void) {
     streamreader_reset ();
     while (blocks) {
         streamblock_t *next = blocks->next;
+        rt_mem_unlock (blocks->buf, BLOCK_SIZE);
         free (blocks->buf);
         free (blocks);
         blocks = next;
@@ -155,10 +158,12 @@ streamreader_read_block (streamblock_t *block, playItem_t *track, DB_fileinfo_t
         pl_item_ref(block->track);
     }
 
+    // replaygain is applied together with the output format conversion in the streamer
+    block->replaygain_amp = 1.f;
     if (size > 0) {
         int input_does_rg = fileinfo->plugin->plugin.flags & DDB_PLUGIN_FLAG_REPLAYGAIN;
         if (!input_does_rg) {
-            replaygain_apply (&fileinfo->fmt, block->buf, block->size);
+            block->replaygain_amp = replaygain_get_current_amp ();
         }
     }
 
@@ -196,6 +201,7 @@ streamreader_silence_block (streamblock_t *block, playItem_t *track, DB_fileinfo
         pl_item_ref(block->track);
     }
     block->is_silent_header = 1;
+    block->replaygain_amp = 1.f;
 
     if (_firstblock) {
         block->first = 1;
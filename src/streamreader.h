@@ -36,6 +36,7 @@ typedef struct streamblock_s {
     int last; // set to 1 for last buffer of the stream
     int bitrate;
     int is_silent_header; // set to 1 if the block represents the added silence
+    float replaygain_amp; // replaygain to apply during output processing, 1 if none
 
     playItem_t *track;
     ddb_waveformat_t fmt;
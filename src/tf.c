@@ -40,6 +40,10 @@
 //   len:int32, data
 //  5: text dimming block
 //   dim_amount:int8, len:int32, data
+//  6: resolved meta field (emitted by tf_optimize_block in place of 2)
+//   field:byte, len:byte, data[, key:interned metacache string pointer, when field is TF_FIELD_META]
+//  7: constant (a function call folded by tf_optimize_block)
+//   bool:byte, len:int32, data, call_len:int32, call
 // !0: plain text
 
 #ifdef HAVE_CONFIG_H
@@ -61,6 +65,7 @@
 #include "utf8.h"
 #include "playlist.h"
 #include "plmeta.h"
+#include "metacache.h"
 #include "playqueue.h"
 #include "tf.h"
 #include "gettext.h"
@@ -149,6 +154,118 @@ snprintf_clip (char *buf, size_t len, const char *fmt, ...) {
     return (int)min (n, len-1);
 }
 
+// the output buffer size used for evaluating constant function calls,
+// the folded results are used only with the buffers of at least this size
+#define TF_FOLD_MAX_LENGTH 256
+
+// Trailer stored after the bytecode of each compiled script
+#define TF_SCRIPT_INFO_MAGIC 0x63736674
+
+enum {
+    // the output depends only on the track metadata, and can be memoized per track
+    TF_SCRIPT_FLAG_CACHEABLE = 1,
+};
+
+typedef struct {
+    uint32_t magic;
+    uint32_t id;
+    uint32_t flags;
+    int32_t num_keys;
+    // interned metacache keys, referenced by the bytecode
+    const char *keys[];
+} tf_script_info_t;
+
+static tf_script_info_t *
+tf_get_script_info (const char *code) {
+    if (!code) {
+        return NULL;
+    }
+    int32_t size = *((int32_t *)code);
+    if (size == 0) {
+        return NULL;
+    }
+    tf_script_info_t *info = (tf_script_info_t *)(code + ((4 + size + 4 + 7) & ~7));
+    if (info->magic != TF_SCRIPT_INFO_MAGIC) {
+        return NULL;
+    }
+    return info;
+}
+
+// Memoized results of cacheable scripts, keyed by track, script and track modification stamp.
+// Protected by its own spinlock, rather than pl_lock, since the callers passing DDB_TF_CONTEXT_NO_MUTEX_LOCK
+// may or may not hold pl_lock.
+#define TF_CACHE_SIZE 2048
+#define TF_CACHE_MAX_LENGTH 256
+
+typedef struct {
+    playItem_t *it;
+    uint32_t modification_stamp;
+    uint32_t script_id;
+    uint32_t flags;
+    int outlen;
+    int res;
+    int dimmed;
+    int update;
+    char text[TF_CACHE_MAX_LENGTH];
+} tf_cache_entry_t;
+
+static tf_cache_entry_t *tf_cache;
+static char tf_cache_locked;
+
+static void
+tf_cache_lock (void) {
+    while (__atomic_test_and_set (&tf_cache_locked, __ATOMIC_ACQUIRE));
+}
+
+static void
+tf_cache_unlock (void) {
+    __atomic_clear (&tf_cache_locked, __ATOMIC_RELEASE);
+}
+
+#define TF_CACHE_FLAGS (DDB_TF_CONTEXT_MULTILINE | DDB_TF_CONTEXT_TEXT_DIM)
+
+static tf_cache_entry_t *
+tf_cache_entry (playItem_t *it, uint32_t script_id) {
+    if (!tf_cache) {
+        tf_cache = calloc (TF_CACHE_SIZE, sizeof (tf_cache_entry_t));
+    }
+    uint32_t hash = (uint32_t)((uintptr_t)it >> 4) * 2654435761u ^ script_id * 40503u;
+    return &tf_cache[hash & (TF_CACHE_SIZE - 1)];
+}
+
+// Must be called under tf_cache_lock
+static int
+tf_cache_get (playItem_t *it, uint32_t stamp, uint32_t script_id, uint32_t flags, char *out, int outlen, int *dimmed, int *update) {
+    tf_cache_entry_t *e = tf_cache_entry (it, script_id);
+    // the buffer size is a part of the key, since it affects the truncation of the function arguments
+    if (e->it != it || e->modification_stamp != stamp || e->script_id != script_id || e->flags != flags || e->outlen != outlen) {
+        return -1;
+    }
+    memcpy (out, e->text, e->res + 1);
+    *dimmed = e->dimmed;
+    *update = e->update;
+    return e->res;
+}
+
+// Must be called under tf_cache_lock
+static void
+tf_cache_put (playItem_t *it, uint32_t stamp, uint32_t script_id, uint32_t flags, const char *out, int outlen, int res, int dimmed, int update) {
+    if (res < 0 || res >= TF_CACHE_MAX_LENGTH) {
+        return;
+    }
+    tf_cache_entry_t *e = tf_cache_entry (it, script_id);
+    e->it = it;
+    e->modification_stamp = stamp;
+    e->script_id = script_id;
+    e->flags = flags;
+    e->outlen = outlen;
+    e->res = res;
+    e->dimmed = dimmed;
+    e->update = update;
+    memcpy (e->text, out, res);
+    e->text[res] = 0;
+}
+
 /*
  * @param outlen bytes available in the buffer `out`, including the terminating null byte
  */
@@ -194,6 +311,41 @@ tf_eval (ddb_tf_context_t *_ctx, const char *code, char *out, int outlen) {
         id = _ctx->id;
     }
 
+    tf_script_info_t *info = NULL;
+    uint32_t stamp = 0;
+    uint32_t cache_flags = ctx._ctx.flags & TF_CACHE_FLAGS;
+    if (_ctx->it && codelen > 0 && id != DB_COLUMN_FILENUMBER && id != DB_COLUMN_PLAYING) {
+        info = tf_get_script_info (code - 4);
+        if (info && !(info->flags & TF_SCRIPT_FLAG_CACHEABLE)) {
+            info = NULL;
+        }
+    }
+
+    if (info) {
+        // with DDB_TF_CONTEXT_NO_MUTEX_LOCK, the caller guarantees that the track can be accessed
+        if (ctx._ctx.flags & DDB_TF_CONTEXT_NO_MUTEX_LOCK) {
+            stamp = ((playItem_t *)ctx._ctx.it)->_modification_stamp;
+        }
+        else {
+            pl_lock ();
+            stamp = ((playItem_t *)ctx._ctx.it)->_modification_stamp;
+            pl_unlock ();
+        }
+        int dimmed = 0;
+        int update = 0;
+        tf_cache_lock ();
+        l = tf_cache_get ((playItem_t *)ctx._ctx.it, stamp, info->id, cache_flags, out, outlen, &dimmed, &update);
+        tf_cache_unlock ();
+        if (l >= 0) {
+            _ctx->update = update;
+            if (_ctx->_size >= (char *)&_ctx->dimmed - (char *)_ctx + sizeof(_ctx->dimmed)) {
+                _ctx->dimmed = dimmed;
+            }
+            return l;
+        }
+        l = 0;
+    }
+
     switch (id) {
     case DB_COLUMN_FILENUMBER:
         if (ctx._ctx.flags & DDB_TF_CONTEXT_HAS_INDEX) {
@@ -215,16 +367,22 @@ tf_eval (ddb_tf_context_t *_ctx, const char *code, char *out, int outlen) {
 
     if (!(ctx._ctx.flags & DDB_TF_CONTEXT_MULTILINE)) {
         // replace any unprintable char with '_'
-        for (; *out; out++) {
-            if ((uint8_t)(*out) < ' ') {
-                if (*out == '\033' && (ctx._ctx.flags & DDB_TF_CONTEXT_TEXT_DIM)) {
+        for (char *p = out; *p; p++) {
+            if ((uint8_t)(*p) < ' ') {
+                if (*p == '\033' && (ctx._ctx.flags & DDB_TF_CONTEXT_TEXT_DIM)) {
                     continue;
                 }
-                *out = '_';
+                *p = '_';
             }
         }
     }
 
+    if (info) {
+        tf_cache_lock ();
+        tf_cache_put ((playItem_t *)ctx._ctx.it, stamp, info->id, cache_flags, out, outlen, l, ctx._ctx.dimmed, ctx._ctx.update);
+        tf_cache_unlock ();
+    }
+
     _ctx->update = ctx._ctx.update;
     if (_ctx->_size >= (char *)&_ctx->dimmed - (char *)_ctx + sizeof(_ctx->dimmed)) {
         _ctx->dimmed = ctx._ctx.dimmed;
@@ -2588,6 +2746,123 @@ tf_func_def tf_funcs[TF_MAX_FUNCS] = {
     { NULL, NULL }
 };
 
+// Fields with special handling, resolved at compile time
+typedef enum {
+    TF_FIELD_META, // looked up in the track metadata by name
+    TF_FIELD_ALBUM_ARTIST,
+    TF_FIELD_ARTIST,
+    TF_FIELD_ALBUM,
+    TF_FIELD_TRACK_ARTIST,
+    TF_FIELD_TRACKNUMBER,
+    TF_FIELD_TITLE,
+    TF_FIELD_DISCNUMBER,
+    TF_FIELD_TOTALDISCS,
+    TF_FIELD_TRACK_NUMBER,
+    TF_FIELD_DATE,
+    TF_FIELD_SAMPLERATE,
+    TF_FIELD_PLAYBACK_BITRATE,
+    TF_FIELD_BITRATE,
+    TF_FIELD_FILESIZE,
+    TF_FIELD_FILESIZE_NATURAL,
+    TF_FIELD_CHANNELS,
+    TF_FIELD_CODEC,
+    TF_FIELD_REPLAYGAIN_ALBUM_GAIN,
+    TF_FIELD_REPLAYGAIN_ALBUM_PEAK,
+    TF_FIELD_REPLAYGAIN_TRACK_GAIN,
+    TF_FIELD_REPLAYGAIN_TRACK_PEAK,
+    TF_FIELD_PLAYBACK_TIME,
+    TF_FIELD_PLAYBACK_TIME_SECONDS,
+    TF_FIELD_PLAYBACK_TIME_REMAINING,
+    TF_FIELD_PLAYBACK_TIME_REMAINING_SECONDS,
+    TF_FIELD_PLAYBACK_TIME_MS,
+    TF_FIELD_LENGTH,
+    TF_FIELD_LENGTH_EX,
+    TF_FIELD_LENGTH_SECONDS,
+    TF_FIELD_LENGTH_SECONDS_FP,
+    TF_FIELD_LENGTH_SAMPLES,
+    TF_FIELD_ISPLAYING,
+    TF_FIELD_ISPAUSED,
+    TF_FIELD_FILENAME,
+    TF_FIELD_FILENAME_EXT,
+    TF_FIELD_DIRECTORYNAME,
+    TF_FIELD_LAST_MODIFIED,
+    TF_FIELD_PATH_RAW,
+    TF_FIELD_PATH,
+    TF_FIELD_LIST_INDEX,
+    TF_FIELD_LIST_TOTAL,
+    TF_FIELD_QUEUE_INDEX,
+    TF_FIELD_QUEUE_INDEXES,
+    TF_FIELD_QUEUE_TOTAL,
+    TF_FIELD_DEADBEEF_VERSION,
+    TF_FIELD_PLAYLIST_NAME,
+    TF_FIELD_SELECTION_PLAYBACK_TIME,
+    TF_FIELD_COUNT
+} tf_field_t;
+
+static const struct {
+    const char *name;
+    // the value depends on the player state, rather than the track metadata
+    int dynamic;
+} tf_fields[TF_FIELD_COUNT] = {
+    [TF_FIELD_ALBUM_ARTIST] = { "album artist", 0 },
+    [TF_FIELD_ARTIST] = { "artist", 0 },
+    [TF_FIELD_ALBUM] = { "album", 0 },
+    [TF_FIELD_TRACK_ARTIST] = { "track artist", 0 },
+    [TF_FIELD_TRACKNUMBER] = { "tracknumber", 0 },
+    [TF_FIELD_TITLE] = { "title", 0 },
+    [TF_FIELD_DISCNUMBER] = { "discnumber", 0 },
+    [TF_FIELD_TOTALDISCS] = { "totaldiscs", 0 },
+    [TF_FIELD_TRACK_NUMBER] = { "track number", 0 },
+    [TF_FIELD_DATE] = { "date", 0 },
+    [TF_FIELD_SAMPLERATE] = { "samplerate", 0 },
+    [TF_FIELD_PLAYBACK_BITRATE] = { "playback_bitrate", 1 },
+    [TF_FIELD_BITRATE] = { "bitrate", 0 },
+    [TF_FIELD_FILESIZE] = { "filesize", 0 },
+    [TF_FIELD_FILESIZE_NATURAL] = { "filesize_natural", 0 },
+    [TF_FIELD_CHANNELS] = { "channels", 0 },
+    [TF_FIELD_CODEC] = { "codec", 0 },
+    [TF_FIELD_REPLAYGAIN_ALBUM_GAIN] = { "replaygain_album_gain", 0 },
+    [TF_FIELD_REPLAYGAIN_ALBUM_PEAK] = { "replaygain_album_peak", 0 },
+    [TF_FIELD_REPLAYGAIN_TRACK_GAIN] = { "replaygain_track_gain", 0 },
+    [TF_FIELD_REPLAYGAIN_TRACK_PEAK] = { "replaygain_track_peak", 0 },
+    [TF_FIELD_PLAYBACK_TIME] = { "playback_time", 1 },
+    [TF_FIELD_PLAYBACK_TIME_SECONDS] = { "playback_time_seconds", 1 },
+    [TF_FIELD_PLAYBACK_TIME_REMAINING] = { "playback_time_remaining", 1 },
+    [TF_FIELD_PLAYBACK_TIME_REMAINING_SECONDS] = { "playback_time_remaining_seconds", 1 },
+    [TF_FIELD_PLAYBACK_TIME_MS] = { "playback_time_ms", 1 },
+    [TF_FIELD_LENGTH] = { "length", 0 },
+    [TF_FIELD_LENGTH_EX] = { "length_ex", 0 },
+    [TF_FIELD_LENGTH_SECONDS] = { "length_seconds", 0 },
+    [TF_FIELD_LENGTH_SECONDS_FP] = { "length_seconds_fp", 0 },
+    [TF_FIELD_LENGTH_SAMPLES] = { "length_samples", 0 },
+    [TF_FIELD_ISPLAYING] = { "isplaying", 1 },
+    [TF_FIELD_ISPAUSED] = { "ispaused", 1 },
+    [TF_FIELD_FILENAME] = { "filename", 0 },
+    [TF_FIELD_FILENAME_EXT] = { "filename_ext", 0 },
+    [TF_FIELD_DIRECTORYNAME] = { "directoryname", 0 },
+    [TF_FIELD_LAST_MODIFIED] = { "last_modified", 1 },
+    [TF_FIELD_PATH_RAW] = { "_path_raw", 0 },
+    [TF_FIELD_PATH] = { "path", 0 },
+    [TF_FIELD_LIST_INDEX] = { "list_index", 1 },
+    [TF_FIELD_LIST_TOTAL] = { "list_total", 1 },
+    [TF_FIELD_QUEUE_INDEX] = { "queue_index", 1 },
+    [TF_FIELD_QUEUE_INDEXES] = { "queue_indexes", 1 },
+    [TF_FIELD_QUEUE_TOTAL] = { "queue_total", 1 },
+    [TF_FIELD_DEADBEEF_VERSION] = { "_deadbeef_version", 0 },
+    [TF_FIELD_PLAYLIST_NAME] = { "_playlist_name", 1 },
+    [TF_FIELD_SELECTION_PLAYBACK_TIME] = { "selection_playback_time", 1 },
+};
+
+static tf_field_t
+tf_field_for_name (const char *name) {
+    for (int i = TF_FIELD_META + 1; i < TF_FIELD_COUNT; i++) {
+        if (!strcmp (name, tf_fields[i].name)) {
+            return (tf_field_t)i;
+        }
+    }
+    return TF_FIELD_META;
+}
+
 static const char *
 _tf_get_combined_value (playItem_t *it, const char *key, int *needs_free, int item_index) {
     DB_metaInfo_t *meta = pl_meta_for_key_with_override (it, key);
@@ -2733,10 +3008,17 @@ tf_eval_int (ddb_tf_context_t *ctx, const char *code, int size, char *out, int o
                 code += blocksize;
                 size -= blocksize;
             }
-            else if (*code == 2) {
-                // Meta field
+            else if (*code == 2 || *code == 6) {
+                // Meta field, or a meta field resolved by tf_optimize_block
+                int resolved = *code == 6;
                 code++;
                 size--;
+                tf_field_t field = TF_FIELD_META;
+                if (resolved) {
+                    field = (tf_field_t)(uint8_t)*code;
+                    code++;
+                    size--;
+                }
                 uint8_t len = *code;
                 code++;
                 size--;
@@ -2745,6 +3027,17 @@ tf_eval_int (ddb_tf_context_t *ctx, const char *code, int size, char *out, int o
                 memcpy (name, code, len);
                 name[len] = 0;
 
+                // interned metacache key of a plain metadata field
+                const char *key = name;
+                int blocksize = len;
+                if (resolved && field == TF_FIELD_META) {
+                    memcpy (&key, code + len, sizeof (key));
+                    blocksize += sizeof (key);
+                }
+                else if (!resolved) {
+                    field = tf_field_for_name (name);
+                }
+
                 // special cases
                 // most if not all of this stuff is to make tf scripts
                 // compatible with fb2k syntax
@@ -2772,22 +3065,22 @@ tf_eval_int (ddb_tf_context_t *ctx, const char *code, int size, char *out, int o
                 // temp vars used for strcmp optimizations
                 int tmp_a = 0, tmp_b = 0, tmp_c = 0, tmp_d = 0, tmp_e = 0;
                 int item_index = tf_item_index_for_context(ctx);
-                if (!strcmp (name, aa_fields[0])) {
+                if (field == TF_FIELD_ALBUM_ARTIST) {
                     for (int i = 0; !val && aa_fields[i]; i++) {
                         val = _tf_get_combined_value(it, aa_fields[i], &needs_free, item_index);
                     }
                 }
-                else if (!strcmp (name, a_fields[0])) {
+                else if (field == TF_FIELD_ARTIST) {
                     for (int i = 0; !val && a_fields[i]; i++) {
                         val = _tf_get_combined_value(it, a_fields[i], &needs_free, item_index);
                     }
                 }
-                else if (!strcmp (name, "album")) {
+                else if (field == TF_FIELD_ALBUM) {
                     for (int i = 0; !val && alb_fields[i]; i++) {
                         val = _tf_get_combined_value (it, alb_fields[i], &needs_free, item_index);
                     }
                 }
-                else if (!strcmp (name, "track artist")) {
+                else if (field == TF_FIELD_TRACK_ARTIST) {
                     const char *aa = NULL;
                     for (int i = 0; !val && aa_fields[i]; i++) {
                         val = _tf_get_combined_value (it, aa_fields[i], &needs_free, item_index);
@@ -2801,7 +3094,7 @@ tf_eval_int (ddb_tf_context_t *ctx, const char *code, int size, char *out, int o
                         val = NULL;
                     }
                 }
-                else if (!strcmp (name, "tracknumber")) {
+                else if (field == TF_FIELD_TRACKNUMBER) {
                     const char *v = pl_find_meta_raw (it, "track");
                     if (v) {
                         const char *p = v;
@@ -2822,7 +3115,7 @@ tf_eval_int (ddb_tf_context_t *ctx, const char *code, int size, char *out, int o
                         }
                     }
                 }
-                else if (!strcmp (name, "title")) {
+                else if (field == TF_FIELD_TITLE) {
                     val = _tf_get_combined_value (it, "title", &needs_free, item_index);
                     if (!val) {
                         const char *v = pl_find_meta_raw (it, ":URI");
@@ -2849,27 +3142,27 @@ tf_eval_int (ddb_tf_context_t *ctx, const char *code, int size, char *out, int o
                         }
                     }
                 }
-                else if (!strcmp (name, "discnumber")) {
+                else if (field == TF_FIELD_DISCNUMBER) {
                     val = pl_find_meta_raw (it, "disc");
                 }
-                else if (!strcmp (name, "totaldiscs")) {
+                else if (field == TF_FIELD_TOTALDISCS) {
                     val = pl_find_meta_raw (it, "numdiscs");
                 }
-                else if (!strcmp (name, "track number")) {
+                else if (field == TF_FIELD_TRACK_NUMBER) {
                     const char *v = pl_find_meta_raw (it, "track");
                     if (v) {
                         val = v;
                     }
                 }
-                else if (!strcmp (name, "date")) {
+                else if (field == TF_FIELD_DATE) {
                     // NOTE: foobar2000 uses "date" instead of "year"
                     // so for %date% we simply return the content of "year"
                     val = pl_find_meta_raw (it, "year");
                 }
-                else if (!strcmp (name, "samplerate")) {
+                else if (field == TF_FIELD_SAMPLERATE) {
                     val = pl_find_meta_raw (it, ":SAMPLERATE");
                 }
-                else if (!strcmp (name, "playback_bitrate")) {
+                else if (field == TF_FIELD_PLAYBACK_BITRATE) {
                     if (ctx->flags & TF_INTERNAL_FLAG_LOCKED) {
                         pl_unlock();
                     }
@@ -2890,13 +3183,13 @@ tf_eval_int (ddb_tf_context_t *ctx, const char *code, int size, char *out, int o
                         pl_lock ();
                     }
                 }
-                else if (!strcmp (name, "bitrate")) {
+                else if (field == TF_FIELD_BITRATE) {
                     val = pl_find_meta_raw (it, ":BITRATE");
                 }
-                else if (!strcmp (name, "filesize")) {
+                else if (field == TF_FIELD_FILESIZE) {
                     val = pl_find_meta_raw (it, ":FILE_SIZE");
                 }
-                else if (!strcmp (name, "filesize_natural")) {
+                else if (field == TF_FIELD_FILESIZE_NATURAL) {
                     const char *v = pl_find_meta_raw (it, ":FILE_SIZE");
                     if (v) {
                         int64_t bs = atoll (v);
@@ -2921,25 +3214,25 @@ tf_eval_int (ddb_tf_context_t *ctx, const char *code, int size, char *out, int o
                         skip_out = 1;
                     }
                 }
-                else if (!strcmp (name, "channels")) {
+                else if (field == TF_FIELD_CHANNELS) {
                     val = tf_get_channels_string_for_track (it);
                 }
-                else if (!strcmp (name, "codec")) {
+                else if (field == TF_FIELD_CODEC) {
                     val = pl_find_meta (it, ":FILETYPE");
                 }
-                else if (!strcmp (name, "replaygain_album_gain")) {
+                else if (field == TF_FIELD_REPLAYGAIN_ALBUM_GAIN) {
                     val = pl_find_meta_raw (it, ":REPLAYGAIN_ALBUMGAIN");
                 }
-                else if (!strcmp (name, "replaygain_album_peak")) {
+                else if (field == TF_FIELD_REPLAYGAIN_ALBUM_PEAK) {
                     val = pl_find_meta_raw (it, ":REPLAYGAIN_ALBUMPEAK");
                 }
-                else if (!strcmp (name, "replaygain_track_gain")) {
+                else if (field == TF_FIELD_REPLAYGAIN_TRACK_GAIN) {
                     val = pl_find_meta_raw (it, ":REPLAYGAIN_TRACKGAIN");
                 }
-                else if (!strcmp (name, "replaygain_track_peak")) {
+                else if (field == TF_FIELD_REPLAYGAIN_TRACK_PEAK) {
                     val = pl_find_meta_raw (it, ":REPLAYGAIN_TRACKPEAK");
                 }
-                else if ((tmp_a = !strcmp (name, "playback_time")) || (tmp_b = !strcmp (name, "playback_time_seconds")) || (tmp_c = !strcmp (name, "playback_time_remaining")) || (tmp_d = !strcmp (name, "playback_time_remaining_seconds")) || (tmp_e = !strcmp (name, "playback_time_ms"))) {
+                else if ((tmp_a = field == TF_FIELD_PLAYBACK_TIME) || (tmp_b = field == TF_FIELD_PLAYBACK_TIME_SECONDS) || (tmp_c = field == TF_FIELD_PLAYBACK_TIME_REMAINING) || (tmp_d = field == TF_FIELD_PLAYBACK_TIME_REMAINING_SECONDS) || (tmp_e = field == TF_FIELD_PLAYBACK_TIME_MS)) {
                     if (ctx->flags & TF_INTERNAL_FLAG_LOCKED) {
                         pl_unlock();
                     }
@@ -2993,7 +3286,7 @@ tf_eval_int (ddb_tf_context_t *ctx, const char *code, int size, char *out, int o
                     }
 
                 }
-                else if ((tmp_a = !strcmp (name, "length")) || (tmp_b = !strcmp (name, "length_ex"))) {
+                else if ((tmp_a = field == TF_FIELD_LENGTH) || (tmp_b = field == TF_FIELD_LENGTH_EX)) {
                     float t = pl_get_item_duration (it);
                     if (tmp_a) {
                         t = roundf (t);
@@ -3028,7 +3321,7 @@ tf_eval_int (ddb_tf_context_t *ctx, const char *code, int size, char *out, int o
                         skip_out = 1;
                     }
                 }
-                else if ((tmp_a = !strcmp (name, "length_seconds") || (tmp_b = !strcmp (name, "length_seconds_fp")))) {
+                else if ((tmp_a = field == TF_FIELD_LENGTH_SECONDS || (tmp_b = field == TF_FIELD_LENGTH_SECONDS_FP))) {
                     float t = pl_get_item_duration (it);
                     if (t >= 0) {
                         int l;
@@ -3043,13 +3336,13 @@ tf_eval_int (ddb_tf_context_t *ctx, const char *code, int size, char *out, int o
                         skip_out = 1;
                     }
                 }
-                else if (!strcmp (name, "length_samples")) {
+                else if (field == TF_FIELD_LENGTH_SAMPLES) {
                     int l = snprintf_clip (out, outlen, "%lld", pl_item_get_endsample ((playItem_t *)ctx->it) - pl_item_get_startsample ((playItem_t *)ctx->it));
                     out += l;
                     outlen -= l;
                     skip_out = 1;
                 }
-                else if (!strcmp (name, "isplaying")) {
+                else if (field == TF_FIELD_ISPLAYING) {
                     if (ctx->flags & TF_INTERNAL_FLAG_LOCKED) {
                         pl_unlock();
                     }
@@ -3068,7 +3361,7 @@ tf_eval_int (ddb_tf_context_t *ctx, const char *code, int size, char *out, int o
                         pl_item_unref (playing);
                     }
                 }
-                else if (!strcmp (name, "ispaused")) {
+                else if (field == TF_FIELD_ISPAUSED) {
                     if (ctx->flags & TF_INTERNAL_FLAG_LOCKED) {
                         pl_unlock();
                     }
@@ -3086,7 +3379,7 @@ tf_eval_int (ddb_tf_context_t *ctx, const char *code, int size, char *out, int o
                         pl_item_unref (playing);
                     }
                 }
-                else if (!strcmp (name, "filename")) {
+                else if (field == TF_FIELD_FILENAME) {
                     const char *v = pl_find_meta_raw (it, ":URI");
                     if (v) {
                         const char *start = strrchr (v, '/');
@@ -3103,7 +3396,7 @@ tf_eval_int (ddb_tf_context_t *ctx, const char *code, int size, char *out, int o
                         }
                     }
                 }
-                else if (!strcmp (name, "filename_ext")) {
+                else if (field == TF_FIELD_FILENAME_EXT) {
                     const char *v = pl_find_meta_raw (it, ":URI");
                     if (v) {
                         const char *start = strrchr (v, '/');
@@ -3117,7 +3410,7 @@ tf_eval_int (ddb_tf_context_t *ctx, const char *code, int size, char *out, int o
                         skip_out = 1;
                     }
                 }
-                else if (!strcmp (name, "directoryname")) {
+                else if (field == TF_FIELD_DIRECTORYNAME) {
                     const char *v = pl_find_meta_raw (it, ":URI");
                     if (v) {
                         const char *end = strrchr (v, '/');
@@ -3134,7 +3427,7 @@ tf_eval_int (ddb_tf_context_t *ctx, const char *code, int size, char *out, int o
                         }
                     }
                 }
-                else if (!strcmp (name, "last_modified")) {
+                else if (field == TF_FIELD_LAST_MODIFIED) {
                     const char *v = pl_find_meta_raw (it, ":URI");
                     if (v) {
                         if (!strncmp (v, "file://", 7)) {
@@ -3150,7 +3443,7 @@ tf_eval_int (ddb_tf_context_t *ctx, const char *code, int size, char *out, int o
                         }
                     }
                 }
-                else if (!strcmp (name, "_path_raw")) {
+                else if (field == TF_FIELD_PATH_RAW) {
                     const char *v = pl_find_meta_raw (it, ":URI");
 
                     if (v) {
@@ -3196,7 +3489,7 @@ tf_eval_int (ddb_tf_context_t *ctx, const char *code, int size, char *out, int o
                         skip_out = 1;
                     }
                 }
-                else if (!strcmp (name, "path")) {
+                else if (field == TF_FIELD_PATH) {
                     val = pl_find_meta_raw (it, ":URI");
 
                     // strip file://
@@ -3224,7 +3517,7 @@ tf_eval_int (ddb_tf_context_t *ctx, const char *code, int size, char *out, int o
 #endif
                 }
                 // index of track in playlist (zero-padded)
-                else if (!strcmp (name, "list_index")) {
+                else if (field == TF_FIELD_LIST_INDEX) {
                     if (it) {
                         int total_tracks = plt_get_item_count ((playlist_t *)ctx->plt, ctx->iter);
                         int digits = 0;
@@ -3247,7 +3540,7 @@ tf_eval_int (ddb_tf_context_t *ctx, const char *code, int size, char *out, int o
                     }
                 }
                 // total number of tracks in playlist
-                else if (!strcmp (name, "list_total")) {
+                else if (field == TF_FIELD_LIST_TOTAL) {
                     int total_tracks = -1;
                     if (ctx->plt) {
                         total_tracks = plt_get_item_count ((playlist_t *)ctx->plt, ctx->iter);
@@ -3267,7 +3560,7 @@ tf_eval_int (ddb_tf_context_t *ctx, const char *code, int size, char *out, int o
                     }
                 }
                 // index of track in queue
-                else if (!strcmp (name, "queue_index")) {
+                else if (field == TF_FIELD_QUEUE_INDEX) {
                     if (it) {
                         int idx = playqueue_test (it) + 1;
                         if (idx >= 1) {
@@ -3279,7 +3572,7 @@ tf_eval_int (ddb_tf_context_t *ctx, const char *code, int size, char *out, int o
                     }
                 }
                 // indexes of track in queue
-                else if (!strcmp (name, "queue_indexes")) {
+                else if (field == TF_FIELD_QUEUE_INDEXES) {
                     if (it) {
                         int idx = playqueue_test (it) + 1;
                         if (idx >= 1) {
@@ -3303,7 +3596,7 @@ tf_eval_int (ddb_tf_context_t *ctx, const char *code, int size, char *out, int o
                     }
                 }
                 // total amount of tracks in queue
-                else if (!strcmp (name, "queue_total")) {
+                else if (field == TF_FIELD_QUEUE_TOTAL) {
                     int count = playqueue_getcount ();
                     if (count >= 0) {
                         int l = snprintf_clip (out, outlen, "%d", count);
@@ -3312,13 +3605,13 @@ tf_eval_int (ddb_tf_context_t *ctx, const char *code, int size, char *out, int o
                         skip_out = 1;
                     }
                 }
-                else if (!strcmp (name, "_deadbeef_version")) {
+                else if (field == TF_FIELD_DEADBEEF_VERSION) {
                     val = VERSION;
                 }
-                else if (!strcmp (name, "_playlist_name")) {
+                else if (field == TF_FIELD_PLAYLIST_NAME) {
                     val = ((playlist_t *)ctx->plt)->title;
                 }
-                else if (!strcmp (name, "selection_playback_time")) {
+                else if (field == TF_FIELD_SELECTION_PLAYBACK_TIME) {
                     float seltime = plt_get_selection_playback_time((playlist_t *)ctx->plt);
 
                     int l = format_playback_time (out, outlen, seltime);
@@ -3328,7 +3621,7 @@ tf_eval_int (ddb_tf_context_t *ctx, const char *code, int size, char *out, int o
                     skip_out = 1;
                 }
                 else {
-                    val = _tf_get_combined_value (it, name, &needs_free, item_index);
+                    val = _tf_get_combined_value (it, key, &needs_free, item_index);
                 }
 
                 if (val || (!val && out > init_out)) {
@@ -3353,8 +3646,8 @@ tf_eval_int (ddb_tf_context_t *ctx, const char *code, int size, char *out, int o
                     free ((char *)val);
                 }
 
-                code += len;
-                size -= len;
+                code += blocksize;
+                size -= blocksize;
             }
             else if (*code == 3) { // conditional expression
                 code++;
@@ -3447,6 +3740,52 @@ tf_eval_int (ddb_tf_context_t *ctx, const char *code, int size, char *out, int o
                     outlen -= undimlen;
                 }
             }
+            else if (*code == 7) { // function call folded into a constant by tf_optimize_block
+                code++;
+                size--;
+
+                int truthy = *code;
+                code++;
+                size--;
+
+                int32_t len;
+                memcpy (&len, code, 4);
+                code += 4;
+                size -= 4;
+
+                const char *data = code;
+                code += len;
+                size -= len;
+
+                int32_t call_len;
+                memcpy (&call_len, code, 4);
+                code += 4;
+                size -= 4;
+
+                if (outlen >= TF_FOLD_MAX_LENGTH) {
+                    memcpy (out, data, len);
+                    out += len;
+                    outlen -= len;
+                    if (truthy) {
+                        *bool_out = 1;
+                    }
+                }
+                else {
+                    // evaluate the original call to get the same truncation
+                    int call_bool_out = 0;
+                    int res = tf_eval_int (ctx, code, call_len, out, outlen, &call_bool_out, fail_on_undef);
+                    if (res < 0) {
+                        return -1;
+                    }
+                    out += res;
+                    outlen -= res;
+                    if (call_bool_out) {
+                        *bool_out = 1;
+                    }
+                }
+                code += call_len;
+                size -= call_len;
+            }
             else {
                 return -1;
             }
@@ -3759,6 +4098,258 @@ tf_compile_plain (tf_compiler_t *c) {
     return 0;
 }
 
+typedef struct {
+    char *buf;
+    int32_t size;
+    int32_t alloc;
+    int dynamic;
+    const char **keys;
+    int num_keys;
+} tf_optimizer_t;
+
+static uint32_t tf_script_id;
+
+static void
+tf_optimizer_append (tf_optimizer_t *o, const void *data, int32_t len) {
+    if (o->size + len > o->alloc) {
+        o->alloc = o->alloc * 2 > o->size + len ? o->alloc * 2 : o->size + len + 256;
+        o->buf = realloc (o->buf, o->alloc);
+    }
+    if (data) {
+        memcpy (o->buf + o->size, data, len);
+    }
+    else {
+        memset (o->buf + o->size, 0, len);
+    }
+    o->size += len;
+}
+
+static int
+tf_func_is_pure (tf_func_ptr_t func) {
+    return func != tf_func_rand
+        && func != tf_func_meta
+        && func != tf_func_channels
+        && func != tf_func_rgb
+        && func != tf_func_itematindex;
+}
+
+// Evaluates the function call starting at call_start, and replaces it with the result
+static int
+tf_fold_call (tf_optimizer_t *o, int32_t call_start) {
+    ddb_tf_context_int_t ctx = {0};
+    ctx._ctx._size = sizeof (ddb_tf_context_t);
+    ctx._ctx.flags = DDB_TF_CONTEXT_NO_DYNAMIC | DDB_TF_CONTEXT_NO_MUTEX_LOCK;
+    ctx._ctx.it = (ddb_playItem_t *)&empty_track;
+    ctx._ctx.plt = (ddb_playlist_t *)&empty_playlist;
+
+    // tf_eval clears the output buffer, some functions depend on that
+    char out[TF_FOLD_MAX_LENGTH+1];
+    memset (out, 0, sizeof (out));
+    int bool_out = 0;
+    // same padding as in tf_compile
+    int32_t call_len = o->size - call_start;
+    tf_optimizer_append (o, NULL, 4);
+    o->size -= 4;
+    int res = tf_eval_int (&ctx._ctx, o->buf + call_start, call_len, out, TF_FOLD_MAX_LENGTH, &bool_out, 0);
+    if (res < 0 || res >= TF_FOLD_MAX_LENGTH - 8) {
+        // failed, or possibly truncated
+        return 0;
+    }
+
+    // the call is kept, to be evaluated with smaller output buffers,
+    // since the functions differ in how they truncate
+    char *call = alloca (call_len);
+    memcpy (call, o->buf + call_start, call_len);
+
+    o->size = call_start;
+    uint8_t hdr[3] = { 0, 7, bool_out ? 1 : 0 };
+    tf_optimizer_append (o, hdr, sizeof (hdr));
+    int32_t len = res;
+    tf_optimizer_append (o, &len, 4);
+    tf_optimizer_append (o, out, len);
+    tf_optimizer_append (o, &call_len, 4);
+    tf_optimizer_append (o, call, call_len);
+    return 1;
+}
+
+// Rewrites the compiled bytecode:
+// field names are resolved to field ids and interned metacache keys,
+// function calls with constant arguments are evaluated.
+// Must be called under pl_lock.
+// Returns 1 if the block is constant, 0 if it's not, -1 on error.
+static int
+tf_optimize_block (tf_optimizer_t *o, const char *code, int32_t size) {
+    int is_const = 1;
+    while (size > 0) {
+        if (*code) {
+            // plain text
+            const char *p = code;
+            while (size > 0 && *p) {
+                p++;
+                size--;
+            }
+            tf_optimizer_append (o, code, (int32_t)(p - code));
+            code = p;
+            continue;
+        }
+
+        if (size < 2) {
+            return -1;
+        }
+        uint8_t op = code[1];
+        code += 2;
+        size -= 2;
+
+        if (op == 1) {
+            // function call
+            if (size < 2) {
+                return -1;
+            }
+            uint8_t func_idx = code[0];
+            uint8_t numargs = code[1];
+            code += 2;
+            size -= 2;
+            if (size < numargs * 2) {
+                return -1;
+            }
+            uint16_t *arglens = alloca ((numargs + 1) * sizeof (uint16_t));
+            memcpy (arglens, code, numargs * sizeof (uint16_t));
+            code += numargs * 2;
+            size -= numargs * 2;
+
+            int32_t call_start = o->size;
+            uint8_t hdr[4] = { 0, 1, func_idx, numargs };
+            tf_optimizer_append (o, hdr, sizeof (hdr));
+            int32_t arglens_pos = o->size;
+            tf_optimizer_append (o, NULL, numargs * 2);
+
+            int args_const = 1;
+            for (int i = 0; i < numargs; i++) {
+                if (size < arglens[i]) {
+                    return -1;
+                }
+                int32_t arg_start = o->size;
+                int res = tf_optimize_block (o, code, arglens[i]);
+                if (res < 0) {
+                    return -1;
+                }
+                if (!res) {
+                    args_const = 0;
+                }
+                int32_t newlen = o->size - arg_start;
+                if (newlen > 0xffff) {
+                    return -1;
+                }
+                uint16_t len16 = (uint16_t)newlen;
+                memcpy (o->buf + arglens_pos + i * 2, &len16, 2);
+                code += arglens[i];
+                size -= arglens[i];
+            }
+
+            tf_func_ptr_t func = tf_funcs[func_idx].func;
+            if (func == tf_func_rand) {
+                o->dynamic = 1;
+            }
+            if (args_const && tf_func_is_pure (func) && tf_fold_call (o, call_start)) {
+                continue;
+            }
+            is_const = 0;
+        }
+        else if (op == 2) {
+            // meta field
+            if (size < 1) {
+                return -1;
+            }
+            uint8_t len = (uint8_t)code[0];
+            if (size < 1 + len) {
+                return -1;
+            }
+            char name[len+1];
+            memcpy (name, code + 1, len);
+            name[len] = 0;
+
+            tf_field_t field = tf_field_for_name (name);
+            if (tf_fields[field].dynamic) {
+                o->dynamic = 1;
+            }
+            uint8_t hdr[4] = { 0, 6, (uint8_t)field, len };
+            tf_optimizer_append (o, hdr, sizeof (hdr));
+            tf_optimizer_append (o, name, len);
+            if (field == TF_FIELD_META) {
+                const char *key = metacache_add_string (name);
+                tf_optimizer_append (o, &key, sizeof (key));
+                o->keys = realloc (o->keys, (o->num_keys + 1) * sizeof (const char *));
+                o->keys[o->num_keys++] = key;
+            }
+            code += 1 + len;
+            size -= 1 + len;
+            is_const = 0;
+        }
+        else if (op == 3 || op == 5) {
+            // if_defined / text dimming block
+            int hdrsize = op == 5 ? 1 : 0;
+            if (size < hdrsize + 4) {
+                return -1;
+            }
+            uint8_t hdr[3] = { 0, op, op == 5 ? (uint8_t)code[0] : 0 };
+            tf_optimizer_append (o, hdr, 2 + hdrsize);
+            int32_t len;
+            memcpy (&len, code + hdrsize, 4);
+            code += hdrsize + 4;
+            size -= hdrsize + 4;
+            if (len < 0 || size < len) {
+                return -1;
+            }
+            int32_t len_pos = o->size;
+            tf_optimizer_append (o, NULL, 4);
+            if (tf_optimize_block (o, code, len) < 0) {
+                return -1;
+            }
+            int32_t newlen = o->size - len_pos - 4;
+            memcpy (o->buf + len_pos, &newlen, 4);
+            code += len;
+            size -= len;
+            is_const = 0;
+        }
+        else if (op == 4 || op == 7) {
+            // pre-interpreted text / constant
+            int hdrsize = op == 7 ? 1 : 0;
+            if (size < hdrsize + 4) {
+                return -1;
+            }
+            int32_t len;
+            memcpy (&len, code + hdrsize, 4);
+            if (len < 0 || size < hdrsize + 4 + len) {
+                return -1;
+            }
+            int32_t blocksize = hdrsize + 4 + len;
+            if (op == 7) {
+                int32_t call_len;
+                if (size < blocksize + 4) {
+                    return -1;
+                }
+                memcpy (&call_len, code + blocksize, 4);
+                if (call_len < 0 || size < blocksize + 4 + call_len) {
+                    return -1;
+                }
+                blocksize += 4 + call_len;
+            }
+            uint8_t hdr[2] = { 0, op };
+            tf_optimizer_append (o, hdr, 2);
+            tf_optimizer_append (o, code, blocksize);
+            code += blocksize;
+            size -= blocksize;
+            if (op == 4) {
+                is_const = 0;
+            }
+        }
+        else {
+            return -1;
+        }
+    }
+    return is_const;
+}
+
 char *
 tf_compile (const char *script) {
     tf_compiler_t c;
@@ -3785,18 +4376,60 @@ tf_compile (const char *script) {
     }
 
     size_t size = c.o - code;
-    char *out = malloc (size + 8);
-    memcpy (out + 4, code, size);
-    memset (out + 4 + size, 0, 4); // FIXME: this is the padding for possible buffer overflow bug fix
-    *((int32_t *)out) = (int32_t)(size);
+
+    tf_optimizer_t o;
+    memset (&o, 0, sizeof (o));
+
+    pl_lock ();
+    int res = tf_optimize_block (&o, (const char *)code, (int32_t)size);
+    if (res < 0) {
+        // keep the original bytecode, and don't cache the results
+        trace ("tf: optimization failed <%s>\n", script);
+        for (int i = 0; i < o.num_keys; i++) {
+            metacache_remove_string (o.keys[i]);
+        }
+        o.num_keys = 0;
+        o.dynamic = 1;
+        o.size = 0;
+        tf_optimizer_append (&o, code, (int32_t)size);
+    }
+    uint32_t id = ++tf_script_id;
+    pl_unlock ();
 
     free (code);
 
+    // [size:int32][code][padding:4][info]
+    size = o.size;
+    size_t info_offset = (4 + size + 4 + 7) & ~7;
+    char *out = calloc (1, info_offset + sizeof (tf_script_info_t) + o.num_keys * sizeof (const char *));
+    memcpy (out + 4, o.buf, size); // the padding is for possible buffer overflow bug fix
+    *((int32_t *)out) = (int32_t)(size);
+
+    tf_script_info_t *info = (tf_script_info_t *)(out + info_offset);
+    info->magic = TF_SCRIPT_INFO_MAGIC;
+    info->id = id;
+    info->flags = o.dynamic ? 0 : TF_SCRIPT_FLAG_CACHEABLE;
+    info->num_keys = o.num_keys;
+    if (o.num_keys) {
+        memcpy (info->keys, o.keys, o.num_keys * sizeof (const char *));
+    }
+
+    free (o.buf);
+    free (o.keys);
+
     return out;
 }
 
 void
 tf_free (char *code) {
+    tf_script_info_t *info = tf_get_script_info (code);
+    if (info && info->num_keys) {
+        pl_lock ();
+        for (int i = 0; i < info->num_keys; i++) {
+            metacache_remove_string (info->keys[i]);
+        }
+        pl_unlock ();
+    }
     free (code);
 }
 
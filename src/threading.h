@@ -63,6 +63,22 @@ mutex_lock (uintptr_t mtx);
 int
 mutex_unlock (uintptr_t mtx);
 
+// Non-recursive reader-writer lock
+uintptr_t
+rwlock_create (void);
+
+void
+rwlock_free (uintptr_t rwlock);
+
+int
+rwlock_rdlock (uintptr_t rwlock);
+
+int
+rwlock_wrlock (uintptr_t rwlock);
+
+int
+rwlock_unlock (uintptr_t rwlock);
+
 uintptr_t
 cond_create (void);
 
@@ -72,6 +88,11 @@ cond_free (uintptr_t cond);
 int
 cond_wait (uintptr_t cond, uintptr_t mutex);
 
+// Unlike cond_wait, expects the mutex to be locked exactly once by the caller,
+// and releases it while waiting, so that the condition can be checked without missing a signal.
+int
+cond_wait_locked (uintptr_t cond, uintptr_t mutex);
+
 int
 cond_signal (uintptr_t cond);
 
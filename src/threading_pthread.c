@@ -30,6 +30,7 @@
 #include <errno.h>
 #include <string.h>
 #include "threading.h"
+#include "realtime.h"
 #ifdef HAVE_CONFIG_H
 #include <config.h>
 #endif
@@ -171,6 +172,12 @@ mutex_free (uintptr_t _mtx) {
 int
 mutex_lock (uintptr_t _mtx) {
     pthread_mutex_t *mtx = (pthread_mutex_t *)_mtx;
+    if (rt_thread_checked) {
+        if (pthread_mutex_trylock (mtx) == 0) {
+            return 0;
+        }
+        rt_report_lock_wait (__builtin_return_address (0));
+    }
     int err = pthread_mutex_lock (mtx);
     if (err != 0) {
         fprintf (stderr, "pthread_mutex_lock failed: %s\n", strerror (err));
@@ -188,6 +195,74 @@ mutex_unlock (uintptr_t _mtx) {
     return err;
 }
 
+uintptr_t
+rwlock_create (void) {
+    pthread_rwlock_t *rwlock = malloc (sizeof (pthread_rwlock_t));
+    pthread_rwlockattr_t attr;
+    pthread_rwlockattr_init (&attr);
+#ifdef __GLIBC__
+    // glibc prefers readers by default, so a steady stream of readers would starve the writers
+    pthread_rwlockattr_setkind_np (&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#endif
+    int err = pthread_rwlock_init (rwlock, &attr);
+    pthread_rwlockattr_destroy (&attr);
+    if (err != 0) {
+        fprintf (stderr, "pthread_rwlock_init failed: %s\n", strerror (err));
+        free (rwlock);
+        return 0;
+    }
+    return (uintptr_t)rwlock;
+}
+
+void
+rwlock_free (uintptr_t _rwlock) {
+    pthread_rwlock_t *rwlock = (pthread_rwlock_t *)_rwlock;
+    pthread_rwlock_destroy (rwlock);
+    free (rwlock);
+}
+
+int
+rwlock_rdlock (uintptr_t _rwlock) {
+    pthread_rwlock_t *rwlock = (pthread_rwlock_t *)_rwlock;
+    if (rt_thread_checked) {
+        if (pthread_rwlock_tryrdlock (rwlock) == 0) {
+            return 0;
+        }
+        rt_report_lock_wait (__builtin_return_address (0));
+    }
+    int err = pthread_rwlock_rdlock (rwlock);
+    if (err != 0) {
+        fprintf (stderr, "pthread_rwlock_rdlock failed: %s\n", strerror (err));
+    }
+    return err;
+}
+
+int
+rwlock_wrlock (uintptr_t _rwlock) {
+    pthread_rwlock_t *rwlock = (pthread_rwlock_t *)_rwlock;
+    if (rt_thread_checked) {
+        if (pthread_rwlock_trywrlock (rwlock) == 0) {
+            return 0;
+        }
+        rt_report_lock_wait (__builtin_return_address (0));
+    }
+    int err = pthread_rwlock_wrlock (rwlock);
+    if (err != 0) {
+        fprintf (stderr, "pthread_rwlock_wrlock failed: %s\n", strerror (err));
+    }
+    return err;
+}
+
+int
+rwlock_unlock (uintptr_t _rwlock) {
+    pthread_rwlock_t *rwlock = (pthread_rwlock_t *)_rwlock;
+    int err = pthread_rwlock_unlock (rwlock);
+    if (err != 0) {
+        fprintf (stderr, "pthread_rwlock_unlock failed: %s\n", strerror (err));
+    }
+    return err;
+}
+
 uintptr_t
 cond_create (void) {
     pthread_cond_t *cond = malloc (sizeof (pthread_cond_t));
@@ -225,6 +300,17 @@ cond_wait (uintptr_t c, uintptr_t m) {
     return err;
 }
 
+int
+cond_wait_locked (uintptr_t c, uintptr_t m) {
+    pthread_cond_t *cond = (pthread_cond_t *)c;
+    pthread_mutex_t *mutex = (pthread_mutex_t *)m;
+    int err = pthread_cond_wait (cond, mutex);
+    if (err != 0) {
+        fprintf (stderr, "pthread_cond_wait failed: %s\n", strerror (err));
+    }
+    return err;
+}
+
 int
 cond_signal (uintptr_t c) {
     pthread_cond_t *cond = (pthread_cond_t *)c;
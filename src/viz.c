@@ -20,18 +20,26 @@
 
     3. This notice may not be removed or altered from any source distribution.
 */
-#include <assert.h>
 #include <dispatch/dispatch.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include "conf.h"
 #include "fft.h"
 #include "premix.h"
+#include "ringbuf.h"
 #include "threading.h"
 #include "viz.h"
 
+// The output thread only copies the played data into the tap ring.
+// Conversion, FFT and the listener callbacks run on the low priority viz thread,
+// so that slow listeners can't cause output underruns.
+#define VIZ_TAP_SIZE (2 * 1024 * 1024)
+#define VIZ_CONVERT_FRAMES 4096
+#define VIZ_MIN_FFT_SIZE 256
+#define VIZ_MAX_FFT_SIZE 16384
+
 static dispatch_queue_t sync_queue;
-static dispatch_queue_t process_queue;
 
 // Listeners
 typedef struct wavedata_listener_s {
@@ -43,45 +51,333 @@ typedef struct wavedata_listener_s {
 static wavedata_listener_t *waveform_listeners;
 static wavedata_listener_t *spectrum_listeners;
 
-//#define HISTORY_FRAMES 100000
-
+// Shared between the output thread and the viz thread
+static ringbuf_t _tap;
+static char *_tap_buffer;
+static int _tap_enabled;
+static ddb_waveformat_t _tap_fmt; // owned by the output thread
+static ddb_waveformat_t _tap_fmt_shared; // written by the output thread, when _tap_fmt_seq is odd
+static unsigned _tap_fmt_seq;
+static int _need_reset;
+static int _delay_ms;
+
+static intptr_t _viz_tid;
+static int _viz_terminate;
+
+// Set by viz_configchanged, read by the viz thread
+static int _conf_fft_size = 4096;
+static int _conf_refresh_rate = 60;
+
+// Owned by the viz thread
+static unsigned _tap_fmt_seq_seen;
+static ddb_waveformat_t _src_fmt;
+static ddb_waveformat_t _float_fmt;
+static char *_raw_data;
+static float *_convert_data;
+static float *_history; // ring of interleaved float frames
+static size_t _history_frames; // capacity
+static size_t _history_pos; // total number of frames written
+static float *_wave_data;
 static int _fft_size = 0;
 static float *_freq_data;
 static float *_audio_data;
-static int _need_reset = 0;
-static int audio_data_channels = 0;
+static int _send_empty;
 
 static void
 _free_buffers (void) {
     free (_freq_data);
     free (_audio_data);
+    free (_history);
+    free (_wave_data);
     _freq_data = NULL;
     _audio_data = NULL;
+    _history = NULL;
+    _wave_data = NULL;
+    _history_frames = 0;
+    _history_pos = 0;
+    _fft_size = 0;
+}
+
+static void
+_update_tap_enabled (void) {
+    __atomic_store_n (&_tap_enabled, waveform_listeners != NULL || spectrum_listeners != NULL, __ATOMIC_RELEASE);
+}
+
+void
+viz_tap (const ddb_waveformat_t *fmt, const char *bytes, int size) {
+    if (!__atomic_load_n (&_tap_enabled, __ATOMIC_ACQUIRE) || size <= 0) {
+        return;
+    }
+
+    if (memcmp (fmt, &_tap_fmt, sizeof (ddb_waveformat_t))) {
+        memcpy (&_tap_fmt, fmt, sizeof (ddb_waveformat_t));
+        __atomic_add_fetch (&_tap_fmt_seq, 1, __ATOMIC_ACQ_REL);
+        memcpy (&_tap_fmt_shared, fmt, sizeof (ddb_waveformat_t));
+        __atomic_add_fetch (&_tap_fmt_seq, 1, __ATOMIC_RELEASE);
+    }
+
+    // If the viz thread is behind, drop what doesn't fit
+    int ss = fmt->channels * fmt->bps / 8;
+    size_t avail = ringbuf_get_free (&_tap);
+    if ((size_t)size > avail) {
+        size = (int)(avail - avail % ss);
+    }
+    if (size > 0) {
+        ringbuf_write (&_tap, (char *)bytes, size);
+    }
+}
+
+void
+viz_set_delay (int delay_ms) {
+    __atomic_store_n (&_delay_ms, delay_ms, __ATOMIC_RELAXED);
+}
+
+static void
+_discard_tap (void) {
+    ringbuf_read_commit (&_tap, ringbuf_get_remaining (&_tap));
+}
+
+void
+viz_configchanged (void) {
+    int size = conf_get_int ("viz.fft_size", 4096);
+    int fft_size = VIZ_MIN_FFT_SIZE;
+    while (fft_size < VIZ_MAX_FFT_SIZE && fft_size * 2 <= size) {
+        fft_size *= 2;
+    }
+
+    int refresh_rate = conf_get_int ("viz.refresh_rate", 60);
+    if (refresh_rate < 1) {
+        refresh_rate = 1;
+    }
+    else if (refresh_rate > 240) {
+        refresh_rate = 240;
+    }
+
+    __atomic_store_n (&_conf_fft_size, fft_size, __ATOMIC_RELAXED);
+    __atomic_store_n (&_conf_refresh_rate, refresh_rate, __ATOMIC_RELAXED);
+}
+
+// (Re)allocate the history and analysis buffers, when the format or FFT size changes.
+static void
+_init_buffers (int fft_size, int delay_frames) {
+    size_t history_frames = fft_size * 2 + delay_frames;
+    if (fft_size == _fft_size && history_frames == _history_frames) {
+        return;
+    }
+    _free_buffers ();
+    int channels = _float_fmt.channels;
+    if (channels <= 0) {
+        return;
+    }
+    _fft_size = fft_size;
+    _history_frames = history_frames;
+    _history = calloc (history_frames * channels, sizeof (float));
+    _wave_data = calloc (fft_size * 2 * channels, sizeof (float));
+    _freq_data = calloc (fft_size * DDB_FREQ_MAX_CHANNELS, sizeof (float));
+    _audio_data = calloc (fft_size * 2 * DDB_FREQ_MAX_CHANNELS, sizeof (float));
+}
+
+static void
+_history_append (const float *data, size_t nframes) {
+    int channels = _float_fmt.channels;
+    if (nframes > _history_frames) {
+        data += (nframes - _history_frames) * channels;
+        _history_pos += nframes - _history_frames;
+        nframes = _history_frames;
+    }
+    size_t pos = _history_pos % _history_frames;
+    size_t n = _history_frames - pos;
+    if (n > nframes) {
+        n = nframes;
+    }
+    memcpy (_history + pos * channels, data, n * channels * sizeof (float));
+    memcpy (_history, data + n * channels, (nframes - n) * channels * sizeof (float));
+    _history_pos += nframes;
+}
+
+// Copy the nframes preceding the end frame, which are padded with silence if they are not available
+static void
+_history_copy (float *out, size_t end, size_t nframes) {
+    int channels = _float_fmt.channels;
+    for (size_t i = 0; i < nframes; i++) {
+        size_t frame = end - nframes + i;
+        if (end < nframes - i || frame + _history_frames < _history_pos || frame >= _history_pos) {
+            memset (out + i * channels, 0, channels * sizeof (float));
+        }
+        else {
+            memcpy (out + i * channels, _history + (frame % _history_frames) * channels, channels * sizeof (float));
+        }
+    }
+}
+
+// Move the data from the tap ring into the history.
+// @return number of new frames
+static size_t
+_drain_tap (void) {
+    size_t total = 0;
+    int ss = _src_fmt.channels * _src_fmt.bps / 8;
+    if (ss <= 0 || !_history) {
+        _discard_tap ();
+        return 0;
+    }
+    for (;;) {
+        size_t avail = ringbuf_get_remaining (&_tap) / ss;
+        if (avail == 0) {
+            break;
+        }
+        if (avail > VIZ_CONVERT_FRAMES) {
+            avail = VIZ_CONVERT_FRAMES;
+        }
+        ringbuf_read (&_tap, _raw_data, avail * ss);
+        pcm_convert (&_src_fmt, _raw_data, &_float_fmt, (char *)_convert_data, (int)(avail * ss));
+        _history_append (_convert_data, avail);
+        total += avail;
+    }
+    return total;
+}
+
+static void
+_call_listeners (size_t new_frames, int delay_frames) {
+    int channels = _float_fmt.channels;
+    const int fft_nframes = _fft_size * 2;
+    size_t end = _history_pos > (size_t)delay_frames ? _history_pos - delay_frames : 0;
+
+    // the waveform gets the frames played since the last update
+    int wave_nframes = new_frames < (size_t)fft_nframes ? (int)new_frames : fft_nframes;
+
+    ddb_audio_data_t waveform_data = {
+        .fmt = &_float_fmt,
+        .data = _wave_data,
+        .nframes = wave_nframes
+    };
+
+    ddb_waveformat_t spectrum_fmt = _float_fmt;
+    if (spectrum_fmt.channels > DDB_FREQ_MAX_CHANNELS) {
+        spectrum_fmt.channels = DDB_FREQ_MAX_CHANNELS;
+    }
+    ddb_audio_data_t spectrum_data = {
+        .fmt = &spectrum_fmt,
+        .data = _freq_data,
+        .nframes = new_frames ? _fft_size : 0
+    };
+
+    if (spectrum_listeners && new_frames && _audio_data) {
+        // the FFT window ends at the most recently played frame;
+        // convert it to planar layout, using the waveform buffer as temporary storage
+        float *window = _wave_data;
+        _history_copy (window, end, fft_nframes);
+        for (int c = 0; c < spectrum_fmt.channels; c++) {
+            float *channel = &_audio_data[fft_nframes * c];
+            for (int s = 0; s < fft_nframes; s++) {
+                channel[s] = window[s * channels + c];
+            }
+            fft_calculate (channel, &_freq_data[_fft_size * c], _fft_size);
+        }
+    }
+
+    if (waveform_listeners && _wave_data) {
+        _history_copy (_wave_data, end, wave_nframes);
+    }
+
+    dispatch_sync(sync_queue, ^{
+        for (wavedata_listener_t *l = spectrum_listeners; l; l = l->next) {
+            l->callback (l->ctx, &spectrum_data);
+        }
+        for (wavedata_listener_t *l = waveform_listeners; l; l = l->next) {
+            l->callback (l->ctx, &waveform_data);
+        }
+    });
 }
 
 static void
-_init_buffers (int fft_size) {
-    if (fft_size != _fft_size) {
+_viz_update (void) {
+    // pick up the format changes
+    unsigned seq = __atomic_load_n (&_tap_fmt_seq, __ATOMIC_ACQUIRE);
+    if (seq != _tap_fmt_seq_seen) {
+        if (seq & 1) {
+            return; // being changed
+        }
+        ddb_waveformat_t fmt;
+        memcpy (&fmt, &_tap_fmt_shared, sizeof (ddb_waveformat_t));
+        __atomic_thread_fence (__ATOMIC_ACQUIRE);
+        if (__atomic_load_n (&_tap_fmt_seq, __ATOMIC_RELAXED) != seq) {
+            return;
+        }
+        _tap_fmt_seq_seen = seq;
+        memcpy (&_src_fmt, &fmt, sizeof (ddb_waveformat_t));
+        memcpy (&_float_fmt, &fmt, sizeof (ddb_waveformat_t));
+        _float_fmt.bps = 32;
+        _float_fmt.is_float = 1;
+        _float_fmt.is_bigendian = 0;
+
+        free (_raw_data);
+        free (_convert_data);
+        _raw_data = malloc (VIZ_CONVERT_FRAMES * fmt.channels * fmt.bps / 8);
+        _convert_data = malloc (VIZ_CONVERT_FRAMES * fmt.channels * sizeof (float));
         _free_buffers ();
-        if (fft_size != 0) {
-            _freq_data = calloc(fft_size * DDB_FREQ_MAX_CHANNELS, sizeof (float));
-            _audio_data = calloc(fft_size * 2 * DDB_FREQ_MAX_CHANNELS, sizeof (float));
+        _discard_tap ();
+    }
+
+    if (__atomic_exchange_n (&_need_reset, 0, __ATOMIC_ACQ_REL)) {
+        _discard_tap ();
+        if (_history) {
+            memset (_history, 0, _history_frames * _float_fmt.channels * sizeof (float));
         }
-        _fft_size = fft_size;
+        _history_pos = 0;
+        _send_empty = 1;
+    }
+
+    int delay_frames = (int)((int64_t)__atomic_load_n (&_delay_ms, __ATOMIC_RELAXED) * _float_fmt.samplerate / 1000);
+    _init_buffers (__atomic_load_n (&_conf_fft_size, __ATOMIC_RELAXED), delay_frames);
+
+    size_t new_frames = _drain_tap ();
+    if (!__atomic_load_n (&_tap_enabled, __ATOMIC_ACQUIRE) || !_history) {
+        return;
+    }
+
+    if (new_frames || _send_empty) {
+        // after a reset, the listeners get an empty update, to clear the display
+        _send_empty = 0;
+        _call_listeners (new_frames, delay_frames);
+    }
+}
+
+static void
+_viz_thread (void *ctx) {
+    while (!_viz_terminate) {
+        _viz_update ();
+
+        int refresh_rate = __atomic_load_n (&_conf_refresh_rate, __ATOMIC_RELAXED);
+        usleep (__atomic_load_n (&_tap_enabled, __ATOMIC_ACQUIRE) ? 1000000 / refresh_rate : 100000);
     }
 }
 
 void
 viz_init (void) {
     sync_queue = dispatch_queue_create("Viz Sync Queue", NULL);
-    process_queue = dispatch_queue_create("Viz Process Queue", NULL);
+    _tap_buffer = malloc (VIZ_TAP_SIZE);
+    ringbuf_init (&_tap, _tap_buffer, VIZ_TAP_SIZE);
+    viz_configchanged ();
+    _viz_terminate = 0;
+    _viz_tid = thread_start_low_priority (_viz_thread, NULL);
 }
 
 void
 viz_free (void) {
-    dispatch_release(process_queue);
+    _viz_terminate = 1;
+    if (_viz_tid) {
+        thread_join (_viz_tid);
+        _viz_tid = 0;
+    }
     dispatch_release(sync_queue);
     _free_buffers();
+    free (_raw_data);
+    free (_convert_data);
+    _raw_data = NULL;
+    _convert_data = NULL;
+    ringbuf_deinit (&_tap);
+    free (_tap_buffer);
+    _tap_buffer = NULL;
 }
 
 void
@@ -93,6 +389,7 @@ viz_waveform_listen (void *ctx, void (*callback)(void *ctx, const ddb_audio_data
         l->callback = callback;
         l->next = waveform_listeners;
         waveform_listeners = l;
+        _update_tap_enabled ();
     });
 }
 
@@ -112,6 +409,7 @@ viz_waveform_unlisten (void *ctx) {
                 break;
             }
         }
+        _update_tap_enabled ();
     });
 }
 
@@ -124,6 +422,7 @@ viz_spectrum_listen (void *ctx, void (*callback)(void *ctx, const ddb_audio_data
         l->callback = callback;
         l->next = spectrum_listeners;
         spectrum_listeners = l;
+        _update_tap_enabled ();
     });
 }
 
@@ -143,102 +442,11 @@ viz_spectrum_unlisten (void *ctx) {
                 break;
             }
         }
+        _update_tap_enabled ();
     });
 }
 
 void
 viz_reset (void) {
-    dispatch_sync(sync_queue, ^{
-        _need_reset = 1;
-    });
-}
-
-void
-viz_process (char * restrict _bytes, int _bytes_size, DB_output_t *output, int fft_size, int wave_size) {
-    dispatch_sync(sync_queue, ^{
-        _init_buffers(fft_size);
-        if (!waveform_listeners && !spectrum_listeners) {
-            return;
-        }
-
-        char *bytes = _bytes;
-
-        // convert to float
-        ddb_waveformat_t *out_fmt = calloc (1, sizeof (ddb_waveformat_t));
-        out_fmt->bps = 32;
-        out_fmt->channels = output->fmt.channels;
-        out_fmt->samplerate = output->fmt.samplerate;
-        out_fmt->channelmask = output->fmt.channelmask;
-        out_fmt->is_float = 1;
-        out_fmt->is_bigendian = 0;
-
-        const int fft_nframes = fft_size * 2;
-
-        // calculate the size which can fit either the FFT input, or the wave data.
-        const int output_nframes = fft_nframes > wave_size ? fft_nframes : wave_size;
-
-        const int final_output_size = output_nframes * out_fmt->channels * sizeof (float);
-        const int final_input_size = output_nframes * output->fmt.channels * (output->fmt.bps/8);
-        float *data = calloc(1, final_output_size);
-
-        if (bytes != NULL) {
-            // take only as much bytes as we have available.
-            const int convert_size = _bytes_size < final_input_size ? _bytes_size : final_input_size;
-
-            // After this runs, we'll have a buffer with enough samples for FFT, padded with 0s if needed.
-            pcm_convert (&output->fmt, bytes, out_fmt, (char *)data, convert_size);
-        }
-
-        ddb_audio_data_t *waveform_data = calloc(1, sizeof(ddb_audio_data_t));
-        waveform_data->fmt = out_fmt;
-        waveform_data->data = data;
-        waveform_data->nframes = wave_size;
-
-        if (_need_reset || out_fmt->channels != audio_data_channels || !spectrum_listeners) {
-            // reset
-            audio_data_channels = out_fmt->channels;
-            memset (_freq_data, 0, sizeof (float) * _fft_size * DDB_FREQ_MAX_CHANNELS);
-            memset (_audio_data, 0, sizeof (float) * _fft_size * 2 * DDB_FREQ_MAX_CHANNELS);
-            _need_reset = 0;
-        }
-
-        if (spectrum_listeners) {
-            // convert samples in planar layout
-            assert (fft_nframes == _fft_size * 2);
-            for (int c = 0; c < audio_data_channels; c++) {
-                float *channel = &_audio_data[_fft_size * 2 * c];
-                for (int s = 0; s < fft_nframes; s++) {
-                    channel[s] = data[s * audio_data_channels + c];
-                }
-            }
-
-            // calc fft
-            if (_audio_data != NULL) {
-                for (int c = 0; c < audio_data_channels; c++) {
-                    fft_calculate (&_audio_data[_fft_size * 2 * c], &_freq_data[_fft_size * c], _fft_size);
-                }
-            }
-            ddb_audio_data_t spectrum_data = {
-                .fmt = out_fmt,
-                .data = _freq_data,
-                .nframes = _fft_size
-            };
-            for (wavedata_listener_t *l = spectrum_listeners; l; l = l->next) {
-                l->callback (l->ctx, &spectrum_data);
-            }
-        }
-
-        // Pass to async queue for processing and callbacks
-        dispatch_async (process_queue, ^{
-            for (wavedata_listener_t *l = waveform_listeners; l; l = l->next) {
-                l->callback (l->ctx, waveform_data);
-            }
-
-            free (data);
-            free (out_fmt);
-            free (waveform_data);
-        });
-
-    });
+    __atomic_store_n (&_need_reset, 1, __ATOMIC_RELEASE);
 }
-
@@ -25,12 +25,22 @@
 
 #include <deadbeef/deadbeef.h>
 
+// Called on the output thread with the data which is being played.
+// The data is copied into a lock-free ring, and analyzed later on the viz thread.
 void
-viz_process (char * restrict bytes, int bytes_size, DB_output_t *output, int fft_size, int wave_size);
+viz_tap (const ddb_waveformat_t *fmt, const char *bytes, int size);
+
+// Delay between the tapped data and the audible output, e.g. for AirPlay
+void
+viz_set_delay (int delay_ms);
 
 void
 viz_init (void);
 
+// Re-reads the FFT size and the refresh rate, called on DB_EV_CONFIGCHANGED
+void
+viz_configchanged (void);
+
 void
 viz_free (void);
 